@@ -0,0 +1,224 @@
+#pragma once
+#include <algorithm>
+#include <cstdint>
+#include <mutex>
+#include <stdexcept>
+#include <unordered_map>
+#include <vector>
+
+#include "../ICachePolicy.h"
+#include "../NodePool.h"
+#include "../Stats/StatsRecorder.h"
+
+//2Q (full version): a new key enters A1in, a FIFO of at most kinRatio * capacity entries, and a hit there costs
+//nothing; entries leaving A1in are remembered by key in A1out for koutRatio * capacity more insertions, and only
+//a key seen again within that window is admitted to Am, the LRU holding the proven working set
+//a scan passes through A1in and A1out without touching Am, so it costs one FIFO's worth of cache at most
+//A1out keeps keys only, in a ring that overwrites the oldest; resident nodes come from a NodePool
+template<typename Key, typename Value, bool EnableStats = true>
+class TwoQueueCache : public ICachePolicy<Key, Value> {
+private:
+    static const uint32_t NIL = UINT32_MAX;   //as NodePool::NIL
+    //an index entry with this bit set is a slot of the A1out ring, otherwise a pool slot
+    static const uint32_t GHOST_BIT = 1u << 31;
+    //pool slots of the list sentinels
+    static const uint32_t A1IN = 0;
+    static const uint32_t AM = 1;
+
+    struct Node {
+        Key key{};
+        Value value{};
+        uint32_t pre = NIL;
+        uint32_t next = NIL;
+        bool inAm = false;
+    };
+
+    size_t capacity_;
+    size_t kin_;
+    size_t a1inCount_;
+    size_t residentCount_;
+    mutex mutex_;
+    NodePool<Node> pool_;
+    vector<Key> ghosts_;       //A1out, oldest overwritten first
+    size_t nextGhost_;
+    unordered_map<Key, uint32_t> index_;
+    StatsRecorder<EnableStats> recorder_;
+
+public:
+    TwoQueueCache() = delete;
+    TwoQueueCache(unsigned int capacity, double kinRatio = 0.25, double koutRatio = 0.5);
+    ~TwoQueueCache() override = default;
+
+    void put(const Key& key, const Value& value) override;
+    optional<Value> get(const Key& key) override;
+    bool remove(const Key& key) override;
+    bool isExists(const Key& key) override;
+    optional<Value> peek(const Key& key) override;
+    CacheStats stats() override;
+
+private:
+    void pushBack(uint32_t sentinel, uint32_t node);
+    void unlink(uint32_t node);
+    void reclaim();
+    void remember(const Key& key);
+};
+
+template<typename Key, typename Value, bool EnableStats>
+TwoQueueCache<Key, Value, EnableStats>::TwoQueueCache(unsigned int capacity, double kinRatio, double koutRatio)
+    : capacity_{ capacity }, kin_{ max<size_t>(1, static_cast<size_t>(capacity * kinRatio)) }, a1inCount_{ 0 },
+    residentCount_{ 0 }, pool_{ static_cast<size_t>(capacity) + 2 },
+    ghosts_(max<size_t>(1, static_cast<size_t>(capacity * koutRatio))), nextGhost_{ 0 } {
+    if (capacity >= GHOST_BIT)
+        throw runtime_error("In TwoQueueCache.h-----Capacity must stay below 2^31.");
+    for (uint32_t sentinel = A1IN; sentinel <= AM; ++sentinel) {
+        this->pool_.acquire();
+        this->pool_[sentinel].pre = this->pool_[sentinel].next = sentinel;
+    }
+}
+
+template<typename Key, typename Value, bool EnableStats>
+void TwoQueueCache<Key, Value, EnableStats>::put(const Key& key, const Value& value) {
+    if (this->capacity_ == 0) return;
+    lock_guard<mutex> lock{ this->mutex_ };
+    auto it = this->index_.find(key);
+    if (it != this->index_.end() && !(it->second & GHOST_BIT)) {
+        const uint32_t node = it->second;
+        this->recorder_.record(StatsCounter::Update);
+        this->recorder_.valueReplaced(this->pool_[node].value, value);
+        this->pool_[node].value = value;
+        if (this->pool_[node].inAm) {
+            unlink(node);
+            pushBack(AM, node);
+        }
+        return;
+    }
+
+    //a key still in A1out was reused soon enough to earn a place in Am
+    const bool remembered = it != this->index_.end();
+    if (remembered)
+        this->index_.erase(it);
+    if (this->residentCount_ >= this->capacity_)
+        reclaim();
+    const uint32_t node = this->pool_.acquire();
+    Node& entry = this->pool_[node];
+    entry.key = key;
+    entry.value = value;
+    entry.inAm = remembered;
+    pushBack(remembered ? AM : A1IN, node);
+    if (!remembered)
+        ++this->a1inCount_;
+    ++this->residentCount_;
+    this->index_.emplace(key, node);
+    this->recorder_.record(StatsCounter::Put);
+    this->recorder_.entryAdded(key, value);
+}
+
+template<typename Key, typename Value, bool EnableStats>
+optional<Value> TwoQueueCache<Key, Value, EnableStats>::get(const Key& key) {
+    lock_guard<mutex> lock{ this->mutex_ };
+    auto it = this->index_.find(key);
+    if (it == this->index_.end() || (it->second & GHOST_BIT)) {
+        if (it != this->index_.end())
+            this->recorder_.record(StatsCounter::GhostHit);
+        this->recorder_.record(StatsCounter::Miss);
+        return nullopt;
+    }
+    this->recorder_.record(StatsCounter::Hit);
+    const uint32_t node = it->second;
+    //A1in is a FIFO, a hit there leaves the entry where it is
+    if (this->pool_[node].inAm) {
+        unlink(node);
+        pushBack(AM, node);
+    }
+    return this->pool_[node].value;
+}
+
+//a key in A1out is forgotten too, its ring slot is left to be overwritten
+template<typename Key, typename Value, bool EnableStats>
+bool TwoQueueCache<Key, Value, EnableStats>::remove(const Key& key) {
+    lock_guard<mutex> lock{ this->mutex_ };
+    auto it = this->index_.find(key);
+    if (it == this->index_.end())
+        return false;
+    const uint32_t node = it->second;
+    this->index_.erase(it);
+    if (node & GHOST_BIT)
+        return false;
+    this->recorder_.entryRemoved(key, this->pool_[node].value);
+    if (!this->pool_[node].inAm)
+        --this->a1inCount_;
+    unlink(node);
+    --this->residentCount_;
+    this->pool_.release(node);
+    return true;
+}
+
+template<typename Key, typename Value, bool EnableStats>
+bool TwoQueueCache<Key, Value, EnableStats>::isExists(const Key& key) {
+    lock_guard<mutex> lock{ this->mutex_ };
+    auto it = this->index_.find(key);
+    return it != this->index_.end() && !(it->second & GHOST_BIT);
+}
+
+template<typename Key, typename Value, bool EnableStats>
+optional<Value> TwoQueueCache<Key, Value, EnableStats>::peek(const Key& key) {
+    lock_guard<mutex> lock{ this->mutex_ };
+    auto it = this->index_.find(key);
+    if (it == this->index_.end() || (it->second & GHOST_BIT))
+        return nullopt;
+    return this->pool_[it->second].value;
+}
+
+template<typename Key, typename Value, bool EnableStats>
+CacheStats TwoQueueCache<Key, Value, EnableStats>::stats() {
+    lock_guard<mutex> lock{ this->mutex_ };
+    return this->recorder_.collect(this->residentCount_);
+}
+
+template<typename Key, typename Value, bool EnableStats>
+void TwoQueueCache<Key, Value, EnableStats>::pushBack(uint32_t sentinel, uint32_t node) {
+    const uint32_t back = this->pool_[sentinel].pre;
+    this->pool_[node].pre = back;
+    this->pool_[node].next = sentinel;
+    this->pool_[back].next = node;
+    this->pool_[sentinel].pre = node;
+}
+
+template<typename Key, typename Value, bool EnableStats>
+void TwoQueueCache<Key, Value, EnableStats>::unlink(uint32_t node) {
+    Node& entry = this->pool_[node];
+    this->pool_[entry.pre].next = entry.next;
+    this->pool_[entry.next].pre = entry.pre;
+    entry.pre = entry.next = NIL;
+}
+
+//A1in gives up its oldest entry while it is over Kin, its key moves to A1out; otherwise the LRU end of Am goes
+template<typename Key, typename Value, bool EnableStats>
+void TwoQueueCache<Key, Value, EnableStats>::reclaim() {
+    const bool fromA1in = this->a1inCount_ > this->kin_ || this->pool_[AM].next == AM;
+    const uint32_t victim = this->pool_[fromA1in ? A1IN : AM].next;
+    Node& entry = this->pool_[victim];
+    unlink(victim);
+    this->index_.erase(entry.key);
+    --this->residentCount_;
+    this->recorder_.record(StatsCounter::Eviction);
+    this->recorder_.entryRemoved(entry.key, entry.value);
+    this->notifyEviction(entry.key, entry.value);
+    if (fromA1in) {
+        --this->a1inCount_;
+        remember(entry.key);
+    }
+    this->pool_.release(victim);
+}
+
+template<typename Key, typename Value, bool EnableStats>
+void TwoQueueCache<Key, Value, EnableStats>::remember(const Key& key) {
+    const uint32_t slot = static_cast<uint32_t>(this->nextGhost_);
+    //the slot's previous key is dropped unless it was reused or removed meanwhile and the index moved on
+    auto old = this->index_.find(this->ghosts_[slot]);
+    if (old != this->index_.end() && old->second == (slot | GHOST_BIT))
+        this->index_.erase(old);
+    this->ghosts_[slot] = key;
+    this->index_.emplace(key, slot | GHOST_BIT);
+    this->nextGhost_ = (this->nextGhost_ + 1) % this->ghosts_.size();
+}
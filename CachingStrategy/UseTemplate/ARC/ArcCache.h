@@ -2,19 +2,22 @@
 #include"../ICachePolicy.h"
 #include "ArcLfu.h"
 #include "ArcLru.h"
+#include "../Stats/StatsRecorder.h"
 
-template <typename Key,typename Value>
+template<typename Key, typename Value, bool EnableStats = true>
 class ArcCache :public ICachePolicy<Key,Value> {
 private:
-	using LFU = ArcLfu<Key, Value>;
-	using LRU = ArcLru<Key, Value>;
-	using pLFU = unique_ptr<ArcLfu<Key, Value>>;
-	using pLRU = unique_ptr<ArcLru<Key, Value>>;
+	using LFU = ArcLfu<Key, Value, EnableStats>;
+	using LRU = ArcLru<Key, Value, EnableStats>;
+	using pLFU = unique_ptr<LFU>;
+	using pLRU = unique_ptr<LRU>;
 private:
 	pLFU lfu_;
 	pLRU lru_;
 	unsigned int capacity_;
 	unsigned int threshold_;
+	//lookups and puts are counted here, the halves see several internal calls per operation
+	StatsRecorder<EnableStats> recorder_;
 public:
 	ArcCache() = delete;
 	ArcCache(const unsigned int& capacity) :
@@ -26,16 +29,26 @@ public:
 	void put(const Key& key, const Value& value);
 	bool isExists(const Key& key);
 	bool remove(const Key& key);
+	optional<Value> peek(const Key& key);
+	CacheStats stats() override;
+	//one profiler per half, the halves lock separately
+	void setProfilers(LockProfiler* lruProfiler, LockProfiler* lfuProfiler);
+	void setEvictionListener(const typename ICachePolicy<Key, Value>::EvictionListener& listener) override;
+
+	//keeps the T1/T2 split: both halves are written with their adapted capacities and ghost keys
+	//each half is written under its own lock, so they are not one point-in-time image
+	void snapshot(const string& path);
+	void restore(const string& path);
 private:
-	bool checkGhost(const Key& key);
+	void adapt(bool lruGhost, bool lfuGhost);
+	void replace(bool lfuGhost);
 	void transfer(const Key& key, const Value& value);
 };
 
 
-template<typename Key, typename Value>
-inline optional<Value> ArcCache<Key, Value>::get(const Key& key)
+template<typename Key, typename Value, bool EnableStats>
+inline optional<Value> ArcCache<Key, Value, EnableStats>::get(const Key& key)
 {
-	if (checkGhost(key)) return nullopt;
 	optional<Value> value = optional<Value>();
 	bool isOver = false;
 	if (this->lru_->isExists(key)) {
@@ -47,34 +60,54 @@ inline optional<Value> ArcCache<Key, Value>::get(const Key& key)
 	else if (this->lfu_->isExists(key)) {
 		value = this->lfu_->get(key);
 	}
+	this->recorder_.record(value.has_value() ? StatsCounter::Hit : StatsCounter::Miss);
 	return value;
 }
 
-template<typename Key, typename Value>
-void ArcCache<Key, Value>::put(const Key& key, const Value& value)
+template<typename Key, typename Value, bool EnableStats>
+void ArcCache<Key, Value, EnableStats>::put(const Key& key, const Value& value)
 {
-	checkGhost(key);
 	if (this->lru_->isExists(key)) {
+		this->recorder_.record(StatsCounter::Update);
 		transfer(key, value);
 	}
 	else if (this->lfu_->isExists(key)) {
+		this->recorder_.record(StatsCounter::Update);
 		this->lfu_->put(key, value);
 	}
 	else {
-		this->lru_->put(key, value);
+		this->recorder_.record(StatsCounter::Put);
+		//a ghost hit means the key came back after an eviction, so like ARC it enters the frequent half
+		const bool lruGhost = this->lru_->checkGhost(key);
+		const bool lfuGhost = !lruGhost && this->lfu_->checkGhost(key);
+		adapt(lruGhost, lfuGhost);
+		if (this->lru_->size() + this->lfu_->size() >= this->capacity_)
+			replace(lfuGhost);
+		if (lruGhost || lfuGhost)
+			this->lfu_->admit(key, value);
+		else
+			this->lru_->admit(key, value);
 	}
 }
 
-template<typename Key, typename Value>
-bool ArcCache<Key, Value>::isExists(const Key& key)
+template<typename Key, typename Value, bool EnableStats>
+bool ArcCache<Key, Value, EnableStats>::isExists(const Key& key)
 {
 	if (this->lfu_->isExists(key))return true;
 	if (this->lru_->isExists(key))return true;
 	return false;
 }
 
-template<typename Key, typename Value>
-bool ArcCache<Key, Value>::remove(const Key& key)
+template<typename Key, typename Value, bool EnableStats>
+optional<Value> ArcCache<Key, Value, EnableStats>::peek(const Key& key)
+{
+	optional<Value> value = this->lru_->peek(key);
+	if (value.has_value()) return value;
+	return this->lfu_->peek(key);
+}
+
+template<typename Key, typename Value, bool EnableStats>
+bool ArcCache<Key, Value, EnableStats>::remove(const Key& key)
 {
 	if (this->lfu_->isExists(key)) {
 		this->lfu_->remove(key);
@@ -87,25 +120,84 @@ bool ArcCache<Key, Value>::remove(const Key& key)
 	return false;
 }
 
-template<typename Key, typename Value>
-bool ArcCache<Key, Value>::checkGhost(const Key& key)
+template<typename Key, typename Value, bool EnableStats>
+void ArcCache<Key, Value, EnableStats>::setProfilers(LockProfiler* lruProfiler, LockProfiler* lfuProfiler)
 {
-	if (this->lru_->checkGhost(key)) {
-		this->lru_->increaseCapacity();
-		this->lfu_->decreaseCapacity();
-		return true;
+	this->lru_->setProfiler(lruProfiler);
+	this->lfu_->setProfiler(lfuProfiler);
+}
+
+//evictions, ghost hits, size and bytes come from the halves
+template<typename Key, typename Value, bool EnableStats>
+CacheStats ArcCache<Key, Value, EnableStats>::stats()
+{
+	CacheStats total = this->recorder_.collect(0);
+	for (CacheStats half : { this->lru_->stats(), this->lfu_->stats() }) {
+		total.evictions += half.evictions;
+		total.ghostHits += half.ghostHits;
+		total.size += half.size;
+		total.bytes += half.bytes;
 	}
-	else if (this->lfu_->checkGhost(key)) {
-		this->lfu_->increaseCapacity();
-		this->lru_->decreaseCapacity();
-		return true;
+	return total;
+}
+
+template<typename Key, typename Value, bool EnableStats>
+void ArcCache<Key, Value, EnableStats>::setEvictionListener(const typename ICachePolicy<Key, Value>::EvictionListener& listener)
+{
+	this->lru_->setEvictionListener(listener);
+	this->lfu_->setEvictionListener(listener);
+}
+
+template<typename Key, typename Value, bool EnableStats>
+void ArcCache<Key, Value, EnableStats>::snapshot(const string& path)
+{
+	SnapshotWriter writer{ path, SnapshotHeader::of<Key, Value>(SnapshotEngine::Arc) };
+	writer.write<uint32_t>(this->capacity_);
+	this->lru_->saveTo(writer);
+	this->lfu_->saveTo(writer);
+	writer.commit();
+}
+
+template<typename Key, typename Value, bool EnableStats>
+void ArcCache<Key, Value, EnableStats>::restore(const string& path)
+{
+	SnapshotReader reader{ path, SnapshotHeader::of<Key, Value>(SnapshotEngine::Arc) };
+	//the halves restore their own capacities, they only add up if the total is the same
+	if (reader.read<uint32_t>() != this->capacity_)
+		throw runtime_error("In ArcCache.h-----Snapshot was taken with a different capacity.");
+	this->lru_->loadFrom(reader);
+	this->lfu_->loadFrom(reader);
+}
+
+//a ghost hit only moves the target, the capacities always sum to capacity_ and replace evicts towards them.
+//as in ARC the step is the ratio of the other ghost list to the one hit, at least one slot
+template<typename Key, typename Value, bool EnableStats>
+void ArcCache<Key, Value, EnableStats>::adapt(bool lruGhost, bool lfuGhost)
+{
+	//the hit key has already left its ghost list, count it back in
+	if (lruGhost) {
+		const size_t step = max<size_t>(1, this->lfu_->ghostSize() / (this->lru_->ghostSize() + 1));
+		this->lru_->increaseCapacity(this->lfu_->decreaseCapacity(step));
 	}
-	return false;
+	else if (lfuGhost) {
+		const size_t step = max<size_t>(1, this->lru_->ghostSize() / (this->lfu_->ghostSize() + 1));
+		this->lfu_->increaseCapacity(this->lru_->decreaseCapacity(step));
+	}
+}
+
+//ARC's REPLACE on a full cache: the LRU half gives up its entry if it is above its target, or at it when the key
+//was an LFU ghost, otherwise the LFU half does
+template<typename Key, typename Value, bool EnableStats>
+void ArcCache<Key, Value, EnableStats>::replace(bool lfuGhost)
+{
+	if (this->lru_->replace(lfuGhost) || this->lfu_->replace(true))
+		return;
+	this->lru_->replace(true);
 }
 
-template<typename Key, typename Value>
-void ArcCache<Key, Value>::transfer(const Key& key, const Value& value)
+template<typename Key, typename Value, bool EnableStats>
+void ArcCache<Key, Value, EnableStats>::transfer(const Key& key, const Value& value)
 {
 	this->lru_->remove(key);
-	this->lfu_->put(key, value);
+	this->lfu_->admit(key, value);
 }
@@ -1,11 +1,16 @@
 #pragma once
 #include "ArcNodeList.h"
 #include "../ICachePolicy.h"
+#include "../SeqlockIndex.h"
+#include "../Snapshot/Snapshot.h"
+#include "../Stats/StatsRecorder.h"
+#include "../Stats/LockProfiler.h"
 #include <mutex>
+#include <shared_mutex>
 #include <unordered_map>
 #include <map>
 
-template<typename Key, typename Value>
+template<typename Key, typename Value, bool EnableStats = true>
 class ArcLfu:public ICachePolicy<Key, Value> {
 private:
 	using Node = ArcNode<Key, Value>;
@@ -16,12 +21,15 @@ private:
 	using FreqHash = map<unsigned int, FreqPtr>;
 
 private:
-	mutex mutex_;
+	shared_mutex mutex_;
 	NodeHash nodeHash_;
 	NodeHash ghostHash_;
 	FreqHash freqHash_;
 	FreqList ghostList_;
+	SeqlockIndex<Key, Value> readIndex_;   //lets peek and isExists skip the lock for trivially copyable entries
 	unsigned int capacity_;
+	StatsRecorder<EnableStats> recorder_;
+	atomic<LockProfiler*> profiler_{ nullptr };
 	//unsigned int minFreq_;
 
 public:
@@ -29,13 +37,32 @@ public:
 	ArcLfu(unsigned int capacity);
 	~ArcLfu() = default;
 	void put(const Key&, const Value&);
+	//put for ArcCache, which runs REPLACE itself: a new key never evicts, the half may go above its capacity
+	void admit(const Key&, const Value&);
 	optional<Value> get(const Key&);
 	bool isExists(const Key&);
 	bool remove(const Key&);
-	void increaseCapacity();
-	void decreaseCapacity();
+	optional<Value> peek(const Key&);
+	CacheStats stats() override;
+	//times get/put and the wait for mutex_ into profiler, nullptr detaches it
+	void setProfiler(LockProfiler* profiler) { this->profiler_.store(profiler, memory_order_relaxed); }
+	void increaseCapacity(size_t slots);
+	//gives up to slots but keeps the last one, returns how many it gave; entries above the smaller capacity stay until replace
+	size_t decreaseCapacity(size_t slots);
+	//ARC's REPLACE: gives up the least frequent entry if the half is above its capacity, or at it with atCapacity
+	bool replace(bool atCapacity);
+	size_t size();
+	size_t ghostSize();
 	bool checkGhost(const Key& key);
+
+	//writes the adapted capacity, the entries from the lowest frequency up and then the ghost keys
+	void snapshot(const string& path);
+	void restore(const string& path);
+	void saveTo(SnapshotWriter& writer);
+	void loadFrom(SnapshotReader& reader);
 private:
+	void clearAll();
+	void store(const Key&, const Value&, bool evict);
 	void updateNode(const NodePtr&, const Value&);
 	void insertNewNode(const Key&, const NodePtr&);
 	void insertIntoFreqHash(const NodePtr&);
@@ -45,34 +72,50 @@ private:
 	void removeFromNodeHash(const NodePtr&);
 	void evictLeastFrequentNode();
 	void insertIntoGhost(const NodePtr node);
+	void wakeReadIndex();
 	
 	//void updateMinFreq();
 
 };
 
-template<typename Key, typename Value>
-ArcLfu<Key, Value>::ArcLfu(unsigned int capacity) :capacity_{ capacity } {}
+template<typename Key, typename Value, bool EnableStats>
+ArcLfu<Key, Value, EnableStats>::ArcLfu(unsigned int capacity) :capacity_{ capacity } {}
+
+
+template<typename Key, typename Value, bool EnableStats>
+void ArcLfu<Key, Value, EnableStats>::put(const Key& key, const Value& value) {
+	store(key, value, true);
+}
 
+template<typename Key, typename Value, bool EnableStats>
+void ArcLfu<Key, Value, EnableStats>::admit(const Key& key, const Value& value) {
+	store(key, value, false);
+}
 
-template<typename Key, typename Value>
-void ArcLfu<Key, Value>::put(const Key& key, const Value& value) {
-	lock_guard<mutex> lock{ this->mutex_ };
+template<typename Key, typename Value, bool EnableStats>
+void ArcLfu<Key, Value, EnableStats>::store(const Key& key, const Value& value, bool evict) {
+	ProfiledLock<shared_mutex> lock{ this->mutex_, this->profiler_.load(memory_order_relaxed), ProfiledOperation::Put };
 	auto it = this->nodeHash_.find(key);
 	if (it != this->nodeHash_.end()) {
 		NodePtr node = it->second;
+		this->recorder_.record(StatsCounter::Update);
+		this->recorder_.valueReplaced(node->peekValue(), value);
 		updateNode(node, value);
+		this->readIndex_.assign(key, value);
 		return;
 	}
-	if (this->nodeHash_.size() >= this->capacity_) {
+	if (evict && this->nodeHash_.size() >= this->capacity_) {
 		evictLeastFrequentNode();
 	}
 
+	this->recorder_.record(StatsCounter::Put);
+	this->recorder_.entryAdded(key, value);
 	NodePtr newNode = make_shared<Node>(key, value);
 	insertNewNode(key, newNode);
 }
 
-template<typename Key, typename Value>
-void ArcLfu<Key, Value>::updateNode(const NodePtr& node, const Value& value) {
+template<typename Key, typename Value, bool EnableStats>
+void ArcLfu<Key, Value, EnableStats>::updateNode(const NodePtr& node, const Value& value) {
 	node->setValue(value);
 	removeFromFreqHash(node);
 	node->increaseAccessCount();
@@ -91,14 +134,14 @@ void ArcLfu<Key, Value>::updateNode(const NodePtr& node, const Value& value) {
 //		this->minFreq_ = 1;
 //}
 
-template<typename Key, typename Value>
-void ArcLfu<Key, Value>::insertNewNode(const Key& key, const NodePtr& node) {
+template<typename Key, typename Value, bool EnableStats>
+void ArcLfu<Key, Value, EnableStats>::insertNewNode(const Key& key, const NodePtr& node) {
 	insertIntoNodeHash(key, node);
 	insertIntoFreqHash(node);
 }
 
-template<typename Key, typename Value>
-void ArcLfu<Key, Value>::insertIntoFreqHash(const NodePtr& node) {
+template<typename Key, typename Value, bool EnableStats>
+void ArcLfu<Key, Value, EnableStats>::insertIntoFreqHash(const NodePtr& node) {
 	const unsigned int index = node->getAccessCount();
 	auto it = this->freqHash_.find(index);
 	if (it == this->freqHash_.end()) {
@@ -108,25 +151,27 @@ void ArcLfu<Key, Value>::insertIntoFreqHash(const NodePtr& node) {
 	this->freqHash_[index]->insertNode(node);
 }
 
-template<typename Key, typename Value>
-void ArcLfu<Key, Value>::insertIntoNodeHash(const Key& key, const NodePtr& node) {
+template<typename Key, typename Value, bool EnableStats>
+void ArcLfu<Key, Value, EnableStats>::insertIntoNodeHash(const Key& key, const NodePtr& node) {
 	this->nodeHash_.emplace(key, node);
+	this->readIndex_.assign(key, node->peekValue());
 }
 
-template<typename Key, typename Value>
-void ArcLfu<Key, Value>::removeNode(const NodePtr& node) {
+template<typename Key, typename Value, bool EnableStats>
+void ArcLfu<Key, Value, EnableStats>::removeNode(const NodePtr& node) {
 	removeFromFreqHash(node);
 	removeFromNodeHash(node);
 }
 
-template<typename Key, typename Value>
-void ArcLfu<Key, Value>::removeFromNodeHash(const NodePtr& node) {
+template<typename Key, typename Value, bool EnableStats>
+void ArcLfu<Key, Value, EnableStats>::removeFromNodeHash(const NodePtr& node) {
 	const Key key = node->getKey();
 	this->nodeHash_.erase(key);
+	this->readIndex_.erase(key);
 }
 
-template<typename Key, typename Value>
-void ArcLfu<Key, Value>::removeFromFreqHash(const NodePtr& node) {
+template<typename Key, typename Value, bool EnableStats>
+void ArcLfu<Key, Value, EnableStats>::removeFromFreqHash(const NodePtr& node) {
 	unsigned int freq = node->getAccessCount();
 	auto it = this->freqHash_.find(freq);
 	if (it == this->freqHash_.end())
@@ -138,79 +183,238 @@ void ArcLfu<Key, Value>::removeFromFreqHash(const NodePtr& node) {
 	}
 }
 
-template<typename Key, typename Value>
-void ArcLfu<Key, Value>::evictLeastFrequentNode() {
+template<typename Key, typename Value, bool EnableStats>
+void ArcLfu<Key, Value, EnableStats>::evictLeastFrequentNode() {
 	auto it = this->freqHash_.begin();
 	if (it == this->freqHash_.end())
 		return;
 	NodePtr node = it->second->getLeastNode();
 	removeNode(node);
+	insertIntoGhost(node);
+	this->recorder_.record(StatsCounter::Eviction);
+	this->recorder_.entryRemoved(node->getKey(), node->peekValue());
+	this->notifyEviction(node->getKey(), node->getValue());
 
 	/*removeFromNodeHash(node);
 	* freqList->removeNode(node);
 	*/
 }
 
-template<typename Key, typename Value>
-void ArcLfu<Key, Value>::insertIntoGhost(const NodePtr node)
+template<typename Key, typename Value, bool EnableStats>
+void ArcLfu<Key, Value, EnableStats>::insertIntoGhost(const NodePtr node)
 {
 	if (this->ghostHash_.size() >= this->capacity_) {
 		NodePtr leastGhost = this->ghostList_.getLeastNode();
 		Key key = leastGhost->getKey();
 		this->ghostHash_.erase(key);
-		this->ghostList_.removeNode(node);
+		this->ghostList_.removeNode(leastGhost);
 	}
-	this->ghostHash_(node->getKey(), node);
+	this->ghostHash_.emplace(node->getKey(), node);
 	this->ghostList_.insertNode(node);
 }
 
-template<typename Key, typename Value>
-bool ArcLfu<Key, Value>::checkGhost(const Key& key)
+template<typename Key, typename Value, bool EnableStats>
+bool ArcLfu<Key, Value, EnableStats>::checkGhost(const Key& key)
 {
+	lock_guard<shared_mutex> lock{ this->mutex_ };
 	auto it = this->ghostHash_.find(key);
 	if(it == this->ghostHash_.end())
 	return false;
 	this->ghostList_.removeNode(it->second);
 	this->ghostHash_.erase(it);
+	this->recorder_.record(StatsCounter::GhostHit);
 	return true;
 }
 
-template<typename Key, typename Value>
-optional<Value> ArcLfu<Key, Value>::get(const Key& key) {
-	lock_guard<mutex> lock{ this->mutex_ };
+template<typename Key, typename Value, bool EnableStats>
+optional<Value> ArcLfu<Key, Value, EnableStats>::get(const Key& key) {
+	ProfiledLock<shared_mutex> lock{ this->mutex_, this->profiler_.load(memory_order_relaxed), ProfiledOperation::Get };
 	auto it = this->nodeHash_.find(key);
-	if (it == this->nodeHash_.end())
+	if (it == this->nodeHash_.end()) {
+		this->recorder_.record(StatsCounter::Miss);
 		return nullopt;
+	}
+	this->recorder_.record(StatsCounter::Hit);
 	NodePtr node = it->second;
 	const Value value = node->getValue();
 	updateNode(node, value);
 	return value;
 }
 
-template<typename Key, typename Value>
-bool ArcLfu<Key, Value>::isExists(const Key& key) {
+template<typename Key, typename Value, bool EnableStats>
+bool ArcLfu<Key, Value, EnableStats>::isExists(const Key& key) {
+	optional<Value> value;
+	if (this->readIndex_.dormant())
+		wakeReadIndex();
+	if (this->readIndex_.tryFind(key, value))
+		return value.has_value();
+	shared_lock<shared_mutex> lock{ this->mutex_ };
 	return this->nodeHash_.find(key) != this->nodeHash_.end();
 }
 
-template<typename Key, typename Value>
-bool ArcLfu<Key, Value>::remove(const Key& key) {
+template<typename Key, typename Value, bool EnableStats>
+optional<Value> ArcLfu<Key, Value, EnableStats>::peek(const Key& key) {
+	optional<Value> value;
+	if (this->readIndex_.dormant())
+		wakeReadIndex();
+	if (this->readIndex_.tryFind(key, value))
+		return value;
+	shared_lock<shared_mutex> lock{ this->mutex_ };
+	auto it = this->nodeHash_.find(key);
+	if (it == this->nodeHash_.end())
+		return nullopt;
+	return it->second->getValue();
+}
+
+//the first peek or isExists fills the read index, from then on writers keep it current
+template<typename Key, typename Value, bool EnableStats>
+void ArcLfu<Key, Value, EnableStats>::wakeReadIndex()
+{
+	lock_guard<shared_mutex> lock{ this->mutex_ };
+	this->readIndex_.wake(this->nodeHash_);
+}
+
+template<typename Key, typename Value, bool EnableStats>
+bool ArcLfu<Key, Value, EnableStats>::remove(const Key& key) {
+	lock_guard<shared_mutex> lock{ this->mutex_ };
 	auto it = this->nodeHash_.find(key);
 	if (it == this->nodeHash_.end())
 		return false;
 	NodePtr node = it->second;
+	this->recorder_.entryRemoved(key, node->peekValue());
 	removeNode(node);
 	return true;
 }
 
-template<typename Key, typename Value>
-void ArcLfu<Key, Value>::increaseCapacity()
+template<typename Key, typename Value, bool EnableStats>
+CacheStats ArcLfu<Key, Value, EnableStats>::stats() {
+	shared_lock<shared_mutex> lock{ this->mutex_ };
+	return this->recorder_.collect(this->nodeHash_.size());
+}
+
+template<typename Key, typename Value, bool EnableStats>
+void ArcLfu<Key, Value, EnableStats>::increaseCapacity(size_t slots)
+{
+	lock_guard<shared_mutex> lock{ this->mutex_ };
+	this->capacity_ += static_cast<unsigned int>(slots);
+}
+
+template<typename Key, typename Value, bool EnableStats>
+inline size_t ArcLfu<Key, Value, EnableStats>::decreaseCapacity(size_t slots)
+{
+	lock_guard<shared_mutex> lock{ this->mutex_ };
+	//a new key always needs a slot to enter through
+	if (this->capacity_ <= 1)
+		return 0;
+	slots = min<size_t>(slots, this->capacity_ - 1);
+	this->capacity_ -= static_cast<unsigned int>(slots);
+	return slots;
+}
+
+template<typename Key, typename Value, bool EnableStats>
+bool ArcLfu<Key, Value, EnableStats>::replace(bool atCapacity)
+{
+	lock_guard<shared_mutex> lock{ this->mutex_ };
+	if (this->nodeHash_.empty() || this->nodeHash_.size() + (atCapacity ? 1 : 0) <= this->capacity_)
+		return false;
+	evictLeastFrequentNode();
+	return true;
+}
+
+template<typename Key, typename Value, bool EnableStats>
+size_t ArcLfu<Key, Value, EnableStats>::size()
+{
+	shared_lock<shared_mutex> lock{ this->mutex_ };
+	return this->nodeHash_.size();
+}
+
+template<typename Key, typename Value, bool EnableStats>
+size_t ArcLfu<Key, Value, EnableStats>::ghostSize()
+{
+	shared_lock<shared_mutex> lock{ this->mutex_ };
+	return this->ghostHash_.size();
+}
+
+template<typename Key, typename Value, bool EnableStats>
+void ArcLfu<Key, Value, EnableStats>::snapshot(const string& path)
+{
+	SnapshotWriter writer{ path, SnapshotHeader::of<Key, Value>(SnapshotEngine::ArcLfu) };
+	saveTo(writer);
+	writer.commit();
+}
+
+template<typename Key, typename Value, bool EnableStats>
+void ArcLfu<Key, Value, EnableStats>::restore(const string& path)
+{
+	SnapshotReader reader{ path, SnapshotHeader::of<Key, Value>(SnapshotEngine::ArcLfu) };
+	loadFrom(reader);
+}
+
+template<typename Key, typename Value, bool EnableStats>
+void ArcLfu<Key, Value, EnableStats>::saveTo(SnapshotWriter& writer)
+{
+	shared_lock<shared_mutex> lock{ this->mutex_ };
+	writer.write<uint64_t>(this->capacity_);
+	writer.write<uint64_t>(this->nodeHash_.size());
+	for (auto& pair : this->freqHash_) {
+		FreqPtr freqList = pair.second;
+		for (NodePtr node = freqList->dummyTail_->getPre(); node != freqList->dummyHead_; node = node->getPre()) {
+			writer.write<Key>(node->getKey());
+			writer.write<Value>(node->getValue());
+			writer.write<uint64_t>(node->getAccessCount());
+		}
+	}
+	writer.write<uint64_t>(this->ghostHash_.size());
+	for (NodePtr node = this->ghostList_.dummyTail_->getPre(); node != this->ghostList_.dummyHead_; node = node->getPre()) {
+		writer.write<Key>(node->getKey());
+	}
+}
+
+template<typename Key, typename Value, bool EnableStats>
+void ArcLfu<Key, Value, EnableStats>::loadFrom(SnapshotReader& reader)
 {
-	this->capacity_++;
+	lock_guard<shared_mutex> lock{ this->mutex_ };
+	clearAll();
+	this->capacity_ = static_cast<unsigned int>(reader.read<uint64_t>());
+	const uint64_t count = reader.read<uint64_t>();
+	this->nodeHash_.reserve(static_cast<size_t>(count));
+	for (uint64_t i = 0; i < count; ++i) {
+		Key key = reader.read<Key>();
+		Value value = reader.read<Value>();
+		const uint64_t accessCount = reader.read<uint64_t>();
+		this->recorder_.entryAdded(key, value);
+		NodePtr node = make_shared<Node>(key, value);
+		node->setAccessCount(static_cast<size_t>(accessCount));
+		if (!this->nodeHash_.emplace(key, node).second)
+			throw runtime_error("In ArcLfu.h-----Snapshot holds a key twice.");
+		this->readIndex_.assign(key, node->peekValue());
+		insertIntoFreqHash(node);
+	}
+	//ghosts only need their key, the value slot is left empty
+	const uint64_t ghostCount = reader.read<uint64_t>();
+	for (uint64_t i = 0; i < ghostCount; ++i) {
+		Key key = reader.read<Key>();
+		NodePtr node = make_shared<Node>(key, Value());
+		if (this->ghostHash_.emplace(key, node).second)
+			this->ghostList_.insertNode(node);
+	}
 }
 
-template<typename Key, typename Value>
-inline void ArcLfu<Key, Value>::decreaseCapacity()
+template<typename Key, typename Value, bool EnableStats>
+void ArcLfu<Key, Value, EnableStats>::clearAll()
 {
-	if (this->capacity_ >= 1)
-		this->capacity_--;
+	for (auto& pair : this->nodeHash_)
+		this->recorder_.entryRemoved(pair.first, pair.second->peekValue());
+	//nodes point at each other, break the links so they are actually released
+	for (NodeHash* hash : { &this->nodeHash_, &this->ghostHash_ }) {
+		for (auto& pair : *hash) {
+			pair.second->setPre(nullptr);
+			pair.second->setNext(nullptr);
+		}
+		hash->clear();
+	}
+	this->readIndex_.clear();
+	this->freqHash_.clear();
+	this->ghostList_.dummyHead_->setNext(this->ghostList_.dummyTail_);
+	this->ghostList_.dummyTail_->setPre(this->ghostList_.dummyHead_);
 }
@@ -1,11 +1,16 @@
 #pragma once
 #include "../ICachePolicy.h"
+#include "../SeqlockIndex.h"
 #include "ArcNodeList.h"
+#include "../Snapshot/Snapshot.h"
+#include "../Stats/StatsRecorder.h"
+#include "../Stats/LockProfiler.h"
 #include <unordered_map>
 #include <mutex>
+#include <shared_mutex>
 #include <optional>
 
-template<typename Key,typename Value>
+template<typename Key, typename Value, bool EnableStats = true>
 class ArcLru:public ICachePolicy<Key,Value>
 {
 private:
@@ -18,8 +23,11 @@ private:
 	DList ghostList_;
 	NodeHash nodeHash_;
 	NodeHash ghostHash_;
+	SeqlockIndex<Key, Value> readIndex_;   //lets peek and isExists skip the lock for trivially copyable entries
 	size_t capacity_;
-	mutex mutex_;
+	shared_mutex mutex_;
+	StatsRecorder<EnableStats> recorder_;
+	atomic<LockProfiler*> profiler_{ nullptr };
 	
 public:
 	ArcLru() = delete;
@@ -27,31 +35,57 @@ public:
 	optional<Value> get(const Key& key);
 	optional<Value> get(const Key& key,bool& flag);
 	void put(const Key& key, const Value& value);
+	//put for ArcCache, which runs REPLACE itself: a new key never evicts, the half may go above its capacity
+	void admit(const Key& key, const Value& value);
 	bool isExists(const Key& key);
 	bool remove(const Key& key);
-	void increaseCapacity();
-	void decreaseCapacity();
+	optional<Value> peek(const Key& key);
+	CacheStats stats() override;
+	//times get/put and the wait for mutex_ into profiler, nullptr detaches it
+	void setProfiler(LockProfiler* profiler) { this->profiler_.store(profiler, memory_order_relaxed); }
+	void increaseCapacity(size_t slots);
+	//gives up to slots but keeps the last one, returns how many it gave; entries above the smaller capacity stay until replace
+	size_t decreaseCapacity(size_t slots);
+	//ARC's REPLACE: gives up the least recent entry if the half is above its capacity, or at it with atCapacity
+	bool replace(bool atCapacity);
+	size_t size();
+	size_t ghostSize();
 	bool checkGhost(const Key& key);
+
+	//writes the adapted capacity, the entries least recent first and then the ghost keys,
+	//restore replaces everything including the capacity ArcCache has shifted here; nothing is trimmed,
+	//a shrunk half may hold more entries than its capacity until ArcCache replaces them on later inserts
+	void snapshot(const string& path);
+	void restore(const string& path);
+	void saveTo(SnapshotWriter& writer);
+	void loadFrom(SnapshotReader& reader);
 private:
+	void clearAll();
 	void moveToFront(const NodePtr node);
 	void insertIntoGhost(const NodePtr node);
 	void evictLeastNode();
 	void insertNewNode(const Key& key, const Value& value);
+	void store(const Key& key, const Value& value, bool evict);
+	void wakeReadIndex();
 	
 };
 
-template<typename Key, typename Value>
-ArcLru<Key, Value>::ArcLru(const size_t& capacity):
+template<typename Key, typename Value, bool EnableStats>
+ArcLru<Key, Value, EnableStats>::ArcLru(const size_t& capacity):
 	capacity_{capacity}
 {
 }
 
-template<typename Key, typename Value>
-optional<Value> ArcLru<Key, Value>::get(const Key& key)
+template<typename Key, typename Value, bool EnableStats>
+optional<Value> ArcLru<Key, Value, EnableStats>::get(const Key& key)
 {
-	lock_guard<mutex> lock{ this->mutex_ };
+	ProfiledLock<shared_mutex> lock{ this->mutex_, this->profiler_.load(memory_order_relaxed), ProfiledOperation::Get };
 	auto hash_it = this->nodeHash_.find(key);
-	if (hash_it == this->nodeHash_.end()) return nullopt;
+	if (hash_it == this->nodeHash_.end()) {
+		this->recorder_.record(StatsCounter::Miss);
+		return nullopt;
+	}
+	this->recorder_.record(StatsCounter::Hit);
 	NodePtr node = hash_it->second;
 
 	node->increaseAccessCount();
@@ -60,15 +94,17 @@ optional<Value> ArcLru<Key, Value>::get(const Key& key)
 	return node->getValue();
 }
 
-template<typename Key, typename Value>
-inline optional<Value> ArcLru<Key, Value>::get(const Key& key, bool& flag)
+template<typename Key, typename Value, bool EnableStats>
+inline optional<Value> ArcLru<Key, Value, EnableStats>::get(const Key& key, bool& flag)
 {
-	lock_guard<mutex> lock{ this->mutex_ };
+	ProfiledLock<shared_mutex> lock{ this->mutex_, this->profiler_.load(memory_order_relaxed), ProfiledOperation::Get };
 	auto hash_it = this->nodeHash_.find(key);
 	if (hash_it == this->nodeHash_.end()) {
+		this->recorder_.record(StatsCounter::Miss);
 		flag = false;
 		return nullopt;
 	}
+	this->recorder_.record(StatsCounter::Hit);
 	NodePtr node = hash_it->second;
 	node->increaseAccessCount();
 	moveToFront(node);
@@ -77,65 +113,148 @@ inline optional<Value> ArcLru<Key, Value>::get(const Key& key, bool& flag)
 	return node->getValue();
 }
 
-template<typename Key, typename Value>
-void ArcLru<Key, Value>::put(const Key& key, const Value& value)
+template<typename Key, typename Value, bool EnableStats>
+void ArcLru<Key, Value, EnableStats>::put(const Key& key, const Value& value)
+{
+	store(key, value, true);
+}
+
+template<typename Key, typename Value, bool EnableStats>
+void ArcLru<Key, Value, EnableStats>::admit(const Key& key, const Value& value)
 {
-	lock_guard<mutex> lock{ this->mutex_ };
+	store(key, value, false);
+}
+
+template<typename Key, typename Value, bool EnableStats>
+void ArcLru<Key, Value, EnableStats>::store(const Key& key, const Value& value, bool evict)
+{
+	ProfiledLock<shared_mutex> lock{ this->mutex_, this->profiler_.load(memory_order_relaxed), ProfiledOperation::Put };
 	auto it = this->nodeHash_.find(key);
 
 	if (it != this->nodeHash_.end()) {
+		this->recorder_.record(StatsCounter::Update);
+		this->recorder_.valueReplaced(it->second->peekValue(), value);
 		it->second->increaseAccessCount();
 		it->second->setValue(value);
+		this->readIndex_.assign(key, value);
 		return;
 	}
 
-	if (this->capacity_ <= this->nodeHash_.size()) {
+	if (evict && this->capacity_ <= this->nodeHash_.size()) {
 		evictLeastNode();
 	}
 
 	insertNewNode(key, value);
 }
 
-template<typename Key, typename Value>
-bool ArcLru<Key, Value>::isExists(const Key& key)
+template<typename Key, typename Value, bool EnableStats>
+bool ArcLru<Key, Value, EnableStats>::isExists(const Key& key)
 {
+	optional<Value> value;
+	if (this->readIndex_.dormant())
+		wakeReadIndex();
+	if (this->readIndex_.tryFind(key, value))
+		return value.has_value();
+	shared_lock<shared_mutex> lock{ this->mutex_ };
 	auto it = this->nodeHash_.find(key);
 	return it != this->nodeHash_.end();
 }
 
 
-template<typename Key, typename Value>
-bool ArcLru<Key, Value>::remove(const Key& key)
+template<typename Key, typename Value, bool EnableStats>
+optional<Value> ArcLru<Key, Value, EnableStats>::peek(const Key& key)
+{
+	optional<Value> value;
+	if (this->readIndex_.dormant())
+		wakeReadIndex();
+	if (this->readIndex_.tryFind(key, value))
+		return value;
+	shared_lock<shared_mutex> lock{ this->mutex_ };
+	auto it = this->nodeHash_.find(key);
+	if (it == this->nodeHash_.end()) return nullopt;
+	return it->second->getValue();
+}
+
+//the first peek or isExists fills the read index, from then on writers keep it current
+template<typename Key, typename Value, bool EnableStats>
+void ArcLru<Key, Value, EnableStats>::wakeReadIndex()
+{
+	lock_guard<shared_mutex> lock{ this->mutex_ };
+	this->readIndex_.wake(this->nodeHash_);
+}
+
+template<typename Key, typename Value, bool EnableStats>
+bool ArcLru<Key, Value, EnableStats>::remove(const Key& key)
 {
+	lock_guard<shared_mutex> lock{ this->mutex_ };
 	auto it = this->nodeHash_.find(key);
 	if (it == this->nodeHash_.end()) return false;
+	this->recorder_.entryRemoved(key, it->second->peekValue());
 	this->lruList_.removeNode(it->second);
 	this->nodeHash_.erase(it);
+	this->readIndex_.erase(key);
 	return true;
 }
 
-template<typename Key, typename Value>
-void ArcLru<Key, Value>::increaseCapacity()
+template<typename Key, typename Value, bool EnableStats>
+CacheStats ArcLru<Key, Value, EnableStats>::stats()
+{
+	shared_lock<shared_mutex> lock{ this->mutex_ };
+	return this->recorder_.collect(this->nodeHash_.size());
+}
+
+template<typename Key, typename Value, bool EnableStats>
+void ArcLru<Key, Value, EnableStats>::increaseCapacity(size_t slots)
+{
+	lock_guard<shared_mutex> lock{ this->mutex_ };
+	this->capacity_ += slots;
+}
+
+template<typename Key, typename Value, bool EnableStats>
+inline size_t ArcLru<Key, Value, EnableStats>::decreaseCapacity(size_t slots)
 {
-	this->capacity_++;
+	lock_guard<shared_mutex> lock{ this->mutex_ };
+	//a new key always needs a slot to enter through
+	if (this->capacity_ <= 1)
+		return 0;
+	slots = min<size_t>(slots, this->capacity_ - 1);
+	this->capacity_ -= slots;
+	return slots;
 }
 
-template<typename Key, typename Value>
-inline void ArcLru<Key, Value>::decreaseCapacity()
+template<typename Key, typename Value, bool EnableStats>
+bool ArcLru<Key, Value, EnableStats>::replace(bool atCapacity)
 {
-	if (this->capacity_ >= 1)
-		this->capacity_--;
+	lock_guard<shared_mutex> lock{ this->mutex_ };
+	if (this->nodeHash_.empty() || this->nodeHash_.size() + (atCapacity ? 1 : 0) <= this->capacity_)
+		return false;
+	evictLeastNode();
+	return true;
 }
 
-template<typename Key, typename Value>
-void ArcLru<Key, Value>::moveToFront(const NodePtr node)
+template<typename Key, typename Value, bool EnableStats>
+size_t ArcLru<Key, Value, EnableStats>::size()
+{
+	shared_lock<shared_mutex> lock{ this->mutex_ };
+	return this->nodeHash_.size();
+}
+
+template<typename Key, typename Value, bool EnableStats>
+size_t ArcLru<Key, Value, EnableStats>::ghostSize()
+{
+	shared_lock<shared_mutex> lock{ this->mutex_ };
+	return this->ghostHash_.size();
+}
+
+template<typename Key, typename Value, bool EnableStats>
+void ArcLru<Key, Value, EnableStats>::moveToFront(const NodePtr node)
 {
 	this->lruList_.removeNode(node);
 	this->lruList_.insertNode(node);
 }
 
-template<typename Key, typename Value>
-void ArcLru<Key, Value>::insertIntoGhost(const NodePtr node)
+template<typename Key, typename Value, bool EnableStats>
+void ArcLru<Key, Value, EnableStats>::insertIntoGhost(const NodePtr node)
 {
 	if (this->ghostHash_.size() >= this->capacity_) {
 		NodePtr leastGhostNode = this->ghostList_.getLeastNode();
@@ -147,32 +266,124 @@ void ArcLru<Key, Value>::insertIntoGhost(const NodePtr node)
 	this->ghostList_.insertNode(node);
 }
 
-template<typename Key, typename Value>
-void ArcLru<Key, Value>::evictLeastNode()
+template<typename Key, typename Value, bool EnableStats>
+void ArcLru<Key, Value, EnableStats>::evictLeastNode()
 {
 	NodePtr leastNode = this->lruList_.getLeastNode();
-	insertIntoGhost(leastNode);
-
+	//unlink before the ghost list reuses the node's pre/next pointers
 	this->lruList_.removeNode(leastNode);
 	this->nodeHash_.erase(leastNode->getKey());
+	this->readIndex_.erase(leastNode->getKey());
+	insertIntoGhost(leastNode);
+	this->recorder_.record(StatsCounter::Eviction);
+	this->recorder_.entryRemoved(leastNode->getKey(), leastNode->peekValue());
+
+	this->notifyEviction(leastNode->getKey(), leastNode->getValue());
 }
 
-template<typename Key, typename Value>
-void ArcLru<Key, Value>::insertNewNode(const Key& key, const Value& value)
+template<typename Key, typename Value, bool EnableStats>
+void ArcLru<Key, Value, EnableStats>::insertNewNode(const Key& key, const Value& value)
 {
+	this->recorder_.record(StatsCounter::Put);
+	this->recorder_.entryAdded(key, value);
 	NodePtr newNode = make_shared<Node>(key, value);
 	this->nodeHash_.emplace(key,newNode);
+	this->readIndex_.assign(key, value);
 	this->lruList_.insertNode(newNode);
 }
 
-template<typename Key, typename Value>
-bool ArcLru<Key, Value>::checkGhost(const Key& key)
+template<typename Key, typename Value, bool EnableStats>
+bool ArcLru<Key, Value, EnableStats>::checkGhost(const Key& key)
 {
+	lock_guard<shared_mutex> lock{ this->mutex_ };
 	auto it = this->ghostHash_.find(key);
 	if (it == this->ghostHash_.end()) return false;
 	
 	this->ghostList_.removeNode(it->second);
 	this->ghostHash_.erase(it);
+	this->recorder_.record(StatsCounter::GhostHit);
 	
 	return true;
 }
+
+template<typename Key, typename Value, bool EnableStats>
+void ArcLru<Key, Value, EnableStats>::snapshot(const string& path)
+{
+	SnapshotWriter writer{ path, SnapshotHeader::of<Key, Value>(SnapshotEngine::ArcLru) };
+	saveTo(writer);
+	writer.commit();
+}
+
+template<typename Key, typename Value, bool EnableStats>
+void ArcLru<Key, Value, EnableStats>::restore(const string& path)
+{
+	SnapshotReader reader{ path, SnapshotHeader::of<Key, Value>(SnapshotEngine::ArcLru) };
+	loadFrom(reader);
+}
+
+template<typename Key, typename Value, bool EnableStats>
+void ArcLru<Key, Value, EnableStats>::saveTo(SnapshotWriter& writer)
+{
+	shared_lock<shared_mutex> lock{ this->mutex_ };
+	writer.write<uint64_t>(this->capacity_);
+	writer.write<uint64_t>(this->nodeHash_.size());
+	for (NodePtr node = this->lruList_.dummyTail_->getPre(); node != this->lruList_.dummyHead_; node = node->getPre()) {
+		writer.write<Key>(node->getKey());
+		writer.write<Value>(node->getValue());
+		writer.write<uint64_t>(node->getAccessCount());
+	}
+	writer.write<uint64_t>(this->ghostHash_.size());
+	for (NodePtr node = this->ghostList_.dummyTail_->getPre(); node != this->ghostList_.dummyHead_; node = node->getPre()) {
+		writer.write<Key>(node->getKey());
+	}
+}
+
+template<typename Key, typename Value, bool EnableStats>
+void ArcLru<Key, Value, EnableStats>::loadFrom(SnapshotReader& reader)
+{
+	lock_guard<shared_mutex> lock{ this->mutex_ };
+	clearAll();
+	this->capacity_ = static_cast<size_t>(reader.read<uint64_t>());
+	const uint64_t count = reader.read<uint64_t>();
+	this->nodeHash_.reserve(static_cast<size_t>(count));
+	for (uint64_t i = 0; i < count; ++i) {
+		Key key = reader.read<Key>();
+		Value value = reader.read<Value>();
+		const uint64_t accessCount = reader.read<uint64_t>();
+		this->recorder_.entryAdded(key, value);
+		NodePtr node = make_shared<Node>(key, value);
+		node->setAccessCount(static_cast<size_t>(accessCount));
+		if (!this->nodeHash_.emplace(key, node).second)
+			throw runtime_error("In ArcLru.h-----Snapshot holds a key twice.");
+		this->readIndex_.assign(key, node->peekValue());
+		this->lruList_.insertNode(node);
+	}
+	//ghosts only need their key, the value slot is left empty
+	const uint64_t ghostCount = reader.read<uint64_t>();
+	for (uint64_t i = 0; i < ghostCount; ++i) {
+		Key key = reader.read<Key>();
+		NodePtr node = make_shared<Node>(key, Value());
+		if (this->ghostHash_.emplace(key, node).second)
+			this->ghostList_.insertNode(node);
+	}
+}
+
+template<typename Key, typename Value, bool EnableStats>
+void ArcLru<Key, Value, EnableStats>::clearAll()
+{
+	for (auto& pair : this->nodeHash_)
+		this->recorder_.entryRemoved(pair.first, pair.second->peekValue());
+	//nodes point at each other, break the links so they are actually released
+	for (NodeHash* hash : { &this->nodeHash_, &this->ghostHash_ }) {
+		for (auto& pair : *hash) {
+			pair.second->setPre(nullptr);
+			pair.second->setNext(nullptr);
+		}
+		hash->clear();
+	}
+	this->readIndex_.clear();
+	for (DList* list : { &this->lruList_, &this->ghostList_ }) {
+		list->dummyHead_->setNext(list->dummyTail_);
+		list->dummyTail_->setPre(list->dummyHead_);
+	}
+}
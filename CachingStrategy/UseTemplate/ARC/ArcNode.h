@@ -18,6 +18,7 @@ public:
 
 	Key getKey();
 	Value getValue();
+	const Value& peekValue() const { return this->value_; }
 	void setValue(const Value&);
 	size_t getAccessCount();
 	void increaseAccessCount();
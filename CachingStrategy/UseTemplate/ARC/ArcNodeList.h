@@ -10,7 +10,7 @@ public:
 	NodePtr dummyTail_;
 public:
 	ArcNodeList();
-	~ArcNodeList() = default;
+	~ArcNodeList();
 	void insertNode(const NodePtr&);
 	void removeNode(const NodePtr&);
 	NodePtr getLeastNode();
@@ -25,6 +25,18 @@ ArcNodeList<Key, Value>::ArcNodeList() {
 	this->dummyTail_->setPre(this->dummyHead_);
 }
 
+template<typename Key, typename Value>
+ArcNodeList<Key, Value>::~ArcNodeList() {
+	//nodes point at each other, break the links so they are actually released
+	NodePtr node = this->dummyHead_;
+	while (node) {
+		NodePtr next = node->getNext();
+		node->setPre(nullptr);
+		node->setNext(nullptr);
+		node = next;
+	}
+}
+
 template<typename Key, typename Value>
 void ArcNodeList<Key, Value>::insertNode(const NodePtr& node) {
 	node->setNext(this->dummyHead_->getNext());
@@ -0,0 +1,430 @@
+#pragma once
+#include <algorithm>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <unordered_map>
+#include <vector>
+
+#include "../ICachePolicy.h"
+#include "../NodePool.h"
+#include "../Stats/StatsRecorder.h"
+
+//the eviction rules AdaptiveCache switches between
+enum class AdaptivePolicy : size_t {
+    Lru,
+    Lfu,
+    Arc,
+    TwoQueue,
+    Count
+};
+
+//a cache that picks its eviction rule from miniature simulations of the request stream
+//the live entries are one probation list of keys not reused since admission and one protected list of reused
+//ones, both in access order, plus a ring of recently evicted keys per list; the rules only differ in where a
+//reused or returning key goes and which tail gives up the victim:
+//  Lru       the older of the two tails, which is plain LRU
+//  Lfu       probation first, so a reused entry only goes when no single-use one is left: LFU with two counts
+//  Arc       ARC, probation and protected are T1 and T2, the rings B1 and B2 move the target size of T1
+//  TwoQueue  2Q, probation is A1in and a FIFO of a quarter of the capacity, a key back from the newest
+//            half of the probation ring skips it
+//keys whose hash falls under the sampling rate are replayed, key only, into one small copy of this cache per
+//rule; every epoch the copy with the most recent hits (halved each epoch, so the last few epochs count) gives
+//its rule to the live cache, which applies it from the next eviction on, nothing is moved
+//an unsampled request pays one multiply and one compare on top of the live cache
+template<typename Key, typename Value, bool EnableStats = true>
+class AdaptiveCache : public ICachePolicy<Key, Value> {
+private:
+    static const uint32_t NIL = UINT32_MAX;   //as NodePool::NIL
+    //an index entry with this bit set is a slot of the ghost rings, otherwise a pool slot
+    static const uint32_t GHOST_BIT = 1u << 31;
+    //pool slots of the list sentinels
+    static const uint32_t PROBATION = 0;
+    static const uint32_t PROTECTED = 1;
+    static const uint64_t MODULUS = 1 << 24;
+    static constexpr size_t MIN_SHADOW_CAPACITY = 64;
+    static const size_t POLICIES = static_cast<size_t>(AdaptivePolicy::Count);
+
+    struct Node {
+        Key key{};
+        Value value{};
+        uint32_t pre = NIL;
+        uint32_t next = NIL;
+        uint64_t lastAccess = 0;
+        bool isProtected = false;
+    };
+
+    //keys evicted from one list, the oldest overwritten first
+    struct GhostRing {
+        uint32_t base;     //first slot in ghosts_
+        uint32_t next;     //next slot to overwrite, relative to base
+        size_t count;      //slots whose key the index still points at
+    };
+
+    size_t capacity_;
+    size_t probationCount_;
+    size_t residentCount_;
+    size_t arcTarget_;          //ARC's p, the size T1 is steered to
+    uint64_t clock_;
+    AdaptivePolicy policy_;
+    mutex mutex_;
+    NodePool<Node> pool_;
+    vector<Key> ghosts_;        //B1 in the first capacity slots, B2 in the rest
+    GhostRing rings_[2];        //indexed by Node::isProtected
+    unordered_map<Key, uint32_t> index_;
+    StatsRecorder<EnableStats> recorder_;
+
+    //the shadows are guarded by mutex_ as well
+    uint64_t threshold_;        //a key is sampled when its spatial hash is below it, 0 samples none
+    size_t epochLength_;        //sampled gets between two decisions
+    size_t epochRequests_;
+    uint64_t switches_;
+    vector<unique_ptr<AdaptiveCache<Key, char, false>>> shadows_;
+    uint64_t epochHits_[POLICIES];
+    double scores_[POLICIES];
+    uint64_t shadowHits_[POLICIES];
+    uint64_t shadowRequests_;
+
+public:
+    AdaptiveCache() = delete;
+    //samplingRate is raised as far as it takes to give each shadow MIN_SHADOW_CAPACITY entries,
+    //0 runs no shadows and keeps initialPolicy for good
+    AdaptiveCache(unsigned int capacity, double samplingRate = 1.0 / 256, AdaptivePolicy initialPolicy = AdaptivePolicy::Lru);
+    ~AdaptiveCache() override = default;
+
+    void put(const Key& key, const Value& value) override;
+    optional<Value> get(const Key& key) override;
+    bool remove(const Key& key) override;
+    bool isExists(const Key& key) override;
+    optional<Value> peek(const Key& key) override;
+    CacheStats stats() override;
+
+    AdaptivePolicy policy();
+    //hit ratio of every shadow since construction, indexed by AdaptivePolicy, all zero without shadows
+    vector<double> shadowHitRatios();
+    static const char* policyName(AdaptivePolicy policy);
+
+private:
+    //std::hash is the identity for integers, fibonacci hashing spreads it into the top 24 bits
+    static uint64_t spatialHashOf(const Key& key) {
+        return ((static_cast<uint64_t>(hash<Key>{}(key)) + 1) * 0x9e3779b97f4a7c15ull) >> 40;
+    }
+    bool isSampled(const Key& key) const { return spatialHashOf(key) < this->threshold_; }
+
+    void touch(uint32_t node);
+    void pushBack(uint32_t sentinel, uint32_t node);
+    void unlink(uint32_t node);
+    //returningFromB2 is ARC's tie-break, a key back from B2 takes the victim from T1 when T1 is at its target
+    void evict(bool returningFromB2);
+    bool admitFromGhost(uint32_t ghost);
+    void remember(const Key& key, bool fromProtected);
+    void simulateGet(const Key& key);
+    void endEpoch();
+};
+
+template<typename Key, typename Value, bool EnableStats>
+AdaptiveCache<Key, Value, EnableStats>::AdaptiveCache(unsigned int capacity, double samplingRate, AdaptivePolicy initialPolicy)
+    : capacity_{ capacity }, probationCount_{ 0 }, residentCount_{ 0 }, arcTarget_{ 0 }, clock_{ 0 }, policy_{ initialPolicy },
+    pool_{ static_cast<size_t>(capacity) + 2 }, ghosts_(static_cast<size_t>(capacity) * 2),
+    rings_{ { 0, 0, 0 }, { capacity, 0, 0 } }, threshold_{ 0 }, epochLength_{ 0 }, epochRequests_{ 0 }, switches_{ 0 },
+    epochHits_{}, scores_{}, shadowHits_{}, shadowRequests_{ 0 } {
+    if (capacity >= GHOST_BIT / 2)
+        throw runtime_error("In AdaptiveCache.h-----Capacity must stay below 2^30.");
+    if (initialPolicy >= AdaptivePolicy::Count)
+        throw runtime_error("In AdaptiveCache.h-----Unknown initial policy.");
+    for (uint32_t sentinel = PROBATION; sentinel <= PROTECTED; ++sentinel) {
+        this->pool_.acquire();
+        this->pool_[sentinel].pre = this->pool_[sentinel].next = sentinel;
+    }
+    if (samplingRate <= 0.0 || capacity == 0)
+        return;
+
+    const size_t shadowCapacity = min<size_t>(capacity, max<size_t>(MIN_SHADOW_CAPACITY, static_cast<size_t>(capacity * samplingRate)));
+    //the rate the shadows really run at, so a shadow of n entries sees the share of keys a live cache of capacity would
+    this->threshold_ = max<uint64_t>(1, static_cast<uint64_t>(static_cast<double>(shadowCapacity) / capacity * MODULUS));
+    //long enough for a shadow to turn over its content several times, so a score is not just its warm-up,
+    //and for a tiny cache long enough that a score is not just noise
+    this->epochLength_ = 16 * max(shadowCapacity, MIN_SHADOW_CAPACITY);
+    for (size_t i = 0; i < POLICIES; ++i)
+        this->shadows_.push_back(make_unique<AdaptiveCache<Key, char, false>>(static_cast<unsigned int>(shadowCapacity), 0.0, static_cast<AdaptivePolicy>(i)));
+}
+
+template<typename Key, typename Value, bool EnableStats>
+void AdaptiveCache<Key, Value, EnableStats>::put(const Key& key, const Value& value) {
+    if (this->capacity_ == 0) return;
+    lock_guard<mutex> lock{ this->mutex_ };
+    //the shadows take the same puts, a read-through miss enters them exactly when it enters the live cache
+    if (isSampled(key)) {
+        for (auto& shadow : this->shadows_)
+            shadow->put(key, 0);
+    }
+    auto it = this->index_.find(key);
+    if (it != this->index_.end() && !(it->second & GHOST_BIT)) {
+        Node& entry = this->pool_[it->second];
+        this->recorder_.record(StatsCounter::Update);
+        this->recorder_.valueReplaced(entry.value, value);
+        entry.value = value;
+        touch(it->second);
+        return;
+    }
+
+    bool returningFromB2 = false;
+    bool toProtected = false;
+    if (it != this->index_.end()) {
+        const uint32_t ghost = it->second & ~GHOST_BIT;
+        returningFromB2 = ghost >= this->rings_[1].base;
+        this->index_.erase(it);
+        toProtected = admitFromGhost(ghost);
+    }
+    if (this->residentCount_ >= this->capacity_)
+        evict(returningFromB2);
+    const uint32_t node = this->pool_.acquire();
+    Node& entry = this->pool_[node];
+    entry.key = key;
+    entry.value = value;
+    entry.lastAccess = ++this->clock_;
+    entry.isProtected = toProtected;
+    pushBack(toProtected ? PROTECTED : PROBATION, node);
+    if (!toProtected)
+        ++this->probationCount_;
+    ++this->residentCount_;
+    this->index_.emplace(key, node);
+    this->recorder_.record(StatsCounter::Put);
+    this->recorder_.entryAdded(key, value);
+}
+
+template<typename Key, typename Value, bool EnableStats>
+optional<Value> AdaptiveCache<Key, Value, EnableStats>::get(const Key& key) {
+    lock_guard<mutex> lock{ this->mutex_ };
+    if (isSampled(key))
+        simulateGet(key);
+    auto it = this->index_.find(key);
+    if (it == this->index_.end() || (it->second & GHOST_BIT)) {
+        if (it != this->index_.end())
+            this->recorder_.record(StatsCounter::GhostHit);
+        this->recorder_.record(StatsCounter::Miss);
+        return nullopt;
+    }
+    this->recorder_.record(StatsCounter::Hit);
+    touch(it->second);
+    return this->pool_[it->second].value;
+}
+
+//a remembered key is forgotten too, its ring slot is left to be overwritten
+template<typename Key, typename Value, bool EnableStats>
+bool AdaptiveCache<Key, Value, EnableStats>::remove(const Key& key) {
+    lock_guard<mutex> lock{ this->mutex_ };
+    if (isSampled(key)) {
+        for (auto& shadow : this->shadows_)
+            shadow->remove(key);
+    }
+    auto it = this->index_.find(key);
+    if (it == this->index_.end())
+        return false;
+    const uint32_t node = it->second;
+    this->index_.erase(it);
+    if (node & GHOST_BIT) {
+        --this->rings_[(node & ~GHOST_BIT) >= this->rings_[1].base ? 1 : 0].count;
+        return false;
+    }
+    this->recorder_.entryRemoved(key, this->pool_[node].value);
+    if (!this->pool_[node].isProtected)
+        --this->probationCount_;
+    unlink(node);
+    --this->residentCount_;
+    this->pool_.release(node);
+    return true;
+}
+
+template<typename Key, typename Value, bool EnableStats>
+bool AdaptiveCache<Key, Value, EnableStats>::isExists(const Key& key) {
+    lock_guard<mutex> lock{ this->mutex_ };
+    auto it = this->index_.find(key);
+    return it != this->index_.end() && !(it->second & GHOST_BIT);
+}
+
+template<typename Key, typename Value, bool EnableStats>
+optional<Value> AdaptiveCache<Key, Value, EnableStats>::peek(const Key& key) {
+    lock_guard<mutex> lock{ this->mutex_ };
+    auto it = this->index_.find(key);
+    if (it == this->index_.end() || (it->second & GHOST_BIT))
+        return nullopt;
+    return this->pool_[it->second].value;
+}
+
+//switches are counted outside the recorder, an engine built without stats still reports them
+template<typename Key, typename Value, bool EnableStats>
+CacheStats AdaptiveCache<Key, Value, EnableStats>::stats() {
+    lock_guard<mutex> lock{ this->mutex_ };
+    CacheStats stats = this->recorder_.collect(this->residentCount_);
+    stats.policySwitches = this->switches_;
+    return stats;
+}
+
+template<typename Key, typename Value, bool EnableStats>
+AdaptivePolicy AdaptiveCache<Key, Value, EnableStats>::policy() {
+    lock_guard<mutex> lock{ this->mutex_ };
+    return this->policy_;
+}
+
+template<typename Key, typename Value, bool EnableStats>
+vector<double> AdaptiveCache<Key, Value, EnableStats>::shadowHitRatios() {
+    lock_guard<mutex> lock{ this->mutex_ };
+    vector<double> ratios(POLICIES, 0.0);
+    for (size_t i = 0; i < POLICIES && this->shadowRequests_ > 0; ++i)
+        ratios[i] = static_cast<double>(this->shadowHits_[i]) / this->shadowRequests_;
+    return ratios;
+}
+
+template<typename Key, typename Value, bool EnableStats>
+const char* AdaptiveCache<Key, Value, EnableStats>::policyName(AdaptivePolicy policy) {
+    static const char* const names[POLICIES] = { "lru", "lfu", "arc", "2q" };
+    return policy < AdaptivePolicy::Count ? names[static_cast<size_t>(policy)] : "unknown";
+}
+
+//a reuse promotes the entry to the recent end of the protected list, except in 2Q's A1in, a FIFO
+template<typename Key, typename Value, bool EnableStats>
+void AdaptiveCache<Key, Value, EnableStats>::touch(uint32_t node) {
+    Node& entry = this->pool_[node];
+    if (!entry.isProtected) {
+        if (this->policy_ == AdaptivePolicy::TwoQueue)
+            return;
+        entry.isProtected = true;
+        --this->probationCount_;
+    }
+    entry.lastAccess = ++this->clock_;
+    unlink(node);
+    pushBack(PROTECTED, node);
+}
+
+template<typename Key, typename Value, bool EnableStats>
+void AdaptiveCache<Key, Value, EnableStats>::pushBack(uint32_t sentinel, uint32_t node) {
+    const uint32_t back = this->pool_[sentinel].pre;
+    this->pool_[node].pre = back;
+    this->pool_[node].next = sentinel;
+    this->pool_[back].next = node;
+    this->pool_[sentinel].pre = node;
+}
+
+template<typename Key, typename Value, bool EnableStats>
+void AdaptiveCache<Key, Value, EnableStats>::unlink(uint32_t node) {
+    Node& entry = this->pool_[node];
+    this->pool_[entry.pre].next = entry.next;
+    this->pool_[entry.next].pre = entry.pre;
+    entry.pre = entry.next = NIL;
+}
+
+template<typename Key, typename Value, bool EnableStats>
+void AdaptiveCache<Key, Value, EnableStats>::evict(bool returningFromB2) {
+    const uint32_t oldestProbation = this->pool_[PROBATION].next;
+    const uint32_t oldestProtected = this->pool_[PROTECTED].next;
+    bool fromProbation;
+    if (oldestProbation == PROBATION || oldestProtected == PROTECTED) {
+        fromProbation = oldestProbation != PROBATION;
+    }
+    else {
+        switch (this->policy_) {
+        case AdaptivePolicy::Lru:
+            fromProbation = this->pool_[oldestProbation].lastAccess < this->pool_[oldestProtected].lastAccess;
+            break;
+        case AdaptivePolicy::Lfu:
+            fromProbation = true;
+            break;
+        case AdaptivePolicy::Arc:
+            fromProbation = this->probationCount_ > this->arcTarget_ || (returningFromB2 && this->probationCount_ == this->arcTarget_);
+            break;
+        default:
+            fromProbation = this->probationCount_ * 4 > this->capacity_;
+            break;
+        }
+    }
+    const uint32_t victim = fromProbation ? oldestProbation : oldestProtected;
+    Node& entry = this->pool_[victim];
+    unlink(victim);
+    this->index_.erase(entry.key);
+    if (fromProbation)
+        --this->probationCount_;
+    --this->residentCount_;
+    this->recorder_.record(StatsCounter::Eviction);
+    this->recorder_.entryRemoved(entry.key, entry.value);
+    this->notifyEviction(entry.key, entry.value);
+    remember(entry.key, !fromProbation);
+    this->pool_.release(victim);
+}
+
+//ARC's target moves whatever the rule, so a switch to ARC starts from a warm target
+//returns whether the key goes straight to the protected list
+template<typename Key, typename Value, bool EnableStats>
+bool AdaptiveCache<Key, Value, EnableStats>::admitFromGhost(uint32_t ghost) {
+    const bool inB2 = ghost >= this->rings_[1].base;
+    GhostRing& ring = this->rings_[inB2 ? 1 : 0];
+    GhostRing& other = this->rings_[inB2 ? 0 : 1];
+    //a hit in B1 says T1 was too small, one in B2 that T2 was, by the ratio of the ring sizes
+    const size_t step = max<size_t>(1, other.count / ring.count);
+    if (inB2)
+        this->arcTarget_ = this->arcTarget_ > step ? this->arcTarget_ - step : 0;
+    else
+        this->arcTarget_ = min(this->capacity_, this->arcTarget_ + step);
+    --ring.count;
+
+    switch (this->policy_) {
+    case AdaptivePolicy::Arc:
+        return true;
+    case AdaptivePolicy::TwoQueue: {
+        //2Q's A1out is half the capacity, the newest half of B1
+        const size_t age = (ring.next + this->capacity_ - 1 - (ghost - ring.base)) % this->capacity_;
+        return !inB2 && age < this->capacity_ / 2;
+    }
+    default:
+        return false;
+    }
+}
+
+template<typename Key, typename Value, bool EnableStats>
+void AdaptiveCache<Key, Value, EnableStats>::remember(const Key& key, bool fromProtected) {
+    GhostRing& ring = this->rings_[fromProtected ? 1 : 0];
+    const uint32_t slot = ring.base + ring.next;
+    //the slot's previous key is dropped unless it was reused or removed meanwhile and the index moved on
+    auto old = this->index_.find(this->ghosts_[slot]);
+    if (old != this->index_.end() && old->second == (slot | GHOST_BIT))
+        this->index_.erase(old);
+    else
+        ++ring.count;
+    this->ghosts_[slot] = key;
+    this->index_.emplace(key, slot | GHOST_BIT);
+    ring.next = static_cast<uint32_t>((ring.next + 1) % this->capacity_);
+}
+
+template<typename Key, typename Value, bool EnableStats>
+void AdaptiveCache<Key, Value, EnableStats>::simulateGet(const Key& key) {
+    for (size_t i = 0; i < POLICIES; ++i) {
+        if (this->shadows_[i]->get(key)) {
+            ++this->epochHits_[i];
+            ++this->shadowHits_[i];
+        }
+    }
+    ++this->shadowRequests_;
+    if (++this->epochRequests_ >= this->epochLength_)
+        endEpoch();
+}
+
+//the live rule only changes for a clear winner, a near tie would flip back and forth on noise
+template<typename Key, typename Value, bool EnableStats>
+void AdaptiveCache<Key, Value, EnableStats>::endEpoch() {
+    for (size_t i = 0; i < POLICIES; ++i) {
+        this->scores_[i] = this->scores_[i] / 2 + static_cast<double>(this->epochHits_[i]);
+        this->epochHits_[i] = 0;
+    }
+    const size_t current = static_cast<size_t>(this->policy_);
+    size_t best = current;
+    for (size_t i = 0; i < POLICIES; ++i) {
+        if (this->scores_[i] > this->scores_[best])
+            best = i;
+    }
+    if (best != current && this->scores_[best] > this->scores_[current] * 1.02 + 1.0) {
+        this->policy_ = static_cast<AdaptivePolicy>(best);
+        ++this->switches_;
+    }
+    this->epochRequests_ = 0;
+}
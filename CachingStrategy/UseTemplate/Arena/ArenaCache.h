@@ -0,0 +1,110 @@
+#pragma once
+#include <array>
+#include <mutex>
+#include <string>
+
+#include "../ICachePolicy.h"
+#include "SegmentArena.h"
+
+//string-valued cache whose bytes live in a SegmentArena
+//the eviction policy is any engine keyed the same way and storing ArenaHandle, e.g. LruCache<Key, ArenaHandle>,
+//so nodes only carry an 8-byte handle and the heap never sees the payloads
+template<typename Key>
+class ArenaCache : public ICachePolicy<Key, string> {
+private:
+    static const size_t KEY_STRIPES = 16;
+
+    ICachePolicy<Key, ArenaHandle>& engine_;
+    SegmentArena& arena_;
+    //orders replacing a key's handle against removing it
+    array<mutex, KEY_STRIPES> keyMutex_;
+
+public:
+    ArenaCache() = delete;
+    ArenaCache(ICachePolicy<Key, ArenaHandle>& engine, SegmentArena& arena);
+    ~ArenaCache() override;
+
+    void put(const Key& key, const string& value) override;
+    optional<string> get(const Key& key) override;
+    bool remove(const Key& key) override;
+    bool isExists(const Key& key) override;
+    optional<string> peek(const Key& key) override;
+    //bytes count handles, getStats() of the arena has the payload
+    CacheStats stats() override { return this->engine_.stats(); }
+
+private:
+    mutex& keyMutexFor(const Key& key);
+};
+
+template<typename Key>
+ArenaCache<Key>::ArenaCache(ICachePolicy<Key, ArenaHandle>& engine, SegmentArena& arena)
+    : engine_{ engine }, arena_{ arena } {
+    this->engine_.setEvictionListener([this](const Key& key, const ArenaHandle& handle) {
+        if (this->hasEvictionListener()) {
+            optional<string> value = this->arena_.read(handle);
+            if (value.has_value())
+                this->notifyEviction(key, value.value());
+        }
+        this->arena_.free(handle);
+    });
+}
+
+template<typename Key>
+ArenaCache<Key>::~ArenaCache() {
+    this->engine_.setEvictionListener(nullptr);
+}
+
+//a handle freed twice (here and by an eviction in between) is ignored by the arena
+template<typename Key>
+void ArenaCache<Key>::put(const Key& key, const string& value) {
+    lock_guard<mutex> lock{ keyMutexFor(key) };
+    optional<ArenaHandle> old = this->engine_.peek(key);
+    this->engine_.put(key, this->arena_.allocate(value));
+    if (old.has_value())
+        this->arena_.free(old.value());
+}
+
+//a put racing with the read may free the handle we got, the retry sees the new one
+template<typename Key>
+optional<string> ArenaCache<Key>::get(const Key& key) {
+    optional<ArenaHandle> handle = this->engine_.get(key);
+    while (handle.has_value()) {
+        optional<string> value = this->arena_.read(handle.value());
+        if (value.has_value())
+            return value;
+        handle = this->engine_.peek(key);
+    }
+    return nullopt;
+}
+
+template<typename Key>
+bool ArenaCache<Key>::remove(const Key& key) {
+    lock_guard<mutex> lock{ keyMutexFor(key) };
+    optional<ArenaHandle> handle = this->engine_.peek(key);
+    if (!handle.has_value() || !this->engine_.remove(key))
+        return false;
+    this->arena_.free(handle.value());
+    return true;
+}
+
+template<typename Key>
+bool ArenaCache<Key>::isExists(const Key& key) {
+    return this->engine_.isExists(key);
+}
+
+template<typename Key>
+optional<string> ArenaCache<Key>::peek(const Key& key) {
+    optional<ArenaHandle> handle = this->engine_.peek(key);
+    while (handle.has_value()) {
+        optional<string> value = this->arena_.read(handle.value());
+        if (value.has_value())
+            return value;
+        handle = this->engine_.peek(key);
+    }
+    return nullopt;
+}
+
+template<typename Key>
+mutex& ArenaCache<Key>::keyMutexFor(const Key& key) {
+    return this->keyMutex_[hash<Key>{}(key) % KEY_STRIPES];
+}
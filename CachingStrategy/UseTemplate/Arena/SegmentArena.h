@@ -0,0 +1,334 @@
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstring>
+#include <mutex>
+#include <optional>
+#include <shared_mutex>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#endif
+using namespace std;
+
+//stable reference to bytes in a SegmentArena
+//the slot indirection lets the compactor move bytes without touching whoever holds the handle,
+//the generation makes a handle to freed (and possibly reused) bytes detectably stale
+struct ArenaHandle {
+    uint32_t slot = 0;
+    uint32_t generation = 0;
+
+    bool operator==(const ArenaHandle& other) const { return this->slot == other.slot && this->generation == other.generation; }
+    bool operator!=(const ArenaHandle& other) const { return !(*this == other); }
+};
+
+struct ArenaStats {
+    size_t liveBytes;          //payload bytes reachable through live handles
+    size_t reservedBytes;      //bytes of all segments currently mapped
+    size_t segments;
+    size_t compactedSegments;
+    size_t movedBytes;
+};
+
+//append-only byte store for variable-size values
+//bytes go into the active segment until it is full, then a new one is started; freeing only marks
+//bytes dead, a segment goes back to the OS when its last record dies or the compactor has moved
+//its survivors into the active segment
+//segments are mapped straight from the OS so releasing one really shrinks the process
+//record: [u32 slot][u32 length][bytes], padded to 8 bytes
+class SegmentArena {
+private:
+    struct Segment {
+        char* bytes;
+        size_t capacity;
+        size_t used;
+        size_t liveBytes;   //record bytes including headers
+    };
+    struct Slot {
+        uint32_t segment;
+        uint32_t offset;
+        uint32_t length;
+        uint32_t generation;
+        bool live;
+    };
+    struct RecordHeader {
+        uint32_t slot;
+        uint32_t length;
+    };
+    static const uint32_t NO_SEGMENT = UINT32_MAX;
+
+    size_t segmentSize_;
+    double compactThreshold_;   //sealed segments with a smaller live fraction are compacted
+
+    shared_mutex mutex_;
+    vector<Segment> segments_;         //released segments keep their index with bytes == nullptr
+    vector<uint32_t> freeSegments_;
+    vector<Slot> slots_;
+    vector<uint32_t> freeSlots_;
+    uint32_t activeSegment_;
+    size_t liveBytes_;
+    size_t reservedBytes_;
+    size_t segmentCount_;
+    size_t compactedSegments_;
+    size_t movedBytes_;
+
+    mutex compactorMutex_;
+    condition_variable compactorWanted_;
+    bool stopping_;
+    thread compactor_;
+
+public:
+    SegmentArena() = delete;
+    //compactInterval of zero means compact() is only run when called
+    SegmentArena(size_t segmentSize = 2 << 20, double compactThreshold = 0.5,
+        chrono::milliseconds compactInterval = chrono::milliseconds(0));
+    SegmentArena(const SegmentArena&) = delete;
+    SegmentArena& operator=(const SegmentArena&) = delete;
+    ~SegmentArena();
+
+    ArenaHandle allocate(const char* data, size_t length);
+    ArenaHandle allocate(const string& value) { return allocate(value.data(), value.size()); }
+    //nullopt for a stale handle
+    optional<string> read(const ArenaHandle& handle);
+    //false for a stale handle, freeing twice is harmless
+    bool free(const ArenaHandle& handle);
+    //compacts every sealed segment below the threshold, returns the number of segments released
+    size_t compact();
+    ArenaStats getStats();
+
+private:
+    static size_t recordSize(size_t length) { return (sizeof(RecordHeader) + length + 7) & ~static_cast<size_t>(7); }
+    static char* mapSegment(size_t capacity);
+    static void unmapSegment(char* bytes, size_t capacity);
+    void startSegment(size_t minimumCapacity);
+    void releaseSegment(uint32_t index);
+    char* place(uint32_t slot, const char* data, size_t length);
+    bool compactOne();
+    void compactLoop(chrono::milliseconds interval);
+};
+
+inline SegmentArena::SegmentArena(size_t segmentSize, double compactThreshold, chrono::milliseconds compactInterval)
+    : segmentSize_{ segmentSize }, compactThreshold_{ compactThreshold }, activeSegment_{ NO_SEGMENT },
+    liveBytes_{ 0 }, reservedBytes_{ 0 }, segmentCount_{ 0 }, compactedSegments_{ 0 }, movedBytes_{ 0 }, stopping_{ false } {
+    if (this->segmentSize_ < 4096)
+        throw invalid_argument("In SegmentArena.h-----Segment size must be at least 4 KB.");
+    if (compactInterval.count() > 0)
+        this->compactor_ = thread{ [this, compactInterval]() { compactLoop(compactInterval); } };
+}
+
+inline SegmentArena::~SegmentArena() {
+    if (this->compactor_.joinable()) {
+        {
+            lock_guard<mutex> lock{ this->compactorMutex_ };
+            this->stopping_ = true;
+        }
+        this->compactorWanted_.notify_all();
+        this->compactor_.join();
+    }
+    for (Segment& segment : this->segments_) {
+        if (segment.bytes)
+            unmapSegment(segment.bytes, segment.capacity);
+    }
+}
+
+inline ArenaHandle SegmentArena::allocate(const char* data, size_t length) {
+    if (length > UINT32_MAX - sizeof(RecordHeader) - 8)
+        throw length_error("In SegmentArena.h-----Value is too large.");
+    lock_guard<shared_mutex> lock{ this->mutex_ };
+    uint32_t slot;
+    if (!this->freeSlots_.empty()) {
+        slot = this->freeSlots_.back();
+        this->freeSlots_.pop_back();
+    }
+    else {
+        slot = static_cast<uint32_t>(this->slots_.size());
+        this->slots_.push_back(Slot{ NO_SEGMENT, 0, 0, 0, false });
+    }
+    place(slot, data, length);
+    this->slots_[slot].live = true;
+    this->liveBytes_ += length;
+    return ArenaHandle{ slot, this->slots_[slot].generation };
+}
+
+inline optional<string> SegmentArena::read(const ArenaHandle& handle) {
+    shared_lock<shared_mutex> lock{ this->mutex_ };
+    if (handle.slot >= this->slots_.size())
+        return nullopt;
+    const Slot& slot = this->slots_[handle.slot];
+    if (!slot.live || slot.generation != handle.generation)
+        return nullopt;
+    const char* record = this->segments_[slot.segment].bytes + slot.offset;
+    return string{ record + sizeof(RecordHeader), slot.length };
+}
+
+inline bool SegmentArena::free(const ArenaHandle& handle) {
+    lock_guard<shared_mutex> lock{ this->mutex_ };
+    if (handle.slot >= this->slots_.size())
+        return false;
+    Slot& slot = this->slots_[handle.slot];
+    if (!slot.live || slot.generation != handle.generation)
+        return false;
+    Segment& segment = this->segments_[slot.segment];
+    segment.liveBytes -= recordSize(slot.length);
+    this->liveBytes_ -= slot.length;
+    const uint32_t segmentIndex = slot.segment;
+    slot.live = false;
+    slot.generation++;
+    slot.segment = NO_SEGMENT;
+    this->freeSlots_.push_back(handle.slot);
+    if (segment.liveBytes == 0 && segmentIndex != this->activeSegment_)
+        releaseSegment(segmentIndex);
+    return true;
+}
+
+inline size_t SegmentArena::compact() {
+    size_t released = 0;
+    //one segment per lock hold, readers only ever wait for a single segment copy
+    while (compactOne())
+        released++;
+    return released;
+}
+
+inline ArenaStats SegmentArena::getStats() {
+    shared_lock<shared_mutex> lock{ this->mutex_ };
+    return ArenaStats{ this->liveBytes_, this->reservedBytes_, this->segmentCount_, this->compactedSegments_, this->movedBytes_ };
+}
+
+#ifdef _WIN32
+inline char* SegmentArena::mapSegment(size_t capacity) {
+    void* bytes = VirtualAlloc(nullptr, capacity, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE);
+    if (!bytes)
+        throw bad_alloc();
+    return static_cast<char*>(bytes);
+}
+
+inline void SegmentArena::unmapSegment(char* bytes, size_t) {
+    VirtualFree(bytes, 0, MEM_RELEASE);
+}
+#else
+inline char* SegmentArena::mapSegment(size_t capacity) {
+    void* bytes = mmap(nullptr, capacity, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (bytes == MAP_FAILED)
+        throw bad_alloc();
+    return static_cast<char*>(bytes);
+}
+
+inline void SegmentArena::unmapSegment(char* bytes, size_t capacity) {
+    munmap(bytes, capacity);
+}
+#endif
+
+//mutex_ held exclusively
+//an oversized value gets a segment of its own
+inline void SegmentArena::startSegment(size_t minimumCapacity) {
+    const uint32_t previous = this->activeSegment_;
+    const size_t capacity = max(this->segmentSize_, minimumCapacity);
+    Segment segment{ mapSegment(capacity), capacity, 0, 0 };
+    if (!this->freeSegments_.empty()) {
+        this->activeSegment_ = this->freeSegments_.back();
+        this->freeSegments_.pop_back();
+        this->segments_[this->activeSegment_] = segment;
+    }
+    else {
+        this->activeSegment_ = static_cast<uint32_t>(this->segments_.size());
+        this->segments_.push_back(segment);
+    }
+    this->reservedBytes_ += capacity;
+    this->segmentCount_++;
+    //the old active segment may have died completely while it was still being filled
+    if (previous != NO_SEGMENT && this->segments_[previous].liveBytes == 0)
+        releaseSegment(previous);
+}
+
+//mutex_ held exclusively
+inline void SegmentArena::releaseSegment(uint32_t index) {
+    Segment& segment = this->segments_[index];
+    unmapSegment(segment.bytes, segment.capacity);
+    this->reservedBytes_ -= segment.capacity;
+    this->segmentCount_--;
+    segment = Segment{ nullptr, 0, 0, 0 };
+    this->freeSegments_.push_back(index);
+}
+
+//mutex_ held exclusively, appends a record to the active segment and points slot at it
+inline char* SegmentArena::place(uint32_t slot, const char* data, size_t length) {
+    const size_t size = recordSize(length);
+    if (this->activeSegment_ == NO_SEGMENT || this->segments_[this->activeSegment_].used + size > this->segments_[this->activeSegment_].capacity)
+        startSegment(size);
+    Segment& segment = this->segments_[this->activeSegment_];
+    char* record = segment.bytes + segment.used;
+    RecordHeader header{ slot, static_cast<uint32_t>(length) };
+    memcpy(record, &header, sizeof(header));
+    memcpy(record + sizeof(header), data, length);
+    Slot& target = this->slots_[slot];
+    target.segment = this->activeSegment_;
+    target.offset = static_cast<uint32_t>(segment.used);
+    target.length = static_cast<uint32_t>(length);
+    segment.used += size;
+    segment.liveBytes += size;
+    return record;
+}
+
+//moves the survivors of the emptiest sealed segment below the threshold into the active segment
+inline bool SegmentArena::compactOne() {
+    lock_guard<shared_mutex> lock{ this->mutex_ };
+    uint32_t victim = NO_SEGMENT;
+    double lowest = this->compactThreshold_;
+    for (uint32_t i = 0; i < this->segments_.size(); ++i) {
+        const Segment& segment = this->segments_[i];
+        if (!segment.bytes || i == this->activeSegment_)
+            continue;
+        const double liveFraction = static_cast<double>(segment.liveBytes) / static_cast<double>(segment.capacity);
+        if (liveFraction < lowest) {
+            lowest = liveFraction;
+            victim = i;
+        }
+    }
+    if (victim == NO_SEGMENT)
+        return false;
+
+    //walk the records, the ones a live slot still points at are the survivors
+    size_t offset = 0;
+    while (offset < this->segments_[victim].used) {
+        RecordHeader header;
+        memcpy(&header, this->segments_[victim].bytes + offset, sizeof(header));
+        const size_t size = recordSize(header.length);
+        const Slot& slot = this->slots_[header.slot];
+        if (slot.live && slot.segment == victim && slot.offset == offset) {
+            //place() may start a new segment, which can grow segments_, so re-read the source each time
+            this->segments_[victim].liveBytes -= size;
+            place(header.slot, this->segments_[victim].bytes + offset + sizeof(header), header.length);
+            this->movedBytes_ += header.length;
+        }
+        offset += size;
+    }
+    releaseSegment(victim);
+    this->compactedSegments_++;
+    return true;
+}
+
+inline void SegmentArena::compactLoop(chrono::milliseconds interval) {
+    unique_lock<mutex> lock{ this->compactorMutex_ };
+    while (!this->stopping_) {
+        this->compactorWanted_.wait_for(lock, interval, [this]() { return this->stopping_; });
+        if (this->stopping_)
+            return;
+        lock.unlock();
+        compact();
+        lock.lock();
+    }
+}
@@ -0,0 +1,54 @@
+#pragma once
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "ICachePolicy.h"
+#include "LRU/LruCache.h"
+#include "LRU/LruKCache.h"
+#include "LRU/SliceLruCache.h"
+#include "LRU/ConcurrentLruCache.h"
+#include "LFU/LfuCache.h"
+#include "LFU/AgingLfuCache.h"
+#include "ARC/ArcCache.h"
+#include "LIRS/LirsCache.h"
+#include "2Q/TwoQueueCache.h"
+#include "S3FIFO/S3FifoCache.h"
+#include "SIEVE/SieveCache.h"
+#include "SIEVE/ShardedSieveCache.h"
+#include "ClockPro/ClockProCache.h"
+#include "GDSF/GdsfCache.h"
+#include "Hyperbolic/HyperbolicCache.h"
+#include "Adaptive/AdaptiveCache.h"
+#include "SetAssociative/SetAssociativeCache.h"
+using namespace std;
+
+//engines by name, for tools that pick them at run time such as the benchmark and the trace simulator
+//a new engine only has to be added here to show up in both
+inline const vector<string>& cachePolicyNames() {
+    static const vector<string> names{ "lru", "lru-k", "slice-lru", "lfu", "aging-lfu", "arc", "concurrent-lru", "lirs", "2q", "s3-fifo", "sieve", "sharded-sieve", "clock-pro", "gdsf", "hyperbolic", "adaptive", "set-associative" };
+    return names;
+}
+
+template<typename Key, typename Value, bool EnableStats = true>
+unique_ptr<ICachePolicy<Key, Value>> makeCachePolicy(const string& name, unsigned int capacity) {
+    if (name == "lru") return make_unique<LruCache<Key, Value, EnableStats>>(capacity);
+    if (name == "lru-k") return make_unique<LruKCache<Key, Value, EnableStats>>(capacity, capacity, 2);
+    if (name == "slice-lru") return make_unique<SliceLruCache<Key, Value, EnableStats>>(16, capacity);
+    if (name == "lfu") return make_unique<LfuCache<Key, Value, EnableStats>>(capacity);
+    if (name == "aging-lfu") return make_unique<AgingLfuCache<Key, Value, EnableStats>>(capacity);
+    if (name == "arc") return make_unique<ArcCache<Key, Value, EnableStats>>(capacity);
+    if (name == "concurrent-lru") return make_unique<ConcurrentLruCache<Key, Value, EnableStats>>(capacity);
+    if (name == "lirs") return make_unique<LirsCache<Key, Value, EnableStats>>(capacity);
+    if (name == "2q") return make_unique<TwoQueueCache<Key, Value, EnableStats>>(capacity);
+    if (name == "s3-fifo") return make_unique<S3FifoCache<Key, Value, EnableStats>>(capacity);
+    if (name == "sieve") return make_unique<SieveCache<Key, Value, EnableStats>>(capacity);
+    if (name == "sharded-sieve") return make_unique<ShardedSieveCache<Key, Value, EnableStats>>(16, capacity);
+    if (name == "clock-pro") return make_unique<ClockProCache<Key, Value, EnableStats>>(capacity);
+    if (name == "gdsf") return make_unique<GdsfCache<Key, Value, EnableStats>>(capacity);
+    if (name == "hyperbolic") return make_unique<HyperbolicCache<Key, Value, EnableStats>>(capacity);
+    if (name == "adaptive") return make_unique<AdaptiveCache<Key, Value, EnableStats>>(capacity);
+    if (name == "set-associative") return make_unique<SetAssociativeCache<Key, Value, 8, EnableStats>>(capacity);
+    throw runtime_error("In CachePolicyFactory.h-----Unknown policy '" + name + "'");
+}
@@ -0,0 +1,342 @@
+#pragma once
+#include <algorithm>
+#include <cstdint>
+#include <mutex>
+#include <unordered_map>
+
+#include "../ICachePolicy.h"
+#include "../NodePool.h"
+#include "../Stats/StatsRecorder.h"
+
+enum class ClockProState : uint8_t {
+    Hot,     //resident, proven short reuse distance, only demoted by HAND_hot
+    Cold,    //resident, the next victims
+    Test     //evicted while cold and still in its test period, kept as a fingerprint only
+};
+
+//CLOCK-Pro: the reuse-distance test of LIRS run on one clock instead of a stack and a queue
+//all entries, resident or not, share one circular list and new ones go in at the head, just behind HAND_hot
+//a new cold entry starts a test period; referenced within it, it turns hot when HAND_cold reaches it, and a key
+//put again while its test entry lives comes back hot straight away; HAND_hot demotes unreferenced hot entries
+//and ends the test periods it overtakes, HAND_test ends the oldest ones once there are more test entries than capacity
+//a key coming back while its test entry lives raises the cold target, a test period that ends unused lowers it,
+//so the split between hot and cold adapts to the workload
+//a hit only sets the referenced flag and relinks nothing; a test entry keeps the key's hash, not the key
+template<typename Key, typename Value, bool EnableStats = true>
+class ClockProCache : public ICachePolicy<Key, Value> {
+private:
+    static const uint32_t NIL = UINT32_MAX;   //as NodePool::NIL
+
+    struct Node {
+        Key key{};
+        Value value{};
+        size_t fingerprint = 0;
+        uint32_t pre = NIL;
+        uint32_t next = NIL;
+        ClockProState state = ClockProState::Cold;
+        bool referenced = false;
+        bool testing = false;    //cold entries only
+    };
+
+    size_t capacity_;
+    size_t coldTarget_;
+    size_t hotCount_;
+    size_t coldCount_;
+    size_t testCount_;
+    uint32_t handHot_;
+    uint32_t handCold_;
+    uint32_t handTest_;
+    mutex mutex_;
+    NodePool<Node> pool_;
+    unordered_map<Key, uint32_t> index_;           //resident entries
+    unordered_map<size_t, uint32_t> testIndex_;    //test entries by fingerprint
+    StatsRecorder<EnableStats> recorder_;
+
+public:
+    ClockProCache() = delete;
+    ClockProCache(unsigned int capacity);
+    ~ClockProCache() override = default;
+
+    void put(const Key& key, const Value& value) override;
+    optional<Value> get(const Key& key) override;
+    bool remove(const Key& key) override;
+    bool isExists(const Key& key) override;
+    optional<Value> peek(const Key& key) override;
+    CacheStats stats() override;
+
+private:
+    size_t fingerprintOf(const Key& key) const { return hash<Key>{}(key); }
+    void link(uint32_t node);
+    void unlink(uint32_t node);
+    void forget(uint32_t node);
+    void moveToHead(uint32_t node);
+    void balance();
+    void makeRoom();
+    void runHandCold();
+    void runHandHot();
+    void runHandTest();
+    void endTest(uint32_t node);
+};
+
+template<typename Key, typename Value, bool EnableStats>
+ClockProCache<Key, Value, EnableStats>::ClockProCache(unsigned int capacity)
+    : capacity_{ capacity }, coldTarget_{ capacity }, hotCount_{ 0 }, coldCount_{ 0 }, testCount_{ 0 },
+    handHot_{ NIL }, handCold_{ NIL }, handTest_{ NIL }, pool_{ static_cast<size_t>(capacity) * 2 } {
+    this->index_.reserve(capacity);
+    this->testIndex_.reserve(capacity);
+}
+
+template<typename Key, typename Value, bool EnableStats>
+void ClockProCache<Key, Value, EnableStats>::put(const Key& key, const Value& value) {
+    if (this->capacity_ == 0) return;
+    lock_guard<mutex> lock{ this->mutex_ };
+    auto it = this->index_.find(key);
+    if (it != this->index_.end()) {
+        Node& entry = this->pool_[it->second];
+        this->recorder_.record(StatsCounter::Update);
+        this->recorder_.valueReplaced(entry.value, value);
+        entry.value = value;
+        entry.referenced = true;
+        return;
+    }
+
+    //reused within its test period: the reuse distance is short enough for hot, and cold deserves more room
+    const size_t fingerprint = fingerprintOf(key);
+    auto test = this->testIndex_.find(fingerprint);
+    const bool tested = test != this->testIndex_.end();
+    if (tested) {
+        forget(test->second);
+        this->coldTarget_ = min(this->coldTarget_ + 1, this->capacity_);
+    }
+    makeRoom();
+    const uint32_t node = this->pool_.acquire();
+    Node& entry = this->pool_[node];
+    entry.key = key;
+    entry.value = value;
+    entry.fingerprint = fingerprint;
+    entry.state = tested ? ClockProState::Hot : ClockProState::Cold;
+    entry.testing = !tested;
+    if (tested)
+        ++this->hotCount_;
+    else
+        ++this->coldCount_;
+    link(node);
+    this->index_.emplace(key, node);
+    balance();
+    this->recorder_.record(StatsCounter::Put);
+    this->recorder_.entryAdded(key, value);
+}
+
+template<typename Key, typename Value, bool EnableStats>
+optional<Value> ClockProCache<Key, Value, EnableStats>::get(const Key& key) {
+    lock_guard<mutex> lock{ this->mutex_ };
+    auto it = this->index_.find(key);
+    if (it == this->index_.end()) {
+        if (this->testIndex_.count(fingerprintOf(key)))
+            this->recorder_.record(StatsCounter::GhostHit);
+        this->recorder_.record(StatsCounter::Miss);
+        return nullopt;
+    }
+    this->recorder_.record(StatsCounter::Hit);
+    Node& entry = this->pool_[it->second];
+    entry.referenced = true;
+    return entry.value;
+}
+
+template<typename Key, typename Value, bool EnableStats>
+bool ClockProCache<Key, Value, EnableStats>::remove(const Key& key) {
+    lock_guard<mutex> lock{ this->mutex_ };
+    auto it = this->index_.find(key);
+    if (it == this->index_.end())
+        return false;
+    const uint32_t node = it->second;
+    this->recorder_.entryRemoved(key, this->pool_[node].value);
+    this->index_.erase(it);
+    if (this->pool_[node].state == ClockProState::Hot)
+        --this->hotCount_;
+    else
+        --this->coldCount_;
+    unlink(node);
+    this->pool_.release(node);
+    return true;
+}
+
+template<typename Key, typename Value, bool EnableStats>
+bool ClockProCache<Key, Value, EnableStats>::isExists(const Key& key) {
+    lock_guard<mutex> lock{ this->mutex_ };
+    return this->index_.find(key) != this->index_.end();
+}
+
+template<typename Key, typename Value, bool EnableStats>
+optional<Value> ClockProCache<Key, Value, EnableStats>::peek(const Key& key) {
+    lock_guard<mutex> lock{ this->mutex_ };
+    auto it = this->index_.find(key);
+    if (it == this->index_.end())
+        return nullopt;
+    return this->pool_[it->second].value;
+}
+
+template<typename Key, typename Value, bool EnableStats>
+CacheStats ClockProCache<Key, Value, EnableStats>::stats() {
+    lock_guard<mutex> lock{ this->mutex_ };
+    return this->recorder_.collect(this->hotCount_ + this->coldCount_);
+}
+
+//the list head is just behind HAND_hot, the entry HAND_hot reaches last
+template<typename Key, typename Value, bool EnableStats>
+void ClockProCache<Key, Value, EnableStats>::link(uint32_t node) {
+    if (this->handHot_ == NIL) {
+        this->pool_[node].pre = this->pool_[node].next = node;
+        this->handHot_ = this->handCold_ = this->handTest_ = node;
+        return;
+    }
+    const uint32_t before = this->pool_[this->handHot_].pre;
+    this->pool_[node].pre = before;
+    this->pool_[node].next = this->handHot_;
+    this->pool_[before].next = node;
+    this->pool_[this->handHot_].pre = node;
+    if (this->handCold_ == this->handHot_)
+        this->handCold_ = node;
+}
+
+//a hand on the node steps back, so its next move lands where the node was
+template<typename Key, typename Value, bool EnableStats>
+void ClockProCache<Key, Value, EnableStats>::unlink(uint32_t node) {
+    Node& entry = this->pool_[node];
+    const uint32_t pre = entry.pre == node ? NIL : entry.pre;
+    if (this->handHot_ == node) this->handHot_ = pre;
+    if (this->handCold_ == node) this->handCold_ = pre;
+    if (this->handTest_ == node) this->handTest_ = pre;
+    if (pre != NIL) {
+        this->pool_[entry.pre].next = entry.next;
+        this->pool_[entry.next].pre = entry.pre;
+    }
+    entry.pre = entry.next = NIL;
+}
+
+//drops a test entry; a fingerprint shared with a newer test entry keeps pointing at that one
+template<typename Key, typename Value, bool EnableStats>
+void ClockProCache<Key, Value, EnableStats>::forget(uint32_t node) {
+    auto it = this->testIndex_.find(this->pool_[node].fingerprint);
+    if (it != this->testIndex_.end() && it->second == node)
+        this->testIndex_.erase(it);
+    unlink(node);
+    --this->testCount_;
+    this->pool_.release(node);
+}
+
+//each hand moves one step per call and leaves the others alone; balance() and makeRoom() drive them in turn
+template<typename Key, typename Value, bool EnableStats>
+void ClockProCache<Key, Value, EnableStats>::balance() {
+    while (this->hotCount_ > this->capacity_ - this->coldTarget_)
+        runHandHot();
+    while (this->testCount_ > this->capacity_)
+        runHandTest();
+}
+
+//at least one resident stays cold, so HAND_cold always finds something to evict within two laps
+template<typename Key, typename Value, bool EnableStats>
+void ClockProCache<Key, Value, EnableStats>::makeRoom() {
+    while (this->hotCount_ + this->coldCount_ >= this->capacity_) {
+        runHandCold();
+        balance();
+    }
+}
+
+template<typename Key, typename Value, bool EnableStats>
+void ClockProCache<Key, Value, EnableStats>::moveToHead(uint32_t node) {
+    unlink(node);
+    link(node);
+}
+
+//a referenced cold entry goes back to the head, hot if the reference came within its test period;
+//an unreferenced one is evicted and stays on as a test entry while its test period lasts
+template<typename Key, typename Value, bool EnableStats>
+void ClockProCache<Key, Value, EnableStats>::runHandCold() {
+    const uint32_t node = this->handCold_;
+    Node& entry = this->pool_[node];
+    if (entry.state != ClockProState::Cold) {
+        this->handCold_ = entry.next;
+        return;
+    }
+    if (entry.referenced) {
+        entry.referenced = false;
+        if (entry.testing) {
+            entry.state = ClockProState::Hot;
+            entry.testing = false;
+            --this->coldCount_;
+            ++this->hotCount_;
+        }
+        else {
+            entry.testing = true;
+        }
+        moveToHead(node);
+    }
+    else {
+        this->index_.erase(entry.key);
+        this->recorder_.record(StatsCounter::Eviction);
+        this->recorder_.entryRemoved(entry.key, entry.value);
+        this->notifyEviction(entry.key, entry.value);
+        --this->coldCount_;
+        if (!entry.testing) {
+            unlink(node);
+            this->pool_.release(node);
+        }
+        else {
+            entry.key = Key{};
+            entry.value = Value{};
+            entry.state = ClockProState::Test;
+            ++this->testCount_;
+            this->testIndex_[entry.fingerprint] = node;
+        }
+    }
+    //evicting the last entry of a one-slot cache empties the list
+    if (this->handCold_ != NIL)
+        this->handCold_ = this->pool_[this->handCold_].next;
+}
+
+//HAND_hot marks the oldest hot entry, a test period it overtakes has lasted longer than any hot entry's
+//reuse distance and ends
+template<typename Key, typename Value, bool EnableStats>
+void ClockProCache<Key, Value, EnableStats>::runHandHot() {
+    const uint32_t node = this->handHot_;
+    Node& entry = this->pool_[node];
+    if (entry.state == ClockProState::Hot) {
+        if (entry.referenced) {
+            entry.referenced = false;
+        }
+        else {
+            entry.state = ClockProState::Cold;
+            --this->hotCount_;
+            ++this->coldCount_;
+        }
+    }
+    else {
+        endTest(node);
+    }
+    this->handHot_ = this->pool_[this->handHot_].next;
+}
+
+//HAND_test only runs while there are more test entries than capacity
+template<typename Key, typename Value, bool EnableStats>
+void ClockProCache<Key, Value, EnableStats>::runHandTest() {
+    const uint32_t node = this->handTest_;
+    if (this->pool_[node].state != ClockProState::Hot)
+        endTest(node);
+    this->handTest_ = this->pool_[this->handTest_].next;
+}
+
+//a test period that passed without a reference says cold entries need less room
+template<typename Key, typename Value, bool EnableStats>
+void ClockProCache<Key, Value, EnableStats>::endTest(uint32_t node) {
+    Node& entry = this->pool_[node];
+    if (entry.state == ClockProState::Cold) {
+        if (!entry.testing)
+            return;
+        entry.testing = false;
+    }
+    else {
+        forget(node);
+    }
+    this->coldTarget_ = max<size_t>(this->coldTarget_ - 1, 1);
+}
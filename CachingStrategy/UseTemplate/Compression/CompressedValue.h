@@ -0,0 +1,61 @@
+#pragma once
+#include <cstdint>
+#include <string>
+
+#include "LzCodec.h"
+#include "../Serializer.h"
+#include "../Stats/CacheStats.h"
+
+//string value that an engine stores as is until a compression pass packs it
+//a value is only packed once: when it does not shrink enough it stays raw and is not tried again
+class CompressedValue {
+private:
+    string bytes_;
+    uint32_t rawSize_;
+    bool compressed_;
+    bool tried_;
+
+public:
+    CompressedValue() : rawSize_{ 0 }, compressed_{ false }, tried_{ false } {}
+    CompressedValue(string raw)
+        : bytes_{ move(raw) }, rawSize_{ static_cast<uint32_t>(bytes_.size()) }, compressed_{ false }, tried_{ false } {}
+
+    string value() const { return this->compressed_ ? LzCodec::decompress(this->bytes_) : this->bytes_; }
+    bool isCompressed() const { return this->compressed_; }
+    bool isTried() const { return this->tried_; }
+    size_t rawSize() const { return this->rawSize_; }
+    size_t storedSize() const { return this->bytes_.size(); }
+
+    //packs the value when that saves at least 1/8 of it, returns the bytes saved
+    size_t compress();
+};
+
+inline size_t CompressedValue::compress() {
+    if (this->tried_)
+        return 0;
+    this->tried_ = true;
+    string packed = LzCodec::compress(this->bytes_);
+    if (packed.size() > this->bytes_.size() - this->bytes_.size() / 8)
+        return 0;
+    const size_t saved = this->bytes_.size() - packed.size();
+    //a fresh exactly-sized string, assigning into bytes_ would keep its old capacity
+    this->bytes_ = string{ packed.data(), packed.size() };
+    this->compressed_ = true;
+    return saved;
+}
+
+template<>
+struct ByteSize<CompressedValue> {
+    static size_t of(const CompressedValue& value) { return sizeof(CompressedValue) + value.storedSize(); }
+};
+
+//persisted raw, a restored engine packs its cold entries again on the next pass
+template<>
+struct Serializer<CompressedValue> {
+    static void append(string& out, const CompressedValue& value) {
+        Serializer<string>::append(out, value.value());
+    }
+    static CompressedValue parse(const char*& cursor, const char* end) {
+        return CompressedValue{ Serializer<string>::parse(cursor, end) };
+    }
+};
@@ -0,0 +1,190 @@
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <thread>
+
+#include "../ICachePolicy.h"
+#include "CompressedValue.h"
+
+struct CompressionStats {
+    size_t passes;
+    size_t compressedEntries;
+    size_t incompressibleEntries;  //tried once and left raw
+    size_t bytesBefore;            //raw size of everything packed so far
+    size_t bytesAfter;
+    size_t compressedHits;         //gets that had to decompress
+};
+
+//string-valued cache over an engine that stores CompressedValue, e.g. LruCache<Key, CompressedValue> or
+//LfuCache<Key, CompressedValue>; the engine has to provide visitColdest() and its ColdCursor
+//a background pass packs the coldEntries least valuable entries in place, get() unpacks transparently
+//entries stay packed when they turn hot again until the next put replaces them
+template<typename Key, typename Engine>
+class CompressingCache : public ICachePolicy<Key, string> {
+private:
+    //entries looked at per engine lock hold, other callers wait at most this long for a pass
+    static constexpr size_t PASS_BATCH = 32;
+
+    Engine& engine_;
+    size_t coldEntries_;
+    size_t minValueSize_;
+
+    mutex compressorMutex_;
+    condition_variable compressorWanted_;
+    bool stopping_;
+    thread compressor_;
+
+    atomic<size_t> passes_;
+    atomic<size_t> compressedEntries_;
+    atomic<size_t> incompressibleEntries_;
+    atomic<size_t> bytesBefore_;
+    atomic<size_t> bytesAfter_;
+    atomic<size_t> compressedHits_;
+
+public:
+    CompressingCache() = delete;
+    //compressInterval of zero means compressColdEntries() is only run when called
+    CompressingCache(Engine& engine, size_t coldEntries, size_t minValueSize = 128,
+        chrono::milliseconds compressInterval = chrono::milliseconds(100));
+    ~CompressingCache() override;
+
+    void put(const Key& key, const string& value) override;
+    optional<string> get(const Key& key) override;
+    bool remove(const Key& key) override;
+    bool isExists(const Key& key) override;
+    optional<string> peek(const Key& key) override;
+    //bytes are what the engine holds, packed entries at their packed size
+    CacheStats stats() override { return this->engine_.stats(); }
+
+    //one pass over the cold end on the calling thread, returns the number of values packed
+    size_t compressColdEntries();
+    CompressionStats getStats();
+
+private:
+    void compressLoop(chrono::milliseconds interval);
+};
+
+template<typename Key, typename Engine>
+CompressingCache<Key, Engine>::CompressingCache(Engine& engine, size_t coldEntries, size_t minValueSize,
+    chrono::milliseconds compressInterval)
+    : engine_{ engine }, coldEntries_{ coldEntries }, minValueSize_{ minValueSize }, stopping_{ false },
+    passes_{ 0 }, compressedEntries_{ 0 }, incompressibleEntries_{ 0 }, bytesBefore_{ 0 }, bytesAfter_{ 0 }, compressedHits_{ 0 } {
+    this->engine_.setEvictionListener([this](const Key& key, const CompressedValue& value) {
+        if (this->hasEvictionListener())
+            this->notifyEviction(key, value.value());
+    });
+    if (compressInterval.count() > 0)
+        this->compressor_ = thread{ [this, compressInterval]() { compressLoop(compressInterval); } };
+}
+
+template<typename Key, typename Engine>
+CompressingCache<Key, Engine>::~CompressingCache() {
+    if (this->compressor_.joinable()) {
+        {
+            lock_guard<mutex> lock{ this->compressorMutex_ };
+            this->stopping_ = true;
+        }
+        this->compressorWanted_.notify_all();
+        this->compressor_.join();
+    }
+    this->engine_.setEvictionListener(nullptr);
+}
+
+template<typename Key, typename Engine>
+void CompressingCache<Key, Engine>::put(const Key& key, const string& value) {
+    this->engine_.put(key, CompressedValue{ value });
+}
+
+//the engine hands out a copy, decompressing happens outside its lock
+template<typename Key, typename Engine>
+optional<string> CompressingCache<Key, Engine>::get(const Key& key) {
+    optional<CompressedValue> value = this->engine_.get(key);
+    if (!value.has_value())
+        return nullopt;
+    if (value.value().isCompressed())
+        this->compressedHits_++;
+    return value.value().value();
+}
+
+template<typename Key, typename Engine>
+bool CompressingCache<Key, Engine>::remove(const Key& key) {
+    return this->engine_.remove(key);
+}
+
+template<typename Key, typename Engine>
+bool CompressingCache<Key, Engine>::isExists(const Key& key) {
+    return this->engine_.isExists(key);
+}
+
+template<typename Key, typename Engine>
+optional<string> CompressingCache<Key, Engine>::peek(const Key& key) {
+    optional<CompressedValue> value = this->engine_.peek(key);
+    if (!value.has_value())
+        return nullopt;
+    return value.value().value();
+}
+
+//each batch holds the engine's lock for at most PASS_BATCH entries and resumes just past the last one the
+//previous batch looked at, so a pass walks the cold end once; if that entry left the cache or was hit in between,
+//the next batch starts over from the cold end and skips what is already tried
+template<typename Key, typename Engine>
+size_t CompressingCache<Key, Engine>::compressColdEntries() {
+    size_t packed = 0;
+    size_t before = 0;
+    size_t after = 0;
+    size_t incompressible = 0;
+    typename Engine::ColdCursor cursor;
+    for (size_t scanned = 0; scanned < this->coldEntries_; ) {
+        const size_t batch = min(PASS_BATCH, this->coldEntries_ - scanned);
+        const size_t visited = this->engine_.visitColdest([&](const Key& key, CompressedValue& value) {
+            if (value.isTried() || value.rawSize() < this->minValueSize_)
+                return true;
+            const size_t saved = value.compress();
+            if (value.isCompressed()) {
+                packed++;
+                before += value.rawSize();
+                after += value.rawSize() - saved;
+            }
+            else {
+                incompressible++;
+            }
+            return true;
+        }, batch, &cursor);
+        scanned += visited;
+        //the cold end ran out
+        if (visited < batch)
+            break;
+        //let waiting callers in between batches
+        this_thread::yield();
+    }
+    this->passes_++;
+    this->compressedEntries_ += packed;
+    this->incompressibleEntries_ += incompressible;
+    this->bytesBefore_ += before;
+    this->bytesAfter_ += after;
+    return packed;
+}
+
+template<typename Key, typename Engine>
+CompressionStats CompressingCache<Key, Engine>::getStats() {
+    return CompressionStats{ this->passes_.load(), this->compressedEntries_.load(), this->incompressibleEntries_.load(),
+        this->bytesBefore_.load(), this->bytesAfter_.load(), this->compressedHits_.load() };
+}
+
+template<typename Key, typename Engine>
+void CompressingCache<Key, Engine>::compressLoop(chrono::milliseconds interval) {
+    unique_lock<mutex> lock{ this->compressorMutex_ };
+    while (!this->stopping_) {
+        this->compressorWanted_.wait_for(lock, interval, [this]() { return this->stopping_; });
+        if (this->stopping_)
+            return;
+        lock.unlock();
+        compressColdEntries();
+        lock.lock();
+    }
+}
@@ -0,0 +1,179 @@
+#pragma once
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+using namespace std;
+
+//dependency-free LZ77 block codec in the spirit of LZ4, tuned for short text values such as JSON
+//block layout: varint raw length, then sequences of
+//  token (literal length << 4 | match length - 4), extra literal length bytes, literals,
+//  16-bit little-endian offset, extra match length bytes
+//the last sequence carries literals only and ends the block
+class LzCodec {
+private:
+    static const size_t MIN_MATCH = 4;
+    static const size_t LAST_LITERALS = 5;     //a block never ends in a match, keeps the decoder simple
+    static const size_t MAX_OFFSET = 65535;
+    static const unsigned int HASH_BITS = 12;
+
+public:
+    static string compress(const string& raw) { return compress(raw.data(), raw.size()); }
+    static string compress(const char* data, size_t size);
+    //throws runtime_error for anything compress() could not have produced
+    static string decompress(const string& block);
+    //reads the length header only
+    static size_t rawSize(const string& block);
+
+private:
+    static uint32_t read32(const char* p) {
+        uint32_t value;
+        memcpy(&value, p, sizeof(value));
+        return value;
+    }
+    static size_t hashOf(uint32_t sequence) { return (sequence * 2654435761u) >> (32 - HASH_BITS); }
+    static void appendLength(string& out, size_t length);
+    static void appendSequence(string& out, const char* literals, size_t literalLength, size_t offset, size_t matchLength);
+    static size_t readLength(const unsigned char*& in, const unsigned char* end);
+    static size_t readVarint(const unsigned char*& in, const unsigned char* end);
+};
+
+inline string LzCodec::compress(const char* data, size_t size) {
+    //positions from an earlier call are only hints, every candidate is checked against the bytes
+    //so the table never needs clearing
+    thread_local uint32_t table[1 << HASH_BITS];
+
+    string out;
+    out.reserve(size / 2 + 16);
+    for (size_t length = size; ; length >>= 7) {
+        if (length < 0x80) {
+            out.push_back(static_cast<char>(length));
+            break;
+        }
+        out.push_back(static_cast<char>((length & 0x7f) | 0x80));
+    }
+
+    size_t anchor = 0;
+    size_t pos = 0;
+    if (size >= MIN_MATCH + LAST_LITERALS) {
+        const size_t matchLimit = size - LAST_LITERALS;
+        while (pos + MIN_MATCH <= matchLimit) {
+            const uint32_t sequence = read32(data + pos);
+            const size_t slot = hashOf(sequence);
+            const size_t candidate = table[slot];
+            table[slot] = static_cast<uint32_t>(pos);
+            if (candidate < pos && pos - candidate <= MAX_OFFSET && read32(data + candidate) == sequence) {
+                size_t length = MIN_MATCH;
+                while (pos + length < matchLimit && data[candidate + length] == data[pos + length])
+                    length++;
+                appendSequence(out, data + anchor, pos - anchor, pos - candidate, length);
+                pos += length;
+                anchor = pos;
+            }
+            else {
+                //step faster through data that keeps missing, incompressible input costs little
+                pos += 1 + ((pos - anchor) >> 6);
+            }
+        }
+    }
+    appendSequence(out, data + anchor, size - anchor, 0, 0);
+    return out;
+}
+
+inline string LzCodec::decompress(const string& block) {
+    const unsigned char* in = reinterpret_cast<const unsigned char*>(block.data());
+    const unsigned char* end = in + block.size();
+    const size_t size = readVarint(in, end);
+    //one byte of block expands to at most 255, refuse headers that could only come from corruption
+    if (size / 255 > block.size())
+        throw runtime_error("In LzCodec.h-----Length header is implausible.");
+    string out(size, '\0');
+    size_t written = 0;
+    while (true) {
+        if (in >= end)
+            throw runtime_error("In LzCodec.h-----Block is truncated.");
+        const unsigned char token = *in++;
+        size_t literalLength = token >> 4;
+        if (literalLength == 15)
+            literalLength += readLength(in, end);
+        if (static_cast<size_t>(end - in) < literalLength || size - written < literalLength)
+            throw runtime_error("In LzCodec.h-----Literal run is out of bounds.");
+        memcpy(&out[written], in, literalLength);
+        in += literalLength;
+        written += literalLength;
+        if (in == end)
+            break;
+
+        if (end - in < 2)
+            throw runtime_error("In LzCodec.h-----Block is truncated.");
+        const size_t offset = in[0] | (static_cast<size_t>(in[1]) << 8);
+        in += 2;
+        size_t matchLength = token & 15;
+        if (matchLength == 15)
+            matchLength += readLength(in, end);
+        matchLength += MIN_MATCH;
+        if (offset == 0 || offset > written || size - written < matchLength)
+            throw runtime_error("In LzCodec.h-----Match is out of bounds.");
+        //byte by byte on purpose, a match may overlap the bytes it is producing
+        const size_t from = written - offset;
+        for (size_t i = 0; i < matchLength; ++i)
+            out[written + i] = out[from + i];
+        written += matchLength;
+    }
+    if (written != size)
+        throw runtime_error("In LzCodec.h-----Block is shorter than its header says.");
+    return out;
+}
+
+inline size_t LzCodec::rawSize(const string& block) {
+    const unsigned char* in = reinterpret_cast<const unsigned char*>(block.data());
+    return readVarint(in, in + block.size());
+}
+
+inline void LzCodec::appendLength(string& out, size_t length) {
+    while (length >= 255) {
+        out.push_back(static_cast<char>(255));
+        length -= 255;
+    }
+    out.push_back(static_cast<char>(length));
+}
+
+inline void LzCodec::appendSequence(string& out, const char* literals, size_t literalLength, size_t offset, size_t matchLength) {
+    const size_t matchCode = matchLength == 0 ? 0 : matchLength - MIN_MATCH;
+    out.push_back(static_cast<char>((min<size_t>(literalLength, 15) << 4) | min<size_t>(matchCode, 15)));
+    if (literalLength >= 15)
+        appendLength(out, literalLength - 15);
+    out.append(literals, literalLength);
+    if (matchLength == 0)
+        return;
+    out.push_back(static_cast<char>(offset & 0xff));
+    out.push_back(static_cast<char>(offset >> 8));
+    if (matchCode >= 15)
+        appendLength(out, matchCode - 15);
+}
+
+inline size_t LzCodec::readLength(const unsigned char*& in, const unsigned char* end) {
+    size_t length = 0;
+    while (true) {
+        if (in >= end)
+            throw runtime_error("In LzCodec.h-----Block is truncated.");
+        const unsigned char byte = *in++;
+        length += byte;
+        if (byte != 255)
+            return length;
+    }
+}
+
+inline size_t LzCodec::readVarint(const unsigned char*& in, const unsigned char* end) {
+    size_t value = 0;
+    for (unsigned int shift = 0; shift < 64; shift += 7) {
+        if (in >= end)
+            throw runtime_error("In LzCodec.h-----Block is truncated.");
+        const unsigned char byte = *in++;
+        value |= static_cast<size_t>(byte & 0x7f) << shift;
+        if (!(byte & 0x80))
+            return value;
+    }
+    throw runtime_error("In LzCodec.h-----Length header is malformed.");
+}
@@ -0,0 +1,103 @@
+#pragma once
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+using namespace std;
+
+//bounded multi-producer multi-consumer FIFO on a ring buffer (Vyukov)
+//head and tail are atomic counters, each cell carries a sequence number telling producers and consumers
+//whose turn it is, so a push or pop is one CAS on the counter plus one store, and never blocks
+//T should be cheap to copy, pointers and small ids
+template<typename T>
+class BoundedQueue {
+private:
+    struct Cell {
+        atomic<size_t> sequence;
+        T value;
+    };
+
+    vector<Cell> cells_;
+    size_t mask_;
+    alignas(64) atomic<size_t> tail_;   //next position to push
+    alignas(64) atomic<size_t> head_;   //next position to pop
+
+public:
+    BoundedQueue() = delete;
+    //rounded up to a power of two
+    explicit BoundedQueue(size_t capacity);
+    BoundedQueue(const BoundedQueue&) = delete;
+    BoundedQueue& operator=(const BoundedQueue&) = delete;
+
+    //false when full
+    bool tryPush(const T& value);
+    //false when empty
+    bool tryPop(T& value);
+    //exact only while nobody pushes or pops
+    size_t size() const;
+    size_t capacity() const { return this->cells_.size(); }
+};
+
+template<typename T>
+BoundedQueue<T>::BoundedQueue(size_t capacity) : tail_{ 0 }, head_{ 0 } {
+    size_t cellCount = 2;
+    while (cellCount < capacity)
+        cellCount <<= 1;
+    this->cells_ = vector<Cell>(cellCount);
+    for (size_t i = 0; i < cellCount; ++i)
+        this->cells_[i].sequence.store(i, memory_order_relaxed);
+    this->mask_ = cellCount - 1;
+}
+
+template<typename T>
+bool BoundedQueue<T>::tryPush(const T& value) {
+    size_t position = this->tail_.load(memory_order_relaxed);
+    while (true) {
+        Cell& cell = this->cells_[position & this->mask_];
+        const size_t sequence = cell.sequence.load(memory_order_acquire);
+        const intptr_t lag = static_cast<intptr_t>(sequence) - static_cast<intptr_t>(position);
+        if (lag == 0) {
+            if (this->tail_.compare_exchange_weak(position, position + 1, memory_order_relaxed)) {
+                cell.value = value;
+                cell.sequence.store(position + 1, memory_order_release);
+                return true;
+            }
+        }
+        else if (lag < 0) {
+            return false;   //the cell still holds the value pushed one lap ago
+        }
+        else {
+            position = this->tail_.load(memory_order_relaxed);
+        }
+    }
+}
+
+template<typename T>
+bool BoundedQueue<T>::tryPop(T& value) {
+    size_t position = this->head_.load(memory_order_relaxed);
+    while (true) {
+        Cell& cell = this->cells_[position & this->mask_];
+        const size_t sequence = cell.sequence.load(memory_order_acquire);
+        const intptr_t lag = static_cast<intptr_t>(sequence) - static_cast<intptr_t>(position + 1);
+        if (lag == 0) {
+            if (this->head_.compare_exchange_weak(position, position + 1, memory_order_relaxed)) {
+                value = cell.value;
+                cell.sequence.store(position + this->mask_ + 1, memory_order_release);
+                return true;
+            }
+        }
+        else if (lag < 0) {
+            return false;   //nothing pushed here yet
+        }
+        else {
+            position = this->head_.load(memory_order_relaxed);
+        }
+    }
+}
+
+template<typename T>
+size_t BoundedQueue<T>::size() const {
+    const size_t head = this->head_.load(memory_order_acquire);
+    const size_t tail = this->tail_.load(memory_order_acquire);
+    return tail > head ? tail - head : 0;
+}
@@ -0,0 +1,65 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <vector>
+
+#include "ThreadSlot.h"
+
+//epoch-based reclamation
+//readers pin() around every access to shared nodes; a node unlinked while the global epoch
+//was E may be freed once the global epoch has reached E + 2, because every thread that
+//could still see it has unpinned in between
+class EpochManager {
+private:
+    static const uint64_t ACTIVE = 1;
+
+    struct alignas(64) Slot {
+        atomic<uint64_t> state{ 0 };   //(epoch << 1) | ACTIVE while pinned
+        unsigned int depth = 0;        //nesting, only touched by the owning thread
+    };
+
+    alignas(64) atomic<uint64_t> globalEpoch_;
+    vector<Slot> slots_;
+
+public:
+    class Guard {
+    private:
+        EpochManager* manager_;
+        Slot* slot_;
+    public:
+        Guard(EpochManager& manager) : manager_{ &manager }, slot_{ &manager.slots_[ThreadSlot::index()] } {
+            if (this->slot_->depth++ == 0) {
+                uint64_t epoch = this->manager_->globalEpoch_.load(memory_order_seq_cst);
+                this->slot_->state.store((epoch << 1) | ACTIVE, memory_order_seq_cst);
+            }
+        }
+        Guard(const Guard&) = delete;
+        Guard& operator=(const Guard&) = delete;
+        ~Guard() {
+            if (--this->slot_->depth == 0)
+                this->slot_->state.store(0, memory_order_release);
+        }
+    };
+
+public:
+    EpochManager() : globalEpoch_{ 2 }, slots_(ThreadSlot::MAX_THREADS) {}
+    EpochManager(const EpochManager&) = delete;
+    EpochManager& operator=(const EpochManager&) = delete;
+
+    Guard pin() { return Guard{ *this }; }
+
+    uint64_t currentEpoch() const { return this->globalEpoch_.load(memory_order_seq_cst); }
+
+    //moves the global epoch forward if every pinned thread has observed the current one
+    bool tryAdvance() {
+        uint64_t epoch = this->globalEpoch_.load(memory_order_seq_cst);
+        for (Slot& slot : this->slots_) {
+            uint64_t state = slot.state.load(memory_order_seq_cst);
+            if ((state & ACTIVE) && (state >> 1) != epoch)
+                return false;
+        }
+        return this->globalEpoch_.compare_exchange_strong(epoch, epoch + 1, memory_order_seq_cst);
+    }
+
+    bool isSafeToFree(uint64_t retireEpoch) const { return currentEpoch() >= retireEpoch + 2; }
+};
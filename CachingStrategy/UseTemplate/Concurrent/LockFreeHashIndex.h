@@ -0,0 +1,119 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <vector>
+using namespace std;
+
+//fixed bucket array of lock-free sorted lists (Harris/Michael)
+//the table never resizes, callers size it from their capacity
+//Node must provide: Key key_; size_t hash_; atomic<uintptr_t> indexNext_;
+//the low bit of indexNext_ marks a node as logically deleted
+//
+//every call must run inside an EpochManager guard, the index never frees nodes itself:
+//once erase() returns true the node is unreachable and the caller decides when to retire it
+template<typename Key, typename Node>
+class LockFreeHashIndex {
+private:
+    using Link = atomic<uintptr_t>;
+    static const uintptr_t MARK = 1;
+
+    vector<Link> buckets_;
+    size_t mask_;
+
+    struct Position {
+        Link* prev;
+        Node* cur;
+        bool found;
+    };
+
+public:
+    LockFreeHashIndex() = delete;
+    LockFreeHashIndex(size_t expectedSize) {
+        size_t bucketCount = 16;
+        while (bucketCount < expectedSize)
+            bucketCount <<= 1;
+        this->buckets_ = vector<Link>(bucketCount);
+        for (Link& bucket : this->buckets_)
+            bucket.store(0, memory_order_relaxed);
+        this->mask_ = bucketCount - 1;
+    }
+
+    Node* find(const Key& key, size_t hash) {
+        Position position = search(key, hash);
+        return position.found ? position.cur : nullptr;
+    }
+
+    //returns nullptr when node was linked, otherwise the live node already holding the key
+    Node* insertIfAbsent(Node* node) {
+        while (true) {
+            Position position = search(node->key_, node->hash_);
+            if (position.found)
+                return position.cur;
+            node->indexNext_.store(reinterpret_cast<uintptr_t>(position.cur), memory_order_relaxed);
+            uintptr_t expected = reinterpret_cast<uintptr_t>(position.cur);
+            if (position.prev->compare_exchange_strong(expected, reinterpret_cast<uintptr_t>(node),
+                memory_order_release, memory_order_relaxed))
+                return nullptr;
+        }
+    }
+
+    //true if this call removed node, false if another thread got there first
+    bool erase(Node* node) {
+        uintptr_t next = node->indexNext_.load(memory_order_acquire);
+        while (true) {
+            if (next & MARK)
+                return false;
+            if (node->indexNext_.compare_exchange_weak(next, next | MARK, memory_order_acq_rel, memory_order_acquire))
+                break;
+        }
+        //a search over the key snips every marked node on its path, including this one
+        search(node->key_, node->hash_);
+        return true;
+    }
+
+    //walks every live node, only safe while no other thread touches the index
+    template<typename Visitor>
+    void forEachUnsafe(Visitor visitor) {
+        for (Link& bucket : this->buckets_) {
+            Node* cur = pointerOf(bucket.load(memory_order_relaxed));
+            while (cur) {
+                Node* next = pointerOf(cur->indexNext_.load(memory_order_relaxed));
+                visitor(cur);
+                cur = next;
+            }
+        }
+    }
+
+private:
+    static Node* pointerOf(uintptr_t link) { return reinterpret_cast<Node*>(link & ~MARK); }
+
+    static bool comesBefore(const Node* node, const Key& key, size_t hash) {
+        if (node->hash_ != hash)
+            return node->hash_ < hash;
+        return less<Key>{}(node->key_, key);
+    }
+
+    Position search(const Key& key, size_t hash) {
+    retry:
+        Link* prev = &this->buckets_[hash & this->mask_];
+        Node* cur = pointerOf(prev->load(memory_order_acquire));
+        while (cur) {
+            uintptr_t next = cur->indexNext_.load(memory_order_acquire);
+            if (next & MARK) {
+                uintptr_t expected = reinterpret_cast<uintptr_t>(cur);
+                if (!prev->compare_exchange_strong(expected, next & ~MARK, memory_order_acq_rel, memory_order_acquire))
+                    goto retry;
+                cur = pointerOf(next);
+                continue;
+            }
+            if (!comesBefore(cur, key, hash)) {
+                bool found = cur->hash_ == hash && cur->key_ == key;
+                return Position{ prev, cur, found };
+            }
+            prev = &cur->indexNext_;
+            cur = pointerOf(next);
+        }
+        return Position{ prev, nullptr, false };
+    }
+};
@@ -0,0 +1,49 @@
+#pragma once
+#include <mutex>
+#include <stdexcept>
+#include <vector>
+using namespace std;
+
+//small per-thread index handed out for the lifetime of a thread and recycled when it exits
+//lets lock-free structures and striped counters keep fixed per-thread slots instead of thread_local maps
+class ThreadSlot {
+public:
+    static const size_t MAX_THREADS = 256;
+
+    static size_t index() {
+        thread_local Holder holder;
+        return holder.index;
+    }
+
+private:
+    struct Registry {
+        mutex mutex_;
+        vector<size_t> freeIndexes_;
+        size_t nextIndex_ = 0;
+    };
+    struct Holder {
+        size_t index;
+        Holder() {
+            Registry& registry = ThreadSlot::registry();
+            lock_guard<mutex> lock{ registry.mutex_ };
+            if (!registry.freeIndexes_.empty()) {
+                this->index = registry.freeIndexes_.back();
+                registry.freeIndexes_.pop_back();
+            }
+            else {
+                if (registry.nextIndex_ >= MAX_THREADS)
+                    throw runtime_error("In ThreadSlot.h-----Too many live threads.");
+                this->index = registry.nextIndex_++;
+            }
+        }
+        ~Holder() {
+            Registry& registry = ThreadSlot::registry();
+            lock_guard<mutex> lock{ registry.mutex_ };
+            registry.freeIndexes_.push_back(this->index);
+        }
+    };
+    static Registry& registry() {
+        static Registry registry;
+        return registry;
+    }
+};
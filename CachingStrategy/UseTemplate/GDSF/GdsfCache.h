@@ -0,0 +1,282 @@
+#pragma once
+#include <cstdint>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+#include "../ICachePolicy.h"
+#include "../NodePool.h"
+#include "../Stats/StatsRecorder.h"
+
+//GreedyDual-Size-Frequency: every entry has the priority L + frequency * cost / size, the lowest is evicted
+//and L, the inflation, rises to the priority of each victim; an entry that stops being used keeps its old
+//priority while new and reused ones start above the rising L, so it ages out without any decay pass
+//big cheap entries are the first to go, small and costly ones hold their place with fewer hits
+//priorities live in a 4-ary min-heap of (priority, slot) pairs, one contiguous array: a sift compares
+//priorities side by side and only writes a moved slot's heap position back into its entry
+//both the entry count and the byte budget are honoured, a put that cannot fit the budget at all is refused
+template<typename Key, typename Value, bool EnableStats = true>
+class GdsfCache : public ICachePolicy<Key, Value> {
+private:
+    static const size_t ARITY = 4;
+
+    struct Entry {
+        Key key{};
+        Value value{};
+        size_t size = 0;
+        double cost = 0.0;
+        uint64_t frequency = 0;
+        uint32_t heapPosition = 0;
+    };
+
+    struct HeapItem {
+        double priority;
+        uint32_t slot;
+    };
+
+    size_t capacity_;
+    size_t byteBudget_;
+    size_t bytes_;
+    double inflation_;
+    mutex mutex_;
+    NodePool<Entry> entries_;
+    vector<HeapItem> heap_;
+    unordered_map<Key, uint32_t> index_;
+    StatsRecorder<EnableStats> recorder_;
+
+public:
+    GdsfCache() = delete;
+    //byteBudget counts the sizes given to put, by default what ByteSize measures for key and value
+    GdsfCache(unsigned int capacity, size_t byteBudget = SIZE_MAX);
+    ~GdsfCache() override = default;
+
+    void put(const Key& key, const Value& value) override;
+    //size in whatever unit byteBudget is in, cost what a miss on the key takes to refetch
+    void put(const Key& key, const Value& value, size_t size, double cost = 1.0);
+    optional<Value> get(const Key& key) override;
+    bool remove(const Key& key) override;
+    bool isExists(const Key& key) override;
+    optional<Value> peek(const Key& key) override;
+    CacheStats stats() override;
+
+    size_t bytes();
+    double inflation();
+
+private:
+    double priorityOf(const Entry& entry) const;
+    void reprioritize(uint32_t slot);
+    void erase(uint32_t slot);
+    void evict();
+    void place(size_t position, HeapItem item);
+    void siftUp(size_t position);
+    void siftDown(size_t position);
+};
+
+template<typename Key, typename Value, bool EnableStats>
+GdsfCache<Key, Value, EnableStats>::GdsfCache(unsigned int capacity, size_t byteBudget)
+    : capacity_{ capacity }, byteBudget_{ byteBudget }, bytes_{ 0 }, inflation_{ 0.0 }, entries_{ capacity } {
+    this->heap_.reserve(capacity);
+    this->index_.reserve(capacity);
+}
+
+template<typename Key, typename Value, bool EnableStats>
+void GdsfCache<Key, Value, EnableStats>::put(const Key& key, const Value& value) {
+    put(key, value, ByteSize<Key>::of(key) + ByteSize<Value>::of(value));
+}
+
+template<typename Key, typename Value, bool EnableStats>
+void GdsfCache<Key, Value, EnableStats>::put(const Key& key, const Value& value, size_t size, double cost) {
+    if (this->capacity_ == 0) return;
+    //a zero size would give an infinite priority
+    size = max<size_t>(size, 1);
+    lock_guard<mutex> lock{ this->mutex_ };
+    auto it = this->index_.find(key);
+    if (it != this->index_.end()) {
+        const uint32_t slot = it->second;
+        if (size > this->byteBudget_) {
+            //the new value alone is over budget, the old one must not stay behind as a stale copy
+            this->recorder_.record(StatsCounter::RejectedAdmission);
+            erase(slot);
+            return;
+        }
+        Entry& entry = this->entries_[slot];
+        this->recorder_.record(StatsCounter::Update);
+        this->recorder_.valueReplaced(entry.value, value);
+        this->bytes_ = this->bytes_ - entry.size + size;
+        entry.value = value;
+        entry.size = size;
+        entry.cost = cost;
+        ++entry.frequency;
+        reprioritize(slot);
+        //a grown value pushes out whatever is cheapest to lose, possibly itself
+        while (this->bytes_ > this->byteBudget_)
+            evict();
+        return;
+    }
+
+    if (size > this->byteBudget_) {
+        this->recorder_.record(StatsCounter::RejectedAdmission);
+        return;
+    }
+    while (this->index_.size() >= this->capacity_ || this->bytes_ + size > this->byteBudget_)
+        evict();
+    const uint32_t slot = this->entries_.acquire();
+    Entry& entry = this->entries_[slot];
+    entry.key = key;
+    entry.value = value;
+    entry.size = size;
+    entry.cost = cost;
+    entry.frequency = 1;
+    this->bytes_ += size;
+    this->heap_.push_back(HeapItem{ priorityOf(entry), slot });
+    entry.heapPosition = static_cast<uint32_t>(this->heap_.size() - 1);
+    siftUp(this->heap_.size() - 1);
+    this->index_.emplace(key, slot);
+    this->recorder_.record(StatsCounter::Put);
+    this->recorder_.record(StatsCounter::MissBytes, size);
+    this->recorder_.entryAdded(key, value);
+}
+
+template<typename Key, typename Value, bool EnableStats>
+optional<Value> GdsfCache<Key, Value, EnableStats>::get(const Key& key) {
+    lock_guard<mutex> lock{ this->mutex_ };
+    auto it = this->index_.find(key);
+    if (it == this->index_.end()) {
+        this->recorder_.record(StatsCounter::Miss);
+        return nullopt;
+    }
+    const uint32_t slot = it->second;
+    Entry& entry = this->entries_[slot];
+    this->recorder_.record(StatsCounter::Hit);
+    this->recorder_.record(StatsCounter::HitBytes, entry.size);
+    ++entry.frequency;
+    reprioritize(slot);
+    return this->entries_[slot].value;
+}
+
+template<typename Key, typename Value, bool EnableStats>
+bool GdsfCache<Key, Value, EnableStats>::remove(const Key& key) {
+    lock_guard<mutex> lock{ this->mutex_ };
+    auto it = this->index_.find(key);
+    if (it == this->index_.end())
+        return false;
+    erase(it->second);
+    return true;
+}
+
+template<typename Key, typename Value, bool EnableStats>
+bool GdsfCache<Key, Value, EnableStats>::isExists(const Key& key) {
+    lock_guard<mutex> lock{ this->mutex_ };
+    return this->index_.find(key) != this->index_.end();
+}
+
+template<typename Key, typename Value, bool EnableStats>
+optional<Value> GdsfCache<Key, Value, EnableStats>::peek(const Key& key) {
+    lock_guard<mutex> lock{ this->mutex_ };
+    auto it = this->index_.find(key);
+    if (it == this->index_.end())
+        return nullopt;
+    return this->entries_[it->second].value;
+}
+
+template<typename Key, typename Value, bool EnableStats>
+CacheStats GdsfCache<Key, Value, EnableStats>::stats() {
+    lock_guard<mutex> lock{ this->mutex_ };
+    return this->recorder_.collect(this->index_.size());
+}
+
+//sizes as given to put, the unit of the byte budget
+template<typename Key, typename Value, bool EnableStats>
+size_t GdsfCache<Key, Value, EnableStats>::bytes() {
+    lock_guard<mutex> lock{ this->mutex_ };
+    return this->bytes_;
+}
+
+template<typename Key, typename Value, bool EnableStats>
+double GdsfCache<Key, Value, EnableStats>::inflation() {
+    lock_guard<mutex> lock{ this->mutex_ };
+    return this->inflation_;
+}
+
+template<typename Key, typename Value, bool EnableStats>
+double GdsfCache<Key, Value, EnableStats>::priorityOf(const Entry& entry) const {
+    return this->inflation_ + static_cast<double>(entry.frequency) * entry.cost / static_cast<double>(entry.size);
+}
+
+//a hit only raises the priority, since L never falls; an update to a bigger or cheaper value may lower it
+template<typename Key, typename Value, bool EnableStats>
+void GdsfCache<Key, Value, EnableStats>::reprioritize(uint32_t slot) {
+    const size_t position = this->entries_[slot].heapPosition;
+    this->heap_[position].priority = priorityOf(this->entries_[slot]);
+    siftUp(position);
+    siftDown(this->entries_[slot].heapPosition);
+}
+
+template<typename Key, typename Value, bool EnableStats>
+void GdsfCache<Key, Value, EnableStats>::erase(uint32_t slot) {
+    Entry& entry = this->entries_[slot];
+    this->recorder_.entryRemoved(entry.key, entry.value);
+    this->index_.erase(entry.key);
+    this->bytes_ -= entry.size;
+    const size_t position = entry.heapPosition;
+    const HeapItem last = this->heap_.back();
+    this->heap_.pop_back();
+    if (position < this->heap_.size()) {
+        place(position, last);
+        siftUp(position);
+        siftDown(this->entries_[last.slot].heapPosition);
+    }
+    this->entries_.release(slot);
+}
+
+template<typename Key, typename Value, bool EnableStats>
+void GdsfCache<Key, Value, EnableStats>::evict() {
+    const uint32_t victim = this->heap_.front().slot;
+    this->inflation_ = this->heap_.front().priority;
+    Entry& entry = this->entries_[victim];
+    this->recorder_.record(StatsCounter::Eviction);
+    this->notifyEviction(entry.key, entry.value);
+    erase(victim);
+}
+
+template<typename Key, typename Value, bool EnableStats>
+void GdsfCache<Key, Value, EnableStats>::place(size_t position, HeapItem item) {
+    this->heap_[position] = item;
+    this->entries_[item.slot].heapPosition = static_cast<uint32_t>(position);
+}
+
+template<typename Key, typename Value, bool EnableStats>
+void GdsfCache<Key, Value, EnableStats>::siftUp(size_t position) {
+    const HeapItem item = this->heap_[position];
+    while (position > 0) {
+        const size_t parent = (position - 1) / ARITY;
+        if (this->heap_[parent].priority <= item.priority)
+            break;
+        place(position, this->heap_[parent]);
+        position = parent;
+    }
+    place(position, item);
+}
+
+template<typename Key, typename Value, bool EnableStats>
+void GdsfCache<Key, Value, EnableStats>::siftDown(size_t position) {
+    const HeapItem item = this->heap_[position];
+    const size_t count = this->heap_.size();
+    while (true) {
+        const size_t first = position * ARITY + 1;
+        if (first >= count)
+            break;
+        //the children sit next to each other, one or two cache lines
+        size_t smallest = first;
+        const size_t last = min(first + ARITY, count);
+        for (size_t child = first + 1; child < last; ++child) {
+            if (this->heap_[child].priority < this->heap_[smallest].priority)
+                smallest = child;
+        }
+        if (item.priority <= this->heap_[smallest].priority)
+            break;
+        place(position, this->heap_[smallest]);
+        position = smallest;
+    }
+    place(position, item);
+}
@@ -0,0 +1,242 @@
+#pragma once
+#include <cstdint>
+#include <mutex>
+#include <stdexcept>
+#include <vector>
+
+#include "../ICachePolicy.h"
+#include "../Stats/StatsRecorder.h"
+
+//hyperbolic caching: an entry's priority is its hits divided by the time it has spent in the cache, times its
+//cost when one is given; eviction draws sampleSize random entries and drops the lowest, so there is no list,
+//heap or frequency map to keep in order and a hit is one counter increment
+//a new entry starts with a high priority that decays as it waits, which covers recency, and a popular one
+//keeps its rate up, which covers frequency; time is the count of gets and puts
+//entries sit densely in one vector with their counters inline, the index is an open-addressing table of
+//32-bit slot numbers at most half full; an eviction or remove moves the last entry into the hole
+template<typename Key, typename Value, bool EnableStats = true>
+class HyperbolicCache : public ICachePolicy<Key, Value> {
+private:
+    static constexpr uint32_t EMPTY = UINT32_MAX;
+
+    struct Entry {
+        Key key;
+        Value value;
+        uint64_t since;     //clock at insertion
+        uint32_t hits;
+        float cost;
+    };
+
+    size_t capacity_;
+    size_t sampleSize_;
+    uint64_t clock_;
+    uint64_t random_;
+    unsigned int shift_;
+    mutex mutex_;
+    vector<Entry> entries_;
+    vector<uint32_t> buckets_;
+    StatsRecorder<EnableStats> recorder_;
+
+public:
+    HyperbolicCache() = delete;
+    HyperbolicCache(unsigned int capacity, size_t sampleSize = 64);
+    ~HyperbolicCache() override = default;
+
+    void put(const Key& key, const Value& value) override;
+    //cost weighs the priority, e.g. the time a miss on the key takes to refetch
+    void put(const Key& key, const Value& value, float cost);
+    optional<Value> get(const Key& key) override;
+    bool remove(const Key& key) override;
+    bool isExists(const Key& key) override;
+    optional<Value> peek(const Key& key) override;
+    CacheStats stats() override;
+
+private:
+    size_t home(const Key& key) const;
+    //the bucket holding key, or the empty bucket where it would go
+    size_t probe(const Key& key) const;
+    void eraseBucket(size_t bucket);
+    void eraseSlot(uint32_t slot, size_t bucket);
+    uint32_t sampleVictim();
+    uint64_t nextRandom();
+};
+
+template<typename Key, typename Value, bool EnableStats>
+HyperbolicCache<Key, Value, EnableStats>::HyperbolicCache(unsigned int capacity, size_t sampleSize)
+    : capacity_{ capacity }, sampleSize_{ max<size_t>(1, sampleSize) }, clock_{ 0 }, random_{ 0x9e3779b97f4a7c15ull } {
+    if (capacity >= EMPTY / 2)
+        throw runtime_error("In HyperbolicCache.h-----Capacity must stay below 2^31.");
+    size_t bucketCount = 2;
+    this->shift_ = 63;
+    while (bucketCount < static_cast<size_t>(capacity) * 2) {
+        bucketCount <<= 1;
+        --this->shift_;
+    }
+    this->buckets_.assign(bucketCount, EMPTY);
+    this->entries_.reserve(capacity);
+}
+
+template<typename Key, typename Value, bool EnableStats>
+void HyperbolicCache<Key, Value, EnableStats>::put(const Key& key, const Value& value) {
+    put(key, value, 1.0f);
+}
+
+template<typename Key, typename Value, bool EnableStats>
+void HyperbolicCache<Key, Value, EnableStats>::put(const Key& key, const Value& value, float cost) {
+    if (this->capacity_ == 0) return;
+    lock_guard<mutex> lock{ this->mutex_ };
+    ++this->clock_;
+    size_t bucket = probe(key);
+    if (this->buckets_[bucket] != EMPTY) {
+        Entry& entry = this->entries_[this->buckets_[bucket]];
+        this->recorder_.record(StatsCounter::Update);
+        this->recorder_.valueReplaced(entry.value, value);
+        entry.value = value;
+        entry.cost = cost;
+        if (entry.hits < UINT32_MAX)
+            ++entry.hits;
+        return;
+    }
+    if (this->entries_.size() >= this->capacity_) {
+        const uint32_t victim = sampleVictim();
+        Entry& entry = this->entries_[victim];
+        this->recorder_.record(StatsCounter::Eviction);
+        this->recorder_.entryRemoved(entry.key, entry.value);
+        this->notifyEviction(entry.key, entry.value);
+        eraseSlot(victim, probe(entry.key));
+        //the backward shift may have moved the empty bucket found for key
+        bucket = probe(key);
+    }
+    this->buckets_[bucket] = static_cast<uint32_t>(this->entries_.size());
+    this->entries_.push_back(Entry{ key, value, this->clock_, 1, cost });
+    this->recorder_.record(StatsCounter::Put);
+    this->recorder_.entryAdded(key, value);
+}
+
+template<typename Key, typename Value, bool EnableStats>
+optional<Value> HyperbolicCache<Key, Value, EnableStats>::get(const Key& key) {
+    lock_guard<mutex> lock{ this->mutex_ };
+    ++this->clock_;
+    const uint32_t slot = this->buckets_[probe(key)];
+    if (slot == EMPTY) {
+        this->recorder_.record(StatsCounter::Miss);
+        return nullopt;
+    }
+    this->recorder_.record(StatsCounter::Hit);
+    Entry& entry = this->entries_[slot];
+    if (entry.hits < UINT32_MAX)
+        ++entry.hits;
+    return entry.value;
+}
+
+template<typename Key, typename Value, bool EnableStats>
+bool HyperbolicCache<Key, Value, EnableStats>::remove(const Key& key) {
+    lock_guard<mutex> lock{ this->mutex_ };
+    const size_t bucket = probe(key);
+    const uint32_t slot = this->buckets_[bucket];
+    if (slot == EMPTY)
+        return false;
+    this->recorder_.entryRemoved(key, this->entries_[slot].value);
+    eraseSlot(slot, bucket);
+    return true;
+}
+
+template<typename Key, typename Value, bool EnableStats>
+bool HyperbolicCache<Key, Value, EnableStats>::isExists(const Key& key) {
+    lock_guard<mutex> lock{ this->mutex_ };
+    return this->buckets_[probe(key)] != EMPTY;
+}
+
+template<typename Key, typename Value, bool EnableStats>
+optional<Value> HyperbolicCache<Key, Value, EnableStats>::peek(const Key& key) {
+    lock_guard<mutex> lock{ this->mutex_ };
+    const uint32_t slot = this->buckets_[probe(key)];
+    if (slot == EMPTY)
+        return nullopt;
+    return this->entries_[slot].value;
+}
+
+template<typename Key, typename Value, bool EnableStats>
+CacheStats HyperbolicCache<Key, Value, EnableStats>::stats() {
+    lock_guard<mutex> lock{ this->mutex_ };
+    return this->recorder_.collect(this->entries_.size());
+}
+
+//Fibonacci hashing, the top bits of the product, so sequential integer keys do not form one long run
+template<typename Key, typename Value, bool EnableStats>
+size_t HyperbolicCache<Key, Value, EnableStats>::home(const Key& key) const {
+    return static_cast<size_t>((static_cast<uint64_t>(hash<Key>{}(key)) * 0x9e3779b97f4a7c15ull) >> this->shift_);
+}
+
+template<typename Key, typename Value, bool EnableStats>
+size_t HyperbolicCache<Key, Value, EnableStats>::probe(const Key& key) const {
+    const size_t mask = this->buckets_.size() - 1;
+    size_t bucket = home(key);
+    while (this->buckets_[bucket] != EMPTY && !(this->entries_[this->buckets_[bucket]].key == key))
+        bucket = (bucket + 1) & mask;
+    return bucket;
+}
+
+//backward-shift deletion: later members of the run move up into the hole unless that would put them
+//before their home bucket, so lookups never need tombstones
+template<typename Key, typename Value, bool EnableStats>
+void HyperbolicCache<Key, Value, EnableStats>::eraseBucket(size_t bucket) {
+    const size_t mask = this->buckets_.size() - 1;
+    size_t hole = bucket;
+    size_t next = (hole + 1) & mask;
+    while (this->buckets_[next] != EMPTY) {
+        const size_t wanted = home(this->entries_[this->buckets_[next]].key);
+        //distance from home to next, and from home to hole, both going forward around the table
+        if (((next - wanted) & mask) >= ((next - hole) & mask)) {
+            this->buckets_[hole] = this->buckets_[next];
+            hole = next;
+        }
+        next = (next + 1) & mask;
+    }
+    this->buckets_[hole] = EMPTY;
+}
+
+//the last entry moves into the freed slot and its bucket is pointed there
+template<typename Key, typename Value, bool EnableStats>
+void HyperbolicCache<Key, Value, EnableStats>::eraseSlot(uint32_t slot, size_t bucket) {
+    eraseBucket(bucket);
+    const uint32_t last = static_cast<uint32_t>(this->entries_.size() - 1);
+    if (slot != last) {
+        this->buckets_[probe(this->entries_[last].key)] = slot;
+        this->entries_[slot] = move(this->entries_[last]);
+    }
+    this->entries_.pop_back();
+}
+
+//hits / age < best.hits / best.age is compared as hits * best.age < best.hits * age, no division;
+//cost multiplies hits on both sides
+template<typename Key, typename Value, bool EnableStats>
+uint32_t HyperbolicCache<Key, Value, EnableStats>::sampleVictim() {
+    const size_t count = this->entries_.size();
+    const bool scanAll = count <= this->sampleSize_;
+    const size_t draws = scanAll ? count : this->sampleSize_;
+    uint32_t victim = 0;
+    double victimWeight = 0.0;
+    double victimAge = 0.0;
+    for (size_t i = 0; i < draws; ++i) {
+        const uint32_t slot = static_cast<uint32_t>(scanAll ? i : nextRandom() % count);
+        const Entry& entry = this->entries_[slot];
+        const double weight = static_cast<double>(entry.hits) * entry.cost;
+        const double age = static_cast<double>(this->clock_ - entry.since + 1);
+        if (i == 0 || weight * victimAge < victimWeight * age) {
+            victim = slot;
+            victimWeight = weight;
+            victimAge = age;
+        }
+    }
+    return victim;
+}
+
+//xorshift64, sampling only needs to be spread out, not unpredictable
+template<typename Key, typename Value, bool EnableStats>
+uint64_t HyperbolicCache<Key, Value, EnableStats>::nextRandom() {
+    this->random_ ^= this->random_ << 13;
+    this->random_ ^= this->random_ >> 7;
+    this->random_ ^= this->random_ << 17;
+    return this->random_;
+}
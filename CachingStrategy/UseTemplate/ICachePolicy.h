@@ -1,13 +1,38 @@
 #pragma once
+#include <functional>
 #include <optional>
+
+#include "Stats/CacheStats.h"
 using namespace std;
 
 template<typename Key,typename Value>
 class ICachePolicy {
 public:
+	using EvictionListener = function<void(const Key&, const Value&)>;
+
 	virtual ~ICachePolicy() {}
 	virtual void put(const Key&,const Value&) = 0;
 	virtual optional<Value> get(const Key&) = 0;
 	virtual bool remove(const Key&) = 0;
 	virtual bool isExists(const Key&) = 0;
+	//read without promoting the entry or counting as an access
+	virtual optional<Value> peek(const Key&) = 0;
+	//hits, misses, evictions and the like since construction
+	//engines built with EnableStats = false report only their size, wrappers report the engine they wrap
+	virtual CacheStats stats() { return CacheStats{}; }
+
+	//the listener runs while the engine still holds its lock,
+	//so it must not call back into the same cache
+	virtual void setEvictionListener(const EvictionListener& listener) { this->evictionListener_ = listener; }
+
+protected:
+	void notifyEviction(const Key& key, const Value& value) {
+		if (this->evictionListener_)
+			this->evictionListener_(key, value);
+	}
+	//lets wrappers skip building a value nobody is going to see
+	bool hasEvictionListener() const { return static_cast<bool>(this->evictionListener_); }
+
+private:
+	EvictionListener evictionListener_;
 };
\ No newline at end of file
@@ -1,15 +1,19 @@
 #pragma once
-#include "..\ICachePolicy.h"
+#include "../ICachePolicy.h"
 #include "LfuNode.h"
 #include "NodeList.h"
+#include "../Snapshot/Snapshot.h"
+#include "../Stats/StatsRecorder.h"
+#include "../Stats/LockProfiler.h"
 #include <mutex>
+#include <shared_mutex>
 #include <unordered_map>
 #include <map>
 #include <stdexcept>
 #include <algorithm>
 
 
-template<typename Key, typename Value>
+template<typename Key, typename Value, bool EnableStats = true>
 class AgingLfuCache : public ICachePolicy<Key, Value> {
 private:
     using Node = LfuNode<Key, Value>;
@@ -21,13 +25,15 @@ private:
     
 
 private:
-    mutex mutex_;
+    shared_mutex mutex_;
     NodeHash nodeHash_;
     FreqHash freqHash_;
     unsigned int capacity_;
     unsigned int maxAverageFreqNum_;
     unsigned int curAverageFreqNum_;
     unsigned int totalFreqNum_;
+    StatsRecorder<EnableStats> recorder_;
+    atomic<LockProfiler*> profiler_{ nullptr };
 
 public:
     AgingLfuCache() = delete;
@@ -38,8 +44,19 @@ public:
     optional<Value> get(const Key& key) override;
     bool isExists(const Key& key)  override;
     bool remove(const Key& key) override;
+    optional<Value> peek(const Key& key) override;
+    CacheStats stats() override;
+    //times get/put and the wait for mutex_ into profiler, nullptr detaches it
+    void setProfiler(LockProfiler* profiler) { this->profiler_.store(profiler, memory_order_relaxed); }
+
+    //same layout as LfuCache, the aging counters are rebuilt from the restored frequencies
+    void snapshot(const string& path);
+    void restore(const string& path);
+    void saveTo(SnapshotWriter& writer);
+    void loadFrom(SnapshotReader& reader);
 
 private:
+    void clearAll();
     void updateNode(const NodePtr& node, const Value& value);
     void insertNewNode(const Key& key, const NodePtr& node);
     void insertIntoFreqHash(const NodePtr& node);
@@ -53,8 +70,8 @@ private:
     void handleOverMaxAverageFreqNum();
 };
 
-template<typename Key, typename Value>
-AgingLfuCache<Key, Value>::AgingLfuCache(unsigned int capacity, unsigned int maxAverageFreqNum)
+template<typename Key, typename Value, bool EnableStats>
+AgingLfuCache<Key, Value, EnableStats>::AgingLfuCache(unsigned int capacity, unsigned int maxAverageFreqNum)
     : capacity_(capacity),
     maxAverageFreqNum_(maxAverageFreqNum),
     curAverageFreqNum_(0),
@@ -64,13 +81,15 @@ AgingLfuCache<Key, Value>::AgingLfuCache(unsigned int capacity, unsigned int max
     }
 }
 
-template<typename Key, typename Value>
-void AgingLfuCache<Key, Value>::put(const Key& key, const Value& value) {
-    lock_guard<mutex> lock(mutex_);
+template<typename Key, typename Value, bool EnableStats>
+void AgingLfuCache<Key, Value, EnableStats>::put(const Key& key, const Value& value) {
+    ProfiledLock<shared_mutex> lock{ this->mutex_, this->profiler_.load(memory_order_relaxed), ProfiledOperation::Put };
 
     auto it = this->nodeHash_.find(key);
     if (it != this->nodeHash_.end()) {
         NodePtr node = it->second;
+        this->recorder_.record(StatsCounter::Update);
+        this->recorder_.valueReplaced(node->peekValue(), value);
         updateNode(node, value); 
         increaseTotalFreqNum();
         return;
@@ -80,27 +99,30 @@ void AgingLfuCache<Key, Value>::put(const Key& key, const Value& value) {
         evictLeastFrequentNode();
     }
 
+    this->recorder_.record(StatsCounter::Put);
+    this->recorder_.entryAdded(key, value);
+
     NodePtr newNode = make_shared<Node>(key, value);
     insertNewNode(key, newNode);
     increaseTotalFreqNum();
 }
 
-template<typename Key, typename Value>
-void AgingLfuCache<Key, Value>::updateNode(const NodePtr& node, const Value& value) {
+template<typename Key, typename Value, bool EnableStats>
+void AgingLfuCache<Key, Value, EnableStats>::updateNode(const NodePtr& node, const Value& value) {
     node->setValue(value);
     removeFromFreqHash(node);
     node->increaseFrequency();
     insertIntoFreqHash(node);
 }
 
-template<typename Key, typename Value>
-void AgingLfuCache<Key, Value>::insertNewNode(const Key& key, const NodePtr& node) {
+template<typename Key, typename Value, bool EnableStats>
+void AgingLfuCache<Key, Value, EnableStats>::insertNewNode(const Key& key, const NodePtr& node) {
     insertIntoNodeHash(key, node);
     insertIntoFreqHash(node);
 }
 
-template<typename Key, typename Value>
-void AgingLfuCache<Key, Value>::insertIntoFreqHash(const NodePtr& node) {
+template<typename Key, typename Value, bool EnableStats>
+void AgingLfuCache<Key, Value, EnableStats>::insertIntoFreqHash(const NodePtr& node) {
     const unsigned int freq = node->getFrequency();
     auto& freqList = freqHash_[freq];  // Զ nullptr 
     if (!freqList) {
@@ -109,20 +131,20 @@ void AgingLfuCache<Key, Value>::insertIntoFreqHash(const NodePtr& node) {
     freqList->insertNode(node);
 }
 
-template<typename Key, typename Value>
-void AgingLfuCache<Key, Value>::insertIntoNodeHash(const Key& key, const NodePtr& node) {
+template<typename Key, typename Value, bool EnableStats>
+void AgingLfuCache<Key, Value, EnableStats>::insertIntoNodeHash(const Key& key, const NodePtr& node) {
     this->nodeHash_.emplace(key, node);
 }
 
-template<typename Key, typename Value>
-void AgingLfuCache<Key, Value>::removeNode(const NodePtr& node) {
+template<typename Key, typename Value, bool EnableStats>
+void AgingLfuCache<Key, Value, EnableStats>::removeNode(const NodePtr& node) {
     removeFromFreqHash(node);
     removeFromNodeHash(node);
     decreaseTotalFreqNum(node->getFrequency());
 }
 
-template<typename Key, typename Value>
-void AgingLfuCache<Key, Value>::removeFromFreqHash(const NodePtr& node) {
+template<typename Key, typename Value, bool EnableStats>
+void AgingLfuCache<Key, Value, EnableStats>::removeFromFreqHash(const NodePtr& node) {
     unsigned int freq = node->getFrequency();
     auto it = freqHash_.find(freq);
     if (it == freqHash_.end()) return;
@@ -136,13 +158,13 @@ void AgingLfuCache<Key, Value>::removeFromFreqHash(const NodePtr& node) {
     }
 }
 
-template<typename Key, typename Value>
-void AgingLfuCache<Key, Value>::removeFromNodeHash(const NodePtr& node) {
+template<typename Key, typename Value, bool EnableStats>
+void AgingLfuCache<Key, Value, EnableStats>::removeFromNodeHash(const NodePtr& node) {
     this->nodeHash_.erase(node->getKey());
 }
 
-template<typename Key, typename Value>
-void AgingLfuCache<Key, Value>::evictLeastFrequentNode() {
+template<typename Key, typename Value, bool EnableStats>
+void AgingLfuCache<Key, Value, EnableStats>::evictLeastFrequentNode() {
     auto it = this->freqHash_.begin();
     if (it == this->freqHash_.end() || it->second->isEmpty()) {       
         throw logic_error("In AgingLfuCache.h-----Cannot evict from an empty cache."); 
@@ -155,18 +177,23 @@ void AgingLfuCache<Key, Value>::evictLeastFrequentNode() {
     }
     else {
     removeNode(node);
+    this->recorder_.record(StatsCounter::Eviction);
+    this->recorder_.entryRemoved(node->getKey(), node->peekValue());
+    this->notifyEviction(node->getKey(), node->getValue());
     }
 }
 
-template<typename Key, typename Value>
-std::optional<Value> AgingLfuCache<Key, Value>::get(const Key& key) {
-    lock_guard<mutex> lock(mutex_);
+template<typename Key, typename Value, bool EnableStats>
+std::optional<Value> AgingLfuCache<Key, Value, EnableStats>::get(const Key& key) {
+    ProfiledLock<shared_mutex> lock{ this->mutex_, this->profiler_.load(memory_order_relaxed), ProfiledOperation::Get };
     
 
     auto it = nodeHash_.find(key);
     if (it == nodeHash_.end()) {
+        this->recorder_.record(StatsCounter::Miss);
         return nullopt;
     }
+    this->recorder_.record(StatsCounter::Hit);
 
     increaseTotalFreqNum();
 
@@ -176,24 +203,44 @@ std::optional<Value> AgingLfuCache<Key, Value>::get(const Key& key) {
     return value;
 }
 
-template<typename Key, typename Value>
-bool AgingLfuCache<Key, Value>::isExists(const Key& key) {
+template<typename Key, typename Value, bool EnableStats>
+bool AgingLfuCache<Key, Value, EnableStats>::isExists(const Key& key) {
+    shared_lock<shared_mutex> lock(mutex_);
     return nodeHash_.find(key) != nodeHash_.end();
 }
 
-template<typename Key, typename Value>
-bool AgingLfuCache<Key, Value>::remove(const Key& key) {
-    lock_guard<mutex> lock(mutex_);
+template<typename Key, typename Value, bool EnableStats>
+optional<Value> AgingLfuCache<Key, Value, EnableStats>::peek(const Key& key) {
+    shared_lock<shared_mutex> lock(mutex_);
+    auto it = nodeHash_.find(key);
+    if (it == nodeHash_.end()) {
+        return nullopt;
+    }
+    return it->second->getValue();
+}
+
+template<typename Key, typename Value, bool EnableStats>
+bool AgingLfuCache<Key, Value, EnableStats>::remove(const Key& key) {
+    lock_guard<shared_mutex> lock(mutex_);
     auto it = this->nodeHash_.find(key);
     if (it == this->nodeHash_.end()) {
         return false;
     }
-    removeNode(it->second);
+    //copy the pointer, removeNode erases the map slot it->second lives in
+    NodePtr node = it->second;
+    this->recorder_.entryRemoved(key, node->peekValue());
+    removeNode(node);
     return true;
 }
 
-template<typename Key, typename Value>
-void AgingLfuCache<Key, Value>::increaseTotalFreqNum() {
+template<typename Key, typename Value, bool EnableStats>
+CacheStats AgingLfuCache<Key, Value, EnableStats>::stats() {
+    shared_lock<shared_mutex> lock(mutex_);
+    return this->recorder_.collect(this->nodeHash_.size());
+}
+
+template<typename Key, typename Value, bool EnableStats>
+void AgingLfuCache<Key, Value, EnableStats>::increaseTotalFreqNum() {
     this->totalFreqNum_++;
     this->curAverageFreqNum_ = this->nodeHash_.empty() ? 0 : totalFreqNum_ / nodeHash_.size();
     if (this->curAverageFreqNum_ > this->maxAverageFreqNum_) {
@@ -201,14 +248,14 @@ void AgingLfuCache<Key, Value>::increaseTotalFreqNum() {
     }
 }
 
-template<typename Key, typename Value>
-void AgingLfuCache<Key, Value>::decreaseTotalFreqNum(unsigned int freq) {
+template<typename Key, typename Value, bool EnableStats>
+void AgingLfuCache<Key, Value, EnableStats>::decreaseTotalFreqNum(unsigned int freq) {
     this->totalFreqNum_ -= freq;
     this->curAverageFreqNum_ = this->nodeHash_.empty() ? 0 : this->totalFreqNum_ / this->nodeHash_.size();
 }
 
-template<typename Key, typename Value>
-void AgingLfuCache<Key, Value>::handleOverMaxAverageFreqNum() {
+template<typename Key, typename Value, bool EnableStats>
+void AgingLfuCache<Key, Value, EnableStats>::handleOverMaxAverageFreqNum() {
     const unsigned int subtrahend = this->maxAverageFreqNum_ / 2;
     this->totalFreqNum_ = 0;
 
@@ -222,4 +269,69 @@ void AgingLfuCache<Key, Value>::handleOverMaxAverageFreqNum() {
     }
 
     this->curAverageFreqNum_ = this->nodeHash_.empty() ? 0 : this->totalFreqNum_ / this->nodeHash_.size();
-}
\ No newline at end of file
+}
+
+template<typename Key, typename Value, bool EnableStats>
+void AgingLfuCache<Key, Value, EnableStats>::snapshot(const string& path) {
+    SnapshotWriter writer{ path, SnapshotHeader::of<Key, Value>(SnapshotEngine::AgingLfu) };
+    saveTo(writer);
+    writer.commit();
+}
+
+template<typename Key, typename Value, bool EnableStats>
+void AgingLfuCache<Key, Value, EnableStats>::restore(const string& path) {
+    SnapshotReader reader{ path, SnapshotHeader::of<Key, Value>(SnapshotEngine::AgingLfu) };
+    loadFrom(reader);
+}
+
+template<typename Key, typename Value, bool EnableStats>
+void AgingLfuCache<Key, Value, EnableStats>::saveTo(SnapshotWriter& writer) {
+    shared_lock<shared_mutex> lock(mutex_);
+    writer.write<uint64_t>(this->nodeHash_.size());
+    for (auto& pair : this->freqHash_) {
+        FreqPtr freqList = pair.second;
+        for (NodePtr node = freqList->dummyTail_->getPre(); node != freqList->dummyHead_; node = node->getPre()) {
+            writer.write<Key>(node->getKey());
+            writer.write<Value>(node->getValue());
+            writer.write<uint32_t>(node->getFrequency());
+        }
+    }
+}
+
+template<typename Key, typename Value, bool EnableStats>
+void AgingLfuCache<Key, Value, EnableStats>::loadFrom(SnapshotReader& reader) {
+    lock_guard<shared_mutex> lock(mutex_);
+    clearAll();
+    const uint64_t count = reader.read<uint64_t>();
+    const uint64_t skipped = count > this->capacity_ ? count - this->capacity_ : 0;
+    this->nodeHash_.reserve(static_cast<size_t>(count - skipped));
+    for (uint64_t i = 0; i < count; ++i) {
+        Key key = reader.read<Key>();
+        Value value = reader.read<Value>();
+        const uint32_t freq = reader.read<uint32_t>();
+        if (i < skipped)
+            continue;
+        this->recorder_.entryAdded(key, value);
+        NodePtr node = make_shared<Node>(key, move(value));
+        node->setFrequency(freq);
+        if (!this->nodeHash_.emplace(key, node).second)
+            throw runtime_error("In AgingLfuCache.h-----Snapshot holds a key twice.");
+        insertIntoFreqHash(node);
+        this->totalFreqNum_ += freq;
+    }
+    this->curAverageFreqNum_ = this->nodeHash_.empty() ? 0 : this->totalFreqNum_ / this->nodeHash_.size();
+}
+
+template<typename Key, typename Value, bool EnableStats>
+void AgingLfuCache<Key, Value, EnableStats>::clearAll() {
+    //nodes point at each other, break the links so they are actually released
+    for (auto& pair : this->nodeHash_) {
+        this->recorder_.entryRemoved(pair.first, pair.second->peekValue());
+        pair.second->setPre(nullptr);
+        pair.second->setNext(nullptr);
+    }
+    this->nodeHash_.clear();
+    this->freqHash_.clear();
+    this->totalFreqNum_ = 0;
+    this->curAverageFreqNum_ = 0;
+}
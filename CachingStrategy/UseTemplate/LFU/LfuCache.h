@@ -1,12 +1,18 @@
 #pragma once
-#include "..\ICachePolicy.h"
+#include "../ICachePolicy.h"
+#include "../SeqlockIndex.h"
 #include "LfuNode.h"
 #include"NodeList.h"
+#include "../Snapshot/Snapshot.h"
+#include "../Stats/StatsRecorder.h"
+#include "../Stats/LockProfiler.h"
 #include <mutex>
+#include <shared_mutex>
 #include <unordered_map>
 #include <map>
+#include <cstdint>
 
-template<typename Key, typename Value>
+template<typename Key, typename Value, bool EnableStats = true>
 class LfuCache :public ICachePolicy<Key, Value> {
 private:
 	using Node = LfuNode<Key, Value>;
@@ -16,11 +22,21 @@ private:
 	using FreqPtr = shared_ptr<FreqList>;
 	using FreqHash = map<unsigned int, FreqPtr>;
 
+public:
+	//where a visitColdest walk stopped, a default constructed one starts at the cold end
+	struct ColdCursor {
+		weak_ptr<Node> node;
+		unsigned int frequency = 0;
+	};
+
 private:
-	mutex mutex_;
+	shared_mutex mutex_;
 	NodeHash nodeHash_;
 	FreqHash freqHash_;
+	SeqlockIndex<Key, Value> readIndex_;   //lets peek and isExists skip the lock for trivially copyable entries
 	unsigned int capacity_;
+	StatsRecorder<EnableStats> recorder_;
+	atomic<LockProfiler*> profiler_{ nullptr };
 	//unsigned int minFreq_;
 
 public:
@@ -31,7 +47,24 @@ public:
 	optional<Value> get(const Key&);
 	bool isExists(const Key&);
 	bool remove(const Key&);
+	optional<Value> peek(const Key&);
+	CacheStats stats() override;
+	//times get/put and the wait for mutex_ into profiler, nullptr detaches it
+	void setProfiler(LockProfiler* profiler) { this->profiler_.store(profiler, memory_order_relaxed); }
+	//hands up to maxScan entries to the visitor from the lowest frequency up, least recent first within one,
+	//without counting an access; the visitor may rewrite the value in place and returns false to stop
+	//runs under the exclusive lock; with a cursor the walk resumes just past where the last one stopped and moves
+	//the cursor along, once that entry is gone or was accessed in between it starts over from the lowest frequency
+	size_t visitColdest(const function<bool(const Key&, Value&)>& visitor, size_t maxScan = SIZE_MAX, ColdCursor* cursor = nullptr);
+
+	//entries are written from the lowest frequency up, least recent first within a frequency,
+	//restore replaces the current content and drops the least frequent entries beyond capacity
+	void snapshot(const string& path);
+	void restore(const string& path);
+	void saveTo(SnapshotWriter& writer);
+	void loadFrom(SnapshotReader& reader);
 private:
+	void clearAll();
 	void updateNode(const NodePtr&, const Value&);
 	void insertNewNode(const Key&, const NodePtr&);
 	void insertIntoFreqHash(const NodePtr&);
@@ -40,33 +73,39 @@ private:
 	void removeFromFreqHash(const NodePtr&);
 	void removeFromNodeHash(const NodePtr&);
 	void evictLeastFrequentNode();
+	void wakeReadIndex();
 	//void updateMinFreq();
 
 };
 
-template<typename Key, typename Value>
-LfuCache<Key, Value>::LfuCache(unsigned int capacity) :capacity_{ capacity } {}
+template<typename Key, typename Value, bool EnableStats>
+LfuCache<Key, Value, EnableStats>::LfuCache(unsigned int capacity) :capacity_{ capacity } {}
 
 
-template<typename Key, typename Value>
-void LfuCache<Key, Value>::put(const Key& key, const Value& value) {
-	lock_guard<mutex> lock{ this->mutex_ };
+template<typename Key, typename Value, bool EnableStats>
+void LfuCache<Key, Value, EnableStats>::put(const Key& key, const Value& value) {
+	ProfiledLock<shared_mutex> lock{ this->mutex_, this->profiler_.load(memory_order_relaxed), ProfiledOperation::Put };
 	auto it = this->nodeHash_.find(key);
 	if (it != this->nodeHash_.end()) {
 		NodePtr node = it->second;
+		this->recorder_.record(StatsCounter::Update);
+		this->recorder_.valueReplaced(node->peekValue(), value);
 		updateNode(node, value);
+		this->readIndex_.assign(key, value);
 		return;
 	}
 	if (this->nodeHash_.size() >= this->capacity_) {
 		evictLeastFrequentNode();
 	}
 
+	this->recorder_.record(StatsCounter::Put);
+	this->recorder_.entryAdded(key, value);
 	NodePtr newNode = make_shared<Node>(key, value);
 	insertNewNode(key, newNode);
 }
 
-template<typename Key, typename Value>
-void LfuCache<Key, Value>::updateNode(const NodePtr& node, const Value& value) {
+template<typename Key, typename Value, bool EnableStats>
+void LfuCache<Key, Value, EnableStats>::updateNode(const NodePtr& node, const Value& value) {
 	node->setValue(value);
 	removeFromFreqHash(node);
 	node->increaseFrequency();
@@ -85,14 +124,14 @@ void LfuCache<Key, Value>::updateNode(const NodePtr& node, const Value& value) {
 //		this->minFreq_ = 1;
 //}
 
-template<typename Key, typename Value>
-void LfuCache<Key, Value>::insertNewNode(const Key& key, const NodePtr& node) {
+template<typename Key, typename Value, bool EnableStats>
+void LfuCache<Key, Value, EnableStats>::insertNewNode(const Key& key, const NodePtr& node) {
 	insertIntoNodeHash(key, node);
 	insertIntoFreqHash(node);
 }
 
-template<typename Key, typename Value>
-void LfuCache<Key, Value>::insertIntoFreqHash(const NodePtr& node) {
+template<typename Key, typename Value, bool EnableStats>
+void LfuCache<Key, Value, EnableStats>::insertIntoFreqHash(const NodePtr& node) {
 	const unsigned int index = node->getFrequency();
 	auto it = this->freqHash_.find(index);
 	if (it == this->freqHash_.end()) {
@@ -102,25 +141,27 @@ void LfuCache<Key, Value>::insertIntoFreqHash(const NodePtr& node) {
 	this->freqHash_[index]->insertNode(node);
 }
 
-template<typename Key, typename Value>
-void LfuCache<Key, Value>::insertIntoNodeHash(const Key& key, const NodePtr& node) {
+template<typename Key, typename Value, bool EnableStats>
+void LfuCache<Key, Value, EnableStats>::insertIntoNodeHash(const Key& key, const NodePtr& node) {
 	this->nodeHash_.emplace(key, node);
+	this->readIndex_.assign(key, node->peekValue());
 }
 
-template<typename Key, typename Value>
-void LfuCache<Key, Value>::removeNode(const NodePtr& node) {
+template<typename Key, typename Value, bool EnableStats>
+void LfuCache<Key, Value, EnableStats>::removeNode(const NodePtr& node) {
 	removeFromFreqHash(node);
 	removeFromNodeHash(node);
 }
 
-template<typename Key, typename Value>
-void LfuCache<Key, Value>::removeFromNodeHash(const NodePtr& node) {
+template<typename Key, typename Value, bool EnableStats>
+void LfuCache<Key, Value, EnableStats>::removeFromNodeHash(const NodePtr& node) {
 	const Key key = node->getKey();
 	this->nodeHash_.erase(key);
+	this->readIndex_.erase(key);
 }
 
-template<typename Key, typename Value>
-void LfuCache<Key, Value>::removeFromFreqHash(const NodePtr& node) {
+template<typename Key, typename Value, bool EnableStats>
+void LfuCache<Key, Value, EnableStats>::removeFromFreqHash(const NodePtr& node) {
 	unsigned int freq = node->getFrequency();
 	auto it = this->freqHash_.find(freq);
 	if (it == this->freqHash_.end())
@@ -132,42 +173,186 @@ void LfuCache<Key, Value>::removeFromFreqHash(const NodePtr& node) {
 	}
 }
 
-template<typename Key, typename Value>
-void LfuCache<Key, Value>::evictLeastFrequentNode() {
+template<typename Key, typename Value, bool EnableStats>
+void LfuCache<Key, Value, EnableStats>::evictLeastFrequentNode() {
 	auto it = this->freqHash_.begin();
 	if (it == this->freqHash_.end())
 		return;
 	NodePtr node = it->second->getLeastNode();
 	removeNode(node);
+	this->recorder_.record(StatsCounter::Eviction);
+	this->recorder_.entryRemoved(node->getKey(), node->peekValue());
+	this->notifyEviction(node->getKey(), node->getValue());
 
 	/*removeFromNodeHash(node);
 	* freqList->removeNode(node);
 	*/
 }
 
-template<typename Key, typename Value>
-optional<Value> LfuCache<Key, Value>::get(const Key& key) {
-	lock_guard<mutex> lock{ this->mutex_ };
+template<typename Key, typename Value, bool EnableStats>
+optional<Value> LfuCache<Key, Value, EnableStats>::get(const Key& key) {
+	ProfiledLock<shared_mutex> lock{ this->mutex_, this->profiler_.load(memory_order_relaxed), ProfiledOperation::Get };
 	auto it = this->nodeHash_.find(key);
-	if (it == this->nodeHash_.end())
+	if (it == this->nodeHash_.end()) {
+		this->recorder_.record(StatsCounter::Miss);
 		return nullopt;
+	}
+	this->recorder_.record(StatsCounter::Hit);
 	NodePtr node = it->second;
 	const Value value = node->getValue();
 	updateNode(node, value);
 	return value;
 }
 
-template<typename Key, typename Value>
-bool LfuCache<Key, Value>::isExists(const Key& key) {
+template<typename Key, typename Value, bool EnableStats>
+bool LfuCache<Key, Value, EnableStats>::isExists(const Key& key) {
+	optional<Value> value;
+	if (this->readIndex_.dormant())
+		wakeReadIndex();
+	if (this->readIndex_.tryFind(key, value))
+		return value.has_value();
+	shared_lock<shared_mutex> lock{ this->mutex_ };
 	return this->nodeHash_.find(key) != this->nodeHash_.end();
 }
 
-template<typename Key, typename Value>
-bool LfuCache<Key, Value>::remove(const Key& key) {
+template<typename Key, typename Value, bool EnableStats>
+optional<Value> LfuCache<Key, Value, EnableStats>::peek(const Key& key) {
+	optional<Value> value;
+	if (this->readIndex_.dormant())
+		wakeReadIndex();
+	if (this->readIndex_.tryFind(key, value))
+		return value;
+	shared_lock<shared_mutex> lock{ this->mutex_ };
+	auto it = this->nodeHash_.find(key);
+	if (it == this->nodeHash_.end())
+		return nullopt;
+	return it->second->getValue();
+}
+
+//the first peek or isExists fills the read index, from then on writers keep it current
+template<typename Key, typename Value, bool EnableStats>
+void LfuCache<Key, Value, EnableStats>::wakeReadIndex() {
+	lock_guard<shared_mutex> lock{ this->mutex_ };
+	this->readIndex_.wake(this->nodeHash_);
+}
+
+template<typename Key, typename Value, bool EnableStats>
+bool LfuCache<Key, Value, EnableStats>::remove(const Key& key) {
+	lock_guard<shared_mutex> lock{ this->mutex_ };
 	auto it = this->nodeHash_.find(key);
 	if (it == this->nodeHash_.end())
 		return false;
 	NodePtr node = it->second;
+	this->recorder_.entryRemoved(key, node->peekValue());
 	removeNode(node);
 	return true;
-}
\ No newline at end of file
+}
+
+template<typename Key, typename Value, bool EnableStats>
+CacheStats LfuCache<Key, Value, EnableStats>::stats() {
+	shared_lock<shared_mutex> lock{ this->mutex_ };
+	return this->recorder_.collect(this->nodeHash_.size());
+}
+
+template<typename Key, typename Value, bool EnableStats>
+size_t LfuCache<Key, Value, EnableStats>::visitColdest(const function<bool(const Key&, Value&)>& visitor, size_t maxScan, ColdCursor* cursor) {
+	lock_guard<shared_mutex> lock{ this->mutex_ };
+	size_t visited = 0;
+	auto freqIt = this->freqHash_.begin();
+	NodePtr resume;
+	if (cursor) {
+		//every access moves the node up one frequency, an unchanged frequency means it stayed in its list
+		NodePtr stopped = cursor->node.lock();
+		if (stopped && stopped->getFrequency() == cursor->frequency) {
+			auto it = this->nodeHash_.find(stopped->getKey());
+			if (it != this->nodeHash_.end() && it->second == stopped) {
+				freqIt = this->freqHash_.find(stopped->getFrequency());
+				resume = stopped->getPre();
+			}
+		}
+	}
+	NodePtr last;
+	bool more = true;
+	for (; freqIt != this->freqHash_.end() && more && visited < maxScan; ++freqIt) {
+		FreqPtr freqList = freqIt->second;
+		NodePtr node = resume ? resume : freqList->dummyTail_->getPre();
+		resume = nullptr;
+		for (; node != freqList->dummyHead_ && more && visited < maxScan; node = node->getPre()) {
+			visited++;
+			last = node;
+			//the visitor may resize the value, account for it as a replacement
+			this->recorder_.entryRemoved(node->getKey(), node->peekValue());
+			more = visitor(node->getKey(), node->mutableValue());
+			this->recorder_.entryAdded(node->getKey(), node->peekValue());
+			this->readIndex_.assign(node->getKey(), node->peekValue());
+		}
+	}
+	if (cursor && last) {
+		cursor->node = last;
+		cursor->frequency = last->getFrequency();
+	}
+	return visited;
+}
+
+template<typename Key, typename Value, bool EnableStats>
+void LfuCache<Key, Value, EnableStats>::snapshot(const string& path) {
+	SnapshotWriter writer{ path, SnapshotHeader::of<Key, Value>(SnapshotEngine::Lfu) };
+	saveTo(writer);
+	writer.commit();
+}
+
+template<typename Key, typename Value, bool EnableStats>
+void LfuCache<Key, Value, EnableStats>::restore(const string& path) {
+	SnapshotReader reader{ path, SnapshotHeader::of<Key, Value>(SnapshotEngine::Lfu) };
+	loadFrom(reader);
+}
+
+template<typename Key, typename Value, bool EnableStats>
+void LfuCache<Key, Value, EnableStats>::saveTo(SnapshotWriter& writer) {
+	shared_lock<shared_mutex> lock{ this->mutex_ };
+	writer.write<uint64_t>(this->nodeHash_.size());
+	for (auto& pair : this->freqHash_) {
+		FreqPtr freqList = pair.second;
+		for (NodePtr node = freqList->dummyTail_->getPre(); node != freqList->dummyHead_; node = node->getPre()) {
+			writer.write<Key>(node->getKey());
+			writer.write<Value>(node->getValue());
+			writer.write<uint32_t>(node->getFrequency());
+		}
+	}
+}
+
+template<typename Key, typename Value, bool EnableStats>
+void LfuCache<Key, Value, EnableStats>::loadFrom(SnapshotReader& reader) {
+	lock_guard<shared_mutex> lock{ this->mutex_ };
+	clearAll();
+	const uint64_t count = reader.read<uint64_t>();
+	const uint64_t skipped = count > this->capacity_ ? count - this->capacity_ : 0;
+	this->nodeHash_.reserve(static_cast<size_t>(count - skipped));
+	for (uint64_t i = 0; i < count; ++i) {
+		Key key = reader.read<Key>();
+		Value value = reader.read<Value>();
+		const uint32_t freq = reader.read<uint32_t>();
+		if (i < skipped)
+			continue;
+		this->recorder_.entryAdded(key, value);
+		NodePtr node = make_shared<Node>(key, move(value));
+		node->setFrequency(freq);
+		if (!this->nodeHash_.emplace(key, node).second)
+			throw runtime_error("In LfuCache.h-----Snapshot holds a key twice.");
+		this->readIndex_.assign(key, node->peekValue());
+		insertIntoFreqHash(node);
+	}
+}
+
+template<typename Key, typename Value, bool EnableStats>
+void LfuCache<Key, Value, EnableStats>::clearAll() {
+	//nodes point at each other, break the links so they are actually released
+	for (auto& pair : this->nodeHash_) {
+		this->recorder_.entryRemoved(pair.first, pair.second->peekValue());
+		pair.second->setPre(nullptr);
+		pair.second->setNext(nullptr);
+	}
+	this->nodeHash_.clear();
+	this->readIndex_.clear();
+	this->freqHash_.clear();
+}
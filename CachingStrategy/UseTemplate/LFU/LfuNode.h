@@ -23,6 +23,8 @@ public:
 	const Key getKey() { return this->key_; }
 	void setKey(const Key& key) { this->key_ = key; }
 	Value getValue() { return this->value_; }
+	const Value& peekValue() const { return this->value_; }
+	Value& mutableValue() { return this->value_; }
 	void setValue(const Value& value) { this->value_ = value; }
 	unsigned int getFrequency() { return freq_; }
 	void setFrequency(const unsigned int& freq) { this->freq_ = freq; }
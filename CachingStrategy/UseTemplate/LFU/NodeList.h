@@ -11,7 +11,7 @@ public:
 	NodePtr dummyTail_;
 public:
 	NodeList();
-	~NodeList() = default;
+	~NodeList();
 	void insertNode(const NodePtr&);
 	void removeNode(const NodePtr&);
 	NodePtr getLeastNode();
@@ -26,6 +26,18 @@ NodeList<Key, Value>::NodeList() {
 	this->dummyTail_->setPre(this->dummyHead_);
 }
 
+template<typename Key,typename Value>
+NodeList<Key, Value>::~NodeList() {
+	//nodes point at each other, break the links so they are actually released
+	NodePtr node = this->dummyHead_;
+	while (node) {
+		NodePtr next = node->getNext();
+		node->setPre(nullptr);
+		node->setNext(nullptr);
+		node = next;
+	}
+}
+
 template<typename Key,typename Value>
 void NodeList<Key, Value>::insertNode(const NodePtr& node) {
 	node->setNext(this->dummyHead_->getNext());
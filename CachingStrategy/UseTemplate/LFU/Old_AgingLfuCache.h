@@ -1,5 +1,5 @@
 #pragma once
-#include "..\ICachePolicy.h"
+#include "../ICachePolicy.h"
 #include "LfuNode.h"
 #include"NodeList.h"
 #include <mutex>
@@ -0,0 +1,336 @@
+#pragma once
+#include <algorithm>
+#include <cstdint>
+#include <mutex>
+#include <unordered_map>
+
+#include "../ICachePolicy.h"
+#include "../NodePool.h"
+#include "../Stats/StatsRecorder.h"
+
+enum class LirsState : uint8_t {
+    Lir,              //resident, recently reused, never evicted directly
+    ResidentHir,      //resident, in the queue Q, the next victims
+    NonResidentHir    //metadata only, a reuse while still in S promotes the key straight to LIR
+};
+
+//LIRS: an entry is judged by its inter-reference recency, the number of distinct keys seen between its last two
+//accesses. LIR entries (small IRR) take most of the capacity and are never evicted directly, HIR entries share
+//the rest and leave in FIFO order from Q; the stack S orders LIR entries and recently seen HIR ones by recency,
+//so a HIR entry reused while still in S has proven a smaller IRR than the oldest LIR entry and swaps places with it
+//a loop just larger than the capacity keeps the same LIR set hitting where LRU misses on every access
+//non-resident HIR entries are capped at nonResidentRatio * capacity, the oldest is forgotten first
+//nodes come from a NodePool and link by index; every hit relinks, so all access takes one exclusive mutex
+template<typename Key, typename Value, bool EnableStats = true>
+class LirsCache : public ICachePolicy<Key, Value> {
+private:
+    static const uint32_t NIL = UINT32_MAX;   //as NodePool::NIL
+    //pool slots of the list sentinels
+    static const uint32_t STACK = 0;
+    static const uint32_t QUEUE = 1;
+    static const uint32_t GHOSTS = 2;
+
+    struct Node {
+        Key key{};
+        Value value{};
+        uint32_t stackPre = NIL;
+        uint32_t stackNext = NIL;
+        uint32_t queuePre = NIL;    //Q for resident HIR entries, the ghost FIFO for non-resident ones
+        uint32_t queueNext = NIL;
+        LirsState state = LirsState::ResidentHir;
+    };
+
+    size_t capacity_;
+    size_t lirCapacity_;
+    size_t nonResidentLimit_;
+    size_t lirCount_;
+    size_t residentCount_;
+    size_t nonResidentCount_;
+    mutex mutex_;
+    NodePool<Node> pool_;
+    unordered_map<Key, uint32_t> index_;
+    StatsRecorder<EnableStats> recorder_;
+
+public:
+    LirsCache() = delete;
+    //hirRatio is the share of capacity kept for HIR entries, at least one slot
+    LirsCache(unsigned int capacity, double hirRatio = 0.01, double nonResidentRatio = 2.0);
+    ~LirsCache() override = default;
+
+    void put(const Key& key, const Value& value) override;
+    optional<Value> get(const Key& key) override;
+    bool remove(const Key& key) override;
+    bool isExists(const Key& key) override;
+    optional<Value> peek(const Key& key) override;
+    CacheStats stats() override;
+
+private:
+    bool inStack(uint32_t node) const { return this->pool_[node].stackNext != NIL; }
+    void pushStack(uint32_t node);
+    void unlinkStack(uint32_t node);
+    void pushQueue(uint32_t sentinel, uint32_t node);
+    void unlinkQueue(uint32_t node);
+
+    void access(uint32_t node);
+    void promote(uint32_t node);
+    void demoteBottomLir();
+    void pruneStack();
+    void evict();
+    void forget(uint32_t node);
+};
+
+template<typename Key, typename Value, bool EnableStats>
+LirsCache<Key, Value, EnableStats>::LirsCache(unsigned int capacity, double hirRatio, double nonResidentRatio)
+    : capacity_{ capacity }, lirCount_{ 0 }, residentCount_{ 0 }, nonResidentCount_{ 0 } {
+    const size_t hirCapacity = min<size_t>(capacity, max<size_t>(1, static_cast<size_t>(capacity * hirRatio)));
+    this->lirCapacity_ = capacity - hirCapacity;
+    this->nonResidentLimit_ = max<size_t>(1, static_cast<size_t>(capacity * nonResidentRatio));
+    //every list is circular through its sentinel, so linking never has to check for an end
+    for (uint32_t sentinel = STACK; sentinel <= GHOSTS; ++sentinel) {
+        this->pool_.acquire();
+        Node& node = this->pool_[sentinel];
+        node.stackPre = node.stackNext = sentinel;
+        node.queuePre = node.queueNext = sentinel;
+    }
+}
+
+template<typename Key, typename Value, bool EnableStats>
+void LirsCache<Key, Value, EnableStats>::put(const Key& key, const Value& value) {
+    if (this->capacity_ == 0) return;
+    lock_guard<mutex> lock{ this->mutex_ };
+    auto it = this->index_.find(key);
+    if (it != this->index_.end() && this->pool_[it->second].state != LirsState::NonResidentHir) {
+        Node& node = this->pool_[it->second];
+        this->recorder_.record(StatsCounter::Update);
+        this->recorder_.valueReplaced(node.value, value);
+        node.value = value;
+        access(it->second);
+        return;
+    }
+
+    uint32_t node = NIL;
+    if (it != this->index_.end()) {
+        //out of the ghost FIFO first so making room cannot forget it
+        node = it->second;
+        unlinkQueue(node);
+        --this->nonResidentCount_;
+    }
+    if (this->residentCount_ >= this->capacity_)
+        evict();
+    if (it == this->index_.end()) {
+        node = this->pool_.acquire();
+        this->pool_[node].key = key;
+        this->index_.emplace(key, node);
+    }
+    this->recorder_.record(StatsCounter::Put);
+    this->recorder_.entryAdded(key, value);
+    this->pool_[node].value = value;
+    ++this->residentCount_;
+
+    //a ghost still in S was reused within the LIR horizon; while LIR has room every new key is LIR
+    if ((inStack(node) && this->lirCapacity_ > 0) || this->lirCount_ < this->lirCapacity_) {
+        if (inStack(node))
+            unlinkStack(node);
+        pushStack(node);
+        promote(node);
+        return;
+    }
+    this->pool_[node].state = LirsState::ResidentHir;
+    if (inStack(node))
+        unlinkStack(node);
+    pushStack(node);
+    pushQueue(QUEUE, node);
+}
+
+template<typename Key, typename Value, bool EnableStats>
+optional<Value> LirsCache<Key, Value, EnableStats>::get(const Key& key) {
+    lock_guard<mutex> lock{ this->mutex_ };
+    auto it = this->index_.find(key);
+    if (it == this->index_.end() || this->pool_[it->second].state == LirsState::NonResidentHir) {
+        if (it != this->index_.end())
+            this->recorder_.record(StatsCounter::GhostHit);
+        this->recorder_.record(StatsCounter::Miss);
+        return nullopt;
+    }
+    this->recorder_.record(StatsCounter::Hit);
+    const Value value = this->pool_[it->second].value;
+    access(it->second);
+    return value;
+}
+
+//a ghost is forgotten too, the key starts over
+template<typename Key, typename Value, bool EnableStats>
+bool LirsCache<Key, Value, EnableStats>::remove(const Key& key) {
+    lock_guard<mutex> lock{ this->mutex_ };
+    auto it = this->index_.find(key);
+    if (it == this->index_.end())
+        return false;
+    const uint32_t node = it->second;
+    const LirsState state = this->pool_[node].state;
+    if (state == LirsState::NonResidentHir) {
+        forget(node);
+        return false;
+    }
+    this->recorder_.entryRemoved(key, this->pool_[node].value);
+    if (state == LirsState::Lir)
+        --this->lirCount_;
+    else
+        unlinkQueue(node);
+    if (inStack(node))
+        unlinkStack(node);
+    --this->residentCount_;
+    this->index_.erase(it);
+    this->pool_.release(node);
+    pruneStack();
+    return true;
+}
+
+template<typename Key, typename Value, bool EnableStats>
+bool LirsCache<Key, Value, EnableStats>::isExists(const Key& key) {
+    lock_guard<mutex> lock{ this->mutex_ };
+    auto it = this->index_.find(key);
+    return it != this->index_.end() && this->pool_[it->second].state != LirsState::NonResidentHir;
+}
+
+template<typename Key, typename Value, bool EnableStats>
+optional<Value> LirsCache<Key, Value, EnableStats>::peek(const Key& key) {
+    lock_guard<mutex> lock{ this->mutex_ };
+    auto it = this->index_.find(key);
+    if (it == this->index_.end() || this->pool_[it->second].state == LirsState::NonResidentHir)
+        return nullopt;
+    return this->pool_[it->second].value;
+}
+
+template<typename Key, typename Value, bool EnableStats>
+CacheStats LirsCache<Key, Value, EnableStats>::stats() {
+    lock_guard<mutex> lock{ this->mutex_ };
+    return this->recorder_.collect(this->residentCount_);
+}
+
+//the top of S is the sentinel's stackPre, the bottom its stackNext
+template<typename Key, typename Value, bool EnableStats>
+void LirsCache<Key, Value, EnableStats>::pushStack(uint32_t node) {
+    const uint32_t top = this->pool_[STACK].stackPre;
+    this->pool_[node].stackPre = top;
+    this->pool_[node].stackNext = STACK;
+    this->pool_[top].stackNext = node;
+    this->pool_[STACK].stackPre = node;
+}
+
+template<typename Key, typename Value, bool EnableStats>
+void LirsCache<Key, Value, EnableStats>::unlinkStack(uint32_t node) {
+    Node& entry = this->pool_[node];
+    this->pool_[entry.stackPre].stackNext = entry.stackNext;
+    this->pool_[entry.stackNext].stackPre = entry.stackPre;
+    entry.stackPre = entry.stackNext = NIL;
+}
+
+template<typename Key, typename Value, bool EnableStats>
+void LirsCache<Key, Value, EnableStats>::pushQueue(uint32_t sentinel, uint32_t node) {
+    const uint32_t back = this->pool_[sentinel].queuePre;
+    this->pool_[node].queuePre = back;
+    this->pool_[node].queueNext = sentinel;
+    this->pool_[back].queueNext = node;
+    this->pool_[sentinel].queuePre = node;
+}
+
+template<typename Key, typename Value, bool EnableStats>
+void LirsCache<Key, Value, EnableStats>::unlinkQueue(uint32_t node) {
+    Node& entry = this->pool_[node];
+    this->pool_[entry.queuePre].queueNext = entry.queueNext;
+    this->pool_[entry.queueNext].queuePre = entry.queuePre;
+    entry.queuePre = entry.queueNext = NIL;
+}
+
+//a hit on a resident entry
+template<typename Key, typename Value, bool EnableStats>
+void LirsCache<Key, Value, EnableStats>::access(uint32_t node) {
+    if (this->pool_[node].state == LirsState::Lir) {
+        const bool wasBottom = this->pool_[STACK].stackNext == node;
+        unlinkStack(node);
+        pushStack(node);
+        if (wasBottom)
+            pruneStack();
+        return;
+    }
+    if (inStack(node) && this->lirCapacity_ > 0) {
+        unlinkStack(node);
+        pushStack(node);
+        unlinkQueue(node);
+        promote(node);
+        return;
+    }
+    //not seen recently enough to compete with LIR, it starts a new recency period at the back of Q
+    if (inStack(node))
+        unlinkStack(node);
+    pushStack(node);
+    unlinkQueue(node);
+    pushQueue(QUEUE, node);
+}
+
+//node is on top of S and in no queue
+//with no LIR entry left S may hold only HIR ones, pruning drops them below the new LIR entry
+template<typename Key, typename Value, bool EnableStats>
+void LirsCache<Key, Value, EnableStats>::promote(uint32_t node) {
+    this->pool_[node].state = LirsState::Lir;
+    if (++this->lirCount_ > this->lirCapacity_)
+        demoteBottomLir();
+    else
+        pruneStack();
+}
+
+template<typename Key, typename Value, bool EnableStats>
+void LirsCache<Key, Value, EnableStats>::demoteBottomLir() {
+    const uint32_t bottom = this->pool_[STACK].stackNext;
+    unlinkStack(bottom);
+    this->pool_[bottom].state = LirsState::ResidentHir;
+    pushQueue(QUEUE, bottom);
+    --this->lirCount_;
+    pruneStack();
+}
+
+//keeps a LIR entry at the bottom of S: HIR entries below the oldest LIR one can no longer be promoted,
+//resident ones stay in Q and ghosts are forgotten
+template<typename Key, typename Value, bool EnableStats>
+void LirsCache<Key, Value, EnableStats>::pruneStack() {
+    uint32_t bottom = this->pool_[STACK].stackNext;
+    while (bottom != STACK && this->pool_[bottom].state != LirsState::Lir) {
+        unlinkStack(bottom);
+        if (this->pool_[bottom].state == LirsState::NonResidentHir)
+            forget(bottom);
+        bottom = this->pool_[STACK].stackNext;
+    }
+}
+
+//the front of Q leaves; it stays in S as a ghost if it may still be reused in time
+template<typename Key, typename Value, bool EnableStats>
+void LirsCache<Key, Value, EnableStats>::evict() {
+    const uint32_t victim = this->pool_[QUEUE].queueNext;
+    unlinkQueue(victim);
+    --this->residentCount_;
+    Node& node = this->pool_[victim];
+    this->recorder_.record(StatsCounter::Eviction);
+    this->recorder_.entryRemoved(node.key, node.value);
+    this->notifyEviction(node.key, node.value);
+    if (!inStack(victim)) {
+        this->index_.erase(node.key);
+        this->pool_.release(victim);
+        return;
+    }
+    node.state = LirsState::NonResidentHir;
+    node.value = Value{};
+    pushQueue(GHOSTS, victim);
+    if (++this->nonResidentCount_ > this->nonResidentLimit_)
+        forget(this->pool_[GHOSTS].queueNext);
+}
+
+//drops a ghost entirely; S is never left with a ghost at the bottom, so no pruning is needed
+template<typename Key, typename Value, bool EnableStats>
+void LirsCache<Key, Value, EnableStats>::forget(uint32_t node) {
+    if (inStack(node))
+        unlinkStack(node);
+    unlinkQueue(node);
+    --this->nonResidentCount_;
+    this->index_.erase(this->pool_[node].key);
+    this->pool_.release(node);
+}
@@ -0,0 +1,399 @@
+#pragma once
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <mutex>
+
+#include "../ICachePolicy.h"
+#include "../Concurrent/EpochManager.h"
+#include "../Concurrent/LockFreeHashIndex.h"
+#include "../Stats/StatsRecorder.h"
+
+//LRU cache whose lookups never take a lock
+//  - the key index is a LockFreeHashIndex, nodes are reclaimed with epochs
+//  - a hit only records the node in a lossy per-thread-stripe read buffer
+//  - inserts and removals are pushed onto lock-free event stacks
+//  - whoever wins a try_lock on policyMutex_ replays buffers and events against the LRU list
+//    and evicts, so the list is only ever touched by one thread at a time
+//the cache may briefly hold more than capacity entries until the next drain
+template<typename Key, typename Value, bool EnableStats = true>
+class ConcurrentLruCache : public ICachePolicy<Key, Value> {
+private:
+    struct ValueBox {
+        Value value;
+        ValueBox* retireNext;
+        uint64_t retireEpoch;
+        ValueBox(const Value& value) : value{ value }, retireNext{ nullptr }, retireEpoch{ 0 } {}
+    };
+
+    struct Node {
+        Key key_;
+        size_t hash_;
+        atomic<uintptr_t> indexNext_;
+        atomic<ValueBox*> value_;
+        Node* insertNext_;
+        Node* removeNext_;
+        //owned by the drainer
+        Node* pre_;
+        Node* next_;
+        bool inserted_;      //insert event replayed
+        bool removalSeen_;   //removal event replayed
+        bool linked_;        //currently in the LRU list
+        uint64_t retireEpoch_;
+
+        Node(const Key& key, size_t hash, ValueBox* value)
+            : key_{ key }, hash_{ hash }, indexNext_{ 0 }, value_{ value }, insertNext_{ nullptr }, removeNext_{ nullptr },
+            pre_{ nullptr }, next_{ nullptr }, inserted_{ false }, removalSeen_{ false }, linked_{ false }, retireEpoch_{ 0 } {}
+        ~Node() { delete this->value_.load(memory_order_relaxed); }
+    };
+
+    static const size_t READ_STRIPES = 16;
+    static const size_t READ_BUFFER_SIZE = 64;
+    struct alignas(64) ReadBuffer {
+        atomic<uint32_t> writeCount{ 0 };
+        array<atomic<Node*>, READ_BUFFER_SIZE> slots;
+        ReadBuffer() {
+            for (auto& slot : this->slots)
+                slot.store(nullptr, memory_order_relaxed);
+        }
+    };
+
+    size_t capacity_;
+    EpochManager epoch_;
+    LockFreeHashIndex<Key, Node> index_;
+    alignas(64) atomic<size_t> size_;
+    alignas(64) atomic<Node*> insertStack_;
+    alignas(64) atomic<Node*> removeStack_;
+    alignas(64) atomic<ValueBox*> retiredBoxStack_;
+    array<ReadBuffer, READ_STRIPES> readBuffers_;
+    StatsRecorder<EnableStats> recorder_;
+
+    //everything below is guarded by policyMutex_
+    alignas(64) mutex policyMutex_;
+    Node dummy_;   //sentinel of the circular LRU list, dummy_.next_ is the least recent
+    deque<Node*> retiredNodes_;
+    deque<ValueBox*> retiredBoxes_;
+
+public:
+    ConcurrentLruCache() = delete;
+    ConcurrentLruCache(size_t capacity);
+    ~ConcurrentLruCache() override;
+
+    void put(const Key& key, const Value& value) override;
+    optional<Value> get(const Key& key) override;
+    bool remove(const Key& key) override;
+    bool isExists(const Key& key) override;
+    optional<Value> peek(const Key& key) override;
+    CacheStats stats() override;
+    size_t size();
+    //replays all pending bookkeeping now, mostly useful for tests
+    void cleanUp();
+
+private:
+    size_t hashOf(const Key& key) { return hash<Key>{}(key); }
+    void updateValue(Node* node, const Value& value);
+    void recordRead(Node* node);
+    void pushInsert(Node* node);
+    void pushRemove(Node* node);
+    void tryDrain();
+    void drain();
+    void replayReads();
+    void replayInserts();
+    void replayRemovals();
+    void evictOverflow();
+    void linkAsRecent(Node* node);
+    void unlink(Node* node);
+    void retire(Node* node);
+};
+
+template<typename Key, typename Value, bool EnableStats>
+ConcurrentLruCache<Key, Value, EnableStats>::ConcurrentLruCache(size_t capacity)
+    : capacity_{ capacity }, index_{ capacity }, size_{ 0 }, insertStack_{ nullptr }, removeStack_{ nullptr },
+    retiredBoxStack_{ nullptr }, dummy_{ Key(), 0, nullptr } {
+    this->dummy_.pre_ = &this->dummy_;
+    this->dummy_.next_ = &this->dummy_;
+}
+
+template<typename Key, typename Value, bool EnableStats>
+ConcurrentLruCache<Key, Value, EnableStats>::~ConcurrentLruCache() {
+    //no other thread may use the cache any more, so epochs no longer matter
+    {
+        lock_guard<mutex> lock{ this->policyMutex_ };
+        replayInserts();
+        replayRemovals();
+    }
+    for (Node* node : this->retiredNodes_)
+        delete node;
+    for (ValueBox* box : this->retiredBoxes_)
+        delete box;
+    ValueBox* box = this->retiredBoxStack_.exchange(nullptr);
+    while (box) {
+        ValueBox* next = box->retireNext;
+        delete box;
+        box = next;
+    }
+    this->index_.forEachUnsafe([](Node* node) { delete node; });
+}
+
+template<typename Key, typename Value, bool EnableStats>
+void ConcurrentLruCache<Key, Value, EnableStats>::put(const Key& key, const Value& value) {
+    if (this->capacity_ == 0) return;
+    {
+        auto guard = this->epoch_.pin();
+        const size_t hash = hashOf(key);
+        Node* node = this->index_.find(key, hash);
+        if (node) {
+            this->recorder_.record(StatsCounter::Update);
+            updateValue(node, value);
+            recordRead(node);
+            return;
+        }
+        Node* newNode = new Node(key, hash, new ValueBox(value));
+        Node* existing = this->index_.insertIfAbsent(newNode);
+        if (existing) {
+            //lost the race to another put of the same key, newNode was never visible
+            delete newNode;
+            this->recorder_.record(StatsCounter::Update);
+            updateValue(existing, value);
+            recordRead(existing);
+            return;
+        }
+        this->size_.fetch_add(1, memory_order_relaxed);
+        this->recorder_.record(StatsCounter::Put);
+        this->recorder_.entryAdded(key, value);
+        pushInsert(newNode);
+    }
+    tryDrain();
+}
+
+template<typename Key, typename Value, bool EnableStats>
+optional<Value> ConcurrentLruCache<Key, Value, EnableStats>::get(const Key& key) {
+    auto guard = this->epoch_.pin();
+    Node* node = this->index_.find(key, hashOf(key));
+    if (!node) {
+        this->recorder_.record(StatsCounter::Miss);
+        return nullopt;
+    }
+    this->recorder_.record(StatsCounter::Hit);
+    Value value = node->value_.load(memory_order_acquire)->value;
+    recordRead(node);
+    return value;
+}
+
+template<typename Key, typename Value, bool EnableStats>
+bool ConcurrentLruCache<Key, Value, EnableStats>::remove(const Key& key) {
+    {
+        auto guard = this->epoch_.pin();
+        Node* node = this->index_.find(key, hashOf(key));
+        if (!node || !this->index_.erase(node))
+            return false;
+        this->size_.fetch_sub(1, memory_order_relaxed);
+        this->recorder_.entryRemoved(node->key_, node->value_.load(memory_order_acquire)->value);
+        pushRemove(node);
+    }
+    tryDrain();
+    return true;
+}
+
+template<typename Key, typename Value, bool EnableStats>
+bool ConcurrentLruCache<Key, Value, EnableStats>::isExists(const Key& key) {
+    auto guard = this->epoch_.pin();
+    return this->index_.find(key, hashOf(key)) != nullptr;
+}
+
+template<typename Key, typename Value, bool EnableStats>
+optional<Value> ConcurrentLruCache<Key, Value, EnableStats>::peek(const Key& key) {
+    auto guard = this->epoch_.pin();
+    Node* node = this->index_.find(key, hashOf(key));
+    if (!node)
+        return nullopt;
+    return node->value_.load(memory_order_acquire)->value;
+}
+
+//size may briefly exceed capacity, see the class comment
+template<typename Key, typename Value, bool EnableStats>
+CacheStats ConcurrentLruCache<Key, Value, EnableStats>::stats() {
+    return this->recorder_.collect(this->size_.load(memory_order_relaxed));
+}
+
+template<typename Key, typename Value, bool EnableStats>
+size_t ConcurrentLruCache<Key, Value, EnableStats>::size() {
+    return this->size_.load(memory_order_relaxed);
+}
+
+template<typename Key, typename Value, bool EnableStats>
+void ConcurrentLruCache<Key, Value, EnableStats>::cleanUp() {
+    lock_guard<mutex> lock{ this->policyMutex_ };
+    drain();
+}
+
+template<typename Key, typename Value, bool EnableStats>
+void ConcurrentLruCache<Key, Value, EnableStats>::updateValue(Node* node, const Value& value) {
+    ValueBox* old = node->value_.exchange(new ValueBox(value), memory_order_acq_rel);
+    //old stays readable until the next epoch turn, the caller is pinned
+    this->recorder_.valueReplaced(old->value, value);
+    old->retireEpoch = this->epoch_.currentEpoch();
+    old->retireNext = this->retiredBoxStack_.load(memory_order_relaxed);
+    while (!this->retiredBoxStack_.compare_exchange_weak(old->retireNext, old, memory_order_release, memory_order_relaxed)) {}
+}
+
+//lossy: a slot overwritten before the drainer reads it only loses one promotion
+template<typename Key, typename Value, bool EnableStats>
+void ConcurrentLruCache<Key, Value, EnableStats>::recordRead(Node* node) {
+    ReadBuffer& buffer = this->readBuffers_[ThreadSlot::index() % READ_STRIPES];
+    uint32_t count = buffer.writeCount.fetch_add(1, memory_order_relaxed);
+    buffer.slots[count % READ_BUFFER_SIZE].store(node, memory_order_release);
+    if (count % READ_BUFFER_SIZE == READ_BUFFER_SIZE - 1)
+        tryDrain();
+}
+
+template<typename Key, typename Value, bool EnableStats>
+void ConcurrentLruCache<Key, Value, EnableStats>::pushInsert(Node* node) {
+    node->insertNext_ = this->insertStack_.load(memory_order_relaxed);
+    while (!this->insertStack_.compare_exchange_weak(node->insertNext_, node, memory_order_release, memory_order_relaxed)) {}
+}
+
+template<typename Key, typename Value, bool EnableStats>
+void ConcurrentLruCache<Key, Value, EnableStats>::pushRemove(Node* node) {
+    node->removeNext_ = this->removeStack_.load(memory_order_relaxed);
+    while (!this->removeStack_.compare_exchange_weak(node->removeNext_, node, memory_order_release, memory_order_relaxed)) {}
+}
+
+//whoever fails the try_lock leaves its events to the current drainer,
+//which checks the stacks once more after unlocking so nothing is stranded
+template<typename Key, typename Value, bool EnableStats>
+void ConcurrentLruCache<Key, Value, EnableStats>::tryDrain() {
+    do {
+        if (!this->policyMutex_.try_lock())
+            return;
+        drain();
+        this->policyMutex_.unlock();
+    } while (this->insertStack_.load(memory_order_acquire) || this->removeStack_.load(memory_order_acquire));
+}
+
+//order matters for reclamation: decide what may be freed first, then replay every buffer and
+//stack (they may still mention those nodes), and free only at the end
+template<typename Key, typename Value, bool EnableStats>
+void ConcurrentLruCache<Key, Value, EnableStats>::drain() {
+    auto guard = this->epoch_.pin();
+    this->epoch_.tryAdvance();
+
+    deque<Node*> freeNodes;
+    while (!this->retiredNodes_.empty() && this->epoch_.isSafeToFree(this->retiredNodes_.front()->retireEpoch_)) {
+        freeNodes.push_back(this->retiredNodes_.front());
+        this->retiredNodes_.pop_front();
+    }
+    ValueBox* box = this->retiredBoxStack_.exchange(nullptr, memory_order_acquire);
+    while (box) {
+        this->retiredBoxes_.push_back(box);
+        box = box->retireNext;
+    }
+    deque<ValueBox*> freeBoxes;
+    auto keep = this->retiredBoxes_.begin();
+    for (auto it = this->retiredBoxes_.begin(); it != this->retiredBoxes_.end(); ++it) {
+        if (this->epoch_.isSafeToFree((*it)->retireEpoch))
+            freeBoxes.push_back(*it);
+        else
+            *keep++ = *it;
+    }
+    this->retiredBoxes_.erase(keep, this->retiredBoxes_.end());
+
+    replayReads();
+    replayInserts();
+    replayRemovals();
+    evictOverflow();
+
+    for (Node* node : freeNodes)
+        delete node;
+    for (ValueBox* freeBox : freeBoxes)
+        delete freeBox;
+}
+
+template<typename Key, typename Value, bool EnableStats>
+void ConcurrentLruCache<Key, Value, EnableStats>::replayReads() {
+    for (ReadBuffer& buffer : this->readBuffers_) {
+        for (auto& slot : buffer.slots) {
+            Node* node = slot.exchange(nullptr, memory_order_acquire);
+            if (node && node->linked_) {
+                unlink(node);
+                linkAsRecent(node);
+            }
+        }
+    }
+}
+
+template<typename Key, typename Value, bool EnableStats>
+void ConcurrentLruCache<Key, Value, EnableStats>::replayInserts() {
+    //the stack is newest first, reverse it to keep insertion order
+    Node* node = this->insertStack_.exchange(nullptr, memory_order_acquire);
+    Node* ordered = nullptr;
+    while (node) {
+        Node* next = node->insertNext_;
+        node->insertNext_ = ordered;
+        ordered = node;
+        node = next;
+    }
+    for (node = ordered; node; node = node->insertNext_) {
+        node->inserted_ = true;
+        if (node->removalSeen_)
+            retire(node);
+        else if ((node->indexNext_.load(memory_order_acquire) & 1) == 0)
+            linkAsRecent(node);
+        //a marked node whose removal event is still on its way is retired by that event
+    }
+}
+
+template<typename Key, typename Value, bool EnableStats>
+void ConcurrentLruCache<Key, Value, EnableStats>::replayRemovals() {
+    Node* node = this->removeStack_.exchange(nullptr, memory_order_acquire);
+    while (node) {
+        Node* next = node->removeNext_;
+        node->removalSeen_ = true;
+        if (node->inserted_) {
+            if (node->linked_)
+                unlink(node);
+            retire(node);
+        }
+        node = next;
+    }
+}
+
+template<typename Key, typename Value, bool EnableStats>
+void ConcurrentLruCache<Key, Value, EnableStats>::evictOverflow() {
+    while (this->size_.load(memory_order_relaxed) > this->capacity_ && this->dummy_.next_ != &this->dummy_) {
+        Node* victim = this->dummy_.next_;
+        unlink(victim);
+        if (this->index_.erase(victim)) {
+            this->size_.fetch_sub(1, memory_order_relaxed);
+            this->recorder_.record(StatsCounter::Eviction);
+            this->recorder_.entryRemoved(victim->key_, victim->value_.load(memory_order_acquire)->value);
+            this->notifyEviction(victim->key_, victim->value_.load(memory_order_acquire)->value);
+            retire(victim);
+        }
+        //otherwise remove() won the race and its removal event retires the node
+    }
+}
+
+template<typename Key, typename Value, bool EnableStats>
+void ConcurrentLruCache<Key, Value, EnableStats>::linkAsRecent(Node* node) {
+    node->pre_ = this->dummy_.pre_;
+    node->next_ = &this->dummy_;
+    this->dummy_.pre_->next_ = node;
+    this->dummy_.pre_ = node;
+    node->linked_ = true;
+}
+
+template<typename Key, typename Value, bool EnableStats>
+void ConcurrentLruCache<Key, Value, EnableStats>::unlink(Node* node) {
+    node->pre_->next_ = node->next_;
+    node->next_->pre_ = node->pre_;
+    node->linked_ = false;
+}
+
+template<typename Key, typename Value, bool EnableStats>
+void ConcurrentLruCache<Key, Value, EnableStats>::retire(Node* node) {
+    node->retireEpoch_ = this->epoch_.currentEpoch();
+    this->retiredNodes_.push_back(node);
+}
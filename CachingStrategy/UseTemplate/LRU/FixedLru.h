@@ -0,0 +1,270 @@
+#pragma once
+#include <array>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <limits>
+#include <optional>
+#include <type_traits>
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define FIXED_LRU_SSE2
+#endif
+using namespace std;
+
+//an LRU of at most N entries whose whole state lives inside the object: keys, values and links are std::arrays,
+//nothing is allocated, so it can sit on the stack or inside a connection or request object
+//links are 8-bit up to 254 entries and 16-bit above; entries are packed into the first size() slots, a remove
+//moves the last one into the hole
+//up to SCAN_LIMIT entries a lookup scans the keys, four 32-bit keys per SSE2 compare; above it an open-addressing
+//index of 2N links rounded up to a power of two is kept alongside
+//every method is constexpr, with integral keys and literal values a FixedLru works in constant evaluation
+//not thread-safe and not an ICachePolicy: it is meant to be owned by one thread, and a virtual base has no
+//place in a constant expression
+template<typename Key, typename Value, size_t N>
+class FixedLru {
+public:
+    static_assert(N >= 1 && N < 65535, "FixedLru holds 1 to 65534 entries");
+    static constexpr size_t SCAN_LIMIT = 32;
+
+private:
+    using Link = conditional_t<(N < 255), uint8_t, uint16_t>;
+    static constexpr Link NIL = numeric_limits<Link>::max();
+    static constexpr bool HASHED = N > SCAN_LIMIT;
+    static constexpr size_t BUCKETS = HASHED ? bit_ceil(N * 2) : 1;
+
+    array<Key, N> keys_{};
+    array<Value, N> values_{};
+    array<Link, N> pre_{};      //towards the most recent
+    array<Link, N> next_{};     //towards the least recent
+    array<Link, BUCKETS> buckets_{};
+    Link head_ = NIL;           //most recent
+    Link tail_ = NIL;           //least recent, the next victim
+    Link size_ = 0;
+
+public:
+    constexpr FixedLru() {
+        if constexpr (HASHED) {
+            for (Link& bucket : this->buckets_)
+                bucket = NIL;
+        }
+    }
+
+    constexpr optional<Value> get(const Key& key);
+    constexpr void put(const Key& key, const Value& value);
+    constexpr bool remove(const Key& key);
+    constexpr bool isExists(const Key& key) const { return find(key) != NIL; }
+    //read without promoting the entry
+    constexpr optional<Value> peek(const Key& key) const;
+    constexpr void clear();
+
+    constexpr size_t size() const { return this->size_; }
+    static constexpr size_t capacity() { return N; }
+
+private:
+    static constexpr size_t home(const Key& key);
+    //the bucket holding key, or the empty bucket where it would go
+    constexpr size_t probe(const Key& key) const;
+    constexpr void eraseBucket(size_t bucket);
+    constexpr Link find(const Key& key) const;
+    constexpr Link scan(const Key& key) const;
+    constexpr void unlink(Link slot);
+    constexpr void pushFront(Link slot);
+    constexpr void erase(Link slot);
+};
+
+template<typename Key, typename Value, size_t N>
+constexpr optional<Value> FixedLru<Key, Value, N>::get(const Key& key) {
+    const Link slot = find(key);
+    if (slot == NIL)
+        return nullopt;
+    if (slot != this->head_) {
+        unlink(slot);
+        pushFront(slot);
+    }
+    return this->values_[slot];
+}
+
+template<typename Key, typename Value, size_t N>
+constexpr void FixedLru<Key, Value, N>::put(const Key& key, const Value& value) {
+    Link slot = find(key);
+    if (slot != NIL) {
+        this->values_[slot] = value;
+        if (slot != this->head_) {
+            unlink(slot);
+            pushFront(slot);
+        }
+        return;
+    }
+    if (this->size_ == N) {
+        //the victim's slot is taken over in place, no packing needed
+        slot = this->tail_;
+        unlink(slot);
+        if constexpr (HASHED)
+            eraseBucket(probe(this->keys_[slot]));
+    }
+    else {
+        slot = this->size_++;
+    }
+    this->keys_[slot] = key;
+    this->values_[slot] = value;
+    pushFront(slot);
+    if constexpr (HASHED)
+        this->buckets_[probe(key)] = slot;
+}
+
+template<typename Key, typename Value, size_t N>
+constexpr bool FixedLru<Key, Value, N>::remove(const Key& key) {
+    const Link slot = find(key);
+    if (slot == NIL)
+        return false;
+    erase(slot);
+    return true;
+}
+
+template<typename Key, typename Value, size_t N>
+constexpr optional<Value> FixedLru<Key, Value, N>::peek(const Key& key) const {
+    const Link slot = find(key);
+    if (slot == NIL)
+        return nullopt;
+    return this->values_[slot];
+}
+
+template<typename Key, typename Value, size_t N>
+constexpr void FixedLru<Key, Value, N>::clear() {
+    for (size_t slot = 0; slot < this->size_; ++slot) {
+        this->keys_[slot] = Key{};
+        this->values_[slot] = Value{};
+    }
+    if constexpr (HASHED) {
+        for (Link& bucket : this->buckets_)
+            bucket = NIL;
+    }
+    this->head_ = this->tail_ = NIL;
+    this->size_ = 0;
+}
+
+//integers are mixed here rather than by std::hash, which is the identity for them and not constexpr
+template<typename Key, typename Value, size_t N>
+constexpr size_t FixedLru<Key, Value, N>::home(const Key& key) {
+    uint64_t h;
+    if constexpr (is_integral<Key>::value)
+        h = static_cast<uint64_t>(key);
+    else
+        h = static_cast<uint64_t>(hash<Key>{}(key));
+    return static_cast<size_t>((h * 0x9e3779b97f4a7c15ull) >> (64 - countr_zero(BUCKETS)));
+}
+
+template<typename Key, typename Value, size_t N>
+constexpr size_t FixedLru<Key, Value, N>::probe(const Key& key) const {
+    size_t bucket = home(key);
+    while (this->buckets_[bucket] != NIL && !(this->keys_[this->buckets_[bucket]] == key))
+        bucket = (bucket + 1) & (BUCKETS - 1);
+    return bucket;
+}
+
+//backward-shift deletion, so lookups never meet a tombstone
+template<typename Key, typename Value, size_t N>
+constexpr void FixedLru<Key, Value, N>::eraseBucket(size_t bucket) {
+    const size_t mask = BUCKETS - 1;
+    size_t hole = bucket;
+    size_t next = (hole + 1) & mask;
+    while (this->buckets_[next] != NIL) {
+        const size_t wanted = home(this->keys_[this->buckets_[next]]);
+        if (((next - wanted) & mask) >= ((next - hole) & mask)) {
+            this->buckets_[hole] = this->buckets_[next];
+            hole = next;
+        }
+        next = (next + 1) & mask;
+    }
+    this->buckets_[hole] = NIL;
+}
+
+template<typename Key, typename Value, size_t N>
+constexpr typename FixedLru<Key, Value, N>::Link FixedLru<Key, Value, N>::find(const Key& key) const {
+    if constexpr (HASHED)
+        return this->buckets_[probe(key)];
+    else
+        return scan(key);
+}
+
+template<typename Key, typename Value, size_t N>
+constexpr typename FixedLru<Key, Value, N>::Link FixedLru<Key, Value, N>::scan(const Key& key) const {
+    size_t slot = 0;
+#if defined(FIXED_LRU_SSE2)
+    if constexpr (is_integral<Key>::value && sizeof(Key) == 4) {
+        if (!is_constant_evaluated()) {
+            const __m128i wanted = _mm_set1_epi32(static_cast<int>(key));
+            for (; slot + 4 <= this->size_; slot += 4) {
+                const __m128i keys = _mm_loadu_si128(reinterpret_cast<const __m128i*>(this->keys_.data() + slot));
+                const int mask = _mm_movemask_ps(_mm_castsi128_ps(_mm_cmpeq_epi32(keys, wanted)));
+                if (mask != 0)
+                    return static_cast<Link>(slot + countr_zero(static_cast<unsigned int>(mask)));
+            }
+        }
+    }
+#endif
+    for (; slot < this->size_; ++slot) {
+        if (this->keys_[slot] == key)
+            return static_cast<Link>(slot);
+    }
+    return NIL;
+}
+
+template<typename Key, typename Value, size_t N>
+constexpr void FixedLru<Key, Value, N>::unlink(Link slot) {
+    const Link pre = this->pre_[slot];
+    const Link next = this->next_[slot];
+    if (pre != NIL)
+        this->next_[pre] = next;
+    else
+        this->head_ = next;
+    if (next != NIL)
+        this->pre_[next] = pre;
+    else
+        this->tail_ = pre;
+}
+
+template<typename Key, typename Value, size_t N>
+constexpr void FixedLru<Key, Value, N>::pushFront(Link slot) {
+    this->pre_[slot] = NIL;
+    this->next_[slot] = this->head_;
+    if (this->head_ != NIL)
+        this->pre_[this->head_] = slot;
+    else
+        this->tail_ = slot;
+    this->head_ = slot;
+}
+
+//the last slot moves into the hole, so the scan range and the slot numbers stay dense
+template<typename Key, typename Value, size_t N>
+constexpr void FixedLru<Key, Value, N>::erase(Link slot) {
+    unlink(slot);
+    if constexpr (HASHED)
+        eraseBucket(probe(this->keys_[slot]));
+    const Link last = static_cast<Link>(this->size_ - 1);
+    if (slot != last) {
+        //found before the move, a moved-from key would no longer match
+        size_t movedBucket = 0;
+        if constexpr (HASHED)
+            movedBucket = probe(this->keys_[last]);
+        this->keys_[slot] = move(this->keys_[last]);
+        this->values_[slot] = move(this->values_[last]);
+        this->pre_[slot] = this->pre_[last];
+        this->next_[slot] = this->next_[last];
+        if (this->pre_[slot] != NIL)
+            this->next_[this->pre_[slot]] = slot;
+        else
+            this->head_ = slot;
+        if (this->next_[slot] != NIL)
+            this->pre_[this->next_[slot]] = slot;
+        else
+            this->tail_ = slot;
+        if constexpr (HASHED)
+            this->buckets_[movedBucket] = slot;
+    }
+    this->keys_[last] = Key{};
+    this->values_[last] = Value{};
+    --this->size_;
+}
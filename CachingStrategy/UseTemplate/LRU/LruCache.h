@@ -1,55 +1,103 @@
 #pragma once
 #include <unordered_map>
 #include <mutex>
+#include <shared_mutex>
+#include <cstdint>
+#include <functional>
 
 #include "LruNode.h"
-#include "..\ICachePolicy.h"
+#include "../ICachePolicy.h"
+#include "../SeqlockIndex.h"
+#include "../Snapshot/Snapshot.h"
+#include "../Stats/StatsRecorder.h"
+#include "../Stats/LockProfiler.h"
 
-template<typename Key, typename Value>
+template<typename Key, typename Value, bool EnableStats = true>
 class LruCache : public ICachePolicy<Key, Value> {
 public:
     using Node = LruNode<Key, Value>;
     using NodePtr = shared_ptr<Node>;
     using NodeHash = unordered_map<Key, NodePtr>;
 
+    //where a visitColdest walk stopped, a default constructed one starts at the cold end
+    struct ColdCursor {
+        weak_ptr<Node> node;
+        unsigned int accessCount = 0;
+    };
+
 private:
     size_t capacity_;
-    mutex mutex_;
+    shared_mutex mutex_;   //exclusive for anything that relinks, shared for read-only lookups
     NodeHash nodeHash_;
     NodePtr dummyHead_;
     NodePtr dummyTail_;
+    SeqlockIndex<Key, Value> readIndex_;   //lets peek and isExists skip the lock for trivially copyable entries
+    StatsRecorder<EnableStats> recorder_;
+    atomic<LockProfiler*> profiler_{ nullptr };
 
 public:
     LruCache(unsigned int capacity);
-    ~LruCache() override = default;
+    ~LruCache() override;
 
     void put(const Key& key,const Value& value) override;
     bool isExists(const Key& key) override;
     optional<Value> get(const Key& key) override;
     bool remove(const Key& key) override;
-    NodePtr getNode(const Key& key);
-    void moveToRecentPosition(const NodePtr& node);
-    
+    optional<Value> peek(const Key& key) override;
+    CacheStats stats() override;
+    //times get/put and the wait for mutex_ into profiler, nullptr detaches it
+    void setProfiler(LockProfiler* profiler) { this->profiler_.store(profiler, memory_order_relaxed); }
+    unsigned int touch(const Key& key);
+    //evicts the least recent entry the predicate accepts, looking at no more than maxScan entries
+    //from the cold end; false when nothing matched
+    bool evictIf(const function<bool(const Key&, const Value&)>& predicate, size_t maxScan = SIZE_MAX);
+    //hands up to maxScan entries to the visitor from the cold end, least recent first, without promoting them
+    //the visitor may rewrite the value in place and returns false to stop; runs under the exclusive lock
+    //with a cursor the walk resumes just past where the last one stopped and moves the cursor along;
+    //once that entry is gone or was accessed in between it starts over from the cold end
+    size_t visitColdest(const function<bool(const Key&, Value&)>& visitor, size_t maxScan = SIZE_MAX, ColdCursor* cursor = nullptr);
+
+    //entries are written least recent first with their access counts,
+    //restore replaces the current content and keeps the most recent capacity entries
+    void snapshot(const string& path);
+    void restore(const string& path);
+    void saveTo(SnapshotWriter& writer);
+    void loadFrom(SnapshotReader& reader);
 
 private:
+    void clearList();
+    void moveToRecentPosition(const NodePtr& node);
     void initializeList();
     void insertNode(const NodePtr& node);
     void removeNode(const NodePtr& node);
     void updateExitingNode(const NodePtr& node, const Value& value);
     void evictLeastAccessNode();
     void addNewNode(const Key& key, const Value& value);
+    void wakeReadIndex();
     
 };
 
-template<typename Key, typename Value>
-LruCache<Key, Value>::LruCache(unsigned int capacity) : capacity_(capacity) {
+template<typename Key, typename Value, bool EnableStats>
+LruCache<Key, Value, EnableStats>::LruCache(unsigned int capacity) : capacity_(capacity) {
     initializeList();
 }
 
-template<typename Key, typename Value>
-void LruCache<Key, Value>::put(const Key& key,const Value& value) {
+template<typename Key, typename Value, bool EnableStats>
+LruCache<Key, Value, EnableStats>::~LruCache() {
+    //nodes point at each other, break the links so they are actually released
+    NodePtr node = this->dummyHead_;
+    while (node) {
+        NodePtr next = node->getNext();
+        node->setPre(nullptr);
+        node->setNext(nullptr);
+        node = next;
+    }
+}
+
+template<typename Key, typename Value, bool EnableStats>
+void LruCache<Key, Value, EnableStats>::put(const Key& key,const Value& value) {
     if (this->capacity_ <= 0) return;
-    lock_guard<mutex> lock{ this->mutex_ };
+    ProfiledLock<shared_mutex> lock{ this->mutex_, this->profiler_.load(memory_order_relaxed), ProfiledOperation::Put };
     auto it = nodeHash_.find(key);
     if (it != nodeHash_.end()) {
         updateExitingNode(it->second, value);
@@ -58,17 +106,47 @@ void LruCache<Key, Value>::put(const Key& key,const Value& value) {
     addNewNode(key, value);
 }
 
-template<typename Key, typename Value>
-bool LruCache<Key, Value>::isExists(const Key& key) {
-   return this->nodeHash_.find(key) != this->nodeHash_.end();
+template<typename Key, typename Value, bool EnableStats>
+bool LruCache<Key, Value, EnableStats>::isExists(const Key& key) {
+    optional<Value> value;
+    if (this->readIndex_.dormant())
+        wakeReadIndex();
+    if (this->readIndex_.tryFind(key, value))
+        return value.has_value();
+    shared_lock<shared_mutex> lock{ this->mutex_ };
+    return this->nodeHash_.find(key) != this->nodeHash_.end();
 }
 
-template<typename Key, typename Value>
-optional<Value> LruCache<Key, Value>::get(const Key& key) {
-    lock_guard<mutex> lock{ this->mutex_ };
+template<typename Key, typename Value, bool EnableStats>
+optional<Value> LruCache<Key, Value, EnableStats>::peek(const Key& key) {
+    optional<Value> value;
+    if (this->readIndex_.dormant())
+        wakeReadIndex();
+    if (this->readIndex_.tryFind(key, value))
+        return value;
+    shared_lock<shared_mutex> lock{ this->mutex_ };
     auto it = this->nodeHash_.find(key);
     if (it == this->nodeHash_.end())
         return nullopt;
+    return it->second->getValue();
+}
+
+//the first peek or isExists fills the read index, from then on writers keep it current
+template<typename Key, typename Value, bool EnableStats>
+void LruCache<Key, Value, EnableStats>::wakeReadIndex() {
+    lock_guard<shared_mutex> lock{ this->mutex_ };
+    this->readIndex_.wake(this->nodeHash_);
+}
+
+template<typename Key, typename Value, bool EnableStats>
+optional<Value> LruCache<Key, Value, EnableStats>::get(const Key& key) {
+    ProfiledLock<shared_mutex> lock{ this->mutex_, this->profiler_.load(memory_order_relaxed), ProfiledOperation::Get };
+    auto it = this->nodeHash_.find(key);
+    if (it == this->nodeHash_.end()) {
+        this->recorder_.record(StatsCounter::Miss);
+        return nullopt;
+    }
+    this->recorder_.record(StatsCounter::Hit);
     const NodePtr node = it->second;
     const Value value = node->getValue();
     node->increaseAccessCount();
@@ -76,42 +154,178 @@ optional<Value> LruCache<Key, Value>::get(const Key& key) {
     return value;
 }
 
-template<typename Key, typename Value>
-bool LruCache<Key, Value>::remove(const Key& key) {
-    lock_guard<mutex> lock{ mutex_ };
+template<typename Key, typename Value, bool EnableStats>
+bool LruCache<Key, Value, EnableStats>::remove(const Key& key) {
+    lock_guard<shared_mutex> lock{ this->mutex_ };
     auto it = this->nodeHash_.find(key);
     if (it == this->nodeHash_.end()) {
         return false;
     }
+    this->recorder_.entryRemoved(key, it->second->peekValue());
     removeNode(it->second);
     this->nodeHash_.erase(it);
+    this->readIndex_.erase(key);
     return true;
 }
 
-template<typename Key, typename Value>
-typename LruCache<Key, Value>::NodePtr LruCache<Key, Value>::getNode(const Key& key) {
+template<typename Key, typename Value, bool EnableStats>
+CacheStats LruCache<Key, Value, EnableStats>::stats() {
+    shared_lock<shared_mutex> lock{ this->mutex_ };
+    return this->recorder_.collect(this->nodeHash_.size());
+}
+
+//counts an access and promotes the entry without copying its value
+//returns the new access count, 0 when the key is absent
+template<typename Key, typename Value, bool EnableStats>
+unsigned int LruCache<Key, Value, EnableStats>::touch(const Key& key) {
+    lock_guard<shared_mutex> lock{ this->mutex_ };
     auto it = this->nodeHash_.find(key);
-    if(it == this->nodeHash_.end())
-        return nullptr;
-    return it->second;
+    if (it == this->nodeHash_.end())
+        return 0;
+    it->second->increaseAccessCount();
+    moveToRecentPosition(it->second);
+    return it->second->getAccessCount();
+}
+
+template<typename Key, typename Value, bool EnableStats>
+bool LruCache<Key, Value, EnableStats>::evictIf(const function<bool(const Key&, const Value&)>& predicate, size_t maxScan) {
+    lock_guard<shared_mutex> lock{ this->mutex_ };
+    size_t scanned = 0;
+    for (NodePtr node = this->dummyHead_->getNext(); node != this->dummyTail_ && scanned < maxScan; node = node->getNext(), ++scanned) {
+        if (!predicate(node->getKey(), node->peekValue()))
+            continue;
+        removeNode(node);
+        this->nodeHash_.erase(node->getKey());
+        this->readIndex_.erase(node->getKey());
+        this->recorder_.record(StatsCounter::Eviction);
+        this->recorder_.entryRemoved(node->getKey(), node->peekValue());
+        this->notifyEviction(node->getKey(), node->peekValue());
+        return true;
+    }
+    return false;
+}
+
+template<typename Key, typename Value, bool EnableStats>
+size_t LruCache<Key, Value, EnableStats>::visitColdest(const function<bool(const Key&, Value&)>& visitor, size_t maxScan, ColdCursor* cursor) {
+    lock_guard<shared_mutex> lock{ this->mutex_ };
+    size_t visited = 0;
+    NodePtr node = this->dummyHead_->getNext();
+    if (cursor) {
+        //every access bumps the count and moves the node to the recent end, an unchanged count means it stayed put
+        NodePtr stopped = cursor->node.lock();
+        if (stopped && stopped->getAccessCount() == cursor->accessCount) {
+            auto it = this->nodeHash_.find(stopped->getKey());
+            if (it != this->nodeHash_.end() && it->second == stopped)
+                node = stopped->getNext();
+        }
+    }
+    NodePtr last;
+    for (; node != this->dummyTail_ && visited < maxScan; node = node->getNext()) {
+        visited++;
+        last = node;
+        //the visitor may resize the value, account for it as a replacement
+        this->recorder_.entryRemoved(node->getKey(), node->peekValue());
+        const bool more = visitor(node->getKey(), node->mutableValue());
+        this->recorder_.entryAdded(node->getKey(), node->peekValue());
+        this->readIndex_.assign(node->getKey(), node->peekValue());
+        if (!more)
+            break;
+    }
+    if (cursor && last) {
+        cursor->node = last;
+        cursor->accessCount = last->getAccessCount();
+    }
+    return visited;
 }
 
-template<typename Key, typename Value>
-void LruCache<Key, Value>::moveToRecentPosition(const NodePtr& node) {
+template<typename Key, typename Value, bool EnableStats>
+void LruCache<Key, Value, EnableStats>::snapshot(const string& path) {
+    SnapshotWriter writer{ path, SnapshotHeader::of<Key, Value>(SnapshotEngine::Lru) };
+    saveTo(writer);
+    writer.commit();
+}
+
+template<typename Key, typename Value, bool EnableStats>
+void LruCache<Key, Value, EnableStats>::restore(const string& path) {
+    SnapshotReader reader{ path, SnapshotHeader::of<Key, Value>(SnapshotEngine::Lru) };
+    loadFrom(reader);
+}
+
+//get/put wait while the entries are written, peek and isExists do not
+template<typename Key, typename Value, bool EnableStats>
+void LruCache<Key, Value, EnableStats>::saveTo(SnapshotWriter& writer) {
+    shared_lock<shared_mutex> lock{ this->mutex_ };
+    writer.write<uint64_t>(this->nodeHash_.size());
+    for (NodePtr node = this->dummyHead_->getNext(); node != this->dummyTail_; node = node->getNext()) {
+        writer.write<Key>(node->getKey());
+        writer.write<Value>(node->getValue());
+        writer.write<uint32_t>(node->getAccessCount());
+    }
+}
+
+template<typename Key, typename Value, bool EnableStats>
+void LruCache<Key, Value, EnableStats>::loadFrom(SnapshotReader& reader) {
+    lock_guard<shared_mutex> lock{ this->mutex_ };
+    clearList();
+    const uint64_t count = reader.read<uint64_t>();
+    const uint64_t skipped = count > this->capacity_ ? count - this->capacity_ : 0;
+    this->nodeHash_.reserve(static_cast<size_t>(count - skipped));
+    //entries arrive in list order, append them directly instead of going through insertNode.
+    //once any thread has run every shared_ptr copy is an atomic op, so the node is moved into the hash
+    //and last points at the hash's copy: the two links are the only reference counts taken per entry
+    const NodePtr* last = &this->dummyHead_;
+    for (uint64_t i = 0; i < count; ++i) {
+        Key key = reader.read<Key>();
+        Value value = reader.read<Value>();
+        const uint32_t accessCount = reader.read<uint32_t>();
+        if (i < skipped)
+            continue;
+        this->recorder_.entryAdded(key, value);
+        NodePtr created = make_shared<Node>(key, move(value));
+        created->setAccessCount(accessCount);
+        auto inserted = this->nodeHash_.emplace(move(key), move(created));
+        if (!inserted.second)
+            throw runtime_error("In LruCache.h-----Snapshot holds a key twice.");
+        const NodePtr& node = inserted.first->second;
+        this->readIndex_.assign(node->getKey(), node->peekValue());
+        node->setPre(*last);
+        (*last)->setNext(node);
+        last = &node;
+    }
+    (*last)->setNext(this->dummyTail_);
+    this->dummyTail_->setPre(*last);
+}
+
+template<typename Key, typename Value, bool EnableStats>
+void LruCache<Key, Value, EnableStats>::clearList() {
+    //nodes point at each other, break the links so they are actually released
+    for (auto& pair : this->nodeHash_) {
+        this->recorder_.entryRemoved(pair.first, pair.second->peekValue());
+        pair.second->setPre(nullptr);
+        pair.second->setNext(nullptr);
+    }
+    this->nodeHash_.clear();
+    this->readIndex_.clear();
+    this->dummyHead_->setNext(this->dummyTail_);
+    this->dummyTail_->setPre(this->dummyHead_);
+}
+
+template<typename Key, typename Value, bool EnableStats>
+void LruCache<Key, Value, EnableStats>::moveToRecentPosition(const NodePtr& node) {
     removeNode(node);
     insertNode(node);
 }
 
-template<typename Key, typename Value>
-void LruCache<Key, Value>::initializeList() {
+template<typename Key, typename Value, bool EnableStats>
+void LruCache<Key, Value, EnableStats>::initializeList() {
     this->dummyHead_ = make_shared<Node>(Key(), Value());
     this->dummyTail_ = make_shared<Node>(Key(), Value());
     this->dummyHead_->setNext(dummyTail_);
     this->dummyTail_->setPre(dummyHead_);
 }
 
-template<typename Key, typename Value>
-void LruCache<Key, Value>::insertNode(const NodePtr& node) {
+template<typename Key, typename Value, bool EnableStats>
+void LruCache<Key, Value, EnableStats>::insertNode(const NodePtr& node) {
     node->setNext(dummyTail_);
     node->setPre(dummyTail_->getPre());
 
@@ -119,32 +333,46 @@ void LruCache<Key, Value>::insertNode(const NodePtr& node) {
     this->dummyTail_->setPre(node);
 }
 
-template<typename Key, typename Value>
-void LruCache<Key, Value>::removeNode(const NodePtr& node) {
+template<typename Key, typename Value, bool EnableStats>
+void LruCache<Key, Value, EnableStats>::removeNode(const NodePtr& node) {
     node->getPre()->setNext(node->getNext());
     node->getNext()->setPre(node->getPre());
 }
 
-template<typename Key, typename Value>
-void LruCache<Key, Value>::updateExitingNode(const NodePtr& node, const Value& value) {
-    node->setValue(value);
+template<typename Key, typename Value, bool EnableStats>
+void LruCache<Key, Value, EnableStats>::updateExitingNode(const NodePtr& node, const Value& value) {
+    //copied before anything is recorded, a copy that throws leaves the entry and the stats as they were
+    Value fresh{ value };
+    this->recorder_.record(StatsCounter::Update);
+    this->recorder_.valueReplaced(node->peekValue(), fresh);
+    node->mutableValue() = move(fresh);
+    this->readIndex_.assign(node->getKey(), value);
     node->increaseAccessCount();
     moveToRecentPosition(node);
 }
 
-template<typename Key, typename Value>
-void LruCache<Key, Value>::evictLeastAccessNode() {
+template<typename Key, typename Value, bool EnableStats>
+void LruCache<Key, Value, EnableStats>::evictLeastAccessNode() {
     NodePtr leastNode = this->dummyHead_->getNext();
     removeNode(leastNode);
     this->nodeHash_.erase(leastNode->getKey());
+    this->readIndex_.erase(leastNode->getKey());
+    this->recorder_.record(StatsCounter::Eviction);
+    this->recorder_.entryRemoved(leastNode->getKey(), leastNode->peekValue());
+    this->notifyEviction(leastNode->getKey(), leastNode->getValue());
 }
 
-template<typename Key, typename Value>
-void LruCache<Key, Value>::addNewNode(const Key& key, const Value& value) {
+template<typename Key, typename Value, bool EnableStats>
+void LruCache<Key, Value, EnableStats>::addNewNode(const Key& key, const Value& value) {
+    //allocated before the victim goes, a value copy that throws (a slab at its limit) costs no entry and
+    //records nothing, SlabLruCache retries the put after freeing a chunk of its own
+    NodePtr newNode = make_shared<Node>(key, value);
     if (this->nodeHash_.size() >= this->capacity_) {
         evictLeastAccessNode();
     }
-    NodePtr newNode = make_shared<Node>(key, value);
+    this->recorder_.record(StatsCounter::Put);
+    this->recorder_.entryAdded(key, value);
     insertNode(newNode);
     this->nodeHash_.emplace(key, newNode);
+    this->readIndex_.assign(key, value);
 }
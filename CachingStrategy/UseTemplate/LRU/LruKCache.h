@@ -1,11 +1,15 @@
 #pragma once
 #include "LruCache.h"
 
-template<typename Key, typename Value>
-class LruKCache : public LruCache<Key, Value> {
+template<typename Key, typename Value, bool EnableStats = true>
+class LruKCache : public LruCache<Key, Value, EnableStats> {
 private:
+    using Base = LruCache<Key, Value, EnableStats>;
+
     unsigned int k_;
-    std::unique_ptr<LruCache<Key, Value>> historyList_;
+    //the history only decides admission, its own counters would be noise
+    std::unique_ptr<LruCache<Key, Value, false>> historyList_;
+    StatsRecorder<EnableStats> recorder_;
 
 public:
     LruKCache(unsigned int capacity, unsigned int historyCapacity, unsigned int k);
@@ -14,54 +18,68 @@ public:
     optional<Value> get(const Key&);
     void put(const Key&,const Value&);
     bool remove(const Key&);
+    //puts still waiting in the history list count as rejected admissions
+    CacheStats stats() override;
 
 private:
     void putIntoLruCache(const Key&,const Value&);
     bool isGreaterThanK(const Key&);
 };
 
-template<typename Key, typename Value>
-LruKCache<Key, Value>::LruKCache(unsigned int capacity, unsigned int historyCapacity, unsigned int k)
-    : LruCache<Key, Value>{ capacity },
-    k_{ k }, historyList_{ std::make_unique<LruCache<Key, Value>>(historyCapacity) }
+template<typename Key, typename Value, bool EnableStats>
+LruKCache<Key, Value, EnableStats>::LruKCache(unsigned int capacity, unsigned int historyCapacity, unsigned int k)
+    : Base{ capacity },
+    k_{ k }, historyList_{ std::make_unique<LruCache<Key, Value, false>>(historyCapacity) }
 {}
 
-template<typename Key, typename Value>
-optional<Value> LruKCache<Key, Value>::get(const Key& key) {
-    if (this->historyList_->isExists(key)) {
-        if (isGreaterThanK(key))
-            putIntoLruCache(key, historyList_->get(key).value());
+template<typename Key, typename Value, bool EnableStats>
+optional<Value> LruKCache<Key, Value, EnableStats>::get(const Key& key) {
+    if (isGreaterThanK(key)) {
+        optional<Value> value = historyList_->peek(key);
+        if (value.has_value())
+            putIntoLruCache(key, value.value());
     }
 
-    return LruCache<Key, Value>::get(key);
+    return Base::get(key);
 }
 
-template<typename Key, typename Value>
-void LruKCache<Key, Value>::put(const Key& key,const Value& value) {
+template<typename Key, typename Value, bool EnableStats>
+void LruKCache<Key, Value, EnableStats>::put(const Key& key,const Value& value) {
     if (this->historyList_->isExists(key) == false) {
         this->historyList_->put(key, value);
+        this->recorder_.record(StatsCounter::RejectedAdmission);
+        return;
+    }
+    if (isGreaterThanK(key)) {
+        optional<Value> history = historyList_->peek(key);
+        if (history.has_value())
+            putIntoLruCache(key, history.value());
         return;
     }
-    if (isGreaterThanK(key))
-        putIntoLruCache(key, historyList_->get(key).value());
+    this->recorder_.record(StatsCounter::RejectedAdmission);
+}
+
+template<typename Key, typename Value, bool EnableStats>
+bool LruKCache<Key, Value, EnableStats>::remove(const Key& key) {
+    return Base::remove(key);
 }
 
-template<typename Key, typename Value>
-bool LruKCache<Key, Value>::remove(const Key& key) {
-    return LruCache<Key, Value>::remove(key);
+template<typename Key, typename Value, bool EnableStats>
+CacheStats LruKCache<Key, Value, EnableStats>::stats() {
+    CacheStats total = Base::stats();
+    total.rejectedAdmissions += this->recorder_.collect(0).rejectedAdmissions;
+    return total;
 }
 
-template<typename Key, typename Value>
-void LruKCache<Key, Value>::putIntoLruCache(const Key& key,const Value& value) {
+template<typename Key, typename Value, bool EnableStats>
+void LruKCache<Key, Value, EnableStats>::putIntoLruCache(const Key& key,const Value& value) {
     historyList_->remove(key);
-    LruCache<Key, Value>::put(key, value);
+    Base::put(key, value);
 }
 
-template<typename Key, typename Value>
-bool LruKCache<Key, Value>::isGreaterThanK(const Key& key) {
-    std::shared_ptr<LruNode<Key, Value>> node = this->historyList_->getNode(key);
-    node->increaseAccessCount();
-    size_t accessCount = node->getAccessCount();
-    this->historyList_->moveToRecentPosition(node);
-    return accessCount >= this->k_;
+//false when the key is not (or no longer) in the history list
+template<typename Key, typename Value, bool EnableStats>
+bool LruKCache<Key, Value, EnableStats>::isGreaterThanK(const Key& key) {
+    size_t accessCount = this->historyList_->touch(key);
+    return accessCount != 0 && accessCount >= this->k_;
 }
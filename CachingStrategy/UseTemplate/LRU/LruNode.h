@@ -14,8 +14,8 @@ private:
 public:
 	LruNode() = delete;
 	LruNode(Key key, Value value)
-		: key_{ key }
-		, value_{ value }
+		: key_{ move(key) }
+		, value_{ move(value) }
 		, accessCount_{ 1 } //once something is placed in there, it is considered to have been visited
 							//therefore the initial value is set to 1
 		, pre_{ nullptr }
@@ -24,9 +24,12 @@ public:
 	const Key getKey() { return this->key_; }
 	void setKey(const Key& key) { this->key_ = key; }
 	const Value getValue() { return this->value_; }
+	const Value& peekValue() const { return this->value_; }
+	Value& mutableValue() { return this->value_; }
 	void setValue(const Value& value) { this->value_ = value; }
 	const unsigned int getAccessCount() { return accessCount_; }
 	void increaseAccessCount() { this->accessCount_++; }
+	void setAccessCount(unsigned int accessCount) { this->accessCount_ = accessCount; }
 	shared_ptr<LruNode<Key, Value>> getPre(){ return this->pre_; }
 	void setPre(const shared_ptr<LruNode<Key, Value>>& node) { this->pre_ = node; }
 	shared_ptr<LruNode<Key, Value>> getNext(){ return this->next_; }
@@ -1,12 +1,13 @@
 #pragma once
 #include"LruCache.h"
 
-template<typename Key, typename Value>
+template<typename Key, typename Value, bool EnableStats = true>
 class SliceLruCache :public ICachePolicy<Key,Value>{
 private:
 	unsigned int sliceNum_;
 	unsigned int capacity_;
-	vector<unique_ptr<LruCache<Key, Value>>>  sliceLruCache_;
+	vector<unique_ptr<LruCache<Key, Value, EnableStats>>>  sliceLruCache_;
+	vector<unique_ptr<LockProfiler>> sliceProfilers_;
 public:
 	SliceLruCache(unsigned int sliceNum, unsigned int capacity) : sliceNum_{ sliceNum }, capacity_{ capacity } {
 		initialize();
@@ -18,6 +19,11 @@ public:
 		return this->sliceLruCache_[sliceIndex]->isExists(key);
 	}
 
+	optional<Value> peek(const Key& key) {
+		size_t sliceIndex = hashFun(key) % this->sliceNum_;
+		return this->sliceLruCache_[sliceIndex]->peek(key);
+	}
+
 	optional<Value> get(const Key& key) {
 		size_t sliceIndex = hashFun(key) % this->sliceNum_;
 		return this->sliceLruCache_[sliceIndex]->get(key);
@@ -33,11 +39,65 @@ public:
 		return this->sliceLruCache_[sliceIndex]->remove(key);
 	}
 
+	//each slice counts on its own, the sum is not one point-in-time image
+	CacheStats stats() override {
+		CacheStats total{};
+		for (auto& slice : this->sliceLruCache_) {
+			total += slice->stats();
+		}
+		return total;
+	}
+
+	//attaches one profiler per slice, a hot slice shows up as its lock wait; call before sharing the cache
+	void enableProfiling() {
+		if (!this->sliceProfilers_.empty())
+			return;
+		for (auto& slice : this->sliceLruCache_) {
+			this->sliceProfilers_.emplace_back(make_unique<LockProfiler>());
+			slice->setProfiler(this->sliceProfilers_.back().get());
+		}
+	}
+
+	//one entry per slice in slice order, empty until enableProfiling()
+	vector<ProfileSnapshot> sliceProfiles() {
+		vector<ProfileSnapshot> profiles;
+		for (auto& profiler : this->sliceProfilers_) {
+			profiles.push_back(profiler->snapshot());
+		}
+		return profiles;
+	}
+
+	void setEvictionListener(const typename ICachePolicy<Key, Value>::EvictionListener& listener) override {
+		for (auto& slice : this->sliceLruCache_) {
+			slice->setEvictionListener(listener);
+		}
+	}
+
+	//each slice is written under its own lock, so the slices are not one point-in-time image
+	void snapshot(const string& path) {
+		SnapshotWriter writer{ path, SnapshotHeader::of<Key, Value>(SnapshotEngine::SliceLru) };
+		writer.write<uint32_t>(this->sliceNum_);
+		for (auto& slice : this->sliceLruCache_) {
+			slice->saveTo(writer);
+		}
+		writer.commit();
+	}
+
+	void restore(const string& path) {
+		SnapshotReader reader{ path, SnapshotHeader::of<Key, Value>(SnapshotEngine::SliceLru) };
+		//keys are routed by hash % sliceNum, a different slice count would scatter them
+		if (reader.read<uint32_t>() != this->sliceNum_)
+			throw runtime_error("In SliceLruCache.h-----Snapshot was taken with a different slice count.");
+		for (auto& slice : this->sliceLruCache_) {
+			slice->loadFrom(reader);
+		}
+	}
+
 private:
 	void initialize() {
 		unsigned int sliceCapacity= static_cast<unsigned int>(ceil(static_cast<double>(this->capacity_)/ static_cast<double>(this->sliceNum_)));
 		for (unsigned int i = 0; i < this->sliceNum_; i++) {
-			sliceLruCache_.emplace_back(make_unique<LruCache<Key, Value>>(sliceCapacity));
+			sliceLruCache_.emplace_back(make_unique<LruCache<Key, Value, EnableStats>>(sliceCapacity));
 		}
 	}
 	size_t hashFun(Key key) {
@@ -0,0 +1,145 @@
+#pragma once
+#include <atomic>
+#include <coroutine>
+#include <functional>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+#include "../ICachePolicy.h"
+#include "LoadingCache.h"
+#include "SingleThreadExecutor.h"
+
+//awaitable front end for any ICachePolicy (typically SliceLruCache)
+//a hit completes without suspending, a miss parks the coroutine until the
+//asynchronous loader reports back, and the coroutine is resumed on the executor
+//concurrent misses for one key share a single loader call
+template<typename Key, typename Value>
+class AsyncCache {
+public:
+    //the loader must call the completion exactly once, from any thread
+    //nullopt means the backend has no value, nothing is cached in that case
+    using Completion = function<void(optional<Value>)>;
+    using AsyncLoader = function<void(const Key&, Completion)>;
+
+private:
+    struct Waiter {
+        optional<Value>* result;
+        coroutine_handle<> handle;
+    };
+    using WaiterList = vector<Waiter>;
+    using InFlightHash = unordered_map<Key, WaiterList>;
+
+    ICachePolicy<Key, Value>& cache_;
+    SingleThreadExecutor& executor_;
+    mutex inFlightMutex_;
+    InFlightHash inFlight_;
+    atomic<size_t> hits_;
+    atomic<size_t> loads_;
+    atomic<size_t> coalesced_;
+    atomic<size_t> failures_;
+
+public:
+    class GetAwaiter {
+    private:
+        AsyncCache& owner_;
+        Key key_;
+        AsyncLoader loader_;
+        optional<Value> result_;
+
+    public:
+        GetAwaiter(AsyncCache& owner, const Key& key, AsyncLoader loader)
+            : owner_{ owner }, key_{ key }, loader_{ move(loader) } {}
+
+        bool await_ready() {
+            this->result_ = this->owner_.cache_.get(this->key_);
+            if (this->result_.has_value()) {
+                this->owner_.hits_++;
+                return true;
+            }
+            return false;
+        }
+        bool await_suspend(coroutine_handle<> handle) {
+            return this->owner_.suspendOnMiss(this->key_, this->loader_, this->result_, handle);
+        }
+        optional<Value> await_resume() { return move(this->result_); }
+    };
+
+public:
+    AsyncCache() = delete;
+    AsyncCache(ICachePolicy<Key, Value>& cache, SingleThreadExecutor& executor);
+    ~AsyncCache() = default;
+
+    GetAwaiter getAsync(const Key& key, AsyncLoader loader);
+    LoadingStats getStats();
+
+private:
+    bool suspendOnMiss(const Key& key, const AsyncLoader& loader, optional<Value>& result, coroutine_handle<> handle);
+    void complete(const Key& key, optional<Value> value);
+};
+
+template<typename Key, typename Value>
+AsyncCache<Key, Value>::AsyncCache(ICachePolicy<Key, Value>& cache, SingleThreadExecutor& executor)
+    : cache_{ cache }, executor_{ executor }, hits_{ 0 }, loads_{ 0 }, coalesced_{ 0 }, failures_{ 0 } {}
+
+template<typename Key, typename Value>
+typename AsyncCache<Key, Value>::GetAwaiter AsyncCache<Key, Value>::getAsync(const Key& key, AsyncLoader loader) {
+    return GetAwaiter{ *this, key, move(loader) };
+}
+
+template<typename Key, typename Value>
+LoadingStats AsyncCache<Key, Value>::getStats() {
+    return LoadingStats{ this->hits_.load(), this->loads_.load(), this->coalesced_.load(), this->failures_.load() };
+}
+
+//returns false when the coroutine should not suspend after all
+//the awaiter lives in the suspended frame, so nothing of it may be touched once the loader runs
+template<typename Key, typename Value>
+bool AsyncCache<Key, Value>::suspendOnMiss(const Key& key, const AsyncLoader& loader, optional<Value>& result, coroutine_handle<> handle) {
+    Key loadKey = key;
+    AsyncLoader loadFunction = loader;
+    {
+        lock_guard<mutex> lock{ this->inFlightMutex_ };
+        auto it = this->inFlight_.find(key);
+        if (it != this->inFlight_.end()) {
+            it->second.push_back(Waiter{ &result, handle });
+            this->coalesced_++;
+            return true;
+        }
+        //an earlier load may have completed after await_ready missed; peek neither counts a second miss nor promotes
+        result = this->cache_.peek(key);
+        if (result.has_value()) {
+            this->hits_++;
+            return false;
+        }
+        this->inFlight_[key].push_back(Waiter{ &result, handle });
+    }
+    this->loads_++;
+    loadFunction(loadKey, [this, loadKey](optional<Value> value) {
+        complete(loadKey, move(value));
+    });
+    return true;
+}
+
+template<typename Key, typename Value>
+void AsyncCache<Key, Value>::complete(const Key& key, optional<Value> value) {
+    if (value.has_value())
+        this->cache_.put(key, value.value());
+    else
+        this->failures_++;
+
+    WaiterList waiters;
+    {
+        lock_guard<mutex> lock{ this->inFlightMutex_ };
+        auto it = this->inFlight_.find(key);
+        if (it == this->inFlight_.end())
+            return;
+        waiters.swap(it->second);
+        this->inFlight_.erase(it);
+    }
+    for (Waiter& waiter : waiters) {
+        *waiter.result = value;
+        coroutine_handle<> handle = waiter.handle;
+        this->executor_.post([handle]() { handle.resume(); });
+    }
+}
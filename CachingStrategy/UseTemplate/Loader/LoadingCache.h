@@ -0,0 +1,143 @@
+#pragma once
+#include <atomic>
+#include <functional>
+#include <future>
+#include <mutex>
+#include <unordered_map>
+
+#include "../ICachePolicy.h"
+
+struct LoadingStats {
+    size_t hits;
+    size_t loads;
+    size_t coalesced;   //misses that waited on a load started by another thread
+    size_t failures;
+};
+
+//wraps any ICachePolicy and turns "get, miss, fetch, put" into one call
+//concurrent misses on the same key share a single loader call (single-flight),
+//the other callers block on the leader's shared_future
+template<typename Key, typename Value>
+class LoadingCache : public ICachePolicy<Key, Value> {
+public:
+    using Loader = function<Value(const Key&)>;
+
+private:
+    using InFlight = shared_future<Value>;
+    using InFlightHash = unordered_map<Key, InFlight>;
+
+    ICachePolicy<Key, Value>& cache_;
+    mutex inFlightMutex_;
+    InFlightHash inFlight_;
+    atomic<size_t> hits_;
+    atomic<size_t> loads_;
+    atomic<size_t> coalesced_;
+    atomic<size_t> failures_;
+
+public:
+    LoadingCache() = delete;
+    LoadingCache(ICachePolicy<Key, Value>& cache);
+    ~LoadingCache() override = default;
+
+    Value getOrLoad(const Key& key, const Loader& loader);
+    LoadingStats getStats();
+
+    void put(const Key& key, const Value& value) override;
+    optional<Value> get(const Key& key) override;
+    bool remove(const Key& key) override;
+    bool isExists(const Key& key) override;
+    optional<Value> peek(const Key& key) override;
+    CacheStats stats() override { return this->cache_.stats(); }
+
+private:
+    Value load(const Key& key, const Loader& loader, promise<Value>& loadPromise);
+};
+
+template<typename Key, typename Value>
+LoadingCache<Key, Value>::LoadingCache(ICachePolicy<Key, Value>& cache)
+    : cache_{ cache }, hits_{ 0 }, loads_{ 0 }, coalesced_{ 0 }, failures_{ 0 } {}
+
+template<typename Key, typename Value>
+Value LoadingCache<Key, Value>::getOrLoad(const Key& key, const Loader& loader) {
+    optional<Value> cached = this->cache_.get(key);
+    if (cached.has_value()) {
+        this->hits_++;
+        return cached.value();
+    }
+
+    promise<Value> loadPromise;
+    {
+        unique_lock<mutex> lock{ this->inFlightMutex_ };
+        auto it = this->inFlight_.find(key);
+        if (it != this->inFlight_.end()) {
+            InFlight inFlight = it->second;
+            lock.unlock();
+            this->coalesced_++;
+            return inFlight.get();
+        }
+        //the previous leader may have finished between our miss and taking the lock;
+        //peek neither counts a second miss nor promotes, and is the cheapest lookup to make under the lock
+        cached = this->cache_.peek(key);
+        if (cached.has_value()) {
+            this->hits_++;
+            return cached.value();
+        }
+        this->inFlight_.emplace(key, loadPromise.get_future().share());
+    }
+    return load(key, loader, loadPromise);
+}
+
+template<typename Key, typename Value>
+Value LoadingCache<Key, Value>::load(const Key& key, const Loader& loader, promise<Value>& loadPromise) {
+    this->loads_++;
+    try {
+        Value value = loader(key);
+        this->cache_.put(key, value);
+        {
+            lock_guard<mutex> lock{ this->inFlightMutex_ };
+            this->inFlight_.erase(key);
+        }
+        loadPromise.set_value(value);
+        return value;
+    }
+    catch (...) {
+        //failed loads are not cached, every waiter sees the same exception
+        this->failures_++;
+        {
+            lock_guard<mutex> lock{ this->inFlightMutex_ };
+            this->inFlight_.erase(key);
+        }
+        loadPromise.set_exception(current_exception());
+        throw;
+    }
+}
+
+template<typename Key, typename Value>
+LoadingStats LoadingCache<Key, Value>::getStats() {
+    return LoadingStats{ this->hits_.load(), this->loads_.load(), this->coalesced_.load(), this->failures_.load() };
+}
+
+template<typename Key, typename Value>
+void LoadingCache<Key, Value>::put(const Key& key, const Value& value) {
+    this->cache_.put(key, value);
+}
+
+template<typename Key, typename Value>
+optional<Value> LoadingCache<Key, Value>::get(const Key& key) {
+    return this->cache_.get(key);
+}
+
+template<typename Key, typename Value>
+bool LoadingCache<Key, Value>::remove(const Key& key) {
+    return this->cache_.remove(key);
+}
+
+template<typename Key, typename Value>
+bool LoadingCache<Key, Value>::isExists(const Key& key) {
+    return this->cache_.isExists(key);
+}
+
+template<typename Key, typename Value>
+optional<Value> LoadingCache<Key, Value>::peek(const Key& key) {
+    return this->cache_.peek(key);
+}
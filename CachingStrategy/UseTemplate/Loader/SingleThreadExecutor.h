@@ -0,0 +1,119 @@
+#pragma once
+#include <chrono>
+#include <condition_variable>
+#include <coroutine>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <queue>
+#include <vector>
+using namespace std;
+
+//event loop driven by the thread that calls run()
+//post() and postAfter() may be called from any thread
+class SingleThreadExecutor {
+public:
+    using Clock = chrono::steady_clock;
+    using Work = function<void()>;
+
+private:
+    struct Timer {
+        Clock::time_point deadline;
+        unsigned long long sequence;   //keeps timers with equal deadlines in FIFO order
+        Work work;
+        bool operator>(const Timer& other) const {
+            if (this->deadline != other.deadline)
+                return this->deadline > other.deadline;
+            return this->sequence > other.sequence;
+        }
+    };
+    using TimerQueue = priority_queue<Timer, vector<Timer>, greater<Timer>>;
+
+    mutex mutex_;
+    condition_variable wakeUp_;
+    deque<Work> readyQueue_;
+    TimerQueue timerQueue_;
+    unsigned long long timerSequence_;
+    bool stopped_;
+
+public:
+    SingleThreadExecutor() : timerSequence_{ 0 }, stopped_{ false } {}
+    ~SingleThreadExecutor() = default;
+
+    void post(Work work);
+    void postAfter(Clock::duration delay, Work work);
+    void run();
+    void stop();
+
+    //co_await executor.schedule() continues the coroutine on the executor thread
+    auto schedule() {
+        struct ScheduleAwaiter {
+            SingleThreadExecutor& executor;
+            bool await_ready() { return false; }
+            void await_suspend(coroutine_handle<> handle) { executor.post([handle]() { handle.resume(); }); }
+            void await_resume() {}
+        };
+        return ScheduleAwaiter{ *this };
+    }
+
+private:
+    void moveExpiredTimers();
+};
+
+inline void SingleThreadExecutor::post(Work work) {
+    {
+        lock_guard<mutex> lock{ this->mutex_ };
+        this->readyQueue_.push_back(move(work));
+    }
+    this->wakeUp_.notify_one();
+}
+
+inline void SingleThreadExecutor::postAfter(Clock::duration delay, Work work) {
+    {
+        lock_guard<mutex> lock{ this->mutex_ };
+        this->timerQueue_.push(Timer{ Clock::now() + delay, this->timerSequence_++, move(work) });
+    }
+    this->wakeUp_.notify_one();
+}
+
+inline void SingleThreadExecutor::run() {
+    deque<Work> batch;
+    while (true) {
+        {
+            unique_lock<mutex> lock{ this->mutex_ };
+            while (true) {
+                moveExpiredTimers();
+                if (this->stopped_ || !this->readyQueue_.empty())
+                    break;
+                if (this->timerQueue_.empty())
+                    this->wakeUp_.wait(lock);
+                else
+                    this->wakeUp_.wait_until(lock, this->timerQueue_.top().deadline);
+            }
+            if (this->stopped_)
+                return;
+            batch.swap(this->readyQueue_);
+        }
+        while (!batch.empty()) {
+            Work work = move(batch.front());
+            batch.pop_front();
+            work();
+        }
+    }
+}
+
+inline void SingleThreadExecutor::stop() {
+    {
+        lock_guard<mutex> lock{ this->mutex_ };
+        this->stopped_ = true;
+    }
+    this->wakeUp_.notify_all();
+}
+
+inline void SingleThreadExecutor::moveExpiredTimers() {
+    const Clock::time_point now = Clock::now();
+    while (!this->timerQueue_.empty() && this->timerQueue_.top().deadline <= now) {
+        this->readyQueue_.push_back(move(const_cast<Timer&>(this->timerQueue_.top()).work));
+        this->timerQueue_.pop();
+    }
+}
@@ -0,0 +1,119 @@
+#pragma once
+#include <coroutine>
+#include <exception>
+#include <optional>
+#include <utility>
+using namespace std;
+
+//lazily started coroutine, resumes whoever co_awaits it when it finishes
+template<typename T>
+class Task;
+
+template<typename T>
+class TaskPromiseBase {
+private:
+    coroutine_handle<> continuation_;
+    exception_ptr error_;
+
+    struct FinalAwaiter {
+        bool await_ready() noexcept { return false; }
+        template<typename Promise>
+        coroutine_handle<> await_suspend(coroutine_handle<Promise> handle) noexcept {
+            coroutine_handle<> continuation = handle.promise().continuation_;
+            return continuation ? continuation : noop_coroutine();
+        }
+        void await_resume() noexcept {}
+    };
+
+public:
+    suspend_always initial_suspend() noexcept { return {}; }
+    FinalAwaiter final_suspend() noexcept { return {}; }
+    void unhandled_exception() { this->error_ = current_exception(); }
+    void setContinuation(coroutine_handle<> continuation) { this->continuation_ = continuation; }
+    void rethrowIfFailed() {
+        if (this->error_)
+            rethrow_exception(this->error_);
+    }
+};
+
+template<typename T>
+class TaskPromise : public TaskPromiseBase<T> {
+private:
+    optional<T> value_;
+
+public:
+    Task<T> get_return_object();
+    void return_value(T value) { this->value_.emplace(move(value)); }
+    T takeValue() {
+        this->rethrowIfFailed();
+        return move(this->value_.value());
+    }
+};
+
+template<>
+class TaskPromise<void> : public TaskPromiseBase<void> {
+public:
+    Task<void> get_return_object();
+    void return_void() {}
+    void takeValue() { this->rethrowIfFailed(); }
+};
+
+template<typename T>
+class Task {
+public:
+    using promise_type = TaskPromise<T>;
+    using Handle = coroutine_handle<promise_type>;
+
+private:
+    Handle handle_;
+
+public:
+    Task() = delete;
+    explicit Task(Handle handle) : handle_{ handle } {}
+    Task(const Task&) = delete;
+    Task& operator=(const Task&) = delete;
+    Task(Task&& other) noexcept : handle_{ exchange(other.handle_, nullptr) } {}
+    Task& operator=(Task&& other) noexcept {
+        if (this != &other) {
+            if (this->handle_)
+                this->handle_.destroy();
+            this->handle_ = exchange(other.handle_, nullptr);
+        }
+        return *this;
+    }
+    ~Task() {
+        if (this->handle_)
+            this->handle_.destroy();
+    }
+
+    bool await_ready() { return false; }
+    coroutine_handle<> await_suspend(coroutine_handle<> awaiting) {
+        this->handle_.promise().setContinuation(awaiting);
+        return this->handle_;
+    }
+    T await_resume() { return this->handle_.promise().takeValue(); }
+};
+
+template<typename T>
+Task<T> TaskPromise<T>::get_return_object() {
+    return Task<T>{ coroutine_handle<TaskPromise<T>>::from_promise(*this) };
+}
+
+inline Task<void> TaskPromise<void>::get_return_object() {
+    return Task<void>{ coroutine_handle<TaskPromise<void>>::from_promise(*this) };
+}
+
+//fire-and-forget driver, the frame frees itself once the task finishes
+struct DetachedTask {
+    struct promise_type {
+        DetachedTask get_return_object() { return {}; }
+        suspend_never initial_suspend() noexcept { return {}; }
+        suspend_never final_suspend() noexcept { return {}; }
+        void return_void() {}
+        void unhandled_exception() { terminate(); }
+    };
+};
+
+inline DetachedTask spawn(Task<void> task) {
+    co_await task;
+}
@@ -0,0 +1,57 @@
+#pragma once
+#include <cstdint>
+#include <stdexcept>
+#include <vector>
+using namespace std;
+
+//nodes kept in one vector and linked by 32-bit index instead of shared_ptr: once the pool has grown an entry
+//costs no allocation, relinking touches no reference counts, and the whole structure frees in one go
+//released slots are reused first; an index stays valid until it is released, a reference only until the
+//next acquire(), which may grow the vector
+template<typename Node>
+class NodePool {
+private:
+    vector<Node> nodes_;
+    vector<uint32_t> freeSlots_;
+
+public:
+    static const uint32_t NIL = UINT32_MAX;
+
+    NodePool() = default;
+    explicit NodePool(size_t reserve) { this->nodes_.reserve(reserve); }
+
+    //a default-constructed node
+    uint32_t acquire();
+    //resets the node so its key and value release what they hold
+    void release(uint32_t index);
+    void clear();
+
+    Node& operator[](uint32_t index) { return this->nodes_[index]; }
+    const Node& operator[](uint32_t index) const { return this->nodes_[index]; }
+    size_t size() const { return this->nodes_.size() - this->freeSlots_.size(); }
+};
+
+template<typename Node>
+uint32_t NodePool<Node>::acquire() {
+    if (!this->freeSlots_.empty()) {
+        const uint32_t index = this->freeSlots_.back();
+        this->freeSlots_.pop_back();
+        return index;
+    }
+    if (this->nodes_.size() >= NIL)
+        throw runtime_error("In NodePool.h-----More nodes than a 32-bit index can address.");
+    this->nodes_.emplace_back();
+    return static_cast<uint32_t>(this->nodes_.size() - 1);
+}
+
+template<typename Node>
+void NodePool<Node>::release(uint32_t index) {
+    this->nodes_[index] = Node{};
+    this->freeSlots_.push_back(index);
+}
+
+template<typename Node>
+void NodePool<Node>::clear() {
+    this->nodes_.clear();
+    this->freeSlots_.clear();
+}
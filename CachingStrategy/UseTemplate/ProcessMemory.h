@@ -0,0 +1,79 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#include <windows.h>
+#include <psapi.h>
+#include <malloc.h>
+#pragma comment(lib, "psapi.lib")
+#else
+#include <cstdio>
+#if defined(__GLIBC__)
+#include <malloc.h>
+#endif
+#include <sys/resource.h>
+#include <unistd.h>
+#endif
+using namespace std;
+
+//resident set size of this process in bytes, for memory benchmarks
+//0 when the platform does not report it
+struct ProcessMemory {
+    static size_t currentRss() {
+#ifdef _WIN32
+        PROCESS_MEMORY_COUNTERS counters;
+        if (!GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters)))
+            return 0;
+        return counters.WorkingSetSize;
+#else
+        FILE* statm = fopen("/proc/self/statm", "r");
+        if (!statm)
+            return 0;
+        long pages = 0;
+        long residentPages = 0;
+        int parsed = fscanf(statm, "%ld %ld", &pages, &residentPages);
+        fclose(statm);
+        return parsed == 2 ? static_cast<size_t>(residentPages) * static_cast<size_t>(sysconf(_SC_PAGESIZE)) : 0;
+#endif
+    }
+
+    static size_t peakRss() {
+#ifdef _WIN32
+        PROCESS_MEMORY_COUNTERS counters;
+        if (!GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters)))
+            return 0;
+        return counters.PeakWorkingSetSize;
+#else
+        struct rusage usage;
+        if (getrusage(RUSAGE_SELF, &usage) != 0)
+            return 0;
+#ifdef __APPLE__
+        return static_cast<size_t>(usage.ru_maxrss);
+#else
+        return static_cast<size_t>(usage.ru_maxrss) * 1024;
+#endif
+#endif
+    }
+
+    //hands the heap's free pages back to the OS, a later run then faults in every page it touches instead of
+    //quietly reusing what earlier work freed, and an RSS delta taken from here counts its real footprint
+    //a no-op where the allocator offers no such call
+    static void releaseFreeHeap() {
+#ifdef _WIN32
+        _heapmin();
+#elif defined(__GLIBC__)
+        malloc_trim(0);
+#endif
+    }
+
+    //signed, RSS can shrink while a run frees what came before it
+    static int64_t rssGrowth(size_t before) {
+        return static_cast<int64_t>(currentRss()) - static_cast<int64_t>(before);
+    }
+};
@@ -0,0 +1,405 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <vector>
+
+#include "../ICachePolicy.h"
+#include "../Concurrent/BoundedQueue.h"
+#include "../Concurrent/EpochManager.h"
+#include "../Concurrent/LockFreeHashIndex.h"
+#include "../Stats/StatsRecorder.h"
+
+//S3-FIFO: three FIFOs and no list relinking at all
+//  - a new key enters the small queue S (10% of capacity); one that was hit while in S moves on to the main
+//    queue M when it reaches the head, the rest are evicted and remembered in the ghost G
+//  - a put of a key still in G goes straight to M
+//  - M is a FIFO with reinsertion: a head entry that was hit goes round again with its count lowered by one
+//a hit only bumps a 2-bit saturating counter in the node, so get() is a lock-free index lookup like
+//ConcurrentLruCache's, without even a read buffer; S and M are BoundedQueue rings, G is a direct-mapped
+//table of fingerprints stamped with the eviction count, forgotten once capacity more keys went through it
+//evictions run under evictMutex_, taken with try_lock; the cache may briefly hold more than capacity entries
+template<typename Key, typename Value, bool EnableStats = true>
+class S3FifoCache : public ICachePolicy<Key, Value> {
+private:
+    static const uint8_t MAX_FREQUENCY = 3;
+    static const uint32_t RETIRED_BOXES_PER_RECLAIM = 64;
+
+    struct ValueBox {
+        Value value;
+        ValueBox* retireNext;
+        uint64_t retireEpoch;
+        ValueBox(const Value& value) : value{ value }, retireNext{ nullptr }, retireEpoch{ 0 } {}
+    };
+
+    struct Node {
+        Key key_;
+        size_t hash_;
+        atomic<uintptr_t> indexNext_;
+        atomic<ValueBox*> value_;
+        atomic<uint8_t> frequency_;   //hits since it entered its queue, saturating at MAX_FREQUENCY
+        uint64_t retireEpoch_;
+
+        Node(const Key& key, size_t hash, ValueBox* value)
+            : key_{ key }, hash_{ hash }, indexNext_{ 0 }, value_{ value }, frequency_{ 0 }, retireEpoch_{ 0 } {}
+        ~Node() { delete this->value_.load(memory_order_relaxed); }
+    };
+
+    size_t capacity_;
+    size_t smallTarget_;
+    uint32_t ghostCapacity_;
+    EpochManager epoch_;
+    LockFreeHashIndex<Key, Node> index_;
+    BoundedQueue<Node*> small_;
+    BoundedQueue<Node*> main_;
+    vector<atomic<uint64_t>> ghosts_;   //(fingerprint << 32) | eviction count when it was remembered, 0 is empty
+    unsigned int ghostShift_;
+    alignas(64) atomic<uint32_t> ghostClock_;
+    alignas(64) atomic<size_t> size_;
+    alignas(64) atomic<ValueBox*> retiredBoxStack_;
+    atomic<uint32_t> retiredBoxCount_;
+    StatsRecorder<EnableStats> recorder_;
+
+    //everything below is guarded by evictMutex_
+    alignas(64) mutex evictMutex_;
+    deque<Node*> retiredNodes_;
+    deque<ValueBox*> retiredBoxes_;
+
+public:
+    S3FifoCache() = delete;
+    //smallRatio is the share of capacity S aims for
+    S3FifoCache(size_t capacity, double smallRatio = 0.1);
+    ~S3FifoCache() override;
+
+    void put(const Key& key, const Value& value) override;
+    optional<Value> get(const Key& key) override;
+    bool remove(const Key& key) override;
+    bool isExists(const Key& key) override;
+    optional<Value> peek(const Key& key) override;
+    CacheStats stats() override;
+    size_t size() { return this->size_.load(memory_order_relaxed); }
+    //evicts down to capacity and frees what epochs allow, mostly useful for tests
+    void cleanUp();
+
+private:
+    size_t hashOf(const Key& key) { return hash<Key>{}(key); }
+    static bool isRemoved(const Node* node) { return (node->indexNext_.load(memory_order_acquire) & 1) != 0; }
+    void hit(Node* node);
+    void updateValue(Node* node, const Value& value);
+    void enqueue(Node* node, bool toMain);
+    void tryEvict();
+    void evictOverflow();
+    bool evictFromSmall();
+    bool evictFromMain();
+    bool evict(Node* node, bool toGhost);
+    void remember(size_t hash);
+    bool recall(size_t hash, bool forget);
+    void reclaim();
+    void retire(Node* node);
+};
+
+template<typename Key, typename Value, bool EnableStats>
+S3FifoCache<Key, Value, EnableStats>::S3FifoCache(size_t capacity, double smallRatio)
+    : capacity_{ capacity }, smallTarget_{ max<size_t>(1, static_cast<size_t>(capacity * smallRatio)) },
+    ghostCapacity_{ static_cast<uint32_t>(min<size_t>(max<size_t>(capacity - min(capacity, smallTarget_), 1), UINT32_MAX / 2)) },
+    index_{ capacity }, small_{ capacity * 2 + 64 }, main_{ capacity * 2 + 64 }, ghostShift_{ 63 }, ghostClock_{ 0 },
+    size_{ 0 }, retiredBoxStack_{ nullptr }, retiredBoxCount_{ 0 } {
+    //twice the slots of what G remembers keeps collisions from forgetting much early
+    size_t ghostSlots = 2;
+    while (ghostSlots < static_cast<size_t>(this->ghostCapacity_) * 2) {
+        ghostSlots <<= 1;
+        --this->ghostShift_;
+    }
+    this->ghosts_ = vector<atomic<uint64_t>>(ghostSlots);
+    for (atomic<uint64_t>& ghost : this->ghosts_)
+        ghost.store(0, memory_order_relaxed);
+}
+
+template<typename Key, typename Value, bool EnableStats>
+S3FifoCache<Key, Value, EnableStats>::~S3FifoCache() {
+    //no other thread may use the cache any more; removed nodes are only reachable from the queues,
+    //live ones from the index
+    Node* node;
+    while (this->small_.tryPop(node)) {
+        if (isRemoved(node))
+            delete node;
+    }
+    while (this->main_.tryPop(node)) {
+        if (isRemoved(node))
+            delete node;
+    }
+    for (Node* retired : this->retiredNodes_)
+        delete retired;
+    for (ValueBox* box : this->retiredBoxes_)
+        delete box;
+    ValueBox* box = this->retiredBoxStack_.exchange(nullptr);
+    while (box) {
+        ValueBox* next = box->retireNext;
+        delete box;
+        box = next;
+    }
+    this->index_.forEachUnsafe([](Node* live) { delete live; });
+}
+
+template<typename Key, typename Value, bool EnableStats>
+void S3FifoCache<Key, Value, EnableStats>::put(const Key& key, const Value& value) {
+    if (this->capacity_ == 0) return;
+    {
+        auto guard = this->epoch_.pin();
+        const size_t hash = hashOf(key);
+        Node* node = this->index_.find(key, hash);
+        if (node) {
+            this->recorder_.record(StatsCounter::Update);
+            updateValue(node, value);
+            hit(node);
+            return;
+        }
+        Node* newNode = new Node(key, hash, new ValueBox(value));
+        Node* existing = this->index_.insertIfAbsent(newNode);
+        if (existing) {
+            //lost the race to another put of the same key, newNode was never visible
+            delete newNode;
+            this->recorder_.record(StatsCounter::Update);
+            updateValue(existing, value);
+            hit(existing);
+            return;
+        }
+        this->size_.fetch_add(1, memory_order_relaxed);
+        this->recorder_.record(StatsCounter::Put);
+        this->recorder_.entryAdded(key, value);
+        const bool toMain = recall(hash, true);
+        //room is made before the node joins a queue, so it never competes with the put that brings it in
+        tryEvict();
+        enqueue(newNode, toMain);
+    }
+}
+
+template<typename Key, typename Value, bool EnableStats>
+optional<Value> S3FifoCache<Key, Value, EnableStats>::get(const Key& key) {
+    auto guard = this->epoch_.pin();
+    const size_t hash = hashOf(key);
+    Node* node = this->index_.find(key, hash);
+    if (!node) {
+        if (recall(hash, false))
+            this->recorder_.record(StatsCounter::GhostHit);
+        this->recorder_.record(StatsCounter::Miss);
+        return nullopt;
+    }
+    this->recorder_.record(StatsCounter::Hit);
+    Value value = node->value_.load(memory_order_acquire)->value;
+    hit(node);
+    return value;
+}
+
+//the node stays in its queue, whoever pops it there sees the mark and retires it
+template<typename Key, typename Value, bool EnableStats>
+bool S3FifoCache<Key, Value, EnableStats>::remove(const Key& key) {
+    auto guard = this->epoch_.pin();
+    Node* node = this->index_.find(key, hashOf(key));
+    if (!node || !this->index_.erase(node))
+        return false;
+    this->size_.fetch_sub(1, memory_order_relaxed);
+    this->recorder_.entryRemoved(node->key_, node->value_.load(memory_order_acquire)->value);
+    return true;
+}
+
+template<typename Key, typename Value, bool EnableStats>
+bool S3FifoCache<Key, Value, EnableStats>::isExists(const Key& key) {
+    auto guard = this->epoch_.pin();
+    return this->index_.find(key, hashOf(key)) != nullptr;
+}
+
+template<typename Key, typename Value, bool EnableStats>
+optional<Value> S3FifoCache<Key, Value, EnableStats>::peek(const Key& key) {
+    auto guard = this->epoch_.pin();
+    Node* node = this->index_.find(key, hashOf(key));
+    if (!node)
+        return nullopt;
+    return node->value_.load(memory_order_acquire)->value;
+}
+
+//size may briefly exceed capacity, see the class comment
+template<typename Key, typename Value, bool EnableStats>
+CacheStats S3FifoCache<Key, Value, EnableStats>::stats() {
+    return this->recorder_.collect(this->size_.load(memory_order_relaxed));
+}
+
+template<typename Key, typename Value, bool EnableStats>
+void S3FifoCache<Key, Value, EnableStats>::cleanUp() {
+    lock_guard<mutex> lock{ this->evictMutex_ };
+    evictOverflow();
+}
+
+//a saturated counter is not written again, hot keys leave their cache line shared between readers
+template<typename Key, typename Value, bool EnableStats>
+void S3FifoCache<Key, Value, EnableStats>::hit(Node* node) {
+    const uint8_t frequency = node->frequency_.load(memory_order_relaxed);
+    if (frequency < MAX_FREQUENCY)
+        node->frequency_.store(frequency + 1, memory_order_relaxed);
+}
+
+template<typename Key, typename Value, bool EnableStats>
+void S3FifoCache<Key, Value, EnableStats>::updateValue(Node* node, const Value& value) {
+    ValueBox* old = node->value_.exchange(new ValueBox(value), memory_order_acq_rel);
+    //old stays readable until the next epoch turn, the caller is pinned
+    this->recorder_.valueReplaced(old->value, value);
+    old->retireEpoch = this->epoch_.currentEpoch();
+    old->retireNext = this->retiredBoxStack_.load(memory_order_relaxed);
+    while (!this->retiredBoxStack_.compare_exchange_weak(old->retireNext, old, memory_order_release, memory_order_relaxed)) {}
+    //a workload that fits never evicts, free the old values now and then anyway
+    if (this->retiredBoxCount_.fetch_add(1, memory_order_relaxed) % RETIRED_BOXES_PER_RECLAIM == RETIRED_BOXES_PER_RECLAIM - 1
+        && this->evictMutex_.try_lock()) {
+        reclaim();
+        this->evictMutex_.unlock();
+    }
+}
+
+//the queues have room for twice the capacity, a full one means removed nodes are piling up in it:
+//popping them is exactly what eviction does
+template<typename Key, typename Value, bool EnableStats>
+void S3FifoCache<Key, Value, EnableStats>::enqueue(Node* node, bool toMain) {
+    BoundedQueue<Node*>& queue = toMain ? this->main_ : this->small_;
+    while (!queue.tryPush(node)) {
+        lock_guard<mutex> lock{ this->evictMutex_ };
+        if (toMain)
+            evictFromMain();
+        else
+            evictFromSmall();
+    }
+}
+
+//whoever fails the try_lock leaves the work to the current evictor, which checks the size once more after
+//unlocking; an evictor that finds the queues empty stops, the put still pushing will evict after it
+template<typename Key, typename Value, bool EnableStats>
+void S3FifoCache<Key, Value, EnableStats>::tryEvict() {
+    while (this->size_.load(memory_order_relaxed) > this->capacity_) {
+        if (!this->evictMutex_.try_lock())
+            return;
+        const size_t before = this->size_.load(memory_order_relaxed);
+        evictOverflow();
+        this->evictMutex_.unlock();
+        if (this->size_.load(memory_order_relaxed) >= before)
+            return;
+    }
+}
+
+template<typename Key, typename Value, bool EnableStats>
+void S3FifoCache<Key, Value, EnableStats>::evictOverflow() {
+    auto guard = this->epoch_.pin();
+    while (this->size_.load(memory_order_relaxed) > this->capacity_) {
+        const bool fromSmall = this->small_.size() >= this->smallTarget_ || this->main_.size() == 0;
+        if (!(fromSmall && evictFromSmall()) && !evictFromMain() && !evictFromSmall())
+            break;
+    }
+    reclaim();
+}
+
+//true once something was evicted; S may empty into M without that
+template<typename Key, typename Value, bool EnableStats>
+bool S3FifoCache<Key, Value, EnableStats>::evictFromSmall() {
+    Node* node;
+    while (this->small_.tryPop(node)) {
+        if (isRemoved(node)) {
+            retire(node);
+            continue;
+        }
+        if (node->frequency_.load(memory_order_relaxed) > 0) {
+            node->frequency_.store(0, memory_order_relaxed);
+            if (this->main_.tryPush(node))
+                continue;
+        }
+        if (evict(node, true))
+            return true;
+    }
+    return false;
+}
+
+//every pass over an entry lowers its count, so the loop ends within MAX_FREQUENCY + 1 laps
+template<typename Key, typename Value, bool EnableStats>
+bool S3FifoCache<Key, Value, EnableStats>::evictFromMain() {
+    Node* node;
+    while (this->main_.tryPop(node)) {
+        if (isRemoved(node)) {
+            retire(node);
+            continue;
+        }
+        const uint8_t frequency = node->frequency_.load(memory_order_relaxed);
+        if (frequency > 0) {
+            node->frequency_.store(frequency - 1, memory_order_relaxed);
+            if (this->main_.tryPush(node))
+                continue;
+        }
+        if (evict(node, false))
+            return true;
+    }
+    return false;
+}
+
+//false when remove() unlinked the node first, it is retired here either way
+template<typename Key, typename Value, bool EnableStats>
+bool S3FifoCache<Key, Value, EnableStats>::evict(Node* node, bool toGhost) {
+    const bool evicted = this->index_.erase(node);
+    if (evicted) {
+        this->size_.fetch_sub(1, memory_order_relaxed);
+        this->recorder_.record(StatsCounter::Eviction);
+        this->recorder_.entryRemoved(node->key_, node->value_.load(memory_order_acquire)->value);
+        this->notifyEviction(node->key_, node->value_.load(memory_order_acquire)->value);
+        if (toGhost)
+            remember(node->hash_);
+    }
+    retire(node);
+    return evicted;
+}
+
+template<typename Key, typename Value, bool EnableStats>
+void S3FifoCache<Key, Value, EnableStats>::remember(size_t hash) {
+    const uint64_t mixed = static_cast<uint64_t>(hash) * 0x9e3779b97f4a7c15ull;
+    const uint64_t fingerprint = static_cast<uint32_t>(mixed) | 1u;
+    const uint32_t clock = this->ghostClock_.fetch_add(1, memory_order_relaxed) + 1;
+    this->ghosts_[mixed >> this->ghostShift_].store((fingerprint << 32) | clock, memory_order_relaxed);
+}
+
+//a slot may have been taken over by another key, or be too old to count; forget claims the entry
+template<typename Key, typename Value, bool EnableStats>
+bool S3FifoCache<Key, Value, EnableStats>::recall(size_t hash, bool forget) {
+    const uint64_t mixed = static_cast<uint64_t>(hash) * 0x9e3779b97f4a7c15ull;
+    const uint64_t fingerprint = static_cast<uint32_t>(mixed) | 1u;
+    atomic<uint64_t>& slot = this->ghosts_[mixed >> this->ghostShift_];
+    uint64_t ghost = slot.load(memory_order_relaxed);
+    if ((ghost >> 32) != fingerprint)
+        return false;
+    const uint32_t age = this->ghostClock_.load(memory_order_relaxed) - static_cast<uint32_t>(ghost);
+    if (age >= this->ghostCapacity_)
+        return false;
+    return !forget || slot.compare_exchange_strong(ghost, 0, memory_order_relaxed);
+}
+
+//frees what no pinned reader can still see; the caller holds evictMutex_
+template<typename Key, typename Value, bool EnableStats>
+void S3FifoCache<Key, Value, EnableStats>::reclaim() {
+    this->epoch_.tryAdvance();
+    while (!this->retiredNodes_.empty() && this->epoch_.isSafeToFree(this->retiredNodes_.front()->retireEpoch_)) {
+        delete this->retiredNodes_.front();
+        this->retiredNodes_.pop_front();
+    }
+    ValueBox* box = this->retiredBoxStack_.exchange(nullptr, memory_order_acquire);
+    while (box) {
+        this->retiredBoxes_.push_back(box);
+        box = box->retireNext;
+    }
+    auto keep = this->retiredBoxes_.begin();
+    for (auto it = this->retiredBoxes_.begin(); it != this->retiredBoxes_.end(); ++it) {
+        if (this->epoch_.isSafeToFree((*it)->retireEpoch))
+            delete *it;
+        else
+            *keep++ = *it;
+    }
+    this->retiredBoxes_.erase(keep, this->retiredBoxes_.end());
+}
+
+template<typename Key, typename Value, bool EnableStats>
+void S3FifoCache<Key, Value, EnableStats>::retire(Node* node) {
+    node->retireEpoch_ = this->epoch_.currentEpoch();
+    this->retiredNodes_.push_back(node);
+}
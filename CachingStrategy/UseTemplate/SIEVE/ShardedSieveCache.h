@@ -0,0 +1,68 @@
+#pragma once
+#include <cmath>
+#include <memory>
+#include <vector>
+
+#include "SieveCache.h"
+
+//SieveCache split into shards routed by hash, as SliceLruCache does for LruCache
+//hits already share their shard's lock, the shards spread the exclusive put and eviction path
+template<typename Key, typename Value, bool EnableStats = true>
+class ShardedSieveCache :public ICachePolicy<Key, Value> {
+private:
+	unsigned int shardNum_;
+	unsigned int capacity_;
+	vector<unique_ptr<SieveCache<Key, Value, EnableStats>>> shards_;
+public:
+	ShardedSieveCache(unsigned int shardNum, unsigned int capacity) : shardNum_{ shardNum }, capacity_{ capacity } {
+		initialize();
+	}
+	~ShardedSieveCache() = default;
+
+	bool isExists(const Key& key) override {
+		return shardOf(key).isExists(key);
+	}
+
+	optional<Value> peek(const Key& key) override {
+		return shardOf(key).peek(key);
+	}
+
+	optional<Value> get(const Key& key) override {
+		return shardOf(key).get(key);
+	}
+
+	void put(const Key& key, const Value& value) override {
+		shardOf(key).put(key, value);
+	}
+
+	bool remove(const Key& key) override {
+		return shardOf(key).remove(key);
+	}
+
+	//each shard counts on its own, the sum is not one point-in-time image
+	CacheStats stats() override {
+		CacheStats total{};
+		for (auto& shard : this->shards_) {
+			total += shard->stats();
+		}
+		return total;
+	}
+
+	void setEvictionListener(const typename ICachePolicy<Key, Value>::EvictionListener& listener) override {
+		for (auto& shard : this->shards_) {
+			shard->setEvictionListener(listener);
+		}
+	}
+
+private:
+	void initialize() {
+		unsigned int shardCapacity = static_cast<unsigned int>(ceil(static_cast<double>(this->capacity_) / static_cast<double>(this->shardNum_)));
+		for (unsigned int i = 0; i < this->shardNum_; i++) {
+			shards_.emplace_back(make_unique<SieveCache<Key, Value, EnableStats>>(shardCapacity));
+		}
+	}
+	SieveCache<Key, Value, EnableStats>& shardOf(const Key& key) {
+		hash<Key> hash;
+		return *this->shards_[hash(key) % this->shardNum_];
+	}
+};
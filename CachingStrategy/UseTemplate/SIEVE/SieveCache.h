@@ -0,0 +1,197 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <shared_mutex>
+#include <unordered_map>
+#include <vector>
+
+#include "../ICachePolicy.h"
+#include "../Stats/StatsRecorder.h"
+
+//SIEVE: one FIFO queue, new entries at the head, and a hand that walks from the tail towards the head;
+//the hand clears visited bits as it passes and evicts the first entry it finds unvisited, then stays there
+//unlike CLOCK, an entry that survives keeps its place, so new entries are sifted out quickly and popular ones
+//settle behind the hand
+//entries live in one slot array of exactly capacity, allocated up front and linked by 32-bit index
+//a hit never relinks: it takes the shared lock and sets the visited bit with a relaxed store,
+//so concurrent readers only share the lock word; put and remove take the lock exclusively
+template<typename Key, typename Value, bool EnableStats = true>
+class SieveCache : public ICachePolicy<Key, Value> {
+private:
+    static const uint32_t NIL = UINT32_MAX;
+
+    struct Slot {
+        Key key{};
+        Value value{};
+        uint32_t newer = NIL;
+        uint32_t older = NIL;
+        atomic<bool> visited{ false };
+    };
+
+    size_t capacity_;
+    shared_mutex mutex_;
+    vector<Slot> slots_;
+    vector<uint32_t> freeSlots_;
+    uint32_t head_;    //newest
+    uint32_t tail_;    //oldest
+    uint32_t hand_;    //next eviction candidate, NIL starts over from the tail
+    unordered_map<Key, uint32_t> index_;
+    StatsRecorder<EnableStats> recorder_;
+
+public:
+    SieveCache() = delete;
+    SieveCache(unsigned int capacity);
+    ~SieveCache() override = default;
+
+    void put(const Key& key, const Value& value) override;
+    optional<Value> get(const Key& key) override;
+    bool remove(const Key& key) override;
+    bool isExists(const Key& key) override;
+    optional<Value> peek(const Key& key) override;
+    CacheStats stats() override;
+
+private:
+    void linkAtHead(uint32_t slot);
+    void unlink(uint32_t slot);
+    uint32_t evict();
+};
+
+template<typename Key, typename Value, bool EnableStats>
+SieveCache<Key, Value, EnableStats>::SieveCache(unsigned int capacity)
+    : capacity_{ capacity }, slots_(capacity), head_{ NIL }, tail_{ NIL }, hand_{ NIL } {
+    //handed out from the front, slot 0 first
+    this->freeSlots_.reserve(capacity);
+    for (uint32_t slot = capacity; slot > 0; --slot)
+        this->freeSlots_.push_back(slot - 1);
+    this->index_.reserve(capacity);
+}
+
+template<typename Key, typename Value, bool EnableStats>
+void SieveCache<Key, Value, EnableStats>::put(const Key& key, const Value& value) {
+    if (this->capacity_ == 0) return;
+    lock_guard<shared_mutex> lock{ this->mutex_ };
+    auto it = this->index_.find(key);
+    if (it != this->index_.end()) {
+        Slot& slot = this->slots_[it->second];
+        this->recorder_.record(StatsCounter::Update);
+        this->recorder_.valueReplaced(slot.value, value);
+        slot.value = value;
+        slot.visited.store(true, memory_order_relaxed);
+        return;
+    }
+    uint32_t slot;
+    if (this->freeSlots_.empty()) {
+        slot = evict();
+    }
+    else {
+        slot = this->freeSlots_.back();
+        this->freeSlots_.pop_back();
+    }
+    this->slots_[slot].key = key;
+    this->slots_[slot].value = value;
+    this->slots_[slot].visited.store(false, memory_order_relaxed);
+    linkAtHead(slot);
+    this->index_.emplace(key, slot);
+    this->recorder_.record(StatsCounter::Put);
+    this->recorder_.entryAdded(key, value);
+}
+
+template<typename Key, typename Value, bool EnableStats>
+optional<Value> SieveCache<Key, Value, EnableStats>::get(const Key& key) {
+    shared_lock<shared_mutex> lock{ this->mutex_ };
+    auto it = this->index_.find(key);
+    if (it == this->index_.end()) {
+        this->recorder_.record(StatsCounter::Miss);
+        return nullopt;
+    }
+    this->recorder_.record(StatsCounter::Hit);
+    Slot& slot = this->slots_[it->second];
+    //a bit already set is not written again, hot slots stay shared between readers' caches
+    if (!slot.visited.load(memory_order_relaxed))
+        slot.visited.store(true, memory_order_relaxed);
+    return slot.value;
+}
+
+template<typename Key, typename Value, bool EnableStats>
+bool SieveCache<Key, Value, EnableStats>::remove(const Key& key) {
+    lock_guard<shared_mutex> lock{ this->mutex_ };
+    auto it = this->index_.find(key);
+    if (it == this->index_.end())
+        return false;
+    const uint32_t slot = it->second;
+    this->recorder_.entryRemoved(key, this->slots_[slot].value);
+    this->index_.erase(it);
+    if (this->hand_ == slot)
+        this->hand_ = this->slots_[slot].newer;
+    unlink(slot);
+    //release what the key and value hold now rather than when the slot is reused
+    this->slots_[slot].key = Key{};
+    this->slots_[slot].value = Value{};
+    this->freeSlots_.push_back(slot);
+    return true;
+}
+
+template<typename Key, typename Value, bool EnableStats>
+bool SieveCache<Key, Value, EnableStats>::isExists(const Key& key) {
+    shared_lock<shared_mutex> lock{ this->mutex_ };
+    return this->index_.find(key) != this->index_.end();
+}
+
+template<typename Key, typename Value, bool EnableStats>
+optional<Value> SieveCache<Key, Value, EnableStats>::peek(const Key& key) {
+    shared_lock<shared_mutex> lock{ this->mutex_ };
+    auto it = this->index_.find(key);
+    if (it == this->index_.end())
+        return nullopt;
+    return this->slots_[it->second].value;
+}
+
+template<typename Key, typename Value, bool EnableStats>
+CacheStats SieveCache<Key, Value, EnableStats>::stats() {
+    shared_lock<shared_mutex> lock{ this->mutex_ };
+    return this->recorder_.collect(this->index_.size());
+}
+
+template<typename Key, typename Value, bool EnableStats>
+void SieveCache<Key, Value, EnableStats>::linkAtHead(uint32_t slot) {
+    this->slots_[slot].newer = NIL;
+    this->slots_[slot].older = this->head_;
+    if (this->head_ != NIL)
+        this->slots_[this->head_].newer = slot;
+    else
+        this->tail_ = slot;
+    this->head_ = slot;
+}
+
+template<typename Key, typename Value, bool EnableStats>
+void SieveCache<Key, Value, EnableStats>::unlink(uint32_t slot) {
+    Slot& entry = this->slots_[slot];
+    if (entry.newer != NIL)
+        this->slots_[entry.newer].older = entry.older;
+    else
+        this->head_ = entry.older;
+    if (entry.older != NIL)
+        this->slots_[entry.older].newer = entry.newer;
+    else
+        this->tail_ = entry.newer;
+    entry.newer = entry.older = NIL;
+}
+
+//returns the freed slot; only called on a full cache, so the hand always finds something within one lap
+template<typename Key, typename Value, bool EnableStats>
+uint32_t SieveCache<Key, Value, EnableStats>::evict() {
+    uint32_t victim = this->hand_ != NIL ? this->hand_ : this->tail_;
+    while (this->slots_[victim].visited.load(memory_order_relaxed)) {
+        this->slots_[victim].visited.store(false, memory_order_relaxed);
+        victim = this->slots_[victim].newer != NIL ? this->slots_[victim].newer : this->tail_;
+    }
+    this->hand_ = this->slots_[victim].newer;
+    Slot& entry = this->slots_[victim];
+    this->index_.erase(entry.key);
+    this->recorder_.record(StatsCounter::Eviction);
+    this->recorder_.entryRemoved(entry.key, entry.value);
+    this->notifyEviction(entry.key, entry.value);
+    unlink(victim);
+    return victim;
+}
@@ -0,0 +1,262 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <memory>
+#include <optional>
+#include <type_traits>
+#include <vector>
+using namespace std;
+
+//the read side of an engine's peek and isExists: a copy of its keys and values in an open-addressing table
+//that readers probe without any lock and validate against a version counter afterwards
+//the engine calls assign/erase/clear under its exclusive lock, so there is one writer at a time; it makes the
+//version odd before it changes a slot and even again after, a reader that saw the same even version before and
+//after its probe read a state some writer left complete
+//the index stays dormant, costing writers nothing, until the engine's first peek or isExists wakes it with a
+//copy of the entries
+//this general version holds nothing and never validates, the engine falls back to its shared lock
+template<typename Key, typename Value, typename Enable = void>
+struct SeqlockIndex {
+    bool dormant() const { return false; }
+    template<typename NodeHash>
+    void wake(const NodeHash&) {}
+    void assign(const Key&, const Value&) {}
+    void erase(const Key&) {}
+    void clear() {}
+    //true when the probe validated, value is then the entry or nullopt
+    bool tryFind(const Key&, optional<Value>&) const { return false; }
+};
+
+//entries are stored as 64-bit atomic words, so a reader racing a writer sees stale words and never a data race;
+//only a trivially copyable key or value can be rebuilt from such words
+//a table is not freed while the index lives: growing publishes one twice the size and keeps the old one for
+//readers still probing it, all tables together stay under twice the live one
+template<typename Key, typename Value>
+struct SeqlockIndex<Key, Value, enable_if_t<is_trivially_copyable<Key>::value && is_trivially_copyable<Value>::value
+    && is_default_constructible<Key>::value && is_default_constructible<Value>::value>> {
+private:
+    static constexpr size_t WORDS = (sizeof(Key) + sizeof(Value) + 7) / 8;
+    static constexpr size_t MIN_SLOTS = 16;
+    //a reader that keeps meeting writers stops retrying and takes the engine's lock
+    static constexpr int MAX_ATTEMPTS = 4;
+
+    struct Slot {
+        atomic<uint64_t> tag;   //0 marks an empty slot, otherwise the key's hash with the low bit set
+        atomic<uint64_t> words[WORDS];
+    };
+
+    struct Table {
+        size_t mask;
+        unique_ptr<Slot[]> slots;
+
+        explicit Table(size_t count) : mask{ count - 1 }, slots{ new Slot[count]() } {}
+    };
+
+    atomic<bool> awake_{ false };
+    atomic<uint64_t> version_{ 0 };
+    atomic<Table*> table_{ nullptr };
+    vector<unique_ptr<Table>> tables_;   //the live table is the last one
+    size_t size_ = 0;
+
+public:
+    SeqlockIndex() {
+        this->tables_.push_back(make_unique<Table>(MIN_SLOTS));
+        this->table_.store(this->tables_.back().get(), memory_order_release);
+    }
+    SeqlockIndex(const SeqlockIndex&) = delete;
+    SeqlockIndex& operator=(const SeqlockIndex&) = delete;
+
+    bool dormant() const { return !this->awake_.load(memory_order_acquire); }
+
+    //called with the engine's exclusive lock held, copies in every entry of a key to node pointer map
+    template<typename NodeHash>
+    void wake(const NodeHash& nodeHash) {
+        if (!dormant())
+            return;
+        for (const auto& pair : nodeHash) {
+            insert(pair.first, pair.second->peekValue());
+        }
+        //readers only probe a table that holds every entry
+        this->awake_.store(true, memory_order_release);
+    }
+
+    //writer side, called with the engine's exclusive lock held
+    void assign(const Key& key, const Value& value) {
+        if (this->awake_.load(memory_order_relaxed))
+            insert(key, value);
+    }
+
+    //backward-shift deletion, so probes never meet a tombstone
+    void erase(const Key& key) {
+        if (!this->awake_.load(memory_order_relaxed))
+            return;
+        Table& table = *this->tables_.back();
+        size_t hole = probe(table, key, tagOf(key));
+        if (table.slots[hole].tag.load(memory_order_relaxed) == 0)
+            return;
+        beginWrite();
+        for (size_t next = (hole + 1) & table.mask; ; next = (next + 1) & table.mask) {
+            const uint64_t tag = table.slots[next].tag.load(memory_order_relaxed);
+            if (tag == 0)
+                break;
+            const size_t wanted = homeOf(tag, table.mask);
+            if (((next - wanted) & table.mask) >= ((next - hole) & table.mask)) {
+                copy(table.slots[hole], table.slots[next]);
+                hole = next;
+            }
+        }
+        table.slots[hole].tag.store(0, memory_order_relaxed);
+        this->size_--;
+        endWrite();
+    }
+
+    void clear() {
+        if (!this->awake_.load(memory_order_relaxed))
+            return;
+        Table& table = *this->tables_.back();
+        beginWrite();
+        for (size_t index = 0; index <= table.mask; ++index) {
+            table.slots[index].tag.store(0, memory_order_relaxed);
+        }
+        this->size_ = 0;
+        endWrite();
+    }
+
+    //lock-free; false when writers kept changing the table, the caller then looks under its lock
+    bool tryFind(const Key& key, optional<Value>& value) const {
+        if (dormant())
+            return false;
+        const uint64_t tag = tagOf(key);
+        for (int attempt = 0; attempt < MAX_ATTEMPTS; ++attempt) {
+            const uint64_t before = this->version_.load(memory_order_acquire);
+            if (before & 1)
+                continue;
+            const Table& table = *this->table_.load(memory_order_acquire);
+            optional<Value> found;
+            //bounded by the table size, a probe through slots being shifted must still end
+            size_t index = homeOf(tag, table.mask);
+            for (size_t step = 0; step <= table.mask; ++step, index = (index + 1) & table.mask) {
+                const uint64_t slotTag = table.slots[index].tag.load(memory_order_relaxed);
+                if (slotTag == 0)
+                    break;
+                if (slotTag == tag && keyOf(table.slots[index]) == key) {
+                    found = valueOf(table.slots[index]);
+                    break;
+                }
+            }
+            //orders the slot loads before the second version load
+            atomic_thread_fence(memory_order_acquire);
+            if (this->version_.load(memory_order_relaxed) == before) {
+                value = found;
+                return true;
+            }
+        }
+        return false;
+    }
+
+private:
+    void insert(const Key& key, const Value& value) {
+        const uint64_t tag = tagOf(key);
+        beginWrite();
+        Table* table = this->tables_.back().get();
+        size_t index = probe(*table, key, tag);
+        if (table->slots[index].tag.load(memory_order_relaxed) == 0) {
+            //kept at most three quarters full so a probe soon ends on an empty slot
+            if ((this->size_ + 1) * 4 > (table->mask + 1) * 3) {
+                grow();
+                table = this->tables_.back().get();
+                index = probe(*table, key, tag);
+            }
+            this->size_++;
+        }
+        store(table->slots[index], tag, key, value);
+        endWrite();
+    }
+
+    //std::hash is the identity for integers, the murmur3 finalizer spreads them over the slots
+    static uint64_t tagOf(const Key& key) {
+        uint64_t h = static_cast<uint64_t>(hash<Key>{}(key));
+        h ^= h >> 33;
+        h *= 0xff51afd7ed558ccdull;
+        h ^= h >> 33;
+        return h | 1;
+    }
+    //the low bit of a tag is always set, the home slot comes from the bits above it
+    static size_t homeOf(uint64_t tag, size_t mask) { return static_cast<size_t>(tag >> 1) & mask; }
+
+    void beginWrite() {
+        this->version_.store(this->version_.load(memory_order_relaxed) + 1, memory_order_relaxed);
+        //keeps the slot stores after the odd version
+        atomic_thread_fence(memory_order_release);
+    }
+    void endWrite() {
+        this->version_.store(this->version_.load(memory_order_relaxed) + 1, memory_order_release);
+    }
+
+    //the slot holding key, or the empty slot where it would go
+    static size_t probe(const Table& table, const Key& key, uint64_t tag) {
+        size_t index = homeOf(tag, table.mask);
+        while (true) {
+            const uint64_t slotTag = table.slots[index].tag.load(memory_order_relaxed);
+            if (slotTag == 0 || (slotTag == tag && keyOf(table.slots[index]) == key))
+                return index;
+            index = (index + 1) & table.mask;
+        }
+    }
+
+    static void store(Slot& slot, uint64_t tag, const Key& key, const Value& value) {
+        uint64_t words[WORDS] = {};
+        memcpy(reinterpret_cast<char*>(words), &key, sizeof(Key));
+        memcpy(reinterpret_cast<char*>(words) + sizeof(Key), &value, sizeof(Value));
+        for (size_t word = 0; word < WORDS; ++word) {
+            slot.words[word].store(words[word], memory_order_relaxed);
+        }
+        slot.tag.store(tag, memory_order_relaxed);
+    }
+
+    static void copy(Slot& to, const Slot& from) {
+        for (size_t word = 0; word < WORDS; ++word) {
+            to.words[word].store(from.words[word].load(memory_order_relaxed), memory_order_relaxed);
+        }
+        to.tag.store(from.tag.load(memory_order_relaxed), memory_order_relaxed);
+    }
+
+    static Key keyOf(const Slot& slot) {
+        uint64_t words[WORDS];
+        for (size_t word = 0; word < WORDS; ++word) {
+            words[word] = slot.words[word].load(memory_order_relaxed);
+        }
+        Key key;
+        memcpy(&key, reinterpret_cast<const char*>(words), sizeof(Key));
+        return key;
+    }
+
+    static Value valueOf(const Slot& slot) {
+        uint64_t words[WORDS];
+        for (size_t word = 0; word < WORDS; ++word) {
+            words[word] = slot.words[word].load(memory_order_relaxed);
+        }
+        Value value;
+        memcpy(&value, reinterpret_cast<const char*>(words) + sizeof(Key), sizeof(Value));
+        return value;
+    }
+
+    //the new table is filled before it is published, readers on the old one keep a complete copy
+    void grow() {
+        const Table& old = *this->tables_.back();
+        auto bigger = make_unique<Table>((old.mask + 1) * 2);
+        for (size_t index = 0; index <= old.mask; ++index) {
+            const uint64_t tag = old.slots[index].tag.load(memory_order_relaxed);
+            if (tag == 0)
+                continue;
+            size_t to = homeOf(tag, bigger->mask);
+            while (bigger->slots[to].tag.load(memory_order_relaxed) != 0)
+                to = (to + 1) & bigger->mask;
+            copy(bigger->slots[to], old.slots[index]);
+        }
+        this->table_.store(bigger.get(), memory_order_release);
+        this->tables_.push_back(move(bigger));
+    }
+};
@@ -0,0 +1,44 @@
+#pragma once
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+using namespace std;
+
+//byte encoding of keys and values for everything that leaves process memory
+//trivially copyable types are stored as raw bytes, strings as a 32-bit length plus bytes
+//add a specialization for any other Key or Value type that needs persisting
+template<typename T, typename Enable = void>
+struct Serializer {
+    static_assert(is_trivially_copyable<T>::value, "Serializer needs a specialization for this type");
+
+    static void append(string& out, const T& value) {
+        out.append(reinterpret_cast<const char*>(&value), sizeof(T));
+    }
+    static T parse(const char*& cursor, const char* end) {
+        if (end - cursor < static_cast<ptrdiff_t>(sizeof(T)))
+            throw runtime_error("In Serializer.h-----Record is truncated.");
+        T value;
+        memcpy(&value, cursor, sizeof(T));
+        cursor += sizeof(T);
+        return value;
+    }
+};
+
+template<>
+struct Serializer<string> {
+    static void append(string& out, const string& value) {
+        uint32_t length = static_cast<uint32_t>(value.size());
+        out.append(reinterpret_cast<const char*>(&length), sizeof(length));
+        out.append(value);
+    }
+    static string parse(const char*& cursor, const char* end) {
+        uint32_t length = Serializer<uint32_t>::parse(cursor, end);
+        if (static_cast<size_t>(end - cursor) < length)
+            throw runtime_error("In Serializer.h-----Record is truncated.");
+        string value{ cursor, length };
+        cursor += length;
+        return value;
+    }
+};
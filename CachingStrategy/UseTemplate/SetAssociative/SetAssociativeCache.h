@@ -0,0 +1,285 @@
+#pragma once
+#include <atomic>
+#include <bit>
+#include <cstdint>
+#include <stdexcept>
+#include <thread>
+#include <type_traits>
+#include <vector>
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define SET_ASSOCIATIVE_AVX2
+#endif
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define SET_ASSOCIATIVE_SSE2
+#endif
+
+#include "../ICachePolicy.h"
+#include "../Stats/StatsRecorder.h"
+
+//keys and values of one set; the general version resets a freed way so a string or vector gives its memory back
+template<typename Key, typename Value, size_t Ways, typename Enable = void>
+struct SetPayload {
+    Key keys[Ways];
+    Value values[Ways];
+
+    void release(size_t way) {
+        this->keys[way] = Key{};
+        this->values[way] = Value{};
+    }
+};
+
+//trivially copyable keys and values own nothing, a way is freed by clearing its tag alone
+template<typename Key, typename Value, size_t Ways>
+struct SetPayload<Key, Value, Ways, enable_if_t<is_trivially_copyable<Key>::value && is_trivially_copyable<Value>::value>> {
+    Key keys[Ways];
+    Value values[Ways];
+
+    void release(size_t) {}
+};
+
+//a hardware-style cache: a key hashes to one set of Ways ways and can only live there, so a lookup reads one
+//set and nothing else, and there is no global order to maintain; the price is conflict misses when a set's keys
+//are hotter than its ways, and LRU only among the ways of a set
+//a set is the first cache line with a 16-bit fingerprint per way (0 marks an empty way), the recency bits and
+//a spin lock, followed by the ways' keys and values; all ways' tags are compared in one SSE2 instruction,
+//one AVX2 instruction for 16 ways, and only a matching way's key is read
+//replacement is bit-PLRU: a way's bit is set when it is used and all other bits are cleared once every bit is
+//set, the victim is the first way whose bit is clear
+//each set has its own lock, so threads only meet when they hash to the same set
+//capacity is rounded up to a whole number of sets
+template<typename Key, typename Value, size_t Ways = 8, bool EnableStats = true>
+class SetAssociativeCache : public ICachePolicy<Key, Value> {
+private:
+    static_assert(Ways == 8 || Ways == 16, "SetAssociativeCache supports 8 or 16 ways");
+    static const uint32_t ALL_WAYS = (1u << Ways) - 1;
+
+    struct alignas(64) Set {
+        uint16_t tags[Ways];
+        uint16_t recent;
+        atomic<bool> locked;
+        SetPayload<Key, Value, Ways> payload;
+    };
+
+    size_t capacity_;
+    vector<Set> sets_;
+    StatsRecorder<EnableStats> recorder_;
+
+public:
+    SetAssociativeCache() = delete;
+    SetAssociativeCache(unsigned int capacity);
+    ~SetAssociativeCache() override = default;
+
+    void put(const Key& key, const Value& value) override;
+    optional<Value> get(const Key& key) override;
+    bool remove(const Key& key) override;
+    bool isExists(const Key& key) override;
+    optional<Value> peek(const Key& key) override;
+    CacheStats stats() override;
+
+    size_t capacity() const { return this->sets_.size() * Ways; }
+
+private:
+    //std::hash is the identity for integers, the murmur3 finalizer gives the set index and the tag
+    //independent bits to draw from
+    static uint64_t mix(const Key& key) {
+        uint64_t h = static_cast<uint64_t>(hash<Key>{}(key));
+        h ^= h >> 33;
+        h *= 0xff51afd7ed558ccdull;
+        h ^= h >> 33;
+        return h;
+    }
+    static uint16_t tagOf(uint64_t h) {
+        const uint16_t tag = static_cast<uint16_t>(h >> 16);
+        return tag == 0 ? 1 : tag;
+    }
+    //one bit per way whose tag equals tag
+    static uint32_t matchTags(const uint16_t* tags, uint16_t tag);
+
+    Set& setOf(uint64_t h) {
+        //multiply-shift maps the top 32 bits onto the set count without a division or a power of two
+        return this->sets_[static_cast<size_t>(((h >> 32) * this->sets_.size()) >> 32)];
+    }
+    static void lock(Set& set);
+    static void unlock(Set& set) { set.locked.store(false, memory_order_release); }
+    //the way holding key, or Ways
+    static size_t find(const Set& set, const Key& key, uint16_t tag);
+    static void touch(Set& set, size_t way);
+};
+
+template<typename Key, typename Value, size_t Ways, bool EnableStats>
+SetAssociativeCache<Key, Value, Ways, EnableStats>::SetAssociativeCache(unsigned int capacity)
+    : capacity_{ capacity }, sets_(max<size_t>(1, (static_cast<size_t>(capacity) + Ways - 1) / Ways)) {
+    if (this->sets_.size() > UINT32_MAX)
+        throw runtime_error("In SetAssociativeCache.h-----More sets than a 32-bit hash can spread over.");
+    for (Set& set : this->sets_) {
+        for (size_t way = 0; way < Ways; ++way)
+            set.tags[way] = 0;
+        set.recent = 0;
+        set.locked.store(false, memory_order_relaxed);
+    }
+}
+
+template<typename Key, typename Value, size_t Ways, bool EnableStats>
+void SetAssociativeCache<Key, Value, Ways, EnableStats>::put(const Key& key, const Value& value) {
+    if (this->capacity_ == 0) return;
+    const uint64_t h = mix(key);
+    const uint16_t tag = tagOf(h);
+    Set& set = setOf(h);
+    lock(set);
+    size_t way = find(set, key, tag);
+    if (way < Ways) {
+        this->recorder_.record(StatsCounter::Update);
+        this->recorder_.valueReplaced(set.payload.values[way], value);
+        set.payload.values[way] = value;
+        touch(set, way);
+        unlock(set);
+        return;
+    }
+
+    const uint32_t empty = matchTags(set.tags, 0);
+    if (empty != 0) {
+        way = static_cast<size_t>(countr_zero(empty));
+    }
+    else {
+        way = static_cast<size_t>(countr_zero(~static_cast<uint32_t>(set.recent) & ALL_WAYS));
+        this->recorder_.record(StatsCounter::Eviction);
+        this->recorder_.entryRemoved(set.payload.keys[way], set.payload.values[way]);
+        this->notifyEviction(set.payload.keys[way], set.payload.values[way]);
+    }
+    set.tags[way] = tag;
+    set.payload.keys[way] = key;
+    set.payload.values[way] = value;
+    touch(set, way);
+    this->recorder_.record(StatsCounter::Put);
+    this->recorder_.entryAdded(key, value);
+    unlock(set);
+}
+
+template<typename Key, typename Value, size_t Ways, bool EnableStats>
+optional<Value> SetAssociativeCache<Key, Value, Ways, EnableStats>::get(const Key& key) {
+    const uint64_t h = mix(key);
+    Set& set = setOf(h);
+    lock(set);
+    const size_t way = find(set, key, tagOf(h));
+    if (way == Ways) {
+        unlock(set);
+        this->recorder_.record(StatsCounter::Miss);
+        return nullopt;
+    }
+    touch(set, way);
+    optional<Value> value{ set.payload.values[way] };
+    unlock(set);
+    this->recorder_.record(StatsCounter::Hit);
+    return value;
+}
+
+template<typename Key, typename Value, size_t Ways, bool EnableStats>
+bool SetAssociativeCache<Key, Value, Ways, EnableStats>::remove(const Key& key) {
+    const uint64_t h = mix(key);
+    Set& set = setOf(h);
+    lock(set);
+    const size_t way = find(set, key, tagOf(h));
+    if (way == Ways) {
+        unlock(set);
+        return false;
+    }
+    this->recorder_.entryRemoved(set.payload.keys[way], set.payload.values[way]);
+    set.tags[way] = 0;
+    set.recent &= static_cast<uint16_t>(~(1u << way));
+    set.payload.release(way);
+    unlock(set);
+    return true;
+}
+
+template<typename Key, typename Value, size_t Ways, bool EnableStats>
+bool SetAssociativeCache<Key, Value, Ways, EnableStats>::isExists(const Key& key) {
+    const uint64_t h = mix(key);
+    Set& set = setOf(h);
+    lock(set);
+    const bool found = find(set, key, tagOf(h)) < Ways;
+    unlock(set);
+    return found;
+}
+
+template<typename Key, typename Value, size_t Ways, bool EnableStats>
+optional<Value> SetAssociativeCache<Key, Value, Ways, EnableStats>::peek(const Key& key) {
+    const uint64_t h = mix(key);
+    Set& set = setOf(h);
+    lock(set);
+    const size_t way = find(set, key, tagOf(h));
+    optional<Value> value;
+    if (way < Ways)
+        value = set.payload.values[way];
+    unlock(set);
+    return value;
+}
+
+//there is no global counter to keep up to date on every put, the size is counted from the tags here
+template<typename Key, typename Value, size_t Ways, bool EnableStats>
+CacheStats SetAssociativeCache<Key, Value, Ways, EnableStats>::stats() {
+    size_t size = 0;
+    for (Set& set : this->sets_) {
+        lock(set);
+        size += Ways - static_cast<size_t>(popcount(matchTags(set.tags, 0)));
+        unlock(set);
+    }
+    return this->recorder_.collect(size);
+}
+
+template<typename Key, typename Value, size_t Ways, bool EnableStats>
+uint32_t SetAssociativeCache<Key, Value, Ways, EnableStats>::matchTags(const uint16_t* tags, uint16_t tag) {
+#if defined(SET_ASSOCIATIVE_AVX2)
+    if constexpr (Ways == 16) {
+        const __m256i equal = _mm256_cmpeq_epi16(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(tags)), _mm256_set1_epi16(static_cast<short>(tag)));
+        //16-bit lanes give two mask bits each, packing to bytes leaves one per way
+        const __m128i packed = _mm_packs_epi16(_mm256_castsi256_si128(equal), _mm256_extracti128_si256(equal, 1));
+        return static_cast<uint32_t>(_mm_movemask_epi8(packed));
+    }
+#endif
+#if defined(SET_ASSOCIATIVE_SSE2)
+    const __m128i wanted = _mm_set1_epi16(static_cast<short>(tag));
+    const __m128i low = _mm_cmpeq_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i*>(tags)), wanted);
+    const __m128i high = Ways == 16 ? _mm_cmpeq_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i*>(tags + 8)), wanted) : _mm_setzero_si128();
+    return static_cast<uint32_t>(_mm_movemask_epi8(_mm_packs_epi16(low, high)));
+#else
+    uint32_t mask = 0;
+    for (size_t way = 0; way < Ways; ++way) {
+        if (tags[way] == tag)
+            mask |= 1u << way;
+    }
+    return mask;
+#endif
+}
+
+//sets are small and held for a few dozen instructions, a waiter spins briefly and then gives up its time slice
+template<typename Key, typename Value, size_t Ways, bool EnableStats>
+void SetAssociativeCache<Key, Value, Ways, EnableStats>::lock(Set& set) {
+    while (set.locked.exchange(true, memory_order_acquire)) {
+        //wait on a plain load, the line stays shared until the holder writes it
+        for (unsigned int spins = 0; set.locked.load(memory_order_relaxed); ++spins) {
+            if (spins >= 64)
+                this_thread::yield();
+        }
+    }
+}
+
+template<typename Key, typename Value, size_t Ways, bool EnableStats>
+size_t SetAssociativeCache<Key, Value, Ways, EnableStats>::find(const Set& set, const Key& key, uint16_t tag) {
+    //a 16-bit fingerprint rarely matches a stranger, the key compare settles it
+    for (uint32_t candidates = matchTags(set.tags, tag); candidates != 0; candidates &= candidates - 1) {
+        const size_t way = static_cast<size_t>(countr_zero(candidates));
+        if (set.payload.keys[way] == key)
+            return way;
+    }
+    return Ways;
+}
+
+template<typename Key, typename Value, size_t Ways, bool EnableStats>
+void SetAssociativeCache<Key, Value, Ways, EnableStats>::touch(Set& set, size_t way) {
+    uint32_t recent = set.recent | (1u << way);
+    if (recent == ALL_WAYS)
+        recent = 1u << way;
+    set.recent = static_cast<uint16_t>(recent);
+}
@@ -0,0 +1,138 @@
+#pragma once
+#include <algorithm>
+#include <cstdint>
+#include <exception>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "TraceReader.h"
+#include "../CachePolicyFactory.h"
+using namespace std;
+
+//misses of one policy at one capacity over a whole trace
+struct SimulationResult {
+    string policy;
+    unsigned int capacity;
+    uint64_t requests;
+    uint64_t misses;
+    uint64_t bytes;          //sum of request sizes
+    uint64_t missBytes;
+
+    double missRatio() const { return this->requests == 0 ? 0.0 : static_cast<double>(this->misses) / this->requests; }
+    double byteMissRatio() const { return this->bytes == 0 ? 0.0 : static_cast<double>(this->missBytes) / this->bytes; }
+};
+
+//replays one mapped trace through every policy x capacity pair: a request is a get(), and a put() of its size
+//when it missed; engines are built without statistics and counted here instead
+//pairs are dealt round-robin to the worker threads, each worker streams the trace once with its own
+//cursor and feeds every pair it owns, so the trace is never held in memory and workers share the page cache
+class CacheSimulator {
+private:
+    using Engine = ICachePolicy<uint64_t, uint32_t>;
+
+    string path_;
+    MappedFile file_;
+    TraceFormat format_;
+    unsigned int keyColumn_;
+    unsigned int sizeColumn_;
+
+public:
+    CacheSimulator(const string& path, TraceFormat format = TraceFormat::Auto, unsigned int keyColumn = 0, unsigned int sizeColumn = 1);
+
+    TraceFormat format() const { return this->format_; }
+    //workers == 0 runs one thread per pair
+    vector<SimulationResult> run(const vector<string>& policies, const vector<unsigned int>& capacities, unsigned int workers = 0);
+    //rewrites the trace in the binary format, returns the number of requests
+    uint64_t convert(const string& binaryPath);
+
+private:
+    void replay(vector<unique_ptr<Engine>>& engines, vector<SimulationResult*>& results);
+};
+
+inline CacheSimulator::CacheSimulator(const string& path, TraceFormat format, unsigned int keyColumn, unsigned int sizeColumn)
+    : path_{ path }, file_{ path }, format_{ format }, keyColumn_{ keyColumn }, sizeColumn_{ sizeColumn } {
+    if (this->format_ == TraceFormat::Auto)
+        this->format_ = TraceReader::detect(this->file_, path);
+    //fail on a bad header here rather than in every worker
+    TraceReader probe{ this->file_, this->format_, this->keyColumn_, this->sizeColumn_ };
+}
+
+inline vector<SimulationResult> CacheSimulator::run(const vector<string>& policies, const vector<unsigned int>& capacities, unsigned int workers) {
+    vector<SimulationResult> results;
+    for (unsigned int capacity : capacities) {
+        for (const string& policy : policies)
+            results.push_back(SimulationResult{ policy, capacity, 0, 0, 0, 0 });
+    }
+    if (results.empty())
+        return results;
+    if (workers == 0 || workers > results.size())
+        workers = static_cast<unsigned int>(results.size());
+
+    //engines are built up front so an unknown policy fails before any thread starts
+    vector<vector<unique_ptr<Engine>>> engines(workers);
+    vector<vector<SimulationResult*>> owned(workers);
+    for (size_t i = 0; i < results.size(); ++i) {
+        engines[i % workers].push_back(makeCachePolicy<uint64_t, uint32_t, false>(results[i].policy, results[i].capacity));
+        owned[i % workers].push_back(&results[i]);
+    }
+
+    vector<exception_ptr> errors(workers);
+    vector<thread> threads;
+    for (unsigned int w = 0; w < workers; ++w) {
+        threads.emplace_back([this, w, &engines, &owned, &errors]() {
+            try {
+                replay(engines[w], owned[w]);
+            }
+            catch (...) {
+                errors[w] = current_exception();
+            }
+        });
+    }
+    for (thread& worker : threads)
+        worker.join();
+    for (const exception_ptr& error : errors) {
+        if (error)
+            rethrow_exception(error);
+    }
+    return results;
+}
+
+//counts into a private copy, neighbouring results belong to other workers and would share cache lines
+inline void CacheSimulator::replay(vector<unique_ptr<Engine>>& engines, vector<SimulationResult*>& results) {
+    vector<SimulationResult> local;
+    for (SimulationResult* result : results)
+        local.push_back(*result);
+    TraceReader reader{ this->file_, this->format_, this->keyColumn_, this->sizeColumn_ };
+    TraceRecord record;
+    while (reader.next(record)) {
+        for (size_t i = 0; i < engines.size(); ++i) {
+            SimulationResult& result = local[i];
+            ++result.requests;
+            result.bytes += record.size;
+            if (engines[i]->get(record.key))
+                continue;
+            ++result.misses;
+            result.missBytes += record.size;
+            engines[i]->put(record.key, record.size);
+        }
+    }
+    for (size_t i = 0; i < results.size(); ++i)
+        *results[i] = local[i];
+}
+
+inline uint64_t CacheSimulator::convert(const string& binaryPath) {
+    if (binaryPath == this->path_)
+        throw runtime_error("In CacheSimulator.h-----Cannot convert a trace onto itself");
+    TraceReader reader{ this->file_, this->format_, this->keyColumn_, this->sizeColumn_ };
+    TraceWriter writer{ binaryPath };
+    TraceRecord record;
+    uint64_t count = 0;
+    while (reader.next(record)) {
+        writer.write(record);
+        ++count;
+    }
+    writer.close();
+    return count;
+}
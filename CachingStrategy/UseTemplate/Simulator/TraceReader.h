@@ -0,0 +1,242 @@
+#pragma once
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+#include <string>
+
+#include "../Snapshot/MappedFile.h"
+using namespace std;
+
+//one request of an access trace; size is 1 when the format carries none
+struct TraceRecord {
+    uint64_t key;
+    uint32_t size;
+};
+
+enum class TraceFormat {
+    Auto,     //binary when the magic matches, csv for *.csv, text otherwise
+    Text,     //one key per line
+    Csv,      //comma separated, key and size taken from configurable columns, a non-numeric header line is skipped
+    Binary    //[TraceHeader][key u64, size u32]..., little endian, 12 bytes per request
+};
+
+struct TraceHeader {
+    static const uint32_t MAGIC = 0x43525443;   //"CTRC"
+    static const uint16_t TRACE_VERSION = 1;
+    static const uint16_t RECORD_SIZE = 12;
+
+    uint32_t magic;
+    uint16_t version;
+    uint16_t recordSize;
+};
+static_assert(sizeof(TraceHeader) == 8, "TraceHeader must keep its on-disk size");
+
+//forward-only cursor over a mapped trace, any number of cursors may share one MappedFile
+//nothing is copied out of the mapping, so memory stays flat however large the trace is
+//text keys that are plain decimal numbers are used as they are, anything else is hashed with FNV-1a
+class TraceReader {
+private:
+    const char* cursor_;
+    const char* end_;
+    TraceFormat format_;
+    unsigned int keyColumn_;
+    unsigned int sizeColumn_;
+    uint64_t line_;
+
+public:
+    TraceReader(const MappedFile& file, TraceFormat format, unsigned int keyColumn = 0, unsigned int sizeColumn = 1);
+
+    bool next(TraceRecord& record);
+
+    static TraceFormat detect(const MappedFile& file, const string& path);
+    static uint64_t keyOf(const char* begin, const char* end);
+
+private:
+    bool nextLine(const char*& begin, const char*& end);
+    bool nextCsv(TraceRecord& record);
+};
+
+//writes the binary format, used to convert text and csv traces once so later replays skip the parsing
+class TraceWriter {
+private:
+    static const size_t FLUSH_SIZE = 1 << 20;
+
+    string path_;
+    ofstream file_;
+    string buffer_;
+
+public:
+    TraceWriter(const string& path);
+    TraceWriter(const TraceWriter&) = delete;
+    TraceWriter& operator=(const TraceWriter&) = delete;
+    ~TraceWriter();
+
+    void write(const TraceRecord& record);
+    void close();
+};
+
+inline TraceReader::TraceReader(const MappedFile& file, TraceFormat format, unsigned int keyColumn, unsigned int sizeColumn)
+    : cursor_{ file.data() }, end_{ file.data() + file.size() }, format_{ format }, keyColumn_{ keyColumn },
+    sizeColumn_{ sizeColumn }, line_{ 0 } {
+    if (this->format_ == TraceFormat::Auto)
+        throw runtime_error("In TraceReader.h-----Resolve TraceFormat::Auto with detect() first");
+    if (this->format_ != TraceFormat::Binary)
+        return;
+    TraceHeader header{};
+    if (file.size() < sizeof(TraceHeader))
+        throw runtime_error("In TraceReader.h-----Binary trace is shorter than its header");
+    memcpy(&header, this->cursor_, sizeof(TraceHeader));
+    if (header.magic != TraceHeader::MAGIC || header.version != TraceHeader::TRACE_VERSION || header.recordSize != TraceHeader::RECORD_SIZE)
+        throw runtime_error("In TraceReader.h-----Not a version 1 binary trace");
+    if ((file.size() - sizeof(TraceHeader)) % TraceHeader::RECORD_SIZE != 0)
+        throw runtime_error("In TraceReader.h-----Binary trace ends in the middle of a record");
+    this->cursor_ += sizeof(TraceHeader);
+}
+
+inline TraceFormat TraceReader::detect(const MappedFile& file, const string& path) {
+    if (file.size() >= sizeof(TraceHeader)) {
+        uint32_t magic = 0;
+        memcpy(&magic, file.data(), sizeof(magic));
+        if (magic == TraceHeader::MAGIC)
+            return TraceFormat::Binary;
+    }
+    if (path.size() >= 4 && path.compare(path.size() - 4, 4, ".csv") == 0)
+        return TraceFormat::Csv;
+    return TraceFormat::Text;
+}
+
+inline uint64_t TraceReader::keyOf(const char* begin, const char* end) {
+    //up to 19 digits always fits in 64 bits
+    if (end > begin && end - begin <= 19) {
+        uint64_t number = 0;
+        const char* it = begin;
+        for (; it != end && *it >= '0' && *it <= '9'; ++it)
+            number = number * 10 + static_cast<uint64_t>(*it - '0');
+        if (it == end)
+            return number;
+    }
+    uint64_t hash = 14695981039346656037ull;
+    for (const char* it = begin; it != end; ++it) {
+        hash ^= static_cast<unsigned char>(*it);
+        hash *= 1099511628211ull;
+    }
+    return hash;
+}
+
+inline bool TraceReader::next(TraceRecord& record) {
+    switch (this->format_) {
+    case TraceFormat::Binary:
+        if (this->cursor_ == this->end_)
+            return false;
+        memcpy(&record.key, this->cursor_, sizeof(uint64_t));
+        memcpy(&record.size, this->cursor_ + sizeof(uint64_t), sizeof(uint32_t));
+        this->cursor_ += TraceHeader::RECORD_SIZE;
+        return true;
+    case TraceFormat::Csv:
+        return nextCsv(record);
+    default: {
+        const char* begin;
+        const char* end;
+        if (!nextLine(begin, end))
+            return false;
+        record.key = keyOf(begin, end);
+        record.size = 1;
+        return true;
+    }
+    }
+}
+
+//skips blank lines and strips a trailing \r
+inline bool TraceReader::nextLine(const char*& begin, const char*& end) {
+    while (this->cursor_ != this->end_) {
+        begin = this->cursor_;
+        const char* newline = static_cast<const char*>(memchr(begin, '\n', static_cast<size_t>(this->end_ - begin)));
+        end = newline ? newline : this->end_;
+        this->cursor_ = newline ? newline + 1 : this->end_;
+        ++this->line_;
+        if (end != begin && end[-1] == '\r')
+            --end;
+        if (end != begin)
+            return true;
+    }
+    return false;
+}
+
+inline bool TraceReader::nextCsv(TraceRecord& record) {
+    const char* begin;
+    const char* end;
+    while (nextLine(begin, end)) {
+        const char* keyBegin = nullptr;
+        const char* keyEnd = nullptr;
+        const char* sizeBegin = nullptr;
+        const char* sizeEnd = nullptr;
+        unsigned int column = 0;
+        for (const char* field = begin; field <= end; ++column) {
+            const char* comma = static_cast<const char*>(memchr(field, ',', static_cast<size_t>(end - field)));
+            const char* fieldEnd = comma ? comma : end;
+            if (column == this->keyColumn_) {
+                keyBegin = field;
+                keyEnd = fieldEnd;
+            }
+            if (column == this->sizeColumn_) {
+                sizeBegin = field;
+                sizeEnd = fieldEnd;
+            }
+            if (!comma)
+                break;
+            field = comma + 1;
+        }
+        if (!keyBegin || !sizeBegin)
+            throw runtime_error("In TraceReader.h-----Line " + to_string(this->line_) + " has too few columns");
+        uint64_t size = 0;
+        const char* it = sizeBegin;
+        for (; it != sizeEnd && *it >= '0' && *it <= '9'; ++it)
+            size = size * 10 + static_cast<uint64_t>(*it - '0');
+        if (it != sizeEnd || sizeBegin == sizeEnd || size > UINT32_MAX) {
+            if (this->line_ == 1)
+                continue;   //header line
+            throw runtime_error("In TraceReader.h-----Line " + to_string(this->line_) + " has no valid size");
+        }
+        record.key = keyOf(keyBegin, keyEnd);
+        record.size = static_cast<uint32_t>(size);
+        return true;
+    }
+    return false;
+}
+
+inline TraceWriter::TraceWriter(const string& path) : path_{ path }, file_{ path, ios::binary | ios::trunc } {
+    if (!this->file_)
+        throw runtime_error("In TraceReader.h-----Cannot create " + path);
+    const TraceHeader header{ TraceHeader::MAGIC, TraceHeader::TRACE_VERSION, TraceHeader::RECORD_SIZE };
+    this->buffer_.append(reinterpret_cast<const char*>(&header), sizeof(header));
+}
+
+inline TraceWriter::~TraceWriter() {
+    //close() reports errors, the destructor has to swallow them
+    try {
+        close();
+    }
+    catch (...) {}
+}
+
+inline void TraceWriter::write(const TraceRecord& record) {
+    char bytes[TraceHeader::RECORD_SIZE];
+    memcpy(bytes, &record.key, sizeof(uint64_t));
+    memcpy(bytes + sizeof(uint64_t), &record.size, sizeof(uint32_t));
+    this->buffer_.append(bytes, sizeof(bytes));
+    if (this->buffer_.size() >= FLUSH_SIZE) {
+        this->file_.write(this->buffer_.data(), static_cast<streamsize>(this->buffer_.size()));
+        this->buffer_.clear();
+    }
+}
+
+inline void TraceWriter::close() {
+    if (!this->file_.is_open())
+        return;
+    this->file_.write(this->buffer_.data(), static_cast<streamsize>(this->buffer_.size()));
+    this->buffer_.clear();
+    this->file_.close();
+    if (this->file_.fail())
+        throw runtime_error("In TraceReader.h-----Cannot write " + this->path_);
+}
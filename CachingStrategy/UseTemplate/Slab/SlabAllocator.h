@@ -0,0 +1,217 @@
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <stdexcept>
+#include <string>
+#include <vector>
+using namespace std;
+
+struct SlabClassStats {
+    size_t chunkSize;
+    size_t chunksUsed;
+    size_t chunksTotal;
+    size_t requestedBytes;        //what callers asked for, chunksUsed * chunkSize minus this is internal fragmentation
+    size_t failedAllocations;     //requests refused because the memory limit was reached, i.e. eviction pressure
+};
+
+//memcached-style slab allocator
+//requests are rounded up to the next size class (each class growthFactor times the previous one),
+//every class carves its chunks out of slabs of slabSize bytes and keeps freed chunks on a free list
+//slabs are never handed back, memory moves between classes only through eviction
+//requests above the largest class go straight to operator new
+//when memoryLimit is set an allocation that needs a new slab beyond it throws bad_alloc and counts
+//as pressure on its class, so the cache can evict inside that class instead of globally
+class SlabAllocator {
+private:
+    struct SizeClass {
+        size_t chunkSize;
+        mutex mutex_;
+        void* freeList = nullptr;   //chunks link through their first word
+        vector<void*> slabs;
+        size_t chunksUsed = 0;
+        size_t chunksTotal = 0;
+        size_t requestedBytes = 0;
+        size_t failedAllocations = 0;
+    };
+
+    size_t slabSize_;
+    vector<unique_ptr<SizeClass>> classes_;
+    vector<size_t> chunkSizes_;
+    vector<uint16_t> classByWords_;   //class index for every request size in 8-byte steps, saves a search per call
+    atomic<size_t> memoryLimit_;
+    atomic<size_t> slabBytes_;
+    atomic<size_t> largeBytes_;
+
+public:
+    SlabAllocator(size_t minChunk = 48, size_t maxChunk = 512 * 1024, double growthFactor = 1.25,
+        size_t slabSize = 1 << 20, size_t memoryLimit = 0);
+    SlabAllocator(const SlabAllocator&) = delete;
+    SlabAllocator& operator=(const SlabAllocator&) = delete;
+    ~SlabAllocator();
+
+    //shared by every SlabAllocatorAdapter that was not given an allocator explicitly
+    static SlabAllocator& defaultInstance();
+
+    void* allocate(size_t bytes);
+    void deallocate(void* pointer, size_t bytes);
+
+    //index of the class serving requests of this size, classCount() for requests too large for any class
+    size_t classOf(size_t bytes) const;
+    size_t classCount() const { return this->classes_.size(); }
+    vector<SlabClassStats> getClassStats();
+    size_t getSlabBytes() const { return this->slabBytes_.load(); }
+    //0 means unlimited
+    void setMemoryLimit(size_t bytes) { this->memoryLimit_ = bytes; }
+
+private:
+    bool growClass(SizeClass& sizeClass);
+};
+
+inline SlabAllocator::SlabAllocator(size_t minChunk, size_t maxChunk, double growthFactor, size_t slabSize, size_t memoryLimit)
+    : slabSize_{ slabSize }, memoryLimit_{ memoryLimit }, slabBytes_{ 0 }, largeBytes_{ 0 } {
+    if (growthFactor <= 1.0)
+        throw invalid_argument("In SlabAllocator.h-----Growth factor must be greater than 1.");
+    if (maxChunk > slabSize)
+        throw invalid_argument("In SlabAllocator.h-----The largest chunk must fit in a slab.");
+    //8-byte aligned chunks, at least one pointer wide for the free list
+    size_t size = max<size_t>((minChunk + 7) & ~static_cast<size_t>(7), sizeof(void*));
+    while (true) {
+        this->chunkSizes_.push_back(size);
+        if (size >= maxChunk)
+            break;
+        size_t next = (static_cast<size_t>(size * growthFactor) + 7) & ~static_cast<size_t>(7);
+        size = min(max(next, size + 8), maxChunk);
+    }
+    if (this->chunkSizes_.size() >= UINT16_MAX)
+        throw invalid_argument("In SlabAllocator.h-----Too many size classes.");
+    for (size_t chunkSize : this->chunkSizes_) {
+        this->classes_.push_back(make_unique<SizeClass>());
+        this->classes_.back()->chunkSize = chunkSize;
+    }
+    this->classByWords_.resize(this->chunkSizes_.back() / 8 + 1);
+    size_t index = 0;
+    for (size_t words = 0; words < this->classByWords_.size(); ++words) {
+        while (this->chunkSizes_[index] < words * 8)
+            index++;
+        this->classByWords_[words] = static_cast<uint16_t>(index);
+    }
+}
+
+inline SlabAllocator::~SlabAllocator() {
+    for (auto& sizeClass : this->classes_) {
+        for (void* slab : sizeClass->slabs)
+            ::operator delete(slab);
+    }
+}
+
+inline SlabAllocator& SlabAllocator::defaultInstance() {
+    static SlabAllocator instance;
+    return instance;
+}
+
+inline void* SlabAllocator::allocate(size_t bytes) {
+    const size_t index = classOf(bytes);
+    if (index == this->classes_.size()) {
+        this->largeBytes_ += bytes;
+        return ::operator new(bytes);
+    }
+    SizeClass& sizeClass = *this->classes_[index];
+    lock_guard<mutex> lock{ sizeClass.mutex_ };
+    if (!sizeClass.freeList && !growClass(sizeClass)) {
+        sizeClass.failedAllocations++;
+        throw bad_alloc();
+    }
+    void* chunk = sizeClass.freeList;
+    sizeClass.freeList = *static_cast<void**>(chunk);
+    sizeClass.chunksUsed++;
+    sizeClass.requestedBytes += bytes;
+    return chunk;
+}
+
+inline void SlabAllocator::deallocate(void* pointer, size_t bytes) {
+    if (!pointer)
+        return;
+    const size_t index = classOf(bytes);
+    if (index == this->classes_.size()) {
+        this->largeBytes_ -= bytes;
+        ::operator delete(pointer);
+        return;
+    }
+    SizeClass& sizeClass = *this->classes_[index];
+    lock_guard<mutex> lock{ sizeClass.mutex_ };
+    *static_cast<void**>(pointer) = sizeClass.freeList;
+    sizeClass.freeList = pointer;
+    sizeClass.chunksUsed--;
+    sizeClass.requestedBytes -= bytes;
+}
+
+inline size_t SlabAllocator::classOf(size_t bytes) const {
+    const size_t words = (bytes + 7) / 8;
+    return words < this->classByWords_.size() ? this->classByWords_[words] : this->classes_.size();
+}
+
+inline vector<SlabClassStats> SlabAllocator::getClassStats() {
+    vector<SlabClassStats> stats;
+    for (auto& sizeClass : this->classes_) {
+        lock_guard<mutex> lock{ sizeClass->mutex_ };
+        stats.push_back(SlabClassStats{ sizeClass->chunkSize, sizeClass->chunksUsed, sizeClass->chunksTotal,
+            sizeClass->requestedBytes, sizeClass->failedAllocations });
+    }
+    return stats;
+}
+
+//class mutex held
+inline bool SlabAllocator::growClass(SizeClass& sizeClass) {
+    const size_t limit = this->memoryLimit_.load();
+    size_t current = this->slabBytes_.load();
+    do {
+        if (limit != 0 && current + this->slabSize_ > limit)
+            return false;
+    } while (!this->slabBytes_.compare_exchange_weak(current, current + this->slabSize_));
+
+    char* slab = static_cast<char*>(::operator new(this->slabSize_));
+    sizeClass.slabs.push_back(slab);
+    const size_t chunks = this->slabSize_ / sizeClass.chunkSize;
+    //thread the new chunks onto the free list in address order
+    for (size_t i = chunks; i > 0; --i) {
+        char* chunk = slab + (i - 1) * sizeClass.chunkSize;
+        *reinterpret_cast<void**>(chunk) = sizeClass.freeList;
+        sizeClass.freeList = chunk;
+    }
+    sizeClass.chunksTotal += chunks;
+    return true;
+}
+
+//STL allocator over a SlabAllocator, so containers (strings above all) keep their bytes in slabs
+template<typename T>
+class SlabAllocatorAdapter {
+public:
+    using value_type = T;
+    template<typename U>
+    friend class SlabAllocatorAdapter;
+
+private:
+    SlabAllocator* slab_;
+
+public:
+    SlabAllocatorAdapter() noexcept : slab_{ &SlabAllocator::defaultInstance() } {}
+    SlabAllocatorAdapter(SlabAllocator& slab) noexcept : slab_{ &slab } {}
+    template<typename U>
+    SlabAllocatorAdapter(const SlabAllocatorAdapter<U>& other) noexcept : slab_{ other.slab_ } {}
+
+    T* allocate(size_t count) { return static_cast<T*>(this->slab_->allocate(count * sizeof(T))); }
+    void deallocate(T* pointer, size_t count) noexcept { this->slab_->deallocate(pointer, count * sizeof(T)); }
+    SlabAllocator& slab() const { return *this->slab_; }
+
+    template<typename U>
+    bool operator==(const SlabAllocatorAdapter<U>& other) const noexcept { return this->slab_ == other.slab_; }
+    template<typename U>
+    bool operator!=(const SlabAllocatorAdapter<U>& other) const noexcept { return this->slab_ != other.slab_; }
+};
+
+using SlabString = basic_string<char, char_traits<char>, SlabAllocatorAdapter<char>>;
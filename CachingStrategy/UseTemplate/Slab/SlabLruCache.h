@@ -0,0 +1,57 @@
+#pragma once
+#include <atomic>
+
+#include "SlabAllocator.h"
+#include "../LRU/LruCache.h"
+
+//LruCache over slab-allocated strings
+//when the allocator refuses a chunk because its memory limit is reached, the least recent entry
+//whose value sits in the same size class is evicted and the put retried, which frees exactly the
+//kind of chunk that is missing; if this cache holds nothing of that class the put throws bad_alloc,
+//like memcached refusing a store for a class that owns no slabs
+//values should be built with the same SlabAllocator, e.g. SlabString{ text, SlabAllocatorAdapter<char>{ slab } }
+template<typename Key>
+class SlabLruCache : public LruCache<Key, SlabString> {
+private:
+    SlabAllocator& slab_;
+    size_t inlineCapacity_;        //strings this short never allocate
+    atomic<size_t> classEvictions_;
+
+public:
+    SlabLruCache(unsigned int capacity, SlabAllocator& slab = SlabAllocator::defaultInstance());
+    ~SlabLruCache() override = default;
+
+    void put(const Key& key, const SlabString& value) override;
+    size_t getClassEvictions() { return this->classEvictions_.load(); }
+};
+
+template<typename Key>
+SlabLruCache<Key>::SlabLruCache(unsigned int capacity, SlabAllocator& slab)
+    : LruCache<Key, SlabString>{ capacity }, slab_{ slab },
+    inlineCapacity_{ SlabString{ SlabAllocatorAdapter<char>{ slab } }.capacity() }, classEvictions_{ 0 } {}
+
+template<typename Key>
+void SlabLruCache<Key>::put(const Key& key, const SlabString& value) {
+    //a copy allocates size + 1 bytes, that decides the class it competes in
+    const size_t needed = this->slab_.classOf(value.size() + 1);
+    while (true) {
+        try {
+            LruCache<Key, SlabString>::put(key, value);
+            return;
+        }
+        catch (const bad_alloc&) {
+            //oversized values come from operator new, there is no class to make room in
+            if (needed == this->slab_.classCount())
+                throw;
+        }
+        const size_t inlineCapacity = this->inlineCapacity_;
+        SlabAllocator& slab = this->slab_;
+        bool evicted = this->evictIf([&slab, inlineCapacity, needed](const Key&, const SlabString& stored) {
+            return stored.capacity() > inlineCapacity && slab.classOf(stored.capacity() + 1) == needed;
+        });
+        //slabs never move between classes, evicting other classes would not free a chunk here
+        if (!evicted)
+            throw bad_alloc();
+        this->classEvictions_++;
+    }
+}
@@ -0,0 +1,103 @@
+#pragma once
+#include <cstddef>
+#include <stdexcept>
+#include <string>
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+using namespace std;
+
+//read-only view of a whole file, the pages are loaded by the OS on first touch
+class MappedFile {
+private:
+    const char* data_;
+    size_t size_;
+#ifdef _WIN32
+    HANDLE file_;
+    HANDLE mapping_;
+#else
+    int fd_;
+#endif
+
+public:
+    MappedFile() = delete;
+    MappedFile(const string& path);
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+    ~MappedFile();
+
+    const char* data() const { return this->data_; }
+    size_t size() const { return this->size_; }
+};
+
+#ifdef _WIN32
+inline MappedFile::MappedFile(const string& path) : data_{ nullptr }, size_{ 0 }, file_{ INVALID_HANDLE_VALUE }, mapping_{ nullptr } {
+    this->file_ = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+    if (this->file_ == INVALID_HANDLE_VALUE)
+        throw runtime_error("In MappedFile.h-----Cannot open " + path);
+    LARGE_INTEGER fileSize;
+    if (!GetFileSizeEx(this->file_, &fileSize)) {
+        CloseHandle(this->file_);
+        throw runtime_error("In MappedFile.h-----Cannot stat " + path);
+    }
+    this->size_ = static_cast<size_t>(fileSize.QuadPart);
+    if (this->size_ == 0)
+        return;
+    this->mapping_ = CreateFileMappingA(this->file_, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if (this->mapping_)
+        this->data_ = static_cast<const char*>(MapViewOfFile(this->mapping_, FILE_MAP_READ, 0, 0, 0));
+    if (!this->data_) {
+        if (this->mapping_)
+            CloseHandle(this->mapping_);
+        CloseHandle(this->file_);
+        throw runtime_error("In MappedFile.h-----Cannot map " + path);
+    }
+}
+
+inline MappedFile::~MappedFile() {
+    if (this->data_)
+        UnmapViewOfFile(this->data_);
+    if (this->mapping_)
+        CloseHandle(this->mapping_);
+    CloseHandle(this->file_);
+}
+#else
+inline MappedFile::MappedFile(const string& path) : data_{ nullptr }, size_{ 0 }, fd_{ -1 } {
+    this->fd_ = open(path.c_str(), O_RDONLY);
+    if (this->fd_ < 0)
+        throw runtime_error("In MappedFile.h-----Cannot open " + path);
+    struct stat fileStat;
+    if (fstat(this->fd_, &fileStat) != 0) {
+        close(this->fd_);
+        throw runtime_error("In MappedFile.h-----Cannot stat " + path);
+    }
+    this->size_ = static_cast<size_t>(fileStat.st_size);
+    if (this->size_ == 0)
+        return;
+    void* mapped = mmap(nullptr, this->size_, PROT_READ, MAP_PRIVATE, this->fd_, 0);
+    if (mapped == MAP_FAILED) {
+        close(this->fd_);
+        throw runtime_error("In MappedFile.h-----Cannot map " + path);
+    }
+    //restores read front to back, let the kernel read ahead aggressively
+    madvise(mapped, this->size_, MADV_SEQUENTIAL);
+    this->data_ = static_cast<const char*>(mapped);
+}
+
+inline MappedFile::~MappedFile() {
+    if (this->data_)
+        munmap(const_cast<char*>(this->data_), this->size_);
+    close(this->fd_);
+}
+#endif
@@ -0,0 +1,195 @@
+#pragma once
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+
+#include "MappedFile.h"
+#include "../Serializer.h"
+
+//on-disk layout of a cache snapshot
+//  [SnapshotHeader][body]
+//the body is a flat stream of Serializer records written by the engine's saveTo() and read back
+//in the same order by loadFrom(); it carries no per-record framing, so for trivially copyable
+//keys and values restoring is a run of memcpy calls straight out of the mapping
+//bump SNAPSHOT_VERSION whenever any engine changes what it writes
+enum class SnapshotEngine : uint16_t {
+    Lru = 1,
+    SliceLru = 2,
+    Lfu = 3,
+    AgingLfu = 4,
+    ArcLru = 5,
+    ArcLfu = 6,
+    Arc = 7,
+};
+
+struct SnapshotHeader {
+    static const uint32_t MAGIC = 0x504e5343;   //"CSNP"
+    static const uint16_t SNAPSHOT_VERSION = 1;
+
+    uint32_t magic;
+    uint16_t version;
+    uint16_t engine;
+    uint32_t keySize;     //sizeof(Key) for raw-byte keys, 0 for variable length ones
+    uint32_t valueSize;
+    uint64_t bodyLength;  //written last, a crash mid-snapshot leaves a file that fails this check
+
+    template<typename Key, typename Value>
+    static SnapshotHeader of(SnapshotEngine engine) {
+        return SnapshotHeader{ MAGIC, SNAPSHOT_VERSION, static_cast<uint16_t>(engine),
+            fixedSizeOf<Key>(), fixedSizeOf<Value>(), 0 };
+    }
+
+private:
+    template<typename T>
+    static uint32_t fixedSizeOf() { return is_trivially_copyable<T>::value ? static_cast<uint32_t>(sizeof(T)) : 0; }
+};
+static_assert(sizeof(SnapshotHeader) == 24, "SnapshotHeader must keep its on-disk size");
+
+//streams the body to path.tmp, syncs it and renames it over path on commit() in one atomic replace,
+//then syncs the directory, so a reader or a crash sees either the old snapshot or the new one, never a
+//half-written one or none
+class SnapshotWriter {
+private:
+    static const size_t FLUSH_SIZE = 1 << 20;
+
+    string path_;
+    string tmpPath_;
+    ofstream file_;
+    SnapshotHeader header_;
+    string buffer_;
+    bool committed_;
+
+public:
+    SnapshotWriter() = delete;
+    SnapshotWriter(const string& path, const SnapshotHeader& header)
+        : path_{ path }, tmpPath_{ path + ".tmp" }, file_{ tmpPath_, ios::out | ios::binary | ios::trunc },
+        header_{ header }, committed_{ false } {
+        if (!this->file_.is_open())
+            throw runtime_error("In Snapshot.h-----Cannot create " + this->tmpPath_);
+        this->file_.write(reinterpret_cast<const char*>(&this->header_), sizeof(SnapshotHeader));
+        this->buffer_.reserve(FLUSH_SIZE + 4096);
+    }
+    SnapshotWriter(const SnapshotWriter&) = delete;
+    SnapshotWriter& operator=(const SnapshotWriter&) = delete;
+    ~SnapshotWriter() {
+        if (!this->committed_) {
+            this->file_.close();
+            std::remove(this->tmpPath_.c_str());
+        }
+    }
+
+    template<typename T>
+    void write(const T& value) {
+        Serializer<T>::append(this->buffer_, value);
+        if (this->buffer_.size() >= FLUSH_SIZE)
+            flushBuffer();
+    }
+
+    void commit() {
+        flushBuffer();
+        this->file_.seekp(0);
+        this->file_.write(reinterpret_cast<const char*>(&this->header_), sizeof(SnapshotHeader));
+        this->file_.close();
+        if (!this->file_)
+            throw runtime_error("In Snapshot.h-----Failed to write " + this->tmpPath_);
+        //the data must be on disk before the rename is, or a power loss can leave path naming a short file
+        if (!syncFile(this->tmpPath_))
+            throw runtime_error("In Snapshot.h-----Cannot sync " + this->tmpPath_);
+        if (!replaceFile(this->tmpPath_, this->path_))
+            throw runtime_error("In Snapshot.h-----Cannot replace " + this->path_);
+        this->committed_ = true;
+        if (!syncDirectoryOf(this->path_))
+            throw runtime_error("In Snapshot.h-----Cannot sync the directory of " + this->path_);
+    }
+
+private:
+    //POSIX rename replaces an existing target atomically, the CRT rename on Windows refuses to
+    static bool replaceFile(const string& from, const string& to) {
+#ifdef _WIN32
+        return MoveFileExA(from.c_str(), to.c_str(), MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH) != 0;
+#else
+        return std::rename(from.c_str(), to.c_str()) == 0;
+#endif
+    }
+
+    //ofstream has no sync, the closed file is reopened by name to flush it
+    static bool syncFile(const string& path) {
+#ifdef _WIN32
+        HANDLE file = CreateFileA(path.c_str(), GENERIC_WRITE, 0, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+        if (file == INVALID_HANDLE_VALUE)
+            return false;
+        const bool synced = FlushFileBuffers(file) != 0;
+        CloseHandle(file);
+        return synced;
+#else
+        const int fd = open(path.c_str(), O_WRONLY);
+        if (fd < 0)
+            return false;
+        const bool synced = fsync(fd) == 0;
+        close(fd);
+        return synced;
+#endif
+    }
+
+    //makes the rename itself durable; MOVEFILE_WRITE_THROUGH already does that on Windows
+    static bool syncDirectoryOf(const string& path) {
+#ifdef _WIN32
+        return true;
+#else
+        string directory = filesystem::path(path).parent_path().string();
+        if (directory.empty())
+            directory = ".";
+        const int fd = open(directory.c_str(), O_RDONLY);
+        if (fd < 0)
+            return false;
+        const bool synced = fsync(fd) == 0;
+        close(fd);
+        return synced;
+#endif
+    }
+
+    void flushBuffer() {
+        this->file_.write(this->buffer_.data(), static_cast<streamsize>(this->buffer_.size()));
+        this->header_.bodyLength += this->buffer_.size();
+        this->buffer_.clear();
+    }
+};
+
+//maps a snapshot and checks its header against what the restoring engine expects
+class SnapshotReader {
+private:
+    MappedFile file_;
+    const char* cursor_;
+    const char* end_;
+
+public:
+    SnapshotReader() = delete;
+    SnapshotReader(const string& path, const SnapshotHeader& expected) : file_{ path } {
+        if (this->file_.size() < sizeof(SnapshotHeader))
+            throw runtime_error("In Snapshot.h-----" + path + " is not a snapshot.");
+        SnapshotHeader header;
+        memcpy(&header, this->file_.data(), sizeof(SnapshotHeader));
+        if (header.magic != SnapshotHeader::MAGIC)
+            throw runtime_error("In Snapshot.h-----" + path + " is not a snapshot.");
+        if (header.version != SnapshotHeader::SNAPSHOT_VERSION)
+            throw runtime_error("In Snapshot.h-----Unsupported snapshot version " + to_string(header.version) + ".");
+        if (header.engine != expected.engine)
+            throw runtime_error("In Snapshot.h-----Snapshot was taken from a different cache engine.");
+        if (header.keySize != expected.keySize || header.valueSize != expected.valueSize)
+            throw runtime_error("In Snapshot.h-----Snapshot key or value type does not match.");
+        if (header.bodyLength != this->file_.size() - sizeof(SnapshotHeader))
+            throw runtime_error("In Snapshot.h-----Snapshot is truncated.");
+        this->cursor_ = this->file_.data() + sizeof(SnapshotHeader);
+        this->end_ = this->file_.data() + this->file_.size();
+    }
+
+    template<typename T>
+    T read() { return Serializer<T>::parse(this->cursor_, this->end_); }
+
+    bool atEnd() const { return this->cursor_ == this->end_; }
+};
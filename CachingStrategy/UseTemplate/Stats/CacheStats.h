@@ -0,0 +1,73 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <type_traits>
+#include <utility>
+using namespace std;
+
+//point-in-time counters of one engine, see ICachePolicy::stats()
+//counters only ever grow; size and bytes describe the content at the time of the call
+struct CacheStats {
+    uint64_t hits;
+    uint64_t misses;
+    uint64_t puts;                 //puts of a new key
+    uint64_t updates;              //puts that replaced the value of a cached key
+    uint64_t evictions;
+    uint64_t expirations;          //no engine expires entries yet, kept so the layout does not change when one does
+    uint64_t ghostHits;            //misses on a key ARC still remembered
+    uint64_t rejectedAdmissions;   //puts the admission policy kept out, e.g. LRU-K history
+    //only engines told the size of what they hold fill these, GdsfCache so far: bytes served by hits,
+    //and bytes put under new keys, which is what a read-through cache fetched on its misses
+    uint64_t hitBytes;
+    uint64_t missBytes;
+    uint64_t policySwitches;       //only AdaptiveCache changes policy, the times it did
+    size_t size;
+    size_t bytes;                  //keys plus values as measured by ByteSize, node overhead not included
+    //only filled in by an MrcCache wrapper, all zero otherwise: the hit ratio an LRU of
+    //SIZING_SCALES times the capacity would have had, estimated from sizingSamples sampled lookups
+    uint64_t sizingSamples;
+    double sizingHitRatio[4];
+
+    static constexpr double SIZING_SCALES[4] = { 0.5, 1.0, 2.0, 4.0 };
+
+    double hitRatio() const {
+        const uint64_t lookups = this->hits + this->misses;
+        return lookups == 0 ? 0.0 : static_cast<double>(this->hits) / lookups;
+    }
+
+    double byteHitRatio() const {
+        const uint64_t requested = this->hitBytes + this->missBytes;
+        return requested == 0 ? 0.0 : static_cast<double>(this->hitBytes) / requested;
+    }
+
+    CacheStats& operator+=(const CacheStats& other) {
+        this->hits += other.hits;
+        this->misses += other.misses;
+        this->puts += other.puts;
+        this->updates += other.updates;
+        this->evictions += other.evictions;
+        this->expirations += other.expirations;
+        this->ghostHits += other.ghostHits;
+        this->rejectedAdmissions += other.rejectedAdmissions;
+        this->hitBytes += other.hitBytes;
+        this->missBytes += other.missBytes;
+        this->policySwitches += other.policySwitches;
+        this->size += other.size;
+        this->bytes += other.bytes;
+        //estimates of different caches do not add up, the left side keeps its own
+        return *this;
+    }
+};
+
+//approximate bytes one key or value occupies: sizeof for plain types,
+//plus the element payload for anything with size() and value_type such as string or vector
+//specialize it for value types that know their footprint better
+template<typename T, typename Enable = void>
+struct ByteSize {
+    static size_t of(const T&) { return sizeof(T); }
+};
+
+template<typename T>
+struct ByteSize<T, void_t<decltype(declval<const T&>().size()), typename T::value_type>> {
+    static size_t of(const T& value) { return sizeof(T) + value.size() * sizeof(typename T::value_type); }
+};
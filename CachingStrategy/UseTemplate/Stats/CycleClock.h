@@ -0,0 +1,45 @@
+#pragma once
+#include <chrono>
+#include <cstdint>
+#include <thread>
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+#include <intrin.h>
+#define CYCLE_CLOCK_TSC
+#elif defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define CYCLE_CLOCK_TSC
+#endif
+using namespace std;
+
+//cheapest timestamp the platform offers: the TSC on x86 (a few ns, not serializing),
+//steady_clock elsewhere; ticks are only converted to nanoseconds when somebody reads a report
+class CycleClock {
+public:
+    static uint64_t now() {
+#ifdef CYCLE_CLOCK_TSC
+        return __rdtsc();
+#else
+        return static_cast<uint64_t>(chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now().time_since_epoch()).count());
+#endif
+    }
+
+    //measured once against steady_clock, the first call takes about 10 ms
+    static double nanosPerTick() {
+        static const double value = calibrate();
+        return value;
+    }
+
+private:
+    static double calibrate() {
+#ifdef CYCLE_CLOCK_TSC
+        const auto wallStart = chrono::steady_clock::now();
+        const uint64_t tickStart = now();
+        this_thread::sleep_for(chrono::milliseconds(10));
+        const uint64_t ticks = now() - tickStart;
+        const double nanos = chrono::duration<double, nano>(chrono::steady_clock::now() - wallStart).count();
+        return ticks == 0 ? 1.0 : nanos / ticks;
+#else
+        return 1.0;
+#endif
+    }
+};
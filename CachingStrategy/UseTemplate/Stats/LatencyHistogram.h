@@ -0,0 +1,152 @@
+#pragma once
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <vector>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+#include "CycleClock.h"
+#include "../Concurrent/ThreadSlot.h"
+
+//merged copy of a LatencyHistogram, values come back in nanoseconds
+class HistogramSnapshot {
+private:
+    vector<uint64_t> counts_;
+    uint64_t total_;
+    double nanosPerTick_;
+
+public:
+    HistogramSnapshot() : total_{ 0 }, nanosPerTick_{ 1.0 } {}
+    HistogramSnapshot(vector<uint64_t> counts, double nanosPerTick);
+
+    uint64_t count() const { return this->total_; }
+    //samples that recorded exactly zero ticks
+    uint64_t zeroCount() const { return this->counts_.empty() ? 0 : this->counts_[0]; }
+    //upper bound of the bucket holding the q-th sample, q in [0, 1]
+    double percentile(double q) const;
+    double mean() const;
+    double max() const;
+};
+
+//log-linear histogram in the HdrHistogram mould: exact below 32 ticks, then every power of two
+//is split into 16 buckets, so any value is off by at most 1/16; values above 2^36 ticks are clamped
+//each thread slot owns one row of buckets and bumps it with a plain load+store, no lock prefix;
+//threads past STRIPES share rows and may lose the odd sample to a race, never corrupt one
+class LatencyHistogram {
+public:
+    static const unsigned int SUB_BITS = 4;
+    static const unsigned int MAX_BITS = 36;
+    static const size_t BUCKETS = (MAX_BITS - SUB_BITS) * (1 << SUB_BITS) + (1 << SUB_BITS);
+    static const size_t STRIPES = 16;
+
+private:
+    struct alignas(64) Row {
+        array<atomic<uint64_t>, BUCKETS> counts;
+    };
+
+    vector<Row> rows_;
+
+public:
+    LatencyHistogram() : rows_(STRIPES) {
+        for (Row& row : this->rows_) {
+            for (atomic<uint64_t>& count : row.counts)
+                count.store(0, memory_order_relaxed);
+        }
+    }
+    LatencyHistogram(const LatencyHistogram&) = delete;
+    LatencyHistogram& operator=(const LatencyHistogram&) = delete;
+
+    static size_t stripeOfThisThread() { return ThreadSlot::index() % STRIPES; }
+
+    void record(uint64_t ticks) { record(stripeOfThisThread(), ticks); }
+    void record(size_t stripe, uint64_t ticks) {
+        atomic<uint64_t>& count = this->rows_[stripe].counts[bucketOf(ticks)];
+        count.store(count.load(memory_order_relaxed) + 1, memory_order_relaxed);
+    }
+
+    HistogramSnapshot snapshot() const;
+
+    static size_t bucketOf(uint64_t ticks);
+    static uint64_t bucketUpperBound(size_t bucket);
+
+private:
+    static unsigned int highestBit(uint64_t value) {
+#if defined(_MSC_VER)
+        unsigned long index;
+        _BitScanReverse64(&index, value);
+        return static_cast<unsigned int>(index);
+#else
+        return 63 - static_cast<unsigned int>(__builtin_clzll(value));
+#endif
+    }
+};
+
+inline size_t LatencyHistogram::bucketOf(uint64_t ticks) {
+    const uint64_t limit = (static_cast<uint64_t>(1) << MAX_BITS) - 1;
+    if (ticks > limit)
+        ticks = limit;
+    if (ticks < (static_cast<uint64_t>(2) << SUB_BITS))
+        return static_cast<size_t>(ticks);
+    const unsigned int shift = highestBit(ticks) - SUB_BITS;
+    return (static_cast<size_t>(shift) << SUB_BITS) + static_cast<size_t>(ticks >> shift);
+}
+
+inline uint64_t LatencyHistogram::bucketUpperBound(size_t bucket) {
+    if (bucket < (static_cast<size_t>(2) << SUB_BITS))
+        return bucket;
+    const unsigned int shift = static_cast<unsigned int>(bucket >> SUB_BITS) - 1;
+    const uint64_t top = (bucket & ((1 << SUB_BITS) - 1)) + (static_cast<uint64_t>(1) << SUB_BITS);
+    return ((top + 1) << shift) - 1;
+}
+
+inline HistogramSnapshot LatencyHistogram::snapshot() const {
+    vector<uint64_t> counts(BUCKETS, 0);
+    for (const Row& row : this->rows_) {
+        for (size_t i = 0; i < BUCKETS; ++i)
+            counts[i] += row.counts[i].load(memory_order_relaxed);
+    }
+    return HistogramSnapshot{ move(counts), CycleClock::nanosPerTick() };
+}
+
+inline HistogramSnapshot::HistogramSnapshot(vector<uint64_t> counts, double nanosPerTick)
+    : counts_{ move(counts) }, total_{ 0 }, nanosPerTick_{ nanosPerTick } {
+    for (uint64_t count : this->counts_)
+        this->total_ += count;
+}
+
+inline double HistogramSnapshot::percentile(double q) const {
+    if (this->total_ == 0)
+        return 0.0;
+    const uint64_t rank = static_cast<uint64_t>(q * (this->total_ - 1)) + 1;
+    uint64_t seen = 0;
+    for (size_t i = 0; i < this->counts_.size(); ++i) {
+        seen += this->counts_[i];
+        if (seen >= rank)
+            return LatencyHistogram::bucketUpperBound(i) * this->nanosPerTick_;
+    }
+    return max();
+}
+
+//bucket midpoints, good to the same 1/16 as the buckets
+inline double HistogramSnapshot::mean() const {
+    if (this->total_ == 0)
+        return 0.0;
+    double sum = 0.0;
+    uint64_t lower = 0;
+    for (size_t i = 0; i < this->counts_.size(); ++i) {
+        const uint64_t upper = LatencyHistogram::bucketUpperBound(i);
+        sum += this->counts_[i] * (lower + upper) / 2.0;
+        lower = upper + 1;
+    }
+    return sum / this->total_ * this->nanosPerTick_;
+}
+
+inline double HistogramSnapshot::max() const {
+    for (size_t i = this->counts_.size(); i > 0; --i) {
+        if (this->counts_[i - 1] != 0)
+            return LatencyHistogram::bucketUpperBound(i - 1) * this->nanosPerTick_;
+    }
+    return 0.0;
+}
@@ -0,0 +1,88 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+
+#include "LatencyHistogram.h"
+
+struct ProfileSnapshot {
+    HistogramSnapshot getLatency;   //sampled, lock wait included
+    HistogramSnapshot putLatency;   //sampled
+    HistogramSnapshot lockWait;     //every acquisition, zero for those that did not block
+
+    uint64_t acquisitions() const { return this->lockWait.count(); }
+    uint64_t contended() const { return this->lockWait.count() - this->lockWait.zeroCount(); }
+};
+
+enum class ProfiledOperation {
+    Get,
+    Put
+};
+
+//latency and lock-wait histograms of one engine, attached with the engine's setProfiler()
+//the profiler is owned by the caller and has to outlive every operation that saw it attached
+//a timestamp costs more than the rest of the bookkeeping together, so get/put latency is timed for
+//one operation in SAMPLE_EVERY per thread; contention and lock wait are recorded for every acquisition
+class LockProfiler {
+public:
+    static const unsigned int SAMPLE_EVERY = 8;
+
+private:
+    LatencyHistogram getLatency_;
+    LatencyHistogram putLatency_;
+    LatencyHistogram lockWait_;
+
+public:
+    void recordWait(size_t stripe, uint64_t ticks) { this->lockWait_.record(stripe, ticks); }
+    void recordLatency(size_t stripe, ProfiledOperation operation, uint64_t ticks) {
+        (operation == ProfiledOperation::Get ? this->getLatency_ : this->putLatency_).record(stripe, ticks);
+    }
+
+    ProfileSnapshot snapshot() const {
+        return ProfileSnapshot{ this->getLatency_.snapshot(), this->putLatency_.snapshot(), this->lockWait_.snapshot() };
+    }
+};
+
+//exclusive lock that times the operation around it when a profiler is attached
+//an uncontended acquisition is a try_lock and one histogram bump, a blocked one is timed;
+//without a profiler it is a plain lock_guard behind one branch
+template<typename Mutex>
+class ProfiledLock {
+private:
+    Mutex& mutex_;
+    LockProfiler* profiler_;
+    ProfiledOperation operation_;
+    size_t stripe_;
+    bool timed_;
+    uint64_t start_;
+
+public:
+    ProfiledLock(Mutex& mutex, LockProfiler* profiler, ProfiledOperation operation)
+        : mutex_{ mutex }, profiler_{ profiler }, operation_{ operation }, stripe_{ 0 }, timed_{ false }, start_{ 0 } {
+        if (!this->profiler_) {
+            this->mutex_.lock();
+            return;
+        }
+        thread_local unsigned int operations = 0;
+        this->stripe_ = LatencyHistogram::stripeOfThisThread();
+        this->timed_ = ++operations % LockProfiler::SAMPLE_EVERY == 0;
+        if (this->timed_)
+            this->start_ = CycleClock::now();
+        if (this->mutex_.try_lock()) {
+            this->profiler_->recordWait(this->stripe_, 0);
+            return;
+        }
+        const uint64_t waitStart = this->timed_ ? this->start_ : CycleClock::now();
+        this->mutex_.lock();
+        //at least one tick, zero is reserved for acquisitions that did not block
+        const uint64_t waited = CycleClock::now() - waitStart;
+        this->profiler_->recordWait(this->stripe_, waited == 0 ? 1 : waited);
+    }
+    ProfiledLock(const ProfiledLock&) = delete;
+    ProfiledLock& operator=(const ProfiledLock&) = delete;
+
+    ~ProfiledLock() {
+        this->mutex_.unlock();
+        if (this->timed_)
+            this->profiler_->recordLatency(this->stripe_, this->operation_, CycleClock::now() - this->start_);
+    }
+};
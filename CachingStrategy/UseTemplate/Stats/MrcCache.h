@@ -0,0 +1,72 @@
+#pragma once
+#include "../ICachePolicy.h"
+#include "ShardsEstimator.h"
+
+//wraps any ICachePolicy and estimates its miss-ratio curve online from the live lookups
+//stats() adds the estimated hit ratio at 0.5x, 1x, 2x and 4x the capacity, missRatioCurve() answers any size
+//up to 8x; the curve is that of an LRU over the same requests, for other policies read it as a guide to the trend
+//only get() counts as a request, the put that follows a miss would otherwise look like an immediate reuse
+//the wrapped cache's hit and miss counters give the request count SHARDS_adj needs, so the wrapper adds no write
+//to a lookup it does not sample; over an engine built without stats the curve is read unadjusted
+template<typename Key, typename Value>
+class MrcCache : public ICachePolicy<Key, Value> {
+private:
+    static const size_t MAX_SCALE = 8;
+
+    ICachePolicy<Key, Value>& cache_;
+    size_t capacity_;
+    ShardsEstimator<Key> estimator_;
+
+public:
+    MrcCache() = delete;
+    //capacity is the entry count of the wrapped cache, the scales are relative to it
+    MrcCache(ICachePolicy<Key, Value>& cache, size_t capacity, double samplingRate = 0.01, size_t maxSamples = 8192);
+    ~MrcCache() override = default;
+
+    void put(const Key& key, const Value& value) override { this->cache_.put(key, value); }
+    optional<Value> get(const Key& key) override;
+    bool remove(const Key& key) override;
+    bool isExists(const Key& key) override { return this->cache_.isExists(key); }
+    optional<Value> peek(const Key& key) override { return this->cache_.peek(key); }
+    CacheStats stats() override;
+    void setEvictionListener(const typename ICachePolicy<Key, Value>::EvictionListener& listener) override {
+        this->cache_.setEvictionListener(listener);
+    }
+
+    MissRatioCurve missRatioCurve();
+    double samplingRate() const { return this->estimator_.samplingRate(); }
+};
+
+template<typename Key, typename Value>
+MrcCache<Key, Value>::MrcCache(ICachePolicy<Key, Value>& cache, size_t capacity, double samplingRate, size_t maxSamples)
+    : cache_{ cache }, capacity_{ capacity }, estimator_{ capacity * MAX_SCALE, samplingRate, maxSamples } {}
+
+template<typename Key, typename Value>
+optional<Value> MrcCache<Key, Value>::get(const Key& key) {
+    this->estimator_.access(key);
+    return this->cache_.get(key);
+}
+
+template<typename Key, typename Value>
+bool MrcCache<Key, Value>::remove(const Key& key) {
+    this->estimator_.forget(key);
+    return this->cache_.remove(key);
+}
+
+template<typename Key, typename Value>
+CacheStats MrcCache<Key, Value>::stats() {
+    CacheStats stats = this->cache_.stats();
+    const MissRatioCurve curve = this->estimator_.curve(stats.hits + stats.misses);
+    stats.sizingSamples = curve.samples();
+    for (size_t i = 0; i < 4; ++i) {
+        const size_t size = static_cast<size_t>(this->capacity_ * CacheStats::SIZING_SCALES[i]);
+        stats.sizingHitRatio[i] = curve.samples() == 0 ? 0.0 : curve.hitRatio(size);
+    }
+    return stats;
+}
+
+template<typename Key, typename Value>
+MissRatioCurve MrcCache<Key, Value>::missRatioCurve() {
+    const CacheStats stats = this->cache_.stats();
+    return this->estimator_.curve(stats.hits + stats.misses);
+}
@@ -0,0 +1,260 @@
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <set>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+using namespace std;
+
+//reuse-distance histogram of a sampled request stream, read as the miss ratio an LRU cache
+//of any size up to maxCacheSize() would have had
+class MissRatioCurve {
+private:
+    vector<double> weights_;   //bucket i holds reuses at distance [i * bucketWidth_, (i + 1) * bucketWidth_)
+    double totalWeight_;       //includes first accesses and distances past the last bucket
+    size_t bucketWidth_;
+    uint64_t samples_;
+
+public:
+    MissRatioCurve() : totalWeight_{ 0.0 }, bucketWidth_{ 1 }, samples_{ 0 } {}
+    MissRatioCurve(vector<double> weights, double totalWeight, size_t bucketWidth, uint64_t samples)
+        : weights_{ move(weights) }, totalWeight_{ totalWeight }, bucketWidth_{ bucketWidth }, samples_{ samples } {}
+
+    uint64_t samples() const { return this->samples_; }
+    size_t maxCacheSize() const { return this->weights_.size() * this->bucketWidth_; }
+    //1.0 until something was sampled
+    double missRatio(size_t cacheSize) const;
+    double hitRatio(size_t cacheSize) const { return 1.0 - missRatio(cacheSize); }
+};
+
+//SHARDS: a key is sampled when its spatial hash falls under a threshold, so every access to a sampled key
+//is seen and reuse distances can be measured exactly on the sample, then scaled up by 1 / rate
+//the fixed-size variant is used: once a stripe tracks more than its share of maxSamples keys the key with the
+//largest hash is dropped and the stripe's threshold lowered to it, so memory is bounded however many keys the
+//stream has
+//sampled keys are split over STRIPES stripes by hash bits the sampling does not look at; each stripe is a SHARDS
+//sample of its own, counting distances among its keys only and scaling them by STRIPES, with its own lock, so
+//threads on sampled lookups seldom meet; the curve adds the stripes up
+//access() on an unsampled key is a multiply, one load of its stripe's threshold and a compare, it writes nothing;
+//sampled ones take the stripe's mutex and cost O(log maxSamples)
+//SHARDS_adj is applied when the curve is read with the stream's request count: a hot key that happened to be
+//sampled (or missed) skews the sample badly, so the gap between the sampled and the actual request count is put
+//at distance 0; the estimator does not count requests itself, that would be a write on every lookup
+template<typename Key>
+class ShardsEstimator {
+private:
+    static const uint64_t MODULUS = 1 << 24;
+    static const size_t BUCKETS = 1024;
+    static const size_t STRIPES = 8;
+
+    //everything but threshold is guarded by mutex_
+    struct alignas(64) Stripe {
+        atomic<uint64_t> threshold{ 0 };
+        mutex mutex_;
+        unordered_map<uint64_t, uint64_t> lastAccess;   //std::hash of a sampled key -> time of its last access
+        set<pair<uint64_t, uint64_t>> bySpatialHash;    //(spatial hash, fingerprint), the largest is dropped first
+        vector<int64_t> tree;                           //fenwick tree over time, 1 where a key was last accessed
+        uint64_t clock = 0;
+        vector<double> weights;
+        double totalWeight = 0.0;
+        uint64_t samples = 0;
+    };
+
+    size_t maxSamples_;    //per stripe
+    size_t bucketWidth_;
+    Stripe stripes_[STRIPES];
+
+public:
+    ShardsEstimator() = delete;
+    //maxCacheSize is the largest cache size the curve has to answer for
+    ShardsEstimator(size_t maxCacheSize, double samplingRate = 0.01, size_t maxSamples = 8192);
+    ShardsEstimator(const ShardsEstimator&) = delete;
+    ShardsEstimator& operator=(const ShardsEstimator&) = delete;
+
+    //the unsampled check is kept in the class so it inlines into the caller, the rest is sample()
+    void access(const Key& key) {
+        const uint64_t fingerprint = fingerprintOf(key);
+        Stripe& stripe = stripeOf(fingerprint);
+        if (spatialHashOf(fingerprint) < stripe.threshold.load(memory_order_relaxed))
+            sample(stripe, fingerprint);
+    }
+    //a removed key starts over, its next access is not a reuse
+    void forget(const Key& key);
+    //requests is how many accesses the stream had, for SHARDS_adj; 0 reads the sample unadjusted
+    MissRatioCurve curve(uint64_t requests = 0);
+    double samplingRate() const;
+
+private:
+    static uint64_t fingerprintOf(const Key& key) { return static_cast<uint64_t>(hash<Key>{}(key)); }
+    //std::hash is the identity for integers, fibonacci hashing spreads it with one multiply; the top 24 bits are
+    //the spatial hash and the 3 below them pick the stripe
+    //the offset keeps key 0 from mapping to 0, which every threshold would sample
+    static uint64_t mixOf(uint64_t fingerprint) { return (fingerprint + 1) * 0x9e3779b97f4a7c15ull; }
+    static uint64_t spatialHashOf(uint64_t fingerprint) { return mixOf(fingerprint) >> 40; }
+    Stripe& stripeOf(uint64_t fingerprint) { return this->stripes_[(mixOf(fingerprint) >> 37) & (STRIPES - 1)]; }
+
+    void sample(Stripe& stripe, uint64_t fingerprint);
+    void addToTree(Stripe& stripe, uint64_t time, int64_t delta);
+    int64_t prefixSum(const Stripe& stripe, uint64_t time) const;
+    void drop(Stripe& stripe, uint64_t fingerprint);
+    void shrinkToMaxSamples(Stripe& stripe);
+    void renumber(Stripe& stripe);
+};
+
+inline double MissRatioCurve::missRatio(size_t cacheSize) const {
+    if (this->totalWeight_ <= 0.0)
+        return 1.0;
+    //a reuse at distance d hits in an LRU of more than d entries, a bucket cut by cacheSize counts pro rata
+    double hits = 0.0;
+    for (size_t i = 0; i < this->weights_.size(); ++i) {
+        const size_t lower = i * this->bucketWidth_;
+        if (lower >= cacheSize)
+            break;
+        const size_t covered = min(cacheSize - lower, this->bucketWidth_);
+        hits += this->weights_[i] * covered / this->bucketWidth_;
+    }
+    //SHARDS_adj can push a small cache past either end
+    return min(1.0, max(0.0, 1.0 - hits / this->totalWeight_));
+}
+
+template<typename Key>
+ShardsEstimator<Key>::ShardsEstimator(size_t maxCacheSize, double samplingRate, size_t maxSamples)
+    : maxSamples_{ max<size_t>(maxSamples / STRIPES, 1) },
+    bucketWidth_{ max<size_t>((maxCacheSize + BUCKETS - 1) / BUCKETS, 1) } {
+    const uint64_t threshold = static_cast<uint64_t>(min(max(samplingRate, 1.0 / MODULUS), 1.0) * MODULUS);
+    for (Stripe& stripe : this->stripes_) {
+        stripe.threshold.store(threshold, memory_order_relaxed);
+        stripe.tree.assign(4 * this->maxSamples_ + 1, 0);
+        stripe.weights.assign(BUCKETS, 0.0);
+    }
+}
+
+template<typename Key>
+void ShardsEstimator<Key>::sample(Stripe& stripe, uint64_t fingerprint) {
+    lock_guard<mutex> lock{ stripe.mutex_ };
+    //the threshold may have dropped while we waited
+    const uint64_t threshold = stripe.threshold.load(memory_order_relaxed);
+    if (spatialHashOf(fingerprint) >= threshold)
+        return;
+    if (stripe.clock + 1 >= stripe.tree.size())
+        renumber(stripe);
+    const uint64_t now = ++stripe.clock;
+    //every sampled access stands for 1 / rate accesses of the full stream, the stripe holds 1 / STRIPES of the keys
+    const double scale = static_cast<double>(MODULUS) / threshold;
+    ++stripe.samples;
+    stripe.totalWeight += scale;
+
+    auto it = stripe.lastAccess.find(fingerprint);
+    if (it == stripe.lastAccess.end()) {
+        stripe.lastAccess.emplace(fingerprint, now);
+        stripe.bySpatialHash.emplace(spatialHashOf(fingerprint), fingerprint);
+        addToTree(stripe, now, 1);
+        shrinkToMaxSamples(stripe);
+        return;
+    }
+    //distinct sampled keys of this stripe touched since this one, scaled to the full stream; every tracked key
+    //was last seen before now, so those up to now - 1 are all of them
+    const int64_t distinct = static_cast<int64_t>(stripe.lastAccess.size()) - prefixSum(stripe, it->second);
+    const size_t bucket = static_cast<size_t>(distinct * scale * STRIPES / this->bucketWidth_);
+    if (bucket < stripe.weights.size())
+        stripe.weights[bucket] += scale;
+    addToTree(stripe, it->second, -1);
+    addToTree(stripe, now, 1);
+    it->second = now;
+}
+
+template<typename Key>
+void ShardsEstimator<Key>::forget(const Key& key) {
+    const uint64_t fingerprint = fingerprintOf(key);
+    Stripe& stripe = stripeOf(fingerprint);
+    if (spatialHashOf(fingerprint) >= stripe.threshold.load(memory_order_relaxed))
+        return;
+    lock_guard<mutex> lock{ stripe.mutex_ };
+    if (stripe.lastAccess.count(fingerprint))
+        drop(stripe, fingerprint);
+}
+
+template<typename Key>
+MissRatioCurve ShardsEstimator<Key>::curve(uint64_t requests) {
+    vector<double> weights(BUCKETS, 0.0);
+    double totalWeight = 0.0;
+    uint64_t samples = 0;
+    for (Stripe& stripe : this->stripes_) {
+        lock_guard<mutex> lock{ stripe.mutex_ };
+        for (size_t i = 0; i < BUCKETS; ++i)
+            weights[i] += stripe.weights[i];
+        totalWeight += stripe.totalWeight;
+        samples += stripe.samples;
+    }
+    if (samples == 0)
+        return MissRatioCurve{};
+    //the scaled sample weighs totalWeight requests, the stream had requests; the gap goes to distance 0,
+    //negative when hot keys were oversampled
+    if (requests > 0) {
+        weights[0] += static_cast<double>(requests) - totalWeight;
+        totalWeight = static_cast<double>(requests);
+    }
+    return MissRatioCurve{ move(weights), totalWeight, this->bucketWidth_, samples };
+}
+
+//the stripes lower their thresholds independently, the overall rate is their mean
+template<typename Key>
+double ShardsEstimator<Key>::samplingRate() const {
+    double rate = 0.0;
+    for (const Stripe& stripe : this->stripes_)
+        rate += static_cast<double>(stripe.threshold.load(memory_order_relaxed)) / MODULUS;
+    return rate / STRIPES;
+}
+
+template<typename Key>
+void ShardsEstimator<Key>::addToTree(Stripe& stripe, uint64_t time, int64_t delta) {
+    for (size_t i = static_cast<size_t>(time); i < stripe.tree.size(); i += i & (~i + 1))
+        stripe.tree[i] += delta;
+}
+
+template<typename Key>
+int64_t ShardsEstimator<Key>::prefixSum(const Stripe& stripe, uint64_t time) const {
+    int64_t sum = 0;
+    for (size_t i = static_cast<size_t>(time); i > 0; i -= i & (~i + 1))
+        sum += stripe.tree[i];
+    return sum;
+}
+
+template<typename Key>
+void ShardsEstimator<Key>::drop(Stripe& stripe, uint64_t fingerprint) {
+    auto it = stripe.lastAccess.find(fingerprint);
+    addToTree(stripe, it->second, -1);
+    stripe.bySpatialHash.erase(make_pair(spatialHashOf(fingerprint), fingerprint));
+    stripe.lastAccess.erase(it);
+}
+
+//lowering the threshold to the largest tracked hash drops that key and keeps every other sampled key sampled
+template<typename Key>
+void ShardsEstimator<Key>::shrinkToMaxSamples(Stripe& stripe) {
+    while (stripe.lastAccess.size() > this->maxSamples_) {
+        const uint64_t largest = prev(stripe.bySpatialHash.end())->first;
+        stripe.threshold.store(largest, memory_order_relaxed);
+        while (!stripe.bySpatialHash.empty() && prev(stripe.bySpatialHash.end())->first >= largest)
+            drop(stripe, prev(stripe.bySpatialHash.end())->second);
+    }
+}
+
+//time only needs to order the tracked keys, squeeze it back to 1..n when the tree runs out of slots
+template<typename Key>
+void ShardsEstimator<Key>::renumber(Stripe& stripe) {
+    vector<pair<uint64_t, uint64_t>> byTime;
+    byTime.reserve(stripe.lastAccess.size());
+    for (const auto& entry : stripe.lastAccess)
+        byTime.emplace_back(entry.second, entry.first);
+    sort(byTime.begin(), byTime.end());
+    fill(stripe.tree.begin(), stripe.tree.end(), 0);
+    stripe.clock = 0;
+    for (const auto& entry : byTime) {
+        stripe.lastAccess[entry.second] = ++stripe.clock;
+        addToTree(stripe, stripe.clock, 1);
+    }
+}
@@ -0,0 +1,99 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <vector>
+
+#include "CacheStats.h"
+#include "../Concurrent/ThreadSlot.h"
+
+enum class StatsCounter : size_t {
+    Hit,
+    Miss,
+    Put,
+    Update,
+    Eviction,
+    Expiration,
+    GhostHit,
+    RejectedAdmission,
+    HitBytes,
+    MissBytes,
+    Bytes,        //running sum of signed byte deltas, wraps through unsigned arithmetic
+    Count
+};
+
+//the counters behind an engine's stats()
+//StatsRecorder<false> has no members and empty inline methods, so an engine built with
+//EnableStats = false carries no counters and its hot path compiles to what it was before
+template<bool Enabled>
+class StatsRecorder;
+
+//one cache line of counters per thread slot: a thread only ever writes its own stripe,
+//collect() is the only place that reads them all
+template<>
+class StatsRecorder<true> {
+private:
+    static const size_t STRIPES = 16;
+    static const size_t COUNTERS = static_cast<size_t>(StatsCounter::Count);
+
+    struct alignas(64) Stripe {
+        atomic<uint64_t> counters[COUNTERS];
+    };
+
+    vector<Stripe> stripes_;
+
+public:
+    StatsRecorder() : stripes_(STRIPES) {
+        for (Stripe& stripe : this->stripes_) {
+            for (atomic<uint64_t>& counter : stripe.counters)
+                counter.store(0, memory_order_relaxed);
+        }
+    }
+    StatsRecorder(const StatsRecorder&) = delete;
+    StatsRecorder& operator=(const StatsRecorder&) = delete;
+
+    void record(StatsCounter counter, uint64_t amount = 1) {
+        //relaxed add on a line no other thread writes, threads beyond STRIPES share lines but stay correct
+        this->stripes_[ThreadSlot::index() % STRIPES].counters[static_cast<size_t>(counter)].fetch_add(amount, memory_order_relaxed);
+    }
+
+    template<typename Key, typename Value>
+    void entryAdded(const Key& key, const Value& value) {
+        record(StatsCounter::Bytes, ByteSize<Key>::of(key) + ByteSize<Value>::of(value));
+    }
+    template<typename Key, typename Value>
+    void entryRemoved(const Key& key, const Value& value) {
+        record(StatsCounter::Bytes, 0 - static_cast<uint64_t>(ByteSize<Key>::of(key) + ByteSize<Value>::of(value)));
+    }
+    template<typename Value>
+    void valueReplaced(const Value& oldValue, const Value& newValue) {
+        record(StatsCounter::Bytes, static_cast<uint64_t>(ByteSize<Value>::of(newValue)) - ByteSize<Value>::of(oldValue));
+    }
+
+    //size is passed in by the engine, it already knows it exactly under its own lock
+    CacheStats collect(size_t size) const {
+        uint64_t totals[COUNTERS] = {};
+        for (const Stripe& stripe : this->stripes_) {
+            for (size_t i = 0; i < COUNTERS; ++i)
+                totals[i] += stripe.counters[i].load(memory_order_relaxed);
+        }
+        return CacheStats{ totals[static_cast<size_t>(StatsCounter::Hit)], totals[static_cast<size_t>(StatsCounter::Miss)],
+            totals[static_cast<size_t>(StatsCounter::Put)], totals[static_cast<size_t>(StatsCounter::Update)],
+            totals[static_cast<size_t>(StatsCounter::Eviction)], totals[static_cast<size_t>(StatsCounter::Expiration)],
+            totals[static_cast<size_t>(StatsCounter::GhostHit)], totals[static_cast<size_t>(StatsCounter::RejectedAdmission)],
+            totals[static_cast<size_t>(StatsCounter::HitBytes)], totals[static_cast<size_t>(StatsCounter::MissBytes)], 0,
+            size, static_cast<size_t>(totals[static_cast<size_t>(StatsCounter::Bytes)]), 0, {} };
+    }
+};
+
+template<>
+class StatsRecorder<false> {
+public:
+    void record(StatsCounter, uint64_t = 1) {}
+    template<typename Key, typename Value>
+    void entryAdded(const Key&, const Value&) {}
+    template<typename Key, typename Value>
+    void entryRemoved(const Key&, const Value&) {}
+    template<typename Value>
+    void valueReplaced(const Value&, const Value&) {}
+    CacheStats collect(size_t size) const { return CacheStats{ 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, size, 0, 0, {} }; }
+};
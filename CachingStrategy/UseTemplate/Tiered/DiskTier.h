@@ -0,0 +1,343 @@
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "RandomAccessFile.h"
+#include "../Serializer.h"
+
+struct DiskTierStats {
+    size_t appends;
+    size_t reclaimed;       //entries dropped because their region was reused
+    size_t regionsWritten;
+    size_t failedWrites;
+    size_t diskReads;       //pread calls, one per coalesced run of records
+};
+
+//log-structured second tier on a local file
+//the file is a ring of regionCount regions of regionSize bytes; records are appended to an in-memory
+//region buffer, a full region is sealed and written out by a background thread in one call,
+//and when the ring wraps the oldest region is reused and whatever still lives in it is dropped
+//record: [u32 record length][key][value]
+//only the key -> (offset, length) index is kept in memory
+template<typename Key, typename Value>
+class DiskTier {
+private:
+    struct Location {
+        uint64_t offset;
+        uint32_t length;
+    };
+    using LocationHash = unordered_map<Key, Location>;
+    using Buffer = shared_ptr<string>;
+    struct SealedRegion {
+        size_t region;
+        uint64_t generation;
+        Buffer bytes;
+    };
+    struct DiskRead {
+        size_t index;
+        Location location;
+        uint64_t generation;
+    };
+    //records closer than this are fetched with one read, the gap is read and thrown away
+    static const uint64_t MERGE_GAP = 4096;
+    static const uint64_t MAX_READ_SPAN = 256 * 1024;
+
+    RandomAccessFile file_;
+    size_t regionSize_;
+    size_t regionCount_;
+
+    mutex mutex_;
+    condition_variable writeWanted_;
+    LocationHash locationHash_;
+    vector<vector<Key>> regionKeys_;
+    vector<uint64_t> regionGeneration_;   //bumped whenever a region is reused, readers compare it after reading
+    size_t activeRegion_;
+    Buffer activeBuffer_;
+    deque<SealedRegion> sealed_;          //sealed but not yet on disk, still served from memory
+    bool stopping_;
+    thread writer_;
+
+    atomic<size_t> appends_;
+    atomic<size_t> reclaimed_;
+    atomic<size_t> regionsWritten_;
+    atomic<size_t> failedWrites_;
+    atomic<size_t> diskReads_;
+
+public:
+    DiskTier() = delete;
+    DiskTier(const string& path, size_t regionSize = 1 << 20, size_t regionCount = 64);
+    DiskTier(const DiskTier&) = delete;
+    DiskTier& operator=(const DiskTier&) = delete;
+    ~DiskTier();
+
+    //false when the record is larger than a region
+    bool append(const Key& key, const Value& value);
+    optional<Value> read(const Key& key);
+    //looks every key up at once; records are sorted by offset and neighbouring ones share one read
+    vector<optional<Value>> readBatch(const vector<Key>& keys);
+    //like readBatch, but every record returned is also removed from the tier,
+    //unless the key was appended again while the read was in flight
+    vector<optional<Value>> takeBatch(const vector<Key>& keys);
+    bool erase(const Key& key);
+    bool contains(const Key& key);
+    size_t size();
+    DiskTierStats getStats();
+
+private:
+    vector<optional<Value>> fetch(const vector<Key>& keys, bool take);
+    void sealActiveRegion();
+    void reclaimRegion(size_t region);
+    void writeLoop();
+    static optional<Value> decode(const Key& key, const char* record, size_t length);
+};
+
+template<typename Key, typename Value>
+DiskTier<Key, Value>::DiskTier(const string& path, size_t regionSize, size_t regionCount)
+    : file_{ path }, regionSize_{ regionSize }, regionCount_{ max<size_t>(regionCount, 2) },
+    regionKeys_(regionCount_), regionGeneration_(regionCount_, 0), activeRegion_{ 0 },
+    activeBuffer_{ make_shared<string>() }, stopping_{ false },
+    appends_{ 0 }, reclaimed_{ 0 }, regionsWritten_{ 0 }, failedWrites_{ 0 }, diskReads_{ 0 } {
+    this->activeBuffer_->reserve(this->regionSize_);
+    this->writer_ = thread{ [this]() { writeLoop(); } };
+}
+
+//the tier is a cache, anything not yet written when it shuts down is simply dropped
+template<typename Key, typename Value>
+DiskTier<Key, Value>::~DiskTier() {
+    {
+        lock_guard<mutex> lock{ this->mutex_ };
+        this->stopping_ = true;
+    }
+    this->writeWanted_.notify_all();
+    this->writer_.join();
+}
+
+template<typename Key, typename Value>
+bool DiskTier<Key, Value>::append(const Key& key, const Value& value) {
+    string record;
+    Serializer<uint32_t>::append(record, 0);
+    Serializer<Key>::append(record, key);
+    Serializer<Value>::append(record, value);
+    const uint32_t length = static_cast<uint32_t>(record.size());
+    memcpy(record.data(), &length, sizeof(length));
+    if (record.size() > this->regionSize_)
+        return false;
+
+    bool sealed = false;
+    {
+        lock_guard<mutex> lock{ this->mutex_ };
+        if (this->activeBuffer_->size() + record.size() > this->regionSize_) {
+            sealActiveRegion();
+            sealed = true;
+        }
+        const uint64_t offset = this->activeRegion_ * this->regionSize_ + this->activeBuffer_->size();
+        this->activeBuffer_->append(record);
+        this->locationHash_[key] = Location{ offset, length };
+        this->regionKeys_[this->activeRegion_].push_back(key);
+    }
+    if (sealed)
+        this->writeWanted_.notify_one();
+    this->appends_++;
+    return true;
+}
+
+template<typename Key, typename Value>
+optional<Value> DiskTier<Key, Value>::read(const Key& key) {
+    return readBatch(vector<Key>{ key })[0];
+}
+
+template<typename Key, typename Value>
+vector<optional<Value>> DiskTier<Key, Value>::readBatch(const vector<Key>& keys) {
+    return fetch(keys, false);
+}
+
+template<typename Key, typename Value>
+vector<optional<Value>> DiskTier<Key, Value>::takeBatch(const vector<Key>& keys) {
+    return fetch(keys, true);
+}
+
+template<typename Key, typename Value>
+vector<optional<Value>> DiskTier<Key, Value>::fetch(const vector<Key>& keys, bool take) {
+    vector<optional<Value>> results(keys.size());
+    vector<DiskRead> diskReads;
+    {
+        lock_guard<mutex> lock{ this->mutex_ };
+        for (size_t i = 0; i < keys.size(); ++i) {
+            auto it = this->locationHash_.find(keys[i]);
+            if (it == this->locationHash_.end())
+                continue;
+            const Location location = it->second;
+            const size_t region = static_cast<size_t>(location.offset / this->regionSize_);
+            const size_t inRegion = static_cast<size_t>(location.offset % this->regionSize_);
+            Buffer buffer = nullptr;
+            if (region == this->activeRegion_) {
+                buffer = this->activeBuffer_;
+            }
+            else {
+                //newest first, a region may be queued twice if the writer fell a whole ring behind
+                for (auto sealed = this->sealed_.rbegin(); sealed != this->sealed_.rend(); ++sealed) {
+                    if (sealed->region == region) {
+                        buffer = sealed->bytes;
+                        break;
+                    }
+                }
+            }
+            if (buffer) {
+                results[i] = decode(keys[i], buffer->data() + inRegion, location.length);
+                if (take && results[i].has_value())
+                    this->locationHash_.erase(it);
+            }
+            else
+                diskReads.push_back(DiskRead{ i, location, this->regionGeneration_[region] });
+        }
+    }
+    if (diskReads.empty())
+        return results;
+
+    sort(diskReads.begin(), diskReads.end(), [](const DiskRead& a, const DiskRead& b) {
+        return a.location.offset < b.location.offset;
+    });
+    string buffer;
+    size_t first = 0;
+    while (first < diskReads.size()) {
+        const uint64_t start = diskReads[first].location.offset;
+        uint64_t end = start + diskReads[first].location.length;
+        size_t last = first + 1;
+        while (last < diskReads.size() && diskReads[last].location.offset <= end + MERGE_GAP
+            && diskReads[last].location.offset + diskReads[last].location.length - start <= MAX_READ_SPAN) {
+            end = max(end, diskReads[last].location.offset + diskReads[last].location.length);
+            ++last;
+        }
+        buffer.resize(static_cast<size_t>(end - start));
+        this->file_.readAt(start, buffer.data(), buffer.size());
+        this->diskReads_++;
+        for (size_t i = first; i < last; ++i) {
+            const DiskRead& request = diskReads[i];
+            results[request.index] = decode(keys[request.index],
+                buffer.data() + (request.location.offset - start), request.location.length);
+        }
+        first = last;
+    }
+
+    //a region reused while we were reading may have been overwritten under us
+    lock_guard<mutex> lock{ this->mutex_ };
+    for (const DiskRead& request : diskReads) {
+        const size_t region = static_cast<size_t>(request.location.offset / this->regionSize_);
+        if (this->regionGeneration_[region] != request.generation) {
+            results[request.index] = nullopt;
+            continue;
+        }
+        if (!take || !results[request.index].has_value())
+            continue;
+        auto it = this->locationHash_.find(keys[request.index]);
+        if (it != this->locationHash_.end() && it->second.offset == request.location.offset)
+            this->locationHash_.erase(it);
+    }
+    return results;
+}
+
+template<typename Key, typename Value>
+bool DiskTier<Key, Value>::erase(const Key& key) {
+    lock_guard<mutex> lock{ this->mutex_ };
+    return this->locationHash_.erase(key) > 0;
+}
+
+template<typename Key, typename Value>
+bool DiskTier<Key, Value>::contains(const Key& key) {
+    lock_guard<mutex> lock{ this->mutex_ };
+    return this->locationHash_.find(key) != this->locationHash_.end();
+}
+
+template<typename Key, typename Value>
+size_t DiskTier<Key, Value>::size() {
+    lock_guard<mutex> lock{ this->mutex_ };
+    return this->locationHash_.size();
+}
+
+template<typename Key, typename Value>
+DiskTierStats DiskTier<Key, Value>::getStats() {
+    return DiskTierStats{ this->appends_.load(), this->reclaimed_.load(), this->regionsWritten_.load(),
+        this->failedWrites_.load(), this->diskReads_.load() };
+}
+
+//mutex_ held
+template<typename Key, typename Value>
+void DiskTier<Key, Value>::sealActiveRegion() {
+    this->sealed_.push_back(SealedRegion{ this->activeRegion_, this->regionGeneration_[this->activeRegion_], this->activeBuffer_ });
+    this->activeRegion_ = (this->activeRegion_ + 1) % this->regionCount_;
+    reclaimRegion(this->activeRegion_);
+    this->activeBuffer_ = make_shared<string>();
+    this->activeBuffer_->reserve(this->regionSize_);
+}
+
+//mutex_ held
+template<typename Key, typename Value>
+void DiskTier<Key, Value>::reclaimRegion(size_t region) {
+    this->regionGeneration_[region]++;
+    for (const Key& key : this->regionKeys_[region]) {
+        auto it = this->locationHash_.find(key);
+        //the key may have been erased or appended again into a newer region since
+        if (it != this->locationHash_.end() && it->second.offset / this->regionSize_ == region) {
+            this->locationHash_.erase(it);
+            this->reclaimed_++;
+        }
+    }
+    this->regionKeys_[region].clear();
+}
+
+template<typename Key, typename Value>
+void DiskTier<Key, Value>::writeLoop() {
+    unique_lock<mutex> lock{ this->mutex_ };
+    while (true) {
+        this->writeWanted_.wait(lock, [this]() { return this->stopping_ || !this->sealed_.empty(); });
+        if (this->stopping_)
+            return;
+        //only this thread pops, the front stays valid and keeps serving reads while it is written
+        SealedRegion sealed = this->sealed_.front();
+        lock.unlock();
+        bool written = true;
+        try {
+            this->file_.writeAt(sealed.region * this->regionSize_, sealed.bytes->data(), sealed.bytes->size());
+        }
+        catch (...) {
+            written = false;
+        }
+        lock.lock();
+        this->sealed_.pop_front();
+        if (written) {
+            this->regionsWritten_++;
+        }
+        else {
+            this->failedWrites_++;
+            //the records never reached the file, forget them unless the region was already reused
+            if (this->regionGeneration_[sealed.region] == sealed.generation)
+                reclaimRegion(sealed.region);
+        }
+    }
+}
+
+template<typename Key, typename Value>
+optional<Value> DiskTier<Key, Value>::decode(const Key& key, const char* record, size_t length) {
+    //a record read from a region that was reused meanwhile can be anything, treat it as a miss
+    const char* cursor = record;
+    const char* end = record + length;
+    try {
+        if (Serializer<uint32_t>::parse(cursor, end) != length)
+            return nullopt;
+        if (!(Serializer<Key>::parse(cursor, end) == key))
+            return nullopt;
+        return Serializer<Value>::parse(cursor, end);
+    }
+    catch (const runtime_error&) {
+        return nullopt;
+    }
+}
@@ -0,0 +1,116 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+using namespace std;
+
+//positional reads and writes on one file handle (pread/pwrite, overlapped ReadFile/WriteFile on Windows)
+//calls carry their own offset, so any number of threads may read and write at once without a seek lock
+class RandomAccessFile {
+private:
+#ifdef _WIN32
+    HANDLE file_;
+#else
+    int fd_;
+#endif
+
+public:
+    RandomAccessFile() = delete;
+    //creates or truncates path
+    RandomAccessFile(const string& path);
+    RandomAccessFile(const RandomAccessFile&) = delete;
+    RandomAccessFile& operator=(const RandomAccessFile&) = delete;
+    ~RandomAccessFile();
+
+    void readAt(uint64_t offset, char* buffer, size_t length);
+    void writeAt(uint64_t offset, const char* buffer, size_t length);
+};
+
+#ifdef _WIN32
+inline RandomAccessFile::RandomAccessFile(const string& path) {
+    this->file_ = CreateFileA(path.c_str(), GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ, nullptr,
+        CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (this->file_ == INVALID_HANDLE_VALUE)
+        throw runtime_error("In RandomAccessFile.h-----Cannot open " + path);
+}
+
+inline RandomAccessFile::~RandomAccessFile() {
+    CloseHandle(this->file_);
+}
+
+inline void RandomAccessFile::readAt(uint64_t offset, char* buffer, size_t length) {
+    while (length > 0) {
+        OVERLAPPED position{};
+        position.Offset = static_cast<DWORD>(offset);
+        position.OffsetHigh = static_cast<DWORD>(offset >> 32);
+        DWORD done = 0;
+        DWORD chunk = static_cast<DWORD>(length > (1u << 30) ? (1u << 30) : length);
+        if (!ReadFile(this->file_, buffer, chunk, &done, &position) || done == 0)
+            throw runtime_error("In RandomAccessFile.h-----Read failed.");
+        offset += done;
+        buffer += done;
+        length -= done;
+    }
+}
+
+inline void RandomAccessFile::writeAt(uint64_t offset, const char* buffer, size_t length) {
+    while (length > 0) {
+        OVERLAPPED position{};
+        position.Offset = static_cast<DWORD>(offset);
+        position.OffsetHigh = static_cast<DWORD>(offset >> 32);
+        DWORD done = 0;
+        DWORD chunk = static_cast<DWORD>(length > (1u << 30) ? (1u << 30) : length);
+        if (!WriteFile(this->file_, buffer, chunk, &done, &position) || done == 0)
+            throw runtime_error("In RandomAccessFile.h-----Write failed.");
+        offset += done;
+        buffer += done;
+        length -= done;
+    }
+}
+#else
+inline RandomAccessFile::RandomAccessFile(const string& path) {
+    this->fd_ = open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (this->fd_ < 0)
+        throw runtime_error("In RandomAccessFile.h-----Cannot open " + path);
+}
+
+inline RandomAccessFile::~RandomAccessFile() {
+    close(this->fd_);
+}
+
+inline void RandomAccessFile::readAt(uint64_t offset, char* buffer, size_t length) {
+    while (length > 0) {
+        ssize_t done = pread(this->fd_, buffer, length, static_cast<off_t>(offset));
+        if (done <= 0)
+            throw runtime_error("In RandomAccessFile.h-----Read failed.");
+        offset += done;
+        buffer += done;
+        length -= done;
+    }
+}
+
+inline void RandomAccessFile::writeAt(uint64_t offset, const char* buffer, size_t length) {
+    while (length > 0) {
+        ssize_t done = pwrite(this->fd_, buffer, length, static_cast<off_t>(offset));
+        if (done <= 0)
+            throw runtime_error("In RandomAccessFile.h-----Write failed.");
+        offset += done;
+        buffer += done;
+        length -= done;
+    }
+}
+#endif
@@ -0,0 +1,177 @@
+#pragma once
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <mutex>
+#include <vector>
+
+#include "../ICachePolicy.h"
+#include "DiskTier.h"
+
+struct TieredStats {
+    size_t memoryHits;
+    size_t diskHits;     //found on disk and promoted back into memory
+    size_t misses;
+    size_t demotions;    //entries evicted from memory and appended to disk
+};
+
+//memory engine in front of a DiskTier
+//whatever the engine evicts is appended to the disk tier through the eviction listener,
+//a memory miss that hits on disk moves the entry back into the engine
+//disk reads happen outside the engine's lock, so a slow read only holds up its own key stripe
+template<typename Key, typename Value>
+class TieredCache : public ICachePolicy<Key, Value> {
+private:
+    static const size_t KEY_STRIPES = 16;
+
+    ICachePolicy<Key, Value>& memory_;
+    DiskTier<Key, Value>& disk_;
+    //orders promotion against put/remove of the same key
+    array<mutex, KEY_STRIPES> keyMutex_;
+
+    atomic<size_t> memoryHits_;
+    atomic<size_t> diskHits_;
+    atomic<size_t> misses_;
+    atomic<size_t> demotions_;
+
+public:
+    TieredCache() = delete;
+    TieredCache(ICachePolicy<Key, Value>& memory, DiskTier<Key, Value>& disk);
+    ~TieredCache() override;
+
+    void put(const Key& key, const Value& value) override;
+    optional<Value> get(const Key& key) override;
+    //memory hits are answered directly, all misses go to the disk tier as one batch
+    vector<optional<Value>> getBatch(const vector<Key>& keys);
+    bool remove(const Key& key) override;
+    bool isExists(const Key& key) override;
+    optional<Value> peek(const Key& key) override;
+    //the memory tier only, getStats() covers the disk
+    CacheStats stats() override { return this->memory_.stats(); }
+    TieredStats getStats();
+
+private:
+    mutex& keyMutexFor(const Key& key);
+};
+
+template<typename Key, typename Value>
+TieredCache<Key, Value>::TieredCache(ICachePolicy<Key, Value>& memory, DiskTier<Key, Value>& disk)
+    : memory_{ memory }, disk_{ disk }, memoryHits_{ 0 }, diskHits_{ 0 }, misses_{ 0 }, demotions_{ 0 } {
+    this->memory_.setEvictionListener([this](const Key& key, const Value& value) {
+        if (this->disk_.append(key, value))
+            this->demotions_++;
+    });
+}
+
+template<typename Key, typename Value>
+TieredCache<Key, Value>::~TieredCache() {
+    this->memory_.setEvictionListener(nullptr);
+}
+
+template<typename Key, typename Value>
+void TieredCache<Key, Value>::put(const Key& key, const Value& value) {
+    lock_guard<mutex> lock{ keyMutexFor(key) };
+    this->disk_.erase(key);
+    this->memory_.put(key, value);
+}
+
+template<typename Key, typename Value>
+optional<Value> TieredCache<Key, Value>::get(const Key& key) {
+    optional<Value> value = this->memory_.get(key);
+    if (value.has_value()) {
+        this->memoryHits_++;
+        return value;
+    }
+    lock_guard<mutex> lock{ keyMutexFor(key) };
+    //another reader of this key may have promoted it while we waited
+    value = this->memory_.get(key);
+    if (value.has_value()) {
+        this->memoryHits_++;
+        return value;
+    }
+    value = this->disk_.takeBatch(vector<Key>{ key })[0];
+    if (!value.has_value()) {
+        this->misses_++;
+        return nullopt;
+    }
+    this->diskHits_++;
+    this->memory_.put(key, value.value());
+    return value;
+}
+
+template<typename Key, typename Value>
+vector<optional<Value>> TieredCache<Key, Value>::getBatch(const vector<Key>& keys) {
+    vector<optional<Value>> results(keys.size());
+    vector<Key> missedKeys;
+    vector<size_t> missedIndexes;
+    for (size_t i = 0; i < keys.size(); ++i) {
+        results[i] = this->memory_.get(keys[i]);
+        if (results[i].has_value()) {
+            this->memoryHits_++;
+        }
+        else {
+            missedKeys.push_back(keys[i]);
+            missedIndexes.push_back(i);
+        }
+    }
+    if (missedKeys.empty())
+        return results;
+
+    //hold the stripes of every missed key, in index order, until the batch is back in memory
+    vector<size_t> stripes;
+    for (const Key& key : missedKeys) {
+        stripes.push_back(hash<Key>{}(key) % KEY_STRIPES);
+    }
+    sort(stripes.begin(), stripes.end());
+    stripes.erase(unique(stripes.begin(), stripes.end()), stripes.end());
+    vector<unique_lock<mutex>> locks;
+    for (size_t stripe : stripes) {
+        locks.emplace_back(this->keyMutex_[stripe]);
+    }
+
+    vector<optional<Value>> fromDisk = this->disk_.takeBatch(missedKeys);
+    for (size_t i = 0; i < missedKeys.size(); ++i) {
+        if (!fromDisk[i].has_value()) {
+            //promoted by a concurrent get before we took the stripes
+            results[missedIndexes[i]] = this->memory_.peek(missedKeys[i]);
+            if (!results[missedIndexes[i]].has_value())
+                this->misses_++;
+            continue;
+        }
+        this->diskHits_++;
+        this->memory_.put(missedKeys[i], fromDisk[i].value());
+        results[missedIndexes[i]] = move(fromDisk[i]);
+    }
+    return results;
+}
+
+template<typename Key, typename Value>
+bool TieredCache<Key, Value>::remove(const Key& key) {
+    lock_guard<mutex> lock{ keyMutexFor(key) };
+    const bool inMemory = this->memory_.remove(key);
+    const bool onDisk = this->disk_.erase(key);
+    return inMemory || onDisk;
+}
+
+template<typename Key, typename Value>
+bool TieredCache<Key, Value>::isExists(const Key& key) {
+    return this->memory_.isExists(key) || this->disk_.contains(key);
+}
+
+template<typename Key, typename Value>
+optional<Value> TieredCache<Key, Value>::peek(const Key& key) {
+    optional<Value> value = this->memory_.peek(key);
+    if (value.has_value())
+        return value;
+    return this->disk_.read(key);
+}
+
+template<typename Key, typename Value>
+TieredStats TieredCache<Key, Value>::getStats() {
+    return TieredStats{ this->memoryHits_.load(), this->diskHits_.load(), this->misses_.load(), this->demotions_.load() };
+}
+
+template<typename Key, typename Value>
+mutex& TieredCache<Key, Value>::keyMutexFor(const Key& key) {
+    return this->keyMutex_[hash<Key>{}(key) % KEY_STRIPES];
+}
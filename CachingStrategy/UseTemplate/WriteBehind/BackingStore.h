@@ -0,0 +1,17 @@
+#pragma once
+#include <optional>
+#include <utility>
+#include <vector>
+using namespace std;
+
+//the slow key-value store that sits behind a WriteBehindCache
+template<typename Key, typename Value>
+class BackingStore {
+public:
+    //nullopt in a batch entry deletes the key
+    using Batch = vector<pair<Key, optional<Value>>>;
+
+    virtual ~BackingStore() {}
+    virtual void writeBatch(const Batch& batch) = 0;
+    virtual optional<Value> read(const Key& key) = 0;
+};
@@ -0,0 +1,152 @@
+#pragma once
+#include <fstream>
+#include <iterator>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "BackingStore.h"
+#include "../Serializer.h"
+
+//append-only log file standing in for a real key-value store in tests
+//record: [u8 tag][u32 value length][key][value], tag 0 marks a deletion
+//the latest record of each key wins, an in-memory index keeps its value offset
+template<typename Key, typename Value>
+class FileBackingStore : public BackingStore<Key, Value> {
+public:
+    using Batch = typename BackingStore<Key, Value>::Batch;
+
+private:
+    struct Location {
+        streamoff offset;
+        uint32_t length;
+    };
+    using LocationHash = unordered_map<Key, Location>;
+
+    mutex mutex_;
+    fstream file_;
+    LocationHash locationHash_;
+    streamoff fileSize_;
+    size_t batchesWritten_;
+
+public:
+    FileBackingStore() = delete;
+    FileBackingStore(const string& path);
+    ~FileBackingStore() override = default;
+
+    void writeBatch(const Batch& batch) override;
+    optional<Value> read(const Key& key) override;
+    size_t size();
+    size_t getBatchesWritten();
+
+private:
+    void replay();
+};
+
+template<typename Key, typename Value>
+FileBackingStore<Key, Value>::FileBackingStore(const string& path)
+    : file_{ path, ios::in | ios::out | ios::binary | ios::app }, fileSize_{ 0 }, batchesWritten_{ 0 } {
+    if (!this->file_.is_open()) {
+        throw runtime_error("In FileBackingStore.h-----Cannot open " + path);
+    }
+    replay();
+}
+
+template<typename Key, typename Value>
+void FileBackingStore<Key, Value>::writeBatch(const Batch& batch) {
+    struct Written {
+        const Key* key;
+        bool erased;
+        Location location;   //offset relative to the start of this batch
+    };
+    string buffer;
+    vector<Written> written;
+    written.reserve(batch.size());
+    for (const auto& entry : batch) {
+        const bool erased = !entry.second.has_value();
+        string valueBytes;
+        if (!erased)
+            Serializer<Value>::append(valueBytes, entry.second.value());
+        Serializer<uint8_t>::append(buffer, erased ? 0 : 1);
+        Serializer<uint32_t>::append(buffer, static_cast<uint32_t>(valueBytes.size()));
+        Serializer<Key>::append(buffer, entry.first);
+        written.push_back(Written{ &entry.first, erased,
+            Location{ static_cast<streamoff>(buffer.size()), static_cast<uint32_t>(valueBytes.size()) } });
+        buffer.append(valueBytes);
+    }
+
+    lock_guard<mutex> lock{ this->mutex_ };
+    this->file_.seekp(0, ios::end);
+    this->file_.write(buffer.data(), static_cast<streamsize>(buffer.size()));
+    this->file_.flush();
+    if (!this->file_) {
+        this->file_.clear();
+        throw runtime_error("In FileBackingStore.h-----Failed to append a batch.");
+    }
+    for (const Written& record : written) {
+        if (record.erased) {
+            this->locationHash_.erase(*record.key);
+            continue;
+        }
+        Location location = record.location;
+        location.offset += this->fileSize_;
+        this->locationHash_[*record.key] = location;
+    }
+    this->fileSize_ += static_cast<streamoff>(buffer.size());
+    this->batchesWritten_++;
+}
+
+template<typename Key, typename Value>
+optional<Value> FileBackingStore<Key, Value>::read(const Key& key) {
+    lock_guard<mutex> lock{ this->mutex_ };
+    auto it = this->locationHash_.find(key);
+    if (it == this->locationHash_.end())
+        return nullopt;
+    string valueBytes(it->second.length, '\0');
+    this->file_.seekg(it->second.offset);
+    this->file_.read(valueBytes.data(), static_cast<streamsize>(valueBytes.size()));
+    if (!this->file_) {
+        this->file_.clear();
+        throw runtime_error("In FileBackingStore.h-----Failed to read a record.");
+    }
+    const char* cursor = valueBytes.data();
+    return Serializer<Value>::parse(cursor, valueBytes.data() + valueBytes.size());
+}
+
+template<typename Key, typename Value>
+size_t FileBackingStore<Key, Value>::size() {
+    lock_guard<mutex> lock{ this->mutex_ };
+    return this->locationHash_.size();
+}
+
+template<typename Key, typename Value>
+size_t FileBackingStore<Key, Value>::getBatchesWritten() {
+    lock_guard<mutex> lock{ this->mutex_ };
+    return this->batchesWritten_;
+}
+
+template<typename Key, typename Value>
+void FileBackingStore<Key, Value>::replay() {
+    this->file_.seekg(0);
+    string content{ istreambuf_iterator<char>(this->file_), istreambuf_iterator<char>() };
+    this->file_.clear();
+
+    const char* begin = content.data();
+    const char* cursor = begin;
+    const char* end = begin + content.size();
+    while (cursor < end) {
+        uint8_t tag = Serializer<uint8_t>::parse(cursor, end);
+        uint32_t length = Serializer<uint32_t>::parse(cursor, end);
+        Key key = Serializer<Key>::parse(cursor, end);
+        if (static_cast<size_t>(end - cursor) < length)
+            throw runtime_error("In FileBackingStore.h-----Log ends inside a record.");
+        if (tag)
+            this->locationHash_[key] = Location{ static_cast<streamoff>(cursor - begin), length };
+        else
+            this->locationHash_.erase(key);
+        cursor += length;
+    }
+    this->fileSize_ = static_cast<streamoff>(content.size());
+}
@@ -0,0 +1,362 @@
+#pragma once
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+
+#include "../ICachePolicy.h"
+#include "BackingStore.h"
+
+struct WriteBehindStats {
+    size_t puts;
+    size_t coalesced;        //puts that overwrote a value still waiting to be flushed
+    size_t batches;
+    size_t flushedEntries;
+    size_t evictionFlushes;  //flushes triggered by a dirty entry leaving the cache
+    size_t failedBatches;
+};
+
+//put() updates the cache, marks the key dirty and returns
+//a background flusher writes dirty keys to the store in batches of up to batchSize,
+//repeated puts to one key before a flush are written once
+//an entry evicted while dirty is still held in the dirty table and triggers an immediate flush
+//after a failed batch the flusher pauses for flushInterval, doubling while the store keeps failing
+//on shutdown a failing store is retried with a doubling pause, entries it never takes go back to the caller
+template<typename Key, typename Value>
+class WriteBehindCache : public ICachePolicy<Key, Value> {
+private:
+    using Batch = typename BackingStore<Key, Value>::Batch;
+    using DirtyHash = unordered_map<Key, optional<Value>>;
+    static const size_t WRITE_STRIPES = 16;
+    static const unsigned int SHUTDOWN_ATTEMPTS = 8;
+    static const unsigned int MAX_RETRY_DOUBLINGS = 4;
+    static constexpr chrono::milliseconds FIRST_BACKOFF{ 1 };
+    static constexpr chrono::milliseconds MAX_BACKOFF{ 200 };
+
+    ICachePolicy<Key, Value>& cache_;
+    BackingStore<Key, Value>& store_;
+    size_t batchSize_;
+    chrono::milliseconds flushInterval_;
+
+    //per-key ordering between the cache and the dirty table
+    array<mutex, WRITE_STRIPES> writeMutex_;
+    mutex dirtyMutex_;
+    condition_variable flushWanted_;
+    condition_variable flushDone_;
+    DirtyHash dirtyHash_;
+    DirtyHash flushingHash_;   //batch being written, still visible to get()
+    bool urgent_;
+    bool stopping_;
+    bool cycleRunning_;
+    bool boundedShutdown_;     //give up after SHUTDOWN_ATTEMPTS failed attempts instead of retrying until the store recovers
+    function<void(Batch&&)> unflushedHandler_;
+    unsigned long long finishedCycles_;
+    thread flusher_;
+
+    atomic<size_t> puts_;
+    atomic<size_t> coalesced_;
+    atomic<size_t> batches_;
+    atomic<size_t> flushedEntries_;
+    atomic<size_t> evictionFlushes_;
+    atomic<size_t> failedBatches_;
+
+public:
+    using UnflushedHandler = function<void(Batch&&)>;
+
+    WriteBehindCache() = delete;
+    WriteBehindCache(ICachePolicy<Key, Value>& cache, BackingStore<Key, Value>& store,
+        size_t batchSize = 64, chrono::milliseconds flushInterval = chrono::milliseconds(100));
+    ~WriteBehindCache() override;
+
+    void put(const Key& key, const Value& value) override;
+    optional<Value> get(const Key& key) override;
+    bool remove(const Key& key) override;
+    bool isExists(const Key& key) override;
+    optional<Value> peek(const Key& key) override;
+    CacheStats stats() override { return this->cache_.stats(); }
+
+    //blocks until everything dirty at the time of the call has been handed to the store
+    //entries of a failed batch stay dirty and are retried later, while the store fails this waits out the retry pause
+    void flush();
+    //stops the flusher after writing everything dirty, a failing store gets SHUTDOWN_ATTEMPTS attempts
+    //returns the entries it still refused, nothing is dropped; the cache must not be written to afterwards
+    Batch close();
+    //receives what the destructor could not write; without a handler the destructor retries until the store
+    //takes everything
+    void setUnflushedHandler(UnflushedHandler handler) { this->unflushedHandler_ = move(handler); }
+    size_t dirtyCount();
+    WriteBehindStats getStats();
+
+private:
+    mutex& writeMutexFor(const Key& key);
+    void markDirty(const Key& key, const optional<Value>& value);
+    void onEviction(const Key& key);
+    Batch stopFlusher(bool bounded);
+    void flushLoop();
+    bool writeOut(DirtyHash& pending, unique_lock<mutex>& lock);
+};
+
+template<typename Key, typename Value>
+WriteBehindCache<Key, Value>::WriteBehindCache(ICachePolicy<Key, Value>& cache, BackingStore<Key, Value>& store,
+    size_t batchSize, chrono::milliseconds flushInterval)
+    : cache_{ cache }, store_{ store }, batchSize_{ batchSize == 0 ? 1 : batchSize }, flushInterval_{ flushInterval },
+    urgent_{ false }, stopping_{ false }, cycleRunning_{ false }, boundedShutdown_{ true }, finishedCycles_{ 0 },
+    puts_{ 0 }, coalesced_{ 0 }, batches_{ 0 }, flushedEntries_{ 0 }, evictionFlushes_{ 0 }, failedBatches_{ 0 } {
+    this->cache_.setEvictionListener([this](const Key& key, const Value&) { onEviction(key); });
+    this->flusher_ = thread{ [this]() { flushLoop(); } };
+}
+
+template<typename Key, typename Value>
+WriteBehindCache<Key, Value>::~WriteBehindCache() {
+    if (this->flusher_.joinable()) {
+        Batch unflushed = stopFlusher(static_cast<bool>(this->unflushedHandler_));
+        if (!unflushed.empty())
+            this->unflushedHandler_(move(unflushed));
+    }
+}
+
+template<typename Key, typename Value>
+void WriteBehindCache<Key, Value>::put(const Key& key, const Value& value) {
+    lock_guard<mutex> lock{ writeMutexFor(key) };
+    this->cache_.put(key, value);
+    markDirty(key, value);
+    this->puts_++;
+}
+
+template<typename Key, typename Value>
+optional<Value> WriteBehindCache<Key, Value>::get(const Key& key) {
+    optional<Value> value = this->cache_.get(key);
+    if (value.has_value())
+        return value;
+
+    lock_guard<mutex> writeLock{ writeMutexFor(key) };
+    {
+        //evicted but not yet flushed, the dirty table is the newest copy
+        lock_guard<mutex> lock{ this->dirtyMutex_ };
+        auto it = this->dirtyHash_.find(key);
+        if (it != this->dirtyHash_.end())
+            return it->second;
+        it = this->flushingHash_.find(key);
+        if (it != this->flushingHash_.end())
+            return it->second;
+    }
+    value = this->store_.read(key);
+    if (value.has_value())
+        this->cache_.put(key, value.value());
+    return value;
+}
+
+template<typename Key, typename Value>
+bool WriteBehindCache<Key, Value>::remove(const Key& key) {
+    lock_guard<mutex> lock{ writeMutexFor(key) };
+    bool removed = this->cache_.remove(key);
+    markDirty(key, nullopt);
+    return removed;
+}
+
+template<typename Key, typename Value>
+bool WriteBehindCache<Key, Value>::isExists(const Key& key) {
+    return this->cache_.isExists(key);
+}
+
+//never reads the store, an evicted dirty entry is still visible
+template<typename Key, typename Value>
+optional<Value> WriteBehindCache<Key, Value>::peek(const Key& key) {
+    optional<Value> value = this->cache_.peek(key);
+    if (value.has_value())
+        return value;
+    lock_guard<mutex> lock{ this->dirtyMutex_ };
+    auto it = this->dirtyHash_.find(key);
+    if (it != this->dirtyHash_.end())
+        return it->second;
+    it = this->flushingHash_.find(key);
+    if (it != this->flushingHash_.end())
+        return it->second;
+    return nullopt;
+}
+
+template<typename Key, typename Value>
+void WriteBehindCache<Key, Value>::flush() {
+    unique_lock<mutex> lock{ this->dirtyMutex_ };
+    //a cycle already writing took its snapshot before our entries may have arrived
+    const unsigned long long target = this->finishedCycles_ + (this->cycleRunning_ ? 2 : 1);
+    this->urgent_ = true;
+    this->flushWanted_.notify_one();
+    this->flushDone_.wait(lock, [this, target]() {
+        return this->finishedCycles_ >= target;
+    });
+}
+
+template<typename Key, typename Value>
+typename WriteBehindCache<Key, Value>::Batch WriteBehindCache<Key, Value>::close() {
+    if (!this->flusher_.joinable())
+        return Batch{};
+    return stopFlusher(true);
+}
+
+template<typename Key, typename Value>
+typename WriteBehindCache<Key, Value>::Batch WriteBehindCache<Key, Value>::stopFlusher(bool bounded) {
+    {
+        lock_guard<mutex> lock{ this->dirtyMutex_ };
+        this->boundedShutdown_ = bounded;
+        this->stopping_ = true;
+    }
+    this->flushWanted_.notify_all();
+    this->flusher_.join();
+    this->cache_.setEvictionListener(nullptr);
+
+    Batch unflushed;
+    lock_guard<mutex> lock{ this->dirtyMutex_ };
+    unflushed.reserve(this->dirtyHash_.size());
+    for (auto& entry : this->dirtyHash_) {
+        unflushed.emplace_back(entry.first, move(entry.second));
+    }
+    this->dirtyHash_.clear();
+    return unflushed;
+}
+
+template<typename Key, typename Value>
+size_t WriteBehindCache<Key, Value>::dirtyCount() {
+    lock_guard<mutex> lock{ this->dirtyMutex_ };
+    return this->dirtyHash_.size() + this->flushingHash_.size();
+}
+
+template<typename Key, typename Value>
+WriteBehindStats WriteBehindCache<Key, Value>::getStats() {
+    return WriteBehindStats{ this->puts_.load(), this->coalesced_.load(), this->batches_.load(),
+        this->flushedEntries_.load(), this->evictionFlushes_.load(), this->failedBatches_.load() };
+}
+
+template<typename Key, typename Value>
+mutex& WriteBehindCache<Key, Value>::writeMutexFor(const Key& key) {
+    return this->writeMutex_[hash<Key>{}(key) % WRITE_STRIPES];
+}
+
+template<typename Key, typename Value>
+void WriteBehindCache<Key, Value>::markDirty(const Key& key, const optional<Value>& value) {
+    bool full = false;
+    {
+        lock_guard<mutex> lock{ this->dirtyMutex_ };
+        auto it = this->dirtyHash_.find(key);
+        if (it != this->dirtyHash_.end()) {
+            it->second = value;
+            this->coalesced_++;
+        }
+        else {
+            this->dirtyHash_.emplace(key, value);
+        }
+        full = this->dirtyHash_.size() >= this->batchSize_;
+    }
+    if (full)
+        this->flushWanted_.notify_one();
+}
+
+//called under the engine lock, only the dirty table may be touched here
+template<typename Key, typename Value>
+void WriteBehindCache<Key, Value>::onEviction(const Key& key) {
+    {
+        lock_guard<mutex> lock{ this->dirtyMutex_ };
+        if (this->dirtyHash_.find(key) == this->dirtyHash_.end())
+            return;
+        this->urgent_ = true;
+        this->evictionFlushes_++;
+    }
+    this->flushWanted_.notify_one();
+}
+
+template<typename Key, typename Value>
+void WriteBehindCache<Key, Value>::flushLoop() {
+    unique_lock<mutex> lock{ this->dirtyMutex_ };
+    unsigned int failedAttempts = 0;
+    unsigned int failedCycles = 0;
+    chrono::milliseconds backoff = FIRST_BACKOFF;
+    while (true) {
+        if (failedCycles == 0) {
+            this->flushWanted_.wait_for(lock, this->flushInterval_, [this]() {
+                return this->stopping_ || this->urgent_ || this->dirtyHash_.size() >= this->batchSize_;
+            });
+        }
+        else {
+            //the failed entries are dirty again and would fill a batch at once, only shutdown cuts the pause short
+            const unsigned int doublings = min(failedCycles - 1, MAX_RETRY_DOUBLINGS);
+            this->flushWanted_.wait_for(lock, this->flushInterval_ * (1u << doublings), [this]() {
+                return this->stopping_;
+            });
+        }
+        this->urgent_ = false;
+        this->cycleRunning_ = true;
+        bool written = true;
+        if (!this->dirtyHash_.empty()) {
+            DirtyHash pending;
+            pending.swap(this->dirtyHash_);
+            written = writeOut(pending, lock);
+        }
+        this->cycleRunning_ = false;
+        this->finishedCycles_++;
+        this->flushDone_.notify_all();
+        if (!this->stopping_ || written) {
+            failedCycles = written ? 0 : failedCycles + 1;
+            if (this->stopping_ && this->dirtyHash_.empty())
+                return;
+            continue;
+        }
+        //the store fails at shutdown: failed entries are dirty again, retry after a doubling pause
+        //a bounded shutdown leaves them in the dirty table for stopFlusher to hand back
+        if (this->boundedShutdown_ && ++failedAttempts >= SHUTDOWN_ATTEMPTS)
+            return;
+        lock.unlock();
+        this_thread::sleep_for(backoff);
+        lock.lock();
+        backoff = min(backoff * 2, MAX_BACKOFF);
+    }
+}
+
+//entered and left with dirtyMutex_ held, released around the store calls
+template<typename Key, typename Value>
+bool WriteBehindCache<Key, Value>::writeOut(DirtyHash& pending, unique_lock<mutex>& lock) {
+    this->flushingHash_ = pending;
+    auto it = pending.begin();
+    while (it != pending.end()) {
+        Batch batch;
+        batch.reserve(this->batchSize_);
+        for (; it != pending.end() && batch.size() < this->batchSize_; ++it) {
+            batch.emplace_back(it->first, it->second);
+        }
+        lock.unlock();
+        bool written = true;
+        try {
+            this->store_.writeBatch(batch);
+        }
+        catch (...) {
+            written = false;
+        }
+        lock.lock();
+        if (!written) {
+            //keep failed entries dirty unless a newer put already replaced them
+            this->failedBatches_++;
+            for (auto& entry : batch) {
+                this->dirtyHash_.emplace(entry.first, entry.second);
+            }
+        }
+        else {
+            this->batches_++;
+            this->flushedEntries_ += batch.size();
+        }
+        for (auto& entry : batch) {
+            this->flushingHash_.erase(entry.first);
+        }
+        if (!written) {
+            //the store is failing, leave the rest dirty for flushLoop's retry pause
+            for (; it != pending.end(); ++it) {
+                this->dirtyHash_.emplace(it->first, it->second);
+                this->flushingHash_.erase(it->first);
+            }
+            return false;
+        }
+    }
+    return true;
+}
@@ -0,0 +1,391 @@
+#pragma once
+
+#include <iostream>
+#include <string>
+#include <chrono>
+#include <iomanip>
+#include <random>
+#include <algorithm>
+#include <vector>
+#include <atomic>
+#include <thread>
+#include <memory>
+#include <stdexcept>
+#include <sstream>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+
+#include "options.h"
+#include "UseTemplate/ICachePolicy.h"
+#include "UseTemplate/CachePolicyFactory.h"
+#include "UseTemplate/ProcessMemory.h"
+#include "UseTemplate/Stats/CycleClock.h"
+#include "UseTemplate/Stats/LatencyHistogram.h"
+
+//multithreaded throughput benchmark, run as `CachingStrategy bench [options]`, see printBenchmarkUsage()
+//every engine is driven through ICachePolicy as a read-through cache: a read is get() and a put() when it missed,
+//a write is put(); the key stream of each thread is generated before the clock starts
+
+enum class KeyDistribution {
+    Uniform,
+    Zipf,       //skewed, rank 0 is the hottest key
+    Scan,       //zipf traffic with one-shot sequential reads over keys outside the zipf range mixed in
+    Shifting    //zipf whose hot set moves to fresh keys every shiftEvery operations
+};
+
+struct BenchmarkConfig {
+    std::vector<std::string> engines = cachePolicyNames();
+    std::vector<unsigned int> threads{ 1, std::max(2u, std::thread::hardware_concurrency()) };
+    std::vector<KeyDistribution> distributions{ KeyDistribution::Uniform, KeyDistribution::Zipf, KeyDistribution::Scan, KeyDistribution::Shifting };
+    double readRatio = 0.9;
+    double zipfSkew = 0.99;
+    double scanRatio = 0.2;                 //share of Scan operations that read the next sequential key
+    uint64_t shiftEvery = 100000;           //per thread, for Shifting
+    uint64_t keySpace = 100000;
+    unsigned int capacity = 10000;
+    size_t valueSize = 100;
+    uint64_t operationsPerThread = 200000;
+    uint64_t warmupPerThread = 50000;       //untimed, fills the cache before the measured run
+    uint64_t seed = 42;
+    std::string format = "csv";
+};
+
+struct BenchmarkResult {
+    std::string engine;
+    KeyDistribution distribution;
+    unsigned int threads;
+    uint64_t operations;
+    double seconds;
+    uint64_t reads;
+    uint64_t hits;
+    HistogramSnapshot latency;      //sampled, one operation in LATENCY_SAMPLE_EVERY per thread
+    size_t peakRss;                 //of the whole process so far, grows monotonically across runs
+    size_t rssGrowth;               //resident bytes the engine still held when its run ended
+
+    double opsPerSecond() const { return this->seconds > 0 ? this->operations / this->seconds : 0.0; }
+    double hitRatio() const { return this->reads == 0 ? 0.0 : static_cast<double>(this->hits) / this->reads; }
+};
+
+//ycsb-style zipf sampler (Gray et al.), o(n) setup once and o(1) per draw; skew must be in (0, 1)
+class ZipfGenerator {
+private:
+    uint64_t items_;
+    double zetaN_;
+    double alpha_;
+    double eta_;
+    double secondThreshold_;
+
+public:
+    ZipfGenerator(uint64_t items, double skew);
+    //u uniform in [0, 1)
+    uint64_t rank(double u) const;
+};
+
+int runBenchmark(int argc, char* argv[]);
+
+void printBenchmarkUsage(std::ostream& out);
+
+BenchmarkConfig parseBenchmarkArgs(int argc, char* argv[]);
+
+//one word per operation: key << 1, low bit set for a write
+std::vector<uint64_t> generateOperations(const BenchmarkConfig& config, KeyDistribution distribution, const ZipfGenerator& zipf,
+    unsigned int thread, unsigned int threads);
+
+BenchmarkResult runBenchmarkCase(const BenchmarkConfig& config, const std::string& engine, KeyDistribution distribution,
+    unsigned int threads, const ZipfGenerator& zipf);
+
+void printBenchmarkHeader(const BenchmarkConfig& config);
+
+void printBenchmarkResult(const BenchmarkConfig& config, const BenchmarkResult& result, bool first);
+
+void printBenchmarkFooter(const BenchmarkConfig& config);
+
+const char* distributionName(KeyDistribution distribution);
+
+// Implementation
+
+const uint64_t LATENCY_SAMPLE_EVERY = 8;
+
+ZipfGenerator::ZipfGenerator(uint64_t items, double skew) : items_{ items }, zetaN_{ 0.0 } {
+    if (items < 2)
+        throw std::runtime_error("In benchmark.h-----zipf needs at least two keys");
+    if (!(skew > 0.0 && skew < 1.0))
+        throw std::runtime_error("In benchmark.h-----zipf skew must be in (0, 1)");
+    for (uint64_t i = 1; i <= items; ++i)
+        this->zetaN_ += 1.0 / std::pow(static_cast<double>(i), skew);
+    const double zeta2 = 1.0 + std::pow(0.5, skew);
+    this->alpha_ = 1.0 / (1.0 - skew);
+    this->eta_ = (1.0 - std::pow(2.0 / items, 1.0 - skew)) / (1.0 - zeta2 / this->zetaN_);
+    this->secondThreshold_ = zeta2;
+}
+
+uint64_t ZipfGenerator::rank(double u) const {
+    const double uz = u * this->zetaN_;
+    if (uz < 1.0)
+        return 0;
+    if (uz < this->secondThreshold_)
+        return 1;
+    const uint64_t rank = static_cast<uint64_t>(this->items_ * std::pow(this->eta_ * u - this->eta_ + 1.0, this->alpha_));
+    return std::min(rank, this->items_ - 1);
+}
+
+const char* distributionName(KeyDistribution distribution) {
+    switch (distribution) {
+    case KeyDistribution::Uniform: return "uniform";
+    case KeyDistribution::Zipf: return "zipf";
+    case KeyDistribution::Scan: return "scan";
+    case KeyDistribution::Shifting: return "shifting";
+    }
+    return "unknown";
+}
+
+void printBenchmarkUsage(std::ostream& out) {
+    BenchmarkConfig defaults;
+    std::string engines;
+    for (const std::string& name : cachePolicyNames())
+        engines += (engines.empty() ? "" : ",") + name;
+    out << "usage: CachingStrategy bench [options]\n"
+        << "  --engines LIST      " << engines << " (default all)\n"
+        << "  --threads LIST      thread counts to sweep (default 1," << defaults.threads.back() << ")\n"
+        << "  --dist LIST         uniform,zipf,scan,shifting (default all)\n"
+        << "  --read R            share of reads, the rest are puts (default " << defaults.readRatio << ")\n"
+        << "  --zipf S            zipf skew in (0, 1) (default " << defaults.zipfSkew << ")\n"
+        << "  --scan-ratio R      share of sequential one-shot reads in scan (default " << defaults.scanRatio << ")\n"
+        << "  --shift-every N     operations per thread between hot-set moves in shifting (default " << defaults.shiftEvery << ")\n"
+        << "  --keys N            distinct keys (default " << defaults.keySpace << ")\n"
+        << "  --capacity N        entries per engine (default " << defaults.capacity << ")\n"
+        << "  --value-size N      bytes per value (default " << defaults.valueSize << ")\n"
+        << "  --ops N             measured operations per thread (default " << defaults.operationsPerThread << ")\n"
+        << "  --warmup N          untimed operations per thread first (default " << defaults.warmupPerThread << ")\n"
+        << "  --seed N            workload seed (default " << defaults.seed << ")\n"
+        << "  --format csv|json   results on stdout, progress on stderr (default csv)\n";
+}
+
+BenchmarkConfig parseBenchmarkArgs(int argc, char* argv[]) {
+    BenchmarkConfig config;
+    for (int i = 0; i < argc; ++i) {
+        const std::string option = argv[i];
+        if (option == "--help" || option == "-h") {
+            printBenchmarkUsage(std::cout);
+            std::exit(0);
+        }
+        if (i + 1 >= argc)
+            throw std::runtime_error("In benchmark.h-----" + option + " needs a value");
+        const std::string value = argv[++i];
+        if (option == "--engines") {
+            config.engines = splitOptionList(value);
+            for (const std::string& engine : config.engines)
+                makeCachePolicy<uint64_t, std::string>(engine, 2);
+        }
+        else if (option == "--threads") {
+            config.threads.clear();
+            for (const std::string& item : splitOptionList(value)) {
+                const unsigned int threads = static_cast<unsigned int>(parseOptionNumber(option, item));
+                if (threads == 0)
+                    throw std::runtime_error("In benchmark.h-------threads must be positive");
+                config.threads.push_back(threads);
+            }
+        }
+        else if (option == "--dist") {
+            config.distributions.clear();
+            for (const std::string& item : splitOptionList(value)) {
+                if (item == "uniform") config.distributions.push_back(KeyDistribution::Uniform);
+                else if (item == "zipf") config.distributions.push_back(KeyDistribution::Zipf);
+                else if (item == "scan") config.distributions.push_back(KeyDistribution::Scan);
+                else if (item == "shifting") config.distributions.push_back(KeyDistribution::Shifting);
+                else throw std::runtime_error("In benchmark.h-----unknown distribution '" + item + "'");
+            }
+        }
+        else if (option == "--read") config.readRatio = std::min(parseOptionNumber(option, value), 1.0);
+        else if (option == "--zipf") config.zipfSkew = parseOptionNumber(option, value);
+        else if (option == "--scan-ratio") config.scanRatio = std::min(parseOptionNumber(option, value), 1.0);
+        else if (option == "--shift-every") config.shiftEvery = std::max<uint64_t>(static_cast<uint64_t>(parseOptionNumber(option, value)), 1);
+        else if (option == "--keys") config.keySpace = static_cast<uint64_t>(parseOptionNumber(option, value));
+        else if (option == "--capacity") config.capacity = static_cast<unsigned int>(parseOptionNumber(option, value));
+        else if (option == "--value-size") config.valueSize = static_cast<size_t>(parseOptionNumber(option, value));
+        else if (option == "--ops") config.operationsPerThread = static_cast<uint64_t>(parseOptionNumber(option, value));
+        else if (option == "--warmup") config.warmupPerThread = static_cast<uint64_t>(parseOptionNumber(option, value));
+        else if (option == "--seed") config.seed = static_cast<uint64_t>(parseOptionNumber(option, value));
+        else if (option == "--format") {
+            if (value != "csv" && value != "json")
+                throw std::runtime_error("In benchmark.h-------format is csv or json");
+            config.format = value;
+        }
+        else throw std::runtime_error("In benchmark.h-----unknown option " + option);
+    }
+    if (config.capacity < 2)
+        throw std::runtime_error("In benchmark.h-------capacity must be at least 2");
+    return config;
+}
+
+std::vector<uint64_t> generateOperations(const BenchmarkConfig& config, KeyDistribution distribution, const ZipfGenerator& zipf,
+    unsigned int thread, unsigned int threads) {
+    std::mt19937_64 gen(config.seed * 1000003 + thread);
+    std::uniform_real_distribution<double> unit(0.0, 1.0);
+    const uint64_t total = config.warmupPerThread + config.operationsPerThread;
+    //scan keys sit above the zipf range so a scan never touches a hot key, each thread sweeps its own part
+    uint64_t scanCursor = config.keySpace / threads * thread;
+
+    std::vector<uint64_t> operations;
+    operations.reserve(total);
+    for (uint64_t i = 0; i < total; ++i) {
+        uint64_t key = 0;
+        switch (distribution) {
+        case KeyDistribution::Uniform:
+            key = gen() % config.keySpace;
+            break;
+        case KeyDistribution::Zipf:
+            key = zipf.rank(unit(gen));
+            break;
+        case KeyDistribution::Scan:
+            if (unit(gen) < config.scanRatio) {
+                key = config.keySpace + scanCursor;
+                scanCursor = (scanCursor + 1) % config.keySpace;
+            }
+            else {
+                key = zipf.rank(unit(gen));
+            }
+            break;
+        case KeyDistribution::Shifting:
+            //each phase moves the head by a full capacity, so last phase's hot keys are all cold now
+            key = (zipf.rank(unit(gen)) + i / config.shiftEvery * config.capacity) % config.keySpace;
+            break;
+        }
+        const bool write = unit(gen) >= config.readRatio;
+        operations.push_back(key << 1 | (write ? 1 : 0));
+    }
+    return operations;
+}
+
+BenchmarkResult runBenchmarkCase(const BenchmarkConfig& config, const std::string& engine, KeyDistribution distribution,
+    unsigned int threads, const ZipfGenerator& zipf) {
+    std::vector<std::vector<uint64_t>> operations(threads);
+    for (unsigned int t = 0; t < threads; ++t)
+        operations[t] = generateOperations(config, distribution, zipf, t, threads);
+    const std::string value(config.valueSize, 'v');
+
+    const size_t rssBefore = ProcessMemory::currentRss();
+    std::unique_ptr<ICachePolicy<uint64_t, std::string>> cache = makeCachePolicy<uint64_t, std::string>(engine, config.capacity);
+    LatencyHistogram latency;
+    std::vector<uint64_t> reads(threads, 0), hits(threads, 0);
+    std::atomic<unsigned int> warmed{ 0 };
+    std::atomic<bool> go{ false };
+
+    auto execute = [&](uint64_t operation, uint64_t& threadReads, uint64_t& threadHits) {
+        const uint64_t key = operation >> 1;
+        if (operation & 1) {
+            cache->put(key, value);
+            return;
+        }
+        ++threadReads;
+        if (cache->get(key))
+            ++threadHits;
+        else
+            cache->put(key, value);
+    };
+
+    std::vector<std::thread> workers;
+    for (unsigned int t = 0; t < threads; ++t) {
+        workers.emplace_back([&, t]() {
+            const std::vector<uint64_t>& mine = operations[t];
+            uint64_t ignoredReads = 0, ignoredHits = 0;
+            for (uint64_t i = 0; i < config.warmupPerThread; ++i)
+                execute(mine[i], ignoredReads, ignoredHits);
+            warmed.fetch_add(1);
+            while (!go.load(std::memory_order_acquire))
+                std::this_thread::yield();
+
+            uint64_t threadReads = 0, threadHits = 0;
+            const size_t stripe = t % LatencyHistogram::STRIPES;
+            for (uint64_t i = config.warmupPerThread; i < mine.size(); ++i) {
+                if (i % LATENCY_SAMPLE_EVERY != 0) {
+                    execute(mine[i], threadReads, threadHits);
+                    continue;
+                }
+                const uint64_t start = CycleClock::now();
+                execute(mine[i], threadReads, threadHits);
+                latency.record(stripe, CycleClock::now() - start);
+            }
+            reads[t] = threadReads;
+            hits[t] = threadHits;
+        });
+    }
+    while (warmed.load() != threads)
+        std::this_thread::yield();
+    const auto start = std::chrono::steady_clock::now();
+    go.store(true, std::memory_order_release);
+    for (std::thread& worker : workers)
+        worker.join();
+    const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    const size_t rssAfter = ProcessMemory::currentRss();
+
+    BenchmarkResult result{ engine, distribution, threads, config.operationsPerThread * threads, seconds, 0, 0,
+        latency.snapshot(), ProcessMemory::peakRss(), rssAfter > rssBefore ? rssAfter - rssBefore : 0 };
+    for (unsigned int t = 0; t < threads; ++t) {
+        result.reads += reads[t];
+        result.hits += hits[t];
+    }
+    return result;
+}
+
+void printBenchmarkHeader(const BenchmarkConfig& config) {
+    if (config.format == "json") {
+        std::cout << "[" << std::endl;
+        return;
+    }
+    std::cout << "engine,distribution,threads,read_ratio,key_space,capacity,value_size,operations,seconds,ops_per_sec,"
+        "hit_ratio,p50_ns,p99_ns,p999_ns,max_ns,peak_rss_bytes,rss_growth_bytes" << std::endl;
+}
+
+void printBenchmarkResult(const BenchmarkConfig& config, const BenchmarkResult& result, bool first) {
+    const double p50 = result.latency.percentile(0.5);
+    const double p99 = result.latency.percentile(0.99);
+    const double p999 = result.latency.percentile(0.999);
+    const double max = result.latency.max();
+    std::ostringstream line;
+    line << std::fixed;
+    if (config.format == "json") {
+        line << (first ? "  " : ",\n  ") << "{\"engine\": \"" << result.engine << "\", \"distribution\": \""
+            << distributionName(result.distribution) << "\", \"threads\": " << result.threads << std::setprecision(3)
+            << ", \"read_ratio\": " << config.readRatio << ", \"key_space\": " << config.keySpace << ", \"capacity\": "
+            << config.capacity << ", \"value_size\": " << config.valueSize << ", \"operations\": " << result.operations
+            << std::setprecision(6) << ", \"seconds\": " << result.seconds << std::setprecision(0) << ", \"ops_per_sec\": "
+            << result.opsPerSecond() << std::setprecision(6) << ", \"hit_ratio\": " << result.hitRatio() << std::setprecision(0)
+            << ", \"p50_ns\": " << p50 << ", \"p99_ns\": " << p99 << ", \"p999_ns\": " << p999 << ", \"max_ns\": " << max
+            << ", \"peak_rss_bytes\": " << result.peakRss << ", \"rss_growth_bytes\": " << result.rssGrowth << "}";
+        std::cout << line.str() << std::flush;
+        return;
+    }
+    line << result.engine << "," << distributionName(result.distribution) << "," << result.threads << std::setprecision(3)
+        << "," << config.readRatio << "," << config.keySpace << "," << config.capacity << "," << config.valueSize << ","
+        << result.operations << std::setprecision(6) << "," << result.seconds << std::setprecision(0) << ","
+        << result.opsPerSecond() << std::setprecision(6) << "," << result.hitRatio() << std::setprecision(0) << ","
+        << p50 << "," << p99 << "," << p999 << "," << max << "," << result.peakRss << "," << result.rssGrowth;
+    std::cout << line.str() << std::endl;
+}
+
+void printBenchmarkFooter(const BenchmarkConfig& config) {
+    if (config.format == "json")
+        std::cout << "\n]" << std::endl;
+}
+
+int runBenchmark(int argc, char* argv[]) {
+    const BenchmarkConfig config = parseBenchmarkArgs(argc, argv);
+    //the zipf tables depend only on the key space and skew, build them once for every case
+    const ZipfGenerator zipf(config.keySpace, config.zipfSkew);
+
+    printBenchmarkHeader(config);
+    bool first = true;
+    for (KeyDistribution distribution : config.distributions) {
+        for (unsigned int threads : config.threads) {
+            for (const std::string& engine : config.engines) {
+                std::cerr << distributionName(distribution) << " x" << threads << " " << engine << "..." << std::endl;
+                printBenchmarkResult(config, runBenchmarkCase(config, engine, distribution, threads, zipf), first);
+                first = false;
+            }
+        }
+    }
+    printBenchmarkFooter(config);
+    return 0;
+}
@@ -1,13 +1,22 @@
 #include"test.h"
+#include"benchmark.h"
+#include"simulator.h"
 
 
-int main() {
+//no arguments runs the functional checks in test.h, `bench [options]` runs the benchmark suite
+//and `simulate <trace> [options]` replays an access trace
+int main(int argc, char* argv[]) {
     try {
+        if (argc > 1 && string(argv[1]) == "bench")
+            return runBenchmark(argc - 2, argv + 2);
+        if (argc > 1 && string(argv[1]) == "simulate")
+            return runSimulator(argc - 2, argv + 2);
         test();
     }
     catch (const exception& e) {
         cerr << "Error: " << e.what() << endl;
+        return 1;
     }
 
     return 0;
-}
\ No newline at end of file
+}
@@ -0,0 +1,35 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <sstream>
+#include <stdexcept>
+
+//command line helpers shared by the bench and simulate tools
+
+//"a,b,c" -> {a, b, c}, empty items are dropped and an empty list is an error
+std::vector<std::string> splitOptionList(const std::string& list) {
+    std::vector<std::string> items;
+    std::stringstream stream(list);
+    std::string item;
+    while (std::getline(stream, item, ','))
+        if (!item.empty())
+            items.push_back(item);
+    if (items.empty())
+        throw std::runtime_error("In options.h-----empty list '" + list + "'");
+    return items;
+}
+
+double parseOptionNumber(const std::string& option, const std::string& text) {
+    size_t used = 0;
+    double value = 0.0;
+    try {
+        value = std::stod(text, &used);
+    }
+    catch (const std::exception&) {
+        used = 0;
+    }
+    if (used != text.size() || value < 0)
+        throw std::runtime_error("In options.h-----" + option + " expects a non-negative number, got '" + text + "'");
+    return value;
+}
@@ -0,0 +1,161 @@
+#pragma once
+
+#include <iostream>
+#include <string>
+#include <chrono>
+#include <iomanip>
+#include <vector>
+#include <stdexcept>
+#include <cstdlib>
+
+#include "options.h"
+#include "UseTemplate/CachePolicyFactory.h"
+#include "UseTemplate/Simulator/CacheSimulator.h"
+
+//trace-driven miss-ratio simulator, run as `CachingStrategy simulate <trace> [options]`, see printSimulatorUsage()
+
+struct SimulatorConfig {
+    std::string tracePath;
+    TraceFormat format = TraceFormat::Auto;
+    unsigned int keyColumn = 0;
+    unsigned int sizeColumn = 1;
+    std::vector<std::string> policies{ "lru", "lru-k", "lfu", "aging-lfu", "arc" };
+    std::vector<unsigned int> capacities{ 1000, 10000, 100000 };
+    unsigned int workers = 0;               //0 is one thread per policy/capacity pair
+    std::string output = "table";
+    std::string convertPath;                //write the trace as binary instead of simulating
+};
+
+int runSimulator(int argc, char* argv[]);
+
+void printSimulatorUsage(std::ostream& out);
+
+SimulatorConfig parseSimulatorArgs(int argc, char* argv[]);
+
+void printMissRatioTable(const SimulatorConfig& config, const std::vector<SimulationResult>& results, bool bytes);
+
+void printSimulationCsv(const std::vector<SimulationResult>& results);
+
+// Implementation
+
+void printSimulatorUsage(std::ostream& out) {
+    std::string policies;
+    for (const std::string& name : cachePolicyNames())
+        policies += (policies.empty() ? "" : ",") + name;
+    out << "usage: CachingStrategy simulate TRACE [options]\n"
+        << "  --format F          auto|text|csv|binary (default auto: binary by magic, csv by extension, else text)\n"
+        << "  --key-column N      csv column holding the key (default 0)\n"
+        << "  --size-column N     csv column holding the size (default 1)\n"
+        << "  --policies LIST     any of " << policies << " (default lru,lru-k,lfu,aging-lfu,arc)\n"
+        << "  --capacities LIST   entries per cache (default 1000,10000,100000)\n"
+        << "  --workers N         threads, pairs are shared out round-robin (default one per pair)\n"
+        << "  --output table|csv  miss-ratio table or one csv row per pair (default table)\n"
+        << "  --convert PATH      write TRACE in the binary format to PATH and exit\n";
+}
+
+SimulatorConfig parseSimulatorArgs(int argc, char* argv[]) {
+    SimulatorConfig config;
+    for (int i = 0; i < argc; ++i) {
+        const std::string option = argv[i];
+        if (option == "--help" || option == "-h") {
+            printSimulatorUsage(std::cout);
+            std::exit(0);
+        }
+        if (option.compare(0, 2, "--") != 0) {
+            if (!config.tracePath.empty())
+                throw std::runtime_error("In simulator.h-----more than one trace given");
+            config.tracePath = option;
+            continue;
+        }
+        if (i + 1 >= argc)
+            throw std::runtime_error("In simulator.h-----" + option + " needs a value");
+        const std::string value = argv[++i];
+        if (option == "--format") {
+            if (value == "auto") config.format = TraceFormat::Auto;
+            else if (value == "text") config.format = TraceFormat::Text;
+            else if (value == "csv") config.format = TraceFormat::Csv;
+            else if (value == "binary") config.format = TraceFormat::Binary;
+            else throw std::runtime_error("In simulator.h-----unknown trace format '" + value + "'");
+        }
+        else if (option == "--key-column") config.keyColumn = static_cast<unsigned int>(parseOptionNumber(option, value));
+        else if (option == "--size-column") config.sizeColumn = static_cast<unsigned int>(parseOptionNumber(option, value));
+        else if (option == "--policies") config.policies = splitOptionList(value);
+        else if (option == "--capacities") {
+            config.capacities.clear();
+            for (const std::string& item : splitOptionList(value)) {
+                const unsigned int capacity = static_cast<unsigned int>(parseOptionNumber(option, item));
+                if (capacity == 0)
+                    throw std::runtime_error("In simulator.h-----capacities must be positive");
+                config.capacities.push_back(capacity);
+            }
+        }
+        else if (option == "--workers") config.workers = static_cast<unsigned int>(parseOptionNumber(option, value));
+        else if (option == "--output") {
+            if (value != "table" && value != "csv")
+                throw std::runtime_error("In simulator.h-----output is table or csv");
+            config.output = value;
+        }
+        else if (option == "--convert") config.convertPath = value;
+        else throw std::runtime_error("In simulator.h-----unknown option " + option);
+    }
+    if (config.tracePath.empty())
+        throw std::runtime_error("In simulator.h-----no trace given, see simulate --help");
+    return config;
+}
+
+void printMissRatioTable(const SimulatorConfig& config, const std::vector<SimulationResult>& results, bool bytes) {
+    std::cout << (bytes ? "byte miss ratio" : "miss ratio") << std::endl;
+    std::cout << std::left << std::setw(12) << "capacity";
+    for (const std::string& policy : config.policies)
+        std::cout << std::setw(12) << policy;
+    std::cout << std::endl << std::fixed << std::setprecision(4);
+    //results come capacity-major in the order of config.policies
+    for (size_t row = 0; row < config.capacities.size(); ++row) {
+        std::cout << std::setw(12) << config.capacities[row];
+        for (size_t column = 0; column < config.policies.size(); ++column) {
+            const SimulationResult& result = results[row * config.policies.size() + column];
+            std::cout << std::setw(12) << (bytes ? result.byteMissRatio() : result.missRatio());
+        }
+        std::cout << std::endl;
+    }
+    std::cout << std::right;
+}
+
+void printSimulationCsv(const std::vector<SimulationResult>& results) {
+    std::cout << "policy,capacity,requests,misses,miss_ratio,bytes,miss_bytes,byte_miss_ratio" << std::endl;
+    std::cout << std::fixed << std::setprecision(6);
+    for (const SimulationResult& result : results) {
+        std::cout << result.policy << "," << result.capacity << "," << result.requests << "," << result.misses << ","
+            << result.missRatio() << "," << result.bytes << "," << result.missBytes << "," << result.byteMissRatio() << std::endl;
+    }
+}
+
+int runSimulator(int argc, char* argv[]) {
+    const SimulatorConfig config = parseSimulatorArgs(argc, argv);
+    CacheSimulator simulator(config.tracePath, config.format, config.keyColumn, config.sizeColumn);
+    const auto start = std::chrono::steady_clock::now();
+
+    if (!config.convertPath.empty()) {
+        const uint64_t requests = simulator.convert(config.convertPath);
+        std::cerr << "wrote " << requests << " requests to " << config.convertPath << std::endl;
+        return 0;
+    }
+
+    const std::vector<SimulationResult> results = simulator.run(config.policies, config.capacities, config.workers);
+    const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    const uint64_t requests = results.empty() ? 0 : results.front().requests;
+    std::cerr << std::fixed << std::setprecision(2) << requests << " requests x " << results.size() << " caches in "
+        << seconds << " s" << std::endl;
+
+    if (config.output == "csv") {
+        printSimulationCsv(results);
+        return 0;
+    }
+    printMissRatioTable(config, results, false);
+    //a text trace has no sizes, its byte ratio would just repeat the first table
+    if (simulator.format() != TraceFormat::Text) {
+        std::cout << std::endl;
+        printMissRatioTable(config, results, true);
+    }
+    return 0;
+}